@@ -0,0 +1,365 @@
+// BuildFlags.cpp : Build flag audit of the compilands of a PDB
+//
+
+#include "BuildFlags.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+#include "Util.h"
+
+#define S_THUNK32                   0x1102
+#define S_LPROC32                   0x110F
+#define S_GPROC32                   0x1110
+#define S_COMPILE2                  0x1116
+#define S_COMPILE3                  0x113C
+#define S_ENVBLOCK                  0x113D
+#define S_LPROC32_ID                0x1146
+#define S_GPROC32_ID                0x1147
+#define S_BUILDINFO                 0x114C
+
+#define COMPILE_LTCG                0x00000400
+#define COMPILE_SECURITY_CHECKS     0x00002000
+
+#define CV_CFL_C                    0x00
+#define CV_CFL_CXX                  0x01
+
+#define BUILDINFO_COMMAND_LINE      4
+
+// The records with an end offset, ending at their S_END
+static bool IsScopeKind(uint16_t kind)
+{
+	return kind == S_THUNK32 || kind == S_LPROC32 || kind == S_GPROC32 || kind == S_LPROC32_ID || kind == S_GPROC32_ID;
+}
+
+static bool EqualNoCase(const char * sz1, const char * sz2)
+{
+	for (; *sz1 != '\0' && tolower((unsigned char)*sz1) == tolower((unsigned char)*sz2); sz1++, sz2++) {
+	}
+
+	return *sz1 == *sz2 || tolower((unsigned char)*sz1) == tolower((unsigned char)*sz2);
+}
+
+////////////////////////////////////////////////////////////
+// The whole string of an LF_STRING_ID: its LF_SUBSTR_LIST,
+//  which long command lines are split into, then its own text
+//
+static void AppendStringId(const TpiStream & ipi, uint32_t id, std::string & text)
+{
+	uint16_t cb;
+	const uint8_t * pb = ipi.Record(id, &cb);
+
+	if (pb == NULL || ipi.Leaf(id) != LF_STRING_ID || cb < 4) {
+		return;
+	}
+
+	uint32_t idList = GetU32(pb);
+	const uint8_t * pbList = (idList != 0) ? ipi.Record(idList, &cb) : NULL;
+
+	if (pbList != NULL && ipi.Leaf(idList) == LF_SUBSTR_LIST && cb >= 4) {
+		uint32_t cIds = GetU32(pbList);
+
+		for (uint32_t i = 0; i < cIds && 8 + i * 4 <= cb; i++) {
+			const char * sz = ipi.StringId(GetU32(pbList + 4 + i * 4));
+
+			text += (sz != NULL) ? sz : "";
+		}
+	}
+
+	const char * sz = ipi.StringId(id);
+
+	text += (sz != NULL) ? sz : "";
+}
+
+////////////////////////////////////////////////////////////
+// Take the switches that decide the code from a command line,
+//  a later switch overrides an earlier one like cl does
+//
+void ParseBuildCommandLine(const char * szCommandLine, BuildFlags & flags)
+{
+	std::string option;
+
+	for (const char * pch = szCommandLine; *pch != '\0'; ) {
+		bool fQuoted = false;
+
+		while (*pch != '\0' && isspace((unsigned char)*pch)) {
+			pch++;
+		}
+
+		option.clear();
+
+		for (; *pch != '\0' && (fQuoted || !isspace((unsigned char)*pch)); pch++) {
+			if (*pch == '"') {
+				fQuoted = !fQuoted;
+			}
+
+			else {
+				option += *pch;
+			}
+		}
+
+		if (option.size() < 2 || (option[0] != '/' && option[0] != '-')) {
+			continue;
+		}
+
+		const char * sz = option.c_str() + 1;
+
+		if (!strcmp(sz, "Od") || !strcmp(sz, "O1") || !strcmp(sz, "O2") || !strcmp(sz, "Ox")) {
+			flags.optimization = sz;
+		}
+
+		else if ((!strcmp(sz, "Og") || !strcmp(sz, "Os") || !strcmp(sz, "Ot")) && flags.optimization.empty()) {
+			flags.optimization = sz;
+		}
+
+		else if (!strcmp(sz, "GL")) {
+			flags.flags |= BUILD_FLAG_LTCG;
+		}
+
+		else if (!strcmp(sz, "GL-")) {
+			flags.flags &= ~BUILD_FLAG_LTCG;
+		}
+
+		else if (!strncmp(sz, "arch:", 5)) {
+			flags.arch = sz + 5;
+		}
+
+		else if (!strcmp(sz, "MDd") || !strcmp(sz, "MTd") || !strcmp(sz, "LDd")) {
+			flags.flags |= BUILD_FLAG_DEBUG_CRT;
+		}
+
+		else if (!strcmp(sz, "MD") || !strcmp(sz, "MT") || !strcmp(sz, "LD")) {
+			flags.flags &= ~BUILD_FLAG_DEBUG_CRT;
+		}
+
+		else if (!strncmp(sz, "RTC", 3)) {
+			flags.flags |= BUILD_FLAG_RTC;
+		}
+
+		else if (!strcmp(sz, "GS")) {
+			flags.flags |= BUILD_FLAG_GS;
+		}
+
+		else if (!strcmp(sz, "GS-")) {
+			flags.flags &= ~BUILD_FLAG_GS;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Read the build flags of every module, one module per thread
+//  at a time, and keep the C and C++ compilands
+//
+bool BuildFlagAudit::Build(const PdbFile & pdb, const TpiStream * pIpi, unsigned cThreads)
+{
+	Clear();
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	std::vector<BuildFlags> modules(pdb.Modules().size());
+
+	ParallelFor(cThreads, modules.size(), [&](unsigned, size_t iModule) {
+		ReadModule(pdb, pIpi, (uint16_t)iModule, modules[iModule]);
+	});
+
+	for (BuildFlags & flags : modules) {
+		if (flags.language == CV_CFL_C || flags.language == CV_CFL_CXX) {
+			m_compilands.push_back(std::move(flags));
+		}
+	}
+
+	return !m_compilands.empty();
+}
+
+////////////////////////////////////////////////////////////
+// The compiler record, environment and build info of a module
+//
+//  S_BUILDINFO is usually the last record, so only the top
+//  level records are read, procedures are skipped to their end.
+//
+void BuildFlagAudit::ReadModule(const PdbFile & pdb, const TpiStream * pIpi, uint16_t iModule, BuildFlags & flags) const
+{
+	const PdbModule & module = pdb.Modules()[iModule];
+	std::vector<uint8_t> data;
+	std::string envCommandLine;
+	uint32_t idBuildInfo = 0;
+
+	flags.iModule = iModule;
+	flags.language = BUILD_LANGUAGE_NONE;
+	flags.machine = 0;
+	flags.verMajor = flags.verMinor = flags.verBuild = flags.verQfe = 0;
+	flags.flags = 0;
+	flags.issues = 0;
+
+	// The library is the archive the object was pulled from, or the
+	//  directory of the object
+
+	if (module.objName != module.name) {
+		flags.library = module.objName;
+	}
+
+	else {
+		size_t ich = module.name.find_last_of("\\/");
+
+		flags.library = (ich != std::string::npos) ? module.name.substr(0, ich) : "";
+	}
+
+	if (module.iStream == PDB_STREAM_NONE || !pdb.ReadStream(module.iStream, data)) {
+		return;
+	}
+
+	size_t cbSymbols = std::min<size_t>(module.cbSymbols, data.size());
+	bool fCompile = false;
+
+	for (size_t off = 4; off + 4 <= cbSymbols && !(fCompile && idBuildInfo != 0); ) {
+		const uint8_t * pRecord = &data[off];
+		uint16_t cbRecord = GetU16(pRecord);
+		uint16_t kind = GetU16(pRecord + 2);
+
+		if (cbRecord < 2 || off + 2 + cbRecord > cbSymbols) {
+			break;
+		}
+
+		const char * pchEnd = (const char *)pRecord + 2 + cbRecord;
+
+		off += 2 + cbRecord;
+
+		if (IsScopeKind(kind) && cbRecord >= 10 && GetU32(pRecord + 8) > off && GetU32(pRecord + 8) < cbSymbols) {
+			off = GetU32(pRecord + 8);
+		}
+
+		else if (kind == S_COMPILE3 && cbRecord >= 25) {
+			uint32_t dwFlags = GetU32(pRecord + 4);
+
+			flags.language = (uint8_t)dwFlags;
+			flags.machine = GetU16(pRecord + 8);
+			flags.verMajor = GetU16(pRecord + 18);
+			flags.verMinor = GetU16(pRecord + 20);
+			flags.verBuild = GetU16(pRecord + 22);
+			flags.verQfe = GetU16(pRecord + 24);
+			flags.flags |= (dwFlags & COMPILE_LTCG) ? BUILD_FLAG_LTCG : 0;
+			flags.flags |= (dwFlags & COMPILE_SECURITY_CHECKS) ? BUILD_FLAG_GS : 0;
+			flags.compiler.assign((const char *)pRecord + 26, strnlen((const char *)pRecord + 26, pchEnd - (const char *)pRecord - 26));
+			fCompile = true;
+		}
+
+		else if (kind == S_COMPILE2 && cbRecord >= 21) {
+			uint32_t dwFlags = GetU32(pRecord + 4);
+
+			flags.language = (uint8_t)dwFlags;
+			flags.machine = GetU16(pRecord + 8);
+			flags.verMajor = GetU16(pRecord + 16);
+			flags.verMinor = GetU16(pRecord + 18);
+			flags.verBuild = GetU16(pRecord + 20);
+			flags.flags |= (dwFlags & COMPILE_LTCG) ? BUILD_FLAG_LTCG : 0;
+			flags.flags |= (dwFlags & COMPILE_SECURITY_CHECKS) ? BUILD_FLAG_GS : 0;
+			flags.compiler.assign((const char *)pRecord + 22, strnlen((const char *)pRecord + 22, pchEnd - (const char *)pRecord - 22));
+			fCompile = true;
+		}
+
+		// Pairs of strings, ended by an empty one
+
+		else if (kind == S_ENVBLOCK && cbRecord >= 3) {
+			const char * pch = (const char *)pRecord + 5;
+
+			while (pch < pchEnd && *pch != '\0') {
+				const char * szKey = pch;
+				size_t cchKey = strnlen(szKey, pchEnd - pch);
+
+				pch += cchKey + 1;
+
+				if (pch >= pchEnd) {
+					break;
+				}
+
+				size_t cchValue = strnlen(pch, pchEnd - pch);
+
+				if (!strcmp(szKey, "cmd")) {
+					envCommandLine.assign(pch, cchValue);
+				}
+
+				pch += cchValue + 1;
+			}
+		}
+
+		else if (kind == S_BUILDINFO && cbRecord >= 6) {
+			idBuildInfo = GetU32(pRecord + 4);
+		}
+	}
+
+	// The build info has the command line without the response files
+	//  expanded, like the environment block of older compilers
+
+	if (pIpi != NULL && idBuildInfo != 0) {
+		uint16_t cb;
+		const uint8_t * pb = pIpi->Record(idBuildInfo, &cb);
+
+		if (pb != NULL && pIpi->Leaf(idBuildInfo) == LF_BUILDINFO && cb >= 2 && GetU16(pb) > BUILDINFO_COMMAND_LINE &&
+			2 + (BUILDINFO_COMMAND_LINE + 1) * 4 <= cb) {
+			AppendStringId(*pIpi, GetU32(pb + 2 + BUILDINFO_COMMAND_LINE * 4), flags.commandLine);
+		}
+	}
+
+	if (flags.commandLine.empty()) {
+		flags.commandLine = envCommandLine;
+	}
+
+	if (!flags.commandLine.empty()) {
+		flags.flags |= BUILD_FLAG_COMMAND_LINE;
+		ParseBuildCommandLine(flags.commandLine.c_str(), flags);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Set the issues of every compiland with a command line, the
+//  /arch check is skipped without szArch, "" is the default
+//
+uint32_t BuildFlagAudit::Audit(const char * szArch)
+{
+	bool fLtcg = false;
+	uint32_t cIssues = 0;
+
+	for (const BuildFlags & flags : m_compilands) {
+		fLtcg = fLtcg || (flags.flags & BUILD_FLAG_LTCG) != 0;
+	}
+
+	for (BuildFlags & flags : m_compilands) {
+		flags.issues = 0;
+
+		if (!(flags.flags & BUILD_FLAG_COMMAND_LINE)) {
+			continue;
+		}
+
+		if (flags.optimization != "O2" && flags.optimization != "Ox") {
+			flags.issues |= BUILD_ISSUE_NOT_OPTIMIZED;
+		}
+
+		if (fLtcg && !(flags.flags & BUILD_FLAG_LTCG)) {
+			flags.issues |= BUILD_ISSUE_NO_LTCG;
+		}
+
+		if (szArch != NULL && !EqualNoCase(flags.arch.c_str(), szArch)) {
+			flags.issues |= BUILD_ISSUE_ARCH;
+		}
+
+		if (flags.flags & BUILD_FLAG_DEBUG_CRT) {
+			flags.issues |= BUILD_ISSUE_DEBUG_CRT;
+		}
+
+		if (flags.flags & BUILD_FLAG_RTC) {
+			flags.issues |= BUILD_ISSUE_RTC;
+		}
+
+		cIssues += (flags.issues != 0) ? 1 : 0;
+	}
+
+	return cIssues;
+}
+
+void BuildFlagAudit::Clear()
+{
+	std::vector<BuildFlags>().swap(m_compilands);
+}
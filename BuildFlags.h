@@ -0,0 +1,76 @@
+// BuildFlags.h : Build flag audit of the compilands of a PDB
+//
+// Reads the compiler record (S_COMPILE3 or S_COMPILE2), the S_ENVBLOCK
+// and the S_BUILDINFO of every module, the modules in parallel, and
+// resolves the build info to its LF_BUILDINFO and LF_STRING_ID records
+// in the IPI stream for the command line. The switches that decide the
+// code, the optimization level, /GL, /arch and the CRT, are taken from
+// the command line so the objects built without optimization, without
+// whole program optimization, for another instruction set or against
+// the debug CRT can be listed by library.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "PdbFile.h"
+#include "TpiStream.h"
+
+#define BUILD_LANGUAGE_NONE         0xFF
+
+#define BUILD_FLAG_LTCG             0x0001   // /GL, or the LTCG bit of the compiler record
+#define BUILD_FLAG_DEBUG_CRT        0x0002   // /MDd, /MTd or /LDd
+#define BUILD_FLAG_RTC              0x0004   // /RTC runtime checks
+#define BUILD_FLAG_GS               0x0008
+#define BUILD_FLAG_COMMAND_LINE     0x0010   // the switches are known
+
+#define BUILD_ISSUE_NOT_OPTIMIZED   0x0001   // neither /O2 nor /Ox
+#define BUILD_ISSUE_NO_LTCG         0x0002
+#define BUILD_ISSUE_ARCH            0x0004
+#define BUILD_ISSUE_DEBUG_CRT       0x0008
+#define BUILD_ISSUE_RTC             0x0010
+
+struct BuildFlags
+{
+	uint16_t iModule;
+	uint8_t language;                    // CV_CFL_LANG, BUILD_LANGUAGE_NONE when there is no compiler record
+	uint16_t machine;
+	uint16_t verMajor;                   // of the back end
+	uint16_t verMinor;
+	uint16_t verBuild;
+	uint16_t verQfe;
+	uint16_t flags;
+	uint16_t issues;                     // set by Audit
+	std::string compiler;
+	std::string commandLine;
+	std::string library;                 // the archive, or the directory of the object
+	std::string optimization;            // the last /O switch, "" when none
+	std::string arch;                    // "" for the default
+};
+
+////////////////////////////////////////////////////////////
+// The build flags of every C and C++ compiland
+//
+//  Only the compilands with a command line are audited, the
+//  others can be told apart by BUILD_FLAG_COMMAND_LINE. A
+//  missing /GL is an issue when some other compiland has it.
+//
+class BuildFlagAudit
+{
+	public:
+	bool Build(const PdbFile & pdb, const TpiStream * pIpi, unsigned cThreads);
+	uint32_t Audit(const char * szArch);
+	void Clear();
+
+	const std::vector<BuildFlags> & Compilands() const { return m_compilands; }
+
+	private:
+	void ReadModule(const PdbFile & pdb, const TpiStream * pIpi, uint16_t iModule, BuildFlags & flags) const;
+
+	std::vector<BuildFlags> m_compilands;
+};
+
+void ParseBuildCommandLine(const char * szCommandLine, BuildFlags & flags);
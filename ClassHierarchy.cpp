@@ -0,0 +1,370 @@
+// ClassHierarchy.cpp : Inheritance graph of the classes of the TPI stream
+//
+
+#include "ClassHierarchy.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "Util.h"
+
+#define HIERARCHY_BLOCK_TYPES       4096
+
+struct HierarchyBlock
+{
+	std::vector<uint32_t> classes;
+	std::vector<const char *> names;
+	std::vector<uint32_t> cBases;
+	std::vector<HierarchyEdge> bases;    // iClass is the type index of the base until resolved
+};
+
+static bool IsClassLeaf(uint16_t leaf)
+{
+	return leaf == LF_CLASS || leaf == LF_STRUCTURE || leaf == LF_INTERFACE;
+}
+
+static bool IsDirectEdge(const HierarchyEdge & edge)
+{
+	return edge.kind == HIERARCHY_BASE || edge.kind == HIERARCHY_VIRTUAL;
+}
+
+////////////////////////////////////////////////////////////
+// Decode the base class records of every class definition, then
+//  index the edges both ways
+//
+//  The threads decode blocks of type indices into their own arrays,
+//  which are appended in type index order, so the classes and their
+//  edges come out the same whatever the thread count.
+//
+bool ClassHierarchy::Build(const TpiStream & tpi, unsigned cThreads)
+{
+	Clear();
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	m_pTpi = &tpi;
+
+	uint32_t cBlocks = (tpi.CountTypes() + HIERARCHY_BLOCK_TYPES - 1) / HIERARCHY_BLOCK_TYPES;
+	std::vector<HierarchyBlock> blocks(cBlocks);
+	std::atomic<uint32_t> iNextBlock(0);
+
+	auto worker = [&](unsigned) {
+		std::vector<TpiField> fields;
+		TpiUdt udt;
+
+		for (uint32_t iBlock; (iBlock = iNextBlock++) < cBlocks; ) {
+			HierarchyBlock & block = blocks[iBlock];
+			uint32_t tiBegin = tpi.FirstIndex() + iBlock * HIERARCHY_BLOCK_TYPES;
+			uint32_t tiEnd = std::min<uint32_t>(tiBegin + HIERARCHY_BLOCK_TYPES, tpi.EndIndex());
+
+			for (uint32_t ti = tiBegin; ti < tiEnd; ti++) {
+				if (!IsClassLeaf(tpi.Leaf(ti)) || !tpi.GetUdt(ti, udt) || (udt.property & TPI_PROP_FWDREF)) {
+					continue;
+				}
+
+				size_t iFirst = block.bases.size();
+
+				if (udt.fieldList != 0 && tpi.GetFields(udt.fieldList, fields)) {
+					for (const TpiField & field : fields) {
+						HierarchyEdge edge = {field.type, HIERARCHY_BASE, field.offset};
+
+						switch (field.leaf) {
+							case LF_BCLASS:
+							case LF_BINTERFACE:
+								break;
+
+							case LF_VBCLASS:
+								edge.kind = HIERARCHY_VIRTUAL;
+								edge.offset = field.vbIndex;
+								break;
+
+							case LF_IVBCLASS:
+								edge.kind = HIERARCHY_INDIRECT_VIRTUAL;
+								edge.offset = field.vbIndex;
+								break;
+
+							default:
+								continue;
+						}
+
+						block.bases.push_back(edge);
+					}
+				}
+
+				block.classes.push_back(ti);
+				block.names.push_back(udt.szName);
+				block.cBases.push_back((uint32_t)(block.bases.size() - iFirst));
+			}
+		}
+	};
+
+	RunParallel(cThreads, worker);
+
+	m_classIndex.assign(tpi.CountTypes(), HIERARCHY_NONE);
+
+	for (HierarchyBlock & block : blocks) {
+		for (size_t i = 0; i < block.classes.size(); i++) {
+			m_classIndex[block.classes[i] - tpi.FirstIndex()] = (uint32_t)m_classes.size();
+			m_classes.push_back(block.classes[i]);
+			m_names.push_back(block.names[i]);
+		}
+	}
+
+	// Bases named by a forward reference resolve to the class, the
+	//  ones without a definition are dropped
+
+	m_baseStart.push_back(0);
+
+	for (HierarchyBlock & block : blocks) {
+		size_t iEdge = 0;
+
+		for (uint32_t cBases : block.cBases) {
+			for (uint32_t i = 0; i < cBases; i++) {
+				HierarchyEdge edge = block.bases[iEdge++];
+
+				if ((edge.iClass = Find(edge.iClass)) != HIERARCHY_NONE) {
+					m_bases.push_back(edge);
+				}
+			}
+
+			m_baseStart.push_back((uint32_t)m_bases.size());
+		}
+
+		std::vector<uint32_t>().swap(block.classes);
+		std::vector<HierarchyEdge>().swap(block.bases);
+	}
+
+	// The derived edges, counted then placed, in class order
+
+	uint32_t cClasses = (uint32_t)m_classes.size();
+
+	m_derivedStart.assign(cClasses + 1, 0);
+	m_derived.resize(m_bases.size());
+
+	for (const HierarchyEdge & edge : m_bases) {
+		m_derivedStart[edge.iClass + 1]++;
+	}
+
+	for (uint32_t i = 0; i < cClasses; i++) {
+		m_derivedStart[i + 1] += m_derivedStart[i];
+	}
+
+	std::vector<uint32_t> next(m_derivedStart.begin(), m_derivedStart.end() - 1);
+
+	for (uint32_t iClass = 0; iClass < cClasses; iClass++) {
+		for (uint32_t i = m_baseStart[iClass]; i < m_baseStart[iClass + 1]; i++) {
+			HierarchyEdge edge = m_bases[i];
+
+			edge.iClass = iClass;
+			m_derived[next[m_bases[i].iClass]++] = edge;
+		}
+	}
+
+	BuildAncestors(cThreads);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// The sorted ancestors, the depth and the diamonds of every class
+//
+//  A class only needs the ancestors of its direct bases, so the
+//  classes are taken a depth at a time, the classes of one depth
+//  in parallel. A base reached through two direct bases makes the
+//  class a diamond site. Classes in a base cycle, which only bad
+//  records make, are left at depth 0 without ancestors.
+//
+void ClassHierarchy::BuildAncestors(unsigned cThreads)
+{
+	uint32_t cClasses = (uint32_t)m_classes.size();
+	std::vector<std::vector<uint32_t> > ancestors(cClasses);
+	std::vector<uint32_t> cPending(cClasses, 0);
+	std::vector<uint32_t> level;
+	std::vector<uint32_t> nextLevel;
+	std::vector<std::vector<DiamondSite> > diamonds(cThreads);
+
+	m_depths.assign(cClasses, 0);
+
+	for (uint32_t iClass = 0; iClass < cClasses; iClass++) {
+		for (uint32_t i = m_baseStart[iClass]; i < m_baseStart[iClass + 1]; i++) {
+			cPending[iClass] += IsDirectEdge(m_bases[i]) ? 1 : 0;
+		}
+
+		if (cPending[iClass] == 0) {
+			level.push_back(iClass);
+		}
+	}
+
+	for (uint32_t depth = 0; !level.empty(); depth++) {
+		std::atomic<uint32_t> iNext(0);
+
+		auto worker = [&](unsigned iThread) {
+			std::vector<uint32_t> reached;
+
+			for (uint32_t iLevel; (iLevel = iNext++) < level.size(); ) {
+				uint32_t iClass = level[iLevel];
+
+				reached.clear();
+
+				for (uint32_t i = m_baseStart[iClass]; i < m_baseStart[iClass + 1]; i++) {
+					if (IsDirectEdge(m_bases[i])) {
+						const std::vector<uint32_t> & inherited = ancestors[m_bases[i].iClass];
+
+						reached.push_back(m_bases[i].iClass);
+						reached.insert(reached.end(), inherited.begin(), inherited.end());
+					}
+				}
+
+				std::sort(reached.begin(), reached.end());
+
+				std::vector<uint32_t> & result = ancestors[iClass];
+
+				for (size_t i = 0, j; i < reached.size(); i = j) {
+					for (j = i + 1; j < reached.size() && reached[j] == reached[i]; j++) {
+					}
+
+					result.push_back(reached[i]);
+
+					if (j - i > 1) {
+						DiamondSite site = {iClass, reached[i], (uint32_t)(j - i), false};
+
+						for (uint32_t k = m_baseStart[iClass]; k < m_baseStart[iClass + 1]; k++) {
+							if (m_bases[k].iClass == reached[i] && m_bases[k].kind != HIERARCHY_BASE) {
+								site.fVirtual = true;
+							}
+						}
+
+						diamonds[iThread].push_back(site);
+					}
+				}
+			}
+		};
+
+		RunParallel((unsigned)std::min<size_t>(cThreads, level.size()), worker);
+
+		nextLevel.clear();
+
+		for (uint32_t iClass : level) {
+			m_depths[iClass] = depth;
+
+			for (uint32_t i = m_derivedStart[iClass]; i < m_derivedStart[iClass + 1]; i++) {
+				if (IsDirectEdge(m_derived[i]) && --cPending[m_derived[i].iClass] == 0) {
+					nextLevel.push_back(m_derived[i].iClass);
+				}
+			}
+		}
+
+		level.swap(nextLevel);
+	}
+
+	m_ancestorStart.push_back(0);
+
+	for (std::vector<uint32_t> & result : ancestors) {
+		m_ancestors.insert(m_ancestors.end(), result.begin(), result.end());
+		m_ancestorStart.push_back((uint32_t)m_ancestors.size());
+		std::vector<uint32_t>().swap(result);
+	}
+
+	for (std::vector<DiamondSite> & sites : diamonds) {
+		m_diamonds.insert(m_diamonds.end(), sites.begin(), sites.end());
+	}
+
+	std::sort(m_diamonds.begin(), m_diamonds.end(),
+		[](const DiamondSite & a, const DiamondSite & b) { return a.iClass < b.iClass || (a.iClass == b.iClass && a.iBase < b.iBase); });
+}
+
+void ClassHierarchy::Clear()
+{
+	m_pTpi = NULL;
+	std::vector<uint32_t>().swap(m_classes);
+	std::vector<const char *>().swap(m_names);
+	std::vector<uint32_t>().swap(m_classIndex);
+	std::vector<uint32_t>().swap(m_baseStart);
+	std::vector<HierarchyEdge>().swap(m_bases);
+	std::vector<uint32_t>().swap(m_derivedStart);
+	std::vector<HierarchyEdge>().swap(m_derived);
+	std::vector<uint32_t>().swap(m_ancestorStart);
+	std::vector<uint32_t>().swap(m_ancestors);
+	std::vector<uint32_t>().swap(m_depths);
+	std::vector<DiamondSite>().swap(m_diamonds);
+}
+
+////////////////////////////////////////////////////////////
+// The class of a type index, forward references resolved
+//
+uint32_t ClassHierarchy::Find(uint32_t ti) const
+{
+	if (m_pTpi == NULL) {
+		return HIERARCHY_NONE;
+	}
+
+	ti = m_pTpi->Definition(ti);
+
+	if (ti < m_pTpi->FirstIndex() || ti >= m_pTpi->EndIndex()) {
+		return HIERARCHY_NONE;
+	}
+
+	return m_classIndex[ti - m_pTpi->FirstIndex()];
+}
+
+const HierarchyEdge * ClassHierarchy::Bases(uint32_t iClass, uint32_t * pcBases) const
+{
+	*pcBases = m_baseStart[iClass + 1] - m_baseStart[iClass];
+
+	return m_bases.data() + m_baseStart[iClass];
+}
+
+const HierarchyEdge * ClassHierarchy::Derived(uint32_t iClass, uint32_t * pcDerived) const
+{
+	*pcDerived = m_derivedStart[iClass + 1] - m_derivedStart[iClass];
+
+	return m_derived.data() + m_derivedStart[iClass];
+}
+
+const uint32_t * ClassHierarchy::Ancestors(uint32_t iClass, uint32_t * pcAncestors) const
+{
+	*pcAncestors = m_ancestorStart[iClass + 1] - m_ancestorStart[iClass];
+
+	return m_ancestors.data() + m_ancestorStart[iClass];
+}
+
+bool ClassHierarchy::IsDerivedFrom(uint32_t iClass, uint32_t iBase) const
+{
+	uint32_t cAncestors;
+	const uint32_t * pAncestors = Ancestors(iClass, &cAncestors);
+
+	return std::binary_search(pAncestors, pAncestors + cAncestors, iBase);
+}
+
+////////////////////////////////////////////////////////////
+// Every class deriving from a class, directly or not, in class
+//  order
+//
+void ClassHierarchy::AllDerived(uint32_t iClass, std::vector<uint32_t> & derived) const
+{
+	std::vector<bool> fVisited(m_classes.size(), false);
+	std::vector<uint32_t> stack(1, iClass);
+
+	derived.clear();
+	fVisited[iClass] = true;
+
+	while (!stack.empty()) {
+		uint32_t iNext = stack.back();
+
+		stack.pop_back();
+
+		for (uint32_t i = m_derivedStart[iNext]; i < m_derivedStart[iNext + 1]; i++) {
+			uint32_t iDerived = m_derived[i].iClass;
+
+			if (!fVisited[iDerived]) {
+				fVisited[iDerived] = true;
+				derived.push_back(iDerived);
+				stack.push_back(iDerived);
+			}
+		}
+	}
+
+	std::sort(derived.begin(), derived.end());
+}
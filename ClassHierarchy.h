@@ -0,0 +1,83 @@
+// ClassHierarchy.h : Inheritance graph of the classes of the TPI stream
+//
+// Indexes the base class records of every class, structure and
+// interface definition into compressed adjacency arrays, one from each
+// class to its bases and one from each class to the classes deriving
+// from it. Virtual bases, including the indirect ones the compiler
+// lists on every derived class, are edges of their own kind. The sorted
+// ancestors of every class and its depth are computed at build time,
+// level by level on worker threads, which is also where the classes
+// joining two inheritance paths to one base are found.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "TpiStream.h"
+
+#define HIERARCHY_NONE              0xFFFFFFFF
+
+#define HIERARCHY_BASE              0
+#define HIERARCHY_VIRTUAL           1
+#define HIERARCHY_INDIRECT_VIRTUAL  2
+
+struct HierarchyEdge
+{
+	uint32_t iClass;                     // the base, or the derived class
+	uint8_t kind;
+	int64_t offset;                      // base offset, vbtable index for virtual bases
+};
+
+// A class inheriting one base along more than one path
+struct DiamondSite
+{
+	uint32_t iClass;
+	uint32_t iBase;
+	uint32_t cPaths;                     // direct bases the base is reached through
+	bool fVirtual;                       // one shared subobject
+};
+
+////////////////////////////////////////////////////////////
+// The classes of a type stream and their inheritance
+//
+//  Classes are numbered in type index order. Once built, all the
+//  queries are read only.
+//
+class ClassHierarchy
+{
+	public:
+	bool Build(const TpiStream & tpi, unsigned cThreads);
+	void Clear();
+
+	uint32_t CountClasses() const { return (uint32_t)m_classes.size(); }
+	uint32_t CountEdges() const { return (uint32_t)m_bases.size(); }
+	uint32_t Find(uint32_t ti) const;
+	uint32_t Type(uint32_t iClass) const { return m_classes[iClass]; }
+	const char * Name(uint32_t iClass) const { return m_names[iClass]; }
+	uint32_t Depth(uint32_t iClass) const { return m_depths[iClass]; }
+
+	const HierarchyEdge * Bases(uint32_t iClass, uint32_t * pcBases) const;
+	const HierarchyEdge * Derived(uint32_t iClass, uint32_t * pcDerived) const;
+	const uint32_t * Ancestors(uint32_t iClass, uint32_t * pcAncestors) const;
+	bool IsDerivedFrom(uint32_t iClass, uint32_t iBase) const;
+	void AllDerived(uint32_t iClass, std::vector<uint32_t> & derived) const;
+	const std::vector<DiamondSite> & Diamonds() const { return m_diamonds; }
+
+	private:
+	void BuildAncestors(unsigned cThreads);
+
+	const TpiStream * m_pTpi = NULL;
+	std::vector<uint32_t> m_classes;     // type index per class
+	std::vector<const char *> m_names;
+	std::vector<uint32_t> m_classIndex;  // per type index, HIERARCHY_NONE when not a class
+	std::vector<uint32_t> m_baseStart;   // per class, and one past the last
+	std::vector<HierarchyEdge> m_bases;
+	std::vector<uint32_t> m_derivedStart;
+	std::vector<HierarchyEdge> m_derived;
+	std::vector<uint32_t> m_ancestorStart;
+	std::vector<uint32_t> m_ancestors;   // sorted per class
+	std::vector<uint32_t> m_depths;
+	std::vector<DiamondSite> m_diamonds;
+};
@@ -13,17 +13,56 @@
 #include "stdafx.h"
 #include "Dia2Dump.h"
 #include "PrintSymbol.h"
+#include "FrameProgram.h"
+#include "UnwindX64.h"
+#include "Minidump.h"
+#include "InlineIndex.h"
+#include "PerfMap.h"
+#include "Profile.h"
+#include "LinkOrder.h"
+#include "SizeReport.h"
+#include "IcfFinder.h"
+#include "PdbDiff.h"
+#include "TypeBaseline.h"
+#include "TypeFilter.h"
+#include "TpiStream.h"
+#include "OdrCheck.h"
+#include "LayoutCache.h"
+#include "PaddingReport.h"
+#include "FieldResolver.h"
+#include "ValueRenderer.h"
+#include "HeaderGen.h"
+#include "ClassHierarchy.h"
+#include "VTableLayout.h"
+#include "StaticInit.h"
+#include "StackFrames.h"
+#include "BuildFlags.h"
+#include "HeapSites.h"
 
 #include "Callback.h"
 
 #pragma warning (disable : 4100)
 
 const wchar_t * g_szFilename;
+const wchar_t * g_szImage;              // image to load when first read, NULL once loaded
 IDiaDataSource * g_pDiaDataSource;
 IDiaSession * g_pDiaSession;
 IDiaSymbol * g_pGlobalSymbol;
 DWORD g_dwMachineType = CV_CFL_80386;
 ULONGLONG g_dwloadAddress = 0x400000;
+PeImage g_image;
+X64UnwindIndex g_unwindIndex;
+PdbFile g_pdb;
+InlineIndex g_inlineIndex;
+TpiStream g_tpi;
+TpiStream g_ipi;
+LayoutCache g_layouts;
+FieldResolver g_fields;
+ClassHierarchy g_hierarchy;
+VTableLayout g_vtables;
+StackFrameIndex g_frames;
+
+static bool PrintUnwindX64(const X64RuntimeFunction &);
 
 #include <fstream>
 #include <iostream>
@@ -33,6 +72,7 @@ ULONGLONG g_dwloadAddress = 0x400000;
 #include <ctime>
 #include <map>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -52,6 +92,14 @@ int wmain(int argc, wchar_t * argv[])
 		return -1;
 	}
 
+	if (!_wcsicmp(argv[1], L"-minidump")) {
+		return DumpMinidumps(argc - 2, &argv[2]) ? 0 : -1;
+	}
+
+	if (!_wcsicmp(argv[1], L"-pdbdiff")) {
+		return DumpPdbDiff(argc - 2, &argv[2]) ? 0 : -1;
+	}
+
 	if (_wfopen_s(&pFile, argv[argc - 1], L"r") || !pFile) {
 	  // invalid file name or file does not exist
 		wprintf(L"Can't open file %s\n", argv[argc - 1]);
@@ -62,7 +110,8 @@ int wmain(int argc, wchar_t * argv[])
 	fclose(pFile);
 
 	if (argv[1] != nullptr && argv[2] != nullptr) {
-		if (wcsstr(argv[1], L".pdb") != nullptr && wcsstr(argv[2], L".pdb") != nullptr || wcsstr(argv[1], L"-ptype")) {
+		if (wcsstr(argv[1], L".pdb") != nullptr && wcsstr(argv[2], L".pdb") != nullptr || wcsstr(argv[1], L"-ptype")
+		 || !_wcsicmp(argv[1], L"-typebaseline") || !_wcsicmp(argv[1], L"-typecheck")) {
 			wprintf(L"Comparing PDBs\n");
 			return wmain2(argc, argv);
 		}
@@ -80,6 +129,17 @@ int wmain(int argc, wchar_t * argv[])
 		return -1;
 	}
 
+	// The image itself has the x64 unwind data, use it when given one,
+	//  loading it once a mode reads it
+
+	wchar_t wszExt[MAX_PATH];
+
+	_wsplitpath_s(g_szFilename, NULL, 0, NULL, 0, NULL, 0, wszExt, MAX_PATH);
+
+	if (_wcsicmp(wszExt, L".pdb")) {
+		g_szImage = g_szFilename;
+	}
+
 	if (argc == 4 && dump_specifc_dwords) {
 		DumpAllSpecificDwords(g_pDiaSession, argv[2], argv[1]);
 	} else if (argc == 2) {
@@ -177,6 +237,8 @@ bool LoadDataFromPdb(
 		return false;
 	}
 
+	ClearTypeNames();
+
 	// Retrieve a reference to the global scope
 
 	hr = (*ppSession)->get_globalScope(ppGlobal);
@@ -391,6 +453,24 @@ bool ParseArg(int argc, wchar_t * argv[])
 		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
+	else if (!_wcsicmp(argv[0], L"-image")) {
+	  // -image <file>     : read unwind data from this image, for -fpo on x64
+
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			bReturn = bReturn && LoadPeImage(argv[1], true);
+			iCount = 2;
+		}
+
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-image'");
+
+			return false;
+		}
+
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+	}
+
 	else if (!_wcsicmp(argv[0], L"-fpo")) {
 		if (argc > 1 && *argv[1] != L'-') {
 			DWORD dwRVA = 0;
@@ -420,16 +500,41 @@ bool ParseArg(int argc, wchar_t * argv[])
 		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-compiland")) {
-		if ((argc > 1) && (*argv[1] != L'-')) {
-		  // -compiland [name] : dump symbols for this compiland
+	else if (!_wcsicmp(argv[0], L"-fpoprog")) {
+		if (argc > 1 && iswdigit(*argv[1])) {
+		  // -fpoprog [RVA]    : dump the compiled frame program covering this address
 
-			bReturn = bReturn && DumpCompiland(g_pGlobalSymbol, argv[1]);
-			argc -= 2;
+			DWORD dwRVA = 0;
+
+			swscanf_s(argv[1], L"%x", &dwRVA);
+			bReturn = bReturn && DumpFrameProgram(g_pDiaSession, dwRVA);
+			iCount = 2;
 		}
 
 		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-line'");
+		  // -fpoprog          : compile all frame programs, report index stats and eval timing
+
+			bReturn = bReturn && DumpFrameProgram(g_pDiaSession, 0);
+			iCount = 1;
+		}
+
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+	}
+
+	else if (!_wcsicmp(argv[0], L"-inline")) {
+	  // -inline <RVA>     : dump the chain of inlined calls at this address
+
+		if ((argc > 1) && iswxdigit(*argv[1])) {
+			DWORD dwRVA = 0;
+
+			swscanf_s(argv[1], L"%x", &dwRVA);
+			bReturn = bReturn && DumpInlineFrames(g_pGlobalSymbol, dwRVA);
+			iCount = 2;
+		}
+
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-inline'");
 
 			return false;
 		}
@@ -438,16 +543,16 @@ bool ParseArg(int argc, wchar_t * argv[])
 		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-compcontr")) {
-		if ((argc > 1) && (*argv[1] != L'-')) {
-		  // -compiland [name] : dump symbols for this compiland
+	else if (!_wcsicmp(argv[0], L"-base")) {
+	  // -base <addr>      : load address the RVAs are relocated to, default 400000
 
-			bReturn = bReturn && DumpCompilandContrib(g_pDiaSession,g_pGlobalSymbol, argv[1]);
-			argc -= 2;
+		if ((argc > 1) && iswxdigit(*argv[1])) {
+			swscanf_s(argv[1], L"%llx", &g_dwloadAddress);
+			iCount = 2;
 		}
 
 		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-line'");
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-base'");
 
 			return false;
 		}
@@ -456,28 +561,29 @@ bool ParseArg(int argc, wchar_t * argv[])
 		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-lines")) {
-		if ((argc > 1) && (*argv[1] != L'-')) {
-			DWORD dwRVA = 0;
+	else if (!_wcsicmp(argv[0], L"-perfmap") || !_wcsicmp(argv[0], L"-jitdump")) {
+	  // -perfmap <pid> [file] : write a perf map of the functions, default /tmp/perf-<pid>.map
+	  // -jitdump <pid> [file] : write a perf jitdump of the functions, default jit-<pid>.dump
 
-			if (iswdigit(*argv[1])) {
-			  // -lines <RVA>                  : dump line numbers for this address\n"
+		bool fJitDump = !_wcsicmp(argv[0], L"-jitdump");
 
-				swscanf_s(argv[1], L"%x", &dwRVA);
-				bReturn = bReturn && DumpLines(g_pDiaSession, dwRVA);
-			}
+		if ((argc > 1) && iswdigit(*argv[1])) {
+			DWORD dwPid = 0;
+			const wchar_t * szFile = NULL;
 
-			else {
-			  // -lines <symbolname>           : dump line numbers for this function
+			swscanf_s(argv[1], L"%u", &dwPid);
+			iCount = 2;
 
-				bReturn = bReturn && DumpLines(g_pDiaSession, g_pGlobalSymbol, argv[1]);
+			if ((argc > 2) && (*argv[2] != L'-')) {
+				szFile = argv[2];
+				iCount = 3;
 			}
 
-			iCount = 2;
+			bReturn = bReturn && DumpPerfMap(g_pDiaSession, dwPid, szFile, fJitDump);
 		}
 
 		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-compiland'");
+			wprintf(L"ERROR - ParseArg(): missing pid for option '%s'", argv[0]);
 
 			return false;
 		}
@@ -486,16 +592,24 @@ bool ParseArg(int argc, wchar_t * argv[])
 		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-type")) {
-	  // -type <symbolname>: dump this type in detail
+	else if (!_wcsicmp(argv[0], L"-profile")) {
+	  // -profile <samples> [collapsed] : self sample counts per function, line and compiland
 
 		if ((argc > 1) && (*argv[1] != L'-')) {
-			bReturn = bReturn && DumpType(g_pGlobalSymbol, argv[1]);
+			const wchar_t * szCollapsed = NULL;
+
 			iCount = 2;
+
+			if ((argc > 2) && (*argv[2] != L'-')) {
+				szCollapsed = argv[2];
+				iCount = 3;
+			}
+
+			bReturn = bReturn && DumpProfile(g_pDiaSession, g_pGlobalSymbol, argv[1], szCollapsed);
 		}
 
 		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-type'");
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-profile'");
 
 			return false;
 		}
@@ -504,18 +618,16 @@ bool ParseArg(int argc, wchar_t * argv[])
 		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-label")) {
-	  // -label <RVA>      : dump label at RVA
-		if ((argc > 1) && (*argv[1] != L'-')) {
-			DWORD dwRVA = 0;
+	else if (!_wcsicmp(argv[0], L"-order")) {
+	  // -order <samples> <file> : write an /ORDER file of the hot COMDATs
 
-			swscanf_s(argv[1], L"%x", &dwRVA);
-			bReturn = bReturn && DumpLabel(g_pDiaSession, dwRVA);
-			iCount = 2;
+		if ((argc > 2) && (*argv[1] != L'-') && (*argv[2] != L'-')) {
+			bReturn = bReturn && DumpLinkOrder(g_pDiaSession, argv[1], argv[2]);
+			iCount = 3;
 		}
 
 		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-label'");
+			wprintf(L"ERROR - ParseArg(): missing arguments for option '-order'");
 
 			return false;
 		}
@@ -524,667 +636,713 @@ bool ParseArg(int argc, wchar_t * argv[])
 		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-sym")) {
-		if ((argc > 1) && (*argv[1] != L'-')) {
-			DWORD dwRVA = 0;
-			const wchar_t * szChildname = NULL;
+	else if (!_wcsicmp(argv[0], L"-sizes")) {
+	  // -sizes [n] [file] : size attribution, top n rows per table, tab separated tables to file
 
-			iCount = 2;
+		DWORD dwRows = 0;
+		const wchar_t * szFile = NULL;
 
-			if (argc > 2 && *argv[2] != L'-') {
-				szChildname = argv[2];
-				iCount = 3;
-			}
+		iCount = 1;
 
-			if (iswdigit(*argv[1])) {
-			  // -sym <RVA> [childname]        : dump child information of symbol at this address
+		if ((argc > iCount) && iswdigit(*argv[iCount])) {
+			dwRows = (DWORD)_wtoi(argv[iCount]);
+			iCount++;
+		}
 
-				swscanf_s(argv[1], L"%x", &dwRVA);
-				bReturn = bReturn && DumpSymbolWithRVA(g_pDiaSession, dwRVA, szChildname);
-			}
+		if ((argc > iCount) && (*argv[iCount] != L'-')) {
+			szFile = argv[iCount];
+			iCount++;
+		}
 
-			else {
-			  // -sym <symbolname> [childname] : dump child information of this symbol
+		bReturn = bReturn && DumpSizeReport(g_pDiaSession, dwRows, szFile);
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+	}
 
-				bReturn = bReturn && DumpSymbolsWithRegEx(g_pGlobalSymbol, argv[1], szChildname);
-			}
-		}
+	else if (!_wcsicmp(argv[0], L"-icf")) {
+	  // -icf [n]          : identical code /OPT:ICF could fold, top n groups
 
-		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-sym'");
+		DWORD dwRows = 0;
 
-			return false;
+		iCount = 1;
+
+		if ((argc > 1) && iswdigit(*argv[1])) {
+			dwRows = (DWORD)_wtoi(argv[1]);
+			iCount = 2;
 		}
 
+		bReturn = bReturn && DumpIcfCandidates(g_pDiaSession, dwRows);
 		argc -= iCount;
 		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-lsrc")) {
-	  // -lsrc  <file> [line]          : dump line numbers for this source file
+	else if (!_wcsicmp(argv[0], L"-odr")) {
+	  // -odr [n]          : UDT names with more than one layout, first n names
 
-		if ((argc > 1) && (*argv[1] != L'-')) {
-			DWORD dwLine = 0;
+		DWORD dwRows = 0;
 
-			iCount = 2;
-			if (argc > 2 && *argv[2] != L'-') {
-				swscanf_s(argv[1], L"%d", &dwLine);
-				iCount = 3;
-			}
+		iCount = 1;
 
-			bReturn = bReturn && DumpLinesForSourceFile(g_pDiaSession, argv[1], dwLine);
+		if ((argc > 1) && iswdigit(*argv[1])) {
+			dwRows = (DWORD)_wtoi(argv[1]);
+			iCount = 2;
 		}
 
-		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-lsrc'");
+		bReturn = bReturn && DumpOdrViolations(g_pGlobalSymbol, dwRows);
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+	}
 
-			return false;
+	else if (!_wcsicmp(argv[0], L"-padding")) {
+	  // -padding [n] [weights] : UDT padding and cache line straddles, top n types, weighted by instance counts
+
+		DWORD dwRows = 0;
+		const wchar_t * szWeights = NULL;
+
+		iCount = 1;
+
+		if ((argc > iCount) && iswdigit(*argv[iCount])) {
+			dwRows = (DWORD)_wtoi(argv[iCount]);
+			iCount++;
+		}
+
+		if ((argc > iCount) && (*argv[iCount] != L'-')) {
+			szWeights = argv[iCount];
+			iCount++;
 		}
 
+		bReturn = bReturn && DumpPadding(g_pGlobalSymbol, dwRows, szWeights);
 		argc -= iCount;
 		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-ps")) {
-	  // -ps <RVA> [-n <number>]       : dump symbols after this address, default 16
-
+	else if (!_wcsicmp(argv[0], L"-field")) {
 		if ((argc > 1) && (*argv[1] != L'-')) {
-			DWORD dwRVA = 0;
-			DWORD dwRange;
+		  // -field <RVA|file> : global variable member at this address, or at every RVA of the file
 
-			swscanf_s(argv[1], L"%x", &dwRVA);
-			if (argc > 3 && !_wcsicmp(argv[2], L"-n")) {
-				swscanf_s(argv[3], L"%d", &dwRange);
-				iCount = 4;
-			}
+			bReturn = bReturn && DumpFieldPaths(g_pGlobalSymbol, argv[1]);
+			argc -= 2;
+			bReturn = bReturn && ParseArg(argc, &argv[2]);
+		}
 
-			else {
-				dwRange = 16;
-				iCount = 2;
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-field'");
+
+			return false;
+		}
+	}
+
+	else if (!_wcsicmp(argv[0], L"-render")) {
+		if ((argc > 3) && (*argv[1] != L'-') && (*argv[2] != L'-') && (*argv[3] != L'-')) {
+		  // -render <dump|raw@base> <address|file> <type> [depth] : typed objects, pointers followed depth levels
+
+			DWORD dwDepth = RENDER_POINTER_DEPTH;
+
+			iCount = 4;
+
+			if ((argc > 4) && iswdigit(*argv[4])) {
+				dwDepth = (DWORD)_wtoi(argv[4]);
+				iCount = 5;
 			}
 
-			bReturn = bReturn && DumpPublicSymbolsSorted(g_pDiaSession, dwRVA, dwRange, true);
+			bReturn = bReturn && DumpTypedMemory(g_pGlobalSymbol, argv[1], argv[2], argv[3], dwDepth);
+			argc -= iCount;
+			bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 		}
 
 		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-ps'");
+			wprintf(L"ERROR - ParseArg(): missing arguments for option '-render'");
 
 			return false;
 		}
-
-		argc -= iCount;
-		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-psr")) {
-	  // -psr <RVA> [-n <number>]       : dump symbols before this address, default 16
+	else if (!_wcsicmp(argv[0], L"-header")) {
+		if ((argc > 2) && (*argv[1] != L'-') && (*argv[2] != L'-')) {
+		  // -header <type[,type...]|*> <basename> [n] : C++ headers of the types and what they need, split in n files
 
-		if ((argc > 1) && (*argv[1] != L'-')) {
-			DWORD dwRVA = 0;
-			DWORD dwRange;
+			DWORD dwFiles = 1;
 
-			swscanf_s(argv[1], L"%x", &dwRVA);
+			iCount = 3;
 
-			if (argc > 3 && !_wcsicmp(argv[2], L"-n")) {
-				swscanf_s(argv[3], L"%d", &dwRange);
+			if ((argc > 3) && iswdigit(*argv[3])) {
+				dwFiles = (DWORD)_wtoi(argv[3]);
 				iCount = 4;
 			}
 
-			else {
-				dwRange = 16;
-				iCount = 2;
-			}
-
-			bReturn = bReturn && DumpPublicSymbolsSorted(g_pDiaSession, dwRVA, dwRange, false);
+			bReturn = bReturn && DumpHeaders(g_pGlobalSymbol, argv[1], argv[2], dwFiles);
+			argc -= iCount;
+			bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 		}
 
 		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-psr'");
+			wprintf(L"ERROR - ParseArg(): missing arguments for option '-header'");
 
 			return false;
 		}
-
-		argc -= iCount;
-		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-annotations")) {
-	  // -annotations <RVA>: dump annotation symbol for this RVA
-
+	else if (!_wcsicmp(argv[0], L"-hierarchy")) {
 		if ((argc > 1) && (*argv[1] != L'-')) {
-			DWORD dwRVA = 0;
+		  // -hierarchy <class|*> [n] : bases, ancestors and derived classes of a class, or the deepest classes and diamonds
+
+			DWORD dwRows = 0;
 
-			swscanf_s(argv[1], L"%x", &dwRVA);
-			bReturn = bReturn && DumpAnnotations(g_pDiaSession, dwRVA);
 			iCount = 2;
+
+			if ((argc > 2) && iswdigit(*argv[2])) {
+				dwRows = (DWORD)_wtoi(argv[2]);
+				iCount = 3;
+			}
+
+			bReturn = bReturn && DumpHierarchy(g_pGlobalSymbol, argv[1], dwRows);
+			argc -= iCount;
+			bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 		}
 
 		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-maptosrc'");
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-hierarchy'");
 
 			return false;
 		}
-
-		argc -= iCount;
-		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-maptosrc")) {
-	  // -maptosrc <RVA>   : dump src RVA for this image RVA
-
+	else if (!_wcsicmp(argv[0], L"-vtables")) {
 		if ((argc > 1) && (*argv[1] != L'-')) {
-			DWORD dwRVA = 0;
+		  // -vtables <class|*> [n] : vftable slots of a class, or the n classes with the most slots
+
+			DWORD dwRows = 0;
 
-			swscanf_s(argv[1], L"%x", &dwRVA);
-			bReturn = bReturn && DumpMapToSrc(g_pDiaSession, dwRVA);
 			iCount = 2;
+
+			if ((argc > 2) && iswdigit(*argv[2])) {
+				dwRows = (DWORD)_wtoi(argv[2]);
+				iCount = 3;
+			}
+
+			bReturn = bReturn && DumpVTables(g_pGlobalSymbol, argv[1], dwRows);
+			argc -= iCount;
+			bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 		}
 
 		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-maptosrc'");
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-vtables'");
 
 			return false;
 		}
+	}
+
+	else if (!_wcsicmp(argv[0], L"-staticinit")) {
+	  // -staticinit [n] [samples] : dynamic initializers and .CRT$XC entries in init order, weighted by a startup profile
+
+		DWORD dwRows = 0;
+		const wchar_t * szSamples = NULL;
+
+		iCount = 1;
+
+		if ((argc > iCount) && iswdigit(*argv[iCount])) {
+			dwRows = (DWORD)_wtoi(argv[iCount]);
+			iCount++;
+		}
+
+		if ((argc > iCount) && (*argv[iCount] != L'-')) {
+			szSamples = argv[iCount];
+			iCount++;
+		}
 
+		bReturn = bReturn && DumpStaticInit(g_pGlobalSymbol, dwRows, szSamples);
 		argc -= iCount;
 		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else if (!_wcsicmp(argv[0], L"-mapfromsrc")) {
-	  // -mapfromsrc <RVA> : dump image RVA for src RVA
-
+	else if (!_wcsicmp(argv[0], L"-stackframes")) {
 		if ((argc > 1) && (*argv[1] != L'-')) {
-			DWORD dwRVA = 0;
+		  // -stackframes <function|*> [n] : frame bytes by local, alloca and /GS functions, worst case stack depth
+
+			DWORD dwRows = 0;
 
-			swscanf_s(argv[1], L"%x", &dwRVA);
-			bReturn = bReturn && DumpMapFromSrc(g_pDiaSession, dwRVA);
 			iCount = 2;
+
+			if ((argc > 2) && iswdigit(*argv[2])) {
+				dwRows = (DWORD)_wtoi(argv[2]);
+				iCount = 3;
+			}
+
+			bReturn = bReturn && DumpStackFrames(g_pGlobalSymbol, argv[1], dwRows);
+			argc -= iCount;
+			bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 		}
 
 		else {
-			wprintf(L"ERROR - ParseArg(): missing argument for option '-mapfromsrc'");
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-stackframes'");
 
 			return false;
 		}
-
-		argc -= iCount;
-		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	else {
-		wprintf(L"ERROR - unknown option %s\n", argv[0]);
+	else if (!_wcsicmp(argv[0], L"-buildflags")) {
+		if ((argc > 1) && (*argv[1] != L'-')) {
+		  // -buildflags <arch|*> [file] : C and C++ compilands built without /O2 or /GL, for another /arch or the debug CRT
 
-		PrintHelpOptions();
+			const wchar_t * szFilename = NULL;
 
-		return false;
-	}
+			iCount = 2;
 
-	return bReturn;
-}
+			if ((argc > 2) && (*argv[2] != L'-')) {
+				szFilename = argv[2];
+				iCount = 3;
+			}
 
-////////////////////////////////////////////////////////////
-// Display the usage
-//
-void PrintHelpOptions()
-{
-	static const wchar_t * const helpString = L"usage: Dia2Dump.exe [ options ] <filename>\n"
-		L"  -?                : print this help\n"
-		L"  -all              : print all the debug info\n"
-		L"  -m                : print all the mods\n"
-		L"  -p                : print all the publics\n"
-		L"  -g                : print all the globals\n"
-		L"  -t                : print all the types\n"
-		L"  -f                : print all the files\n"
-		L"  -s                : print symbols\n"
-		L"  -l [RVA [bytes]]  : print line number info at RVA address in the bytes range\n"
-		L"  -c                : print section contribution info\n"
-		L"  -dbg              : dump debug streams\n"
-		L"  -injsrc [file]    : dump injected source\n"
-		L"  -sf               : dump all source files\n"
-		L"  -oem              : dump all OEM specific types\n"
-		L"  -fpo [RVA]        : dump frame pointer omission information for a func addr\n"
-		L"  -fpo [symbolname] : dump frame pointer omission information for a func symbol\n"
-		L"  -compiland [name] : dump symbols for this compiland\n"
-		L"  -compcontr [name] : dump symbols for this compiland contrib\n"
-		L"  -lines <funcname> : dump line numbers for this function\n"
-		L"  -lines <RVA>      : dump line numbers for this address\n"
-		L"  -type <symbolname>: dump this type in detail\n"
-		L"  -label <RVA>      : dump label at RVA\n"
-		L"  -sym <symbolname> [childname] : dump child information of this symbol\n"
-		L"  -sym <RVA> [childname]        : dump child information of symbol at this addr\n"
-		L"  -lsrc  <file> [line]          : dump line numbers for this source file\n"
-		L"  -ps <RVA> [-n <number>]       : dump symbols after this address, default 16\n"
-		L"  -psr <RVA> [-n <number>]      : dump symbols before this address, default 16\n"
-		L"  -annotations <RVA>: dump annotation symbol for this RVA\n"
-		L"  -maptosrc <RVA>   : dump src RVA for this image RVA\n"
-		L"  -mapfromsrc <RVA> : dump image RVA for src RVA\n"
-		L"  Or Specify two pdbs to compare types in them\n"
-		L"  Or Specify a typename, exe and pdb to print specific dwords\n"
-		;
-
-	wprintf(helpString);
-}
-
-////////////////////////////////////////////////////////////
-// Dump all the data stored in a PDB
-//
-void DumpAllPdbInfo(IDiaSession * pSession, IDiaSymbol * pGlobal)
-{
-	DumpAllMods(pGlobal);
-	DumpAllPublics(pGlobal);
-	DumpAllSymbols(pGlobal);
-	DumpAllGlobals(pGlobal);
-	DumpAllTypes(pGlobal);
-	DumpAllFiles(pSession, pGlobal);
-	DumpAllLines(pSession, pGlobal);
-	DumpAllSecContribs(pSession);
-	DumpAllDebugStreams(pSession);
-	DumpAllInjectedSources(pSession);
-	DumpAllFPO(pSession);
-	DumpAllOEMs(pGlobal);
-}
-
-////////////////////////////////////////////////////////////
-// Dump all the modules information
-//
-bool DumpAllMods(IDiaSymbol * pGlobal)
-{
-	wprintf(L"\n\n*** MODULES\n\n");
-
-	// Retrieve all the compiland symbols
+			bReturn = bReturn && DumpBuildFlags(g_pGlobalSymbol, argv[1], szFilename);
+			argc -= iCount;
+			bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+		}
 
-	IDiaEnumSymbols * pEnumSymbols;
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-buildflags'");
 
-	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL, nsNone, &pEnumSymbols))) {
-		return false;
+			return false;
+		}
 	}
 
-	IDiaSymbol * pCompiland;
-	ULONG celt = 0;
-	ULONG iMod = 1;
+	else if (!_wcsicmp(argv[0], L"-heapsites")) {
+		if ((argc > 1) && (*argv[1] != L'-')) {
+		  // -heapsites <file> [n] : heap allocation sites by return RVA with their type, for allocation profilers
 
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pCompiland, &celt)) && (celt == 1)) {
-		BSTR bstrName;
+			DWORD dwRows = 0;
 
-		if (pCompiland->get_name(&bstrName) != S_OK) {
-			wprintf(L"ERROR - Failed to get the compiland's name\n");
+			iCount = 2;
 
-			pCompiland->Release();
-			pEnumSymbols->Release();
+			if ((argc > 2) && iswdigit(*argv[2])) {
+				dwRows = (DWORD)_wtoi(argv[2]);
+				iCount = 3;
+			}
 
-			return false;
+			bReturn = bReturn && DumpHeapSites(g_pGlobalSymbol, argv[1], dwRows);
+			argc -= iCount;
+			bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 		}
 
-		wprintf(L"%04X %s\n", iMod++, bstrName);
-
-		// Deallocate the string allocated previously by the call to get_name
-
-		SysFreeString(bstrName);
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-heapsites'");
 
-		pCompiland->Release();
+			return false;
+		}
 	}
 
-	pEnumSymbols->Release();
+	else if (!_wcsicmp(argv[0], L"-compiland")) {
+		if ((argc > 1) && (*argv[1] != L'-')) {
+		  // -compiland [name] : dump symbols for this compiland
 
-	putwchar(L'\n');
+			bReturn = bReturn && DumpCompiland(g_pGlobalSymbol, argv[1]);
+			argc -= 2;
+		}
 
-	return true;
-}
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-line'");
 
-////////////////////////////////////////////////////////////
-// Dump all the public symbols - SymTagPublicSymbol
-//
-bool DumpAllPublics(IDiaSymbol * pGlobal)
-{
-	wprintf(L"\n\n*** PUBLICS\n\n");
+			return false;
+		}
 
-	// Retrieve all the public symbols
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+	}
 
-	IDiaEnumSymbols * pEnumSymbols;
+	else if (!_wcsicmp(argv[0], L"-compcontr")) {
+		if ((argc > 1) && (*argv[1] != L'-')) {
+		  // -compiland [name] : dump symbols for this compiland
 
-	if (FAILED(pGlobal->findChildren(SymTagPublicSymbol, NULL, nsNone, &pEnumSymbols))) {
-		return false;
-	}
+			bReturn = bReturn && DumpCompilandContrib(g_pDiaSession,g_pGlobalSymbol, argv[1]);
+			argc -= 2;
+		}
 
-	IDiaSymbol * pSymbol;
-	ULONG celt = 0;
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-line'");
 
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-		PrintPublicSymbol(pSymbol);
+			return false;
+		}
 
-		pSymbol->Release();
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	pEnumSymbols->Release();
-
-	putwchar(L'\n');
+	else if (!_wcsicmp(argv[0], L"-lines")) {
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			DWORD dwRVA = 0;
 
-	return true;
-}
+			if (iswdigit(*argv[1])) {
+			  // -lines <RVA>                  : dump line numbers for this address\n"
 
-////////////////////////////////////////////////////////////
-// Dump all the symbol information stored in the compilands
-//
-bool DumpAllSymbols(IDiaSymbol * pGlobal)
-{
-	wprintf(L"\n\n*** SYMBOLS\n\n\n");
+				swscanf_s(argv[1], L"%x", &dwRVA);
+				bReturn = bReturn && DumpLines(g_pDiaSession, dwRVA);
+			}
 
-	// Retrieve the compilands first
+			else {
+			  // -lines <symbolname>           : dump line numbers for this function
 
-	IDiaEnumSymbols * pEnumSymbols;
+				bReturn = bReturn && DumpLines(g_pDiaSession, g_pGlobalSymbol, argv[1]);
+			}
 
-	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL, nsNone, &pEnumSymbols))) {
-		return false;
-	}
+			iCount = 2;
+		}
 
-	IDiaSymbol * pCompiland;
-	ULONG celt = 0;
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-compiland'");
 
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pCompiland, &celt)) && (celt == 1)) {
-		wprintf(L"\n** Module: ");
+			return false;
+		}
 
-		// Retrieve the name of the module
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+	}
 
-		BSTR bstrName;
+	else if (!_wcsicmp(argv[0], L"-type")) {
+	  // -type <symbolname>: dump this type in detail
 
-		if (pCompiland->get_name(&bstrName) != S_OK) {
-			wprintf(L"(???)\n\n");
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			bReturn = bReturn && DumpType(g_pGlobalSymbol, argv[1]);
+			iCount = 2;
 		}
 
 		else {
-			wprintf(L"%s\n\n", bstrName);
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-type'");
 
-			SysFreeString(bstrName);
+			return false;
 		}
 
-		// Find all the symbols defined in this compiland and print their info
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+	}
 
-		IDiaEnumSymbols * pEnumChildren;
+	else if (!_wcsicmp(argv[0], L"-label")) {
+	  // -label <RVA>      : dump label at RVA
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			DWORD dwRVA = 0;
 
-		if (SUCCEEDED(pCompiland->findChildren(SymTagNull, NULL, nsNone, &pEnumChildren))) {
-			IDiaSymbol * pSymbol;
-			ULONG celtChildren = 0;
+			swscanf_s(argv[1], L"%x", &dwRVA);
+			bReturn = bReturn && DumpLabel(g_pDiaSession, dwRVA);
+			iCount = 2;
+		}
 
-			while (SUCCEEDED(pEnumChildren->Next(1, &pSymbol, &celtChildren)) && (celtChildren == 1)) {
-				PrintSymbol(pSymbol, 0);
-				pSymbol->Release();
-			}
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-label'");
 
-			pEnumChildren->Release();
+			return false;
 		}
 
-		pCompiland->Release();
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	pEnumSymbols->Release();
+	else if (!_wcsicmp(argv[0], L"-sym")) {
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			DWORD dwRVA = 0;
+			const wchar_t * szChildname = NULL;
 
-	putwchar(L'\n');
+			iCount = 2;
 
-	return true;
-}
+			if (argc > 2 && *argv[2] != L'-') {
+				szChildname = argv[2];
+				iCount = 3;
+			}
 
-////////////////////////////////////////////////////////////
-// Dump all the global symbols - SymTagFunction,
-//  SymTagThunk and SymTagData
-//
-bool DumpAllGlobals(IDiaSymbol * pGlobal)
-{
-	IDiaEnumSymbols * pEnumSymbols;
-	IDiaSymbol * pSymbol;
-	enum SymTagEnum dwSymTags[] = {SymTagFunction, SymTagThunk, SymTagData};
-	ULONG celt = 0;
+			if (iswdigit(*argv[1])) {
+			  // -sym <RVA> [childname]        : dump child information of symbol at this address
 
-	wprintf(L"\n\n*** GLOBALS\n\n");
+				swscanf_s(argv[1], L"%x", &dwRVA);
+				bReturn = bReturn && DumpSymbolWithRVA(g_pDiaSession, dwRVA, szChildname);
+			}
 
-	for (size_t i = 0; i < _countof(dwSymTags); i++, pEnumSymbols = NULL) {
-		if (SUCCEEDED(pGlobal->findChildren(dwSymTags[i], NULL, nsNone, &pEnumSymbols))) {
-			while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-				PrintGlobalSymbol(pSymbol);
+			else {
+			  // -sym <symbolname> [childname] : dump child information of this symbol
 
-				pSymbol->Release();
+				bReturn = bReturn && DumpSymbolsWithRegEx(g_pGlobalSymbol, argv[1], szChildname);
 			}
-
-			pEnumSymbols->Release();
 		}
 
 		else {
-			wprintf(L"ERROR - DumpAllGlobals() returned no symbols\n");
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-sym'");
 
 			return false;
 		}
-	}
-
-	putwchar(L'\n');
-
-	return true;
-}
 
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+	}
 
-////////////////////////////////////////////////////////////
-// Dump all the typedef and constant symbols - SymTagTypedef,
-//  SymTagData
-//
-bool DumpAllTypedefsAndConsts(IDiaSymbol * pGlobal)
-{
-	IDiaEnumSymbols * pEnumSymbols;
-	IDiaSymbol * pSymbol;
-	enum SymTagEnum dwSymTags[] = {SymTagTypedef, SymTagData};
-	ULONG celt = 0;
+	else if (!_wcsicmp(argv[0], L"-lsrc")) {
+	  // -lsrc  <file> [line]          : dump line numbers for this source file
 
-	wprintf(L"\n\n*** TYPEDEFS AND CONSTANTS\n\n");
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			DWORD dwLine = 0;
 
-	for (size_t i = 0; i < _countof(dwSymTags); i++, pEnumSymbols = NULL) {
-		if (SUCCEEDED(pGlobal->findChildrenEx(dwSymTags[i], NULL, nsNone, &pEnumSymbols))) {
-			while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-				PrintSymbol(pSymbol, 0);
-#if 0
-				IDiaSymbol * pLSymbol;
-				if (pSymbol->get_coffGroup(&pLSymbol) == S_OK) {
-					wprintf(L"    ");
-					PrintSymbol(pLSymbol, 4);
-					pLSymbol->Release();
-				}
-#endif
-				pSymbol->Release();
+			iCount = 2;
+			if (argc > 2 && *argv[2] != L'-') {
+				swscanf_s(argv[1], L"%d", &dwLine);
+				iCount = 3;
 			}
 
-			pEnumSymbols->Release();
+			bReturn = bReturn && DumpLinesForSourceFile(g_pDiaSession, argv[1], dwLine);
 		}
 
 		else {
-			wprintf(L"ERROR - DumpAllTypedefsAndConsts() returned no symbols\n");
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-lsrc'");
 
 			return false;
 		}
-	}
-
-	putwchar(L'\n');
-
-	return true;
-}
-
-////////////////////////////////////////////////////////////
-// Dump all the types information
-//  (type symbols can be UDTs, enums or typedefs)
-//
-bool DumpAllTypes(IDiaSymbol * pGlobal)
-{
-	wprintf(L"\n\n*** TYPES\n");
 
-	bool f1 = DumpAllUDTs(pGlobal);
-	bool f2 = DumpAllEnums(pGlobal);
-	bool f3 = DumpAllTypedefs(pGlobal);
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+	}
 
-	return f1 && f2 && f3;
-}
+	else if (!_wcsicmp(argv[0], L"-ps")) {
+	  // -ps <RVA> [-n <number>]       : dump symbols after this address, default 16
 
-////////////////////////////////////////////////////////////
-// Dump all the user defined types (UDT)
-//
-bool DumpAllUDTs(IDiaSymbol * pGlobal)
-{
-	wprintf(L"\n\n** User Defined Types\n\n");
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			DWORD dwRVA = 0;
+			DWORD dwRange;
 
-	IDiaEnumSymbols * pEnumSymbols;
+			swscanf_s(argv[1], L"%x", &dwRVA);
+			if (argc > 3 && !_wcsicmp(argv[2], L"-n")) {
+				swscanf_s(argv[3], L"%d", &dwRange);
+				iCount = 4;
+			}
 
-	if (FAILED(pGlobal->findChildren(SymTagUDT, NULL, nsNone, &pEnumSymbols))) {
-		wprintf(L"ERROR - DumpAllUDTs() returned no symbols\n");
+			else {
+				dwRange = 16;
+				iCount = 2;
+			}
 
-		return false;
-	}
+			bReturn = bReturn && DumpPublicSymbolsSorted(g_pDiaSession, dwRVA, dwRange, true);
+		}
 
-	IDiaSymbol * pSymbol;
-	ULONG celt = 0;
-	std::multimap<std::wstring, IDiaSymbol*> types;
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-ps'");
 
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-		BSTR bstrName;
-		if (pSymbol->get_name(&bstrName) != S_OK) {
-			break;
+			return false;
 		}
 
-		types.insert(std::make_pair(bstrName, pSymbol));
-		SysFreeString(bstrName);
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	for (auto& sym : types)
-	{
-		PrintTypeInDetail(sym.second, 0);
-		sym.second->Release();
-	}
+	else if (!_wcsicmp(argv[0], L"-psr")) {
+	  // -psr <RVA> [-n <number>]       : dump symbols before this address, default 16
 
-	pEnumSymbols->Release();
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			DWORD dwRVA = 0;
+			DWORD dwRange;
 
-	putwchar(L'\n');
+			swscanf_s(argv[1], L"%x", &dwRVA);
 
-	return true;
-}
+			if (argc > 3 && !_wcsicmp(argv[2], L"-n")) {
+				swscanf_s(argv[3], L"%d", &dwRange);
+				iCount = 4;
+			}
 
-////////////////////////////////////////////////////////////
-// Dump all the enum types from the pdb
-//
-bool DumpAllEnums(IDiaSymbol * pGlobal)
-{
-	wprintf(L"\n\n** ENUMS\n\n");
+			else {
+				dwRange = 16;
+				iCount = 2;
+			}
 
-	IDiaEnumSymbols * pEnumSymbols;
+			bReturn = bReturn && DumpPublicSymbolsSorted(g_pDiaSession, dwRVA, dwRange, false);
+		}
 
-	if (FAILED(pGlobal->findChildren(SymTagEnum, NULL, nsNone, &pEnumSymbols))) {
-		wprintf(L"ERROR - DumpAllEnums() returned no symbols\n");
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-psr'");
 
-		return false;
+			return false;
+		}
+
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	IDiaSymbol * pSymbol;
-	ULONG celt = 0;
+	else if (!_wcsicmp(argv[0], L"-annotations")) {
+	  // -annotations <RVA>: dump annotation symbol for this RVA
 
-	std::multimap<std::wstring, IDiaSymbol*> types;
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			DWORD dwRVA = 0;
 
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-		BSTR bstrName;
-		if (pSymbol->get_name(&bstrName) != S_OK) {
-			break;
+			swscanf_s(argv[1], L"%x", &dwRVA);
+			bReturn = bReturn && DumpAnnotations(g_pDiaSession, dwRVA);
+			iCount = 2;
 		}
 
-		types.insert(std::make_pair(bstrName, pSymbol));
-		SysFreeString(bstrName);
-	}
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-maptosrc'");
 
-	for (auto& sym : types)
-	{
-		PrintTypeInDetail(sym.second, 0);
-		sym.second->Release();
-	}
+			return false;
+		}
 
-	pEnumSymbols->Release();
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
+	}
 
-	putwchar(L'\n');
+	else if (!_wcsicmp(argv[0], L"-maptosrc")) {
+	  // -maptosrc <RVA>   : dump src RVA for this image RVA
 
-	return true;
-}
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			DWORD dwRVA = 0;
 
-////////////////////////////////////////////////////////////
-// Dump all the typedef types from the pdb
-//
-bool DumpAllTypedefs(IDiaSymbol * pGlobal)
-{
-	wprintf(L"\n\n** TYPEDEFS\n\n");
+			swscanf_s(argv[1], L"%x", &dwRVA);
+			bReturn = bReturn && DumpMapToSrc(g_pDiaSession, dwRVA);
+			iCount = 2;
+		}
 
-	IDiaEnumSymbols * pEnumSymbols;
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-maptosrc'");
 
-	if (FAILED(pGlobal->findChildren(SymTagTypedef, NULL, nsNone, &pEnumSymbols))) {
-		wprintf(L"ERROR - DumpAllTypedefs() returned no symbols\n");
+			return false;
+		}
 
-		return false;
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	IDiaSymbol * pSymbol;
-	ULONG celt = 0;
+	else if (!_wcsicmp(argv[0], L"-scrubbench")) {
+	  // -scrubbench [n]   : benchmark name scrubbing over all the publics, n passes
 
-	std::multimap<std::wstring, IDiaSymbol*> types;
+		DWORD dwIterations = 10;
 
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-		BSTR bstrName;
-		if (pSymbol->get_name(&bstrName) != S_OK) {
-			break;
+		iCount = 1;
+		if (argc > 1 && iswdigit(*argv[1])) {
+			swscanf_s(argv[1], L"%u", &dwIterations);
+			iCount = 2;
 		}
 
-		types.insert(std::make_pair(bstrName, pSymbol));
-		SysFreeString(bstrName);
+		bReturn = bReturn && DumpScrubBenchmark(g_pGlobalSymbol, dwIterations);
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	for (auto& sym : types)
-	{
-		PrintTypeInDetail(sym.second, 0);
-		sym.second->Release();
-	}
+	else if (!_wcsicmp(argv[0], L"-mapfromsrc")) {
+	  // -mapfromsrc <RVA> : dump image RVA for src RVA
 
-	pEnumSymbols->Release();
+		if ((argc > 1) && (*argv[1] != L'-')) {
+			DWORD dwRVA = 0;
 
-	putwchar(L'\n');
+			swscanf_s(argv[1], L"%x", &dwRVA);
+			bReturn = bReturn && DumpMapFromSrc(g_pDiaSession, dwRVA);
+			iCount = 2;
+		}
 
-	return true;
-}
+		else {
+			wprintf(L"ERROR - ParseArg(): missing argument for option '-mapfromsrc'");
 
-////////////////////////////////////////////////////////////
-// Dump OEM specific types
-//
-bool DumpAllOEMs(IDiaSymbol * pGlobal)
-{
-	wprintf(L"\n\n*** OEM Specific types\n\n");
+			return false;
+		}
 
-	IDiaEnumSymbols * pEnumSymbols;
-
-	if (FAILED(pGlobal->findChildren(SymTagCustomType, NULL, nsNone, &pEnumSymbols))) {
-		wprintf(L"ERROR - DumpAllOEMs() returned no symbols\n");
-
-		return false;
+		argc -= iCount;
+		bReturn = bReturn && ParseArg(argc, &argv[iCount]);
 	}
 
-	IDiaSymbol * pSymbol;
-	ULONG celt = 0;
+	else {
+		wprintf(L"ERROR - unknown option %s\n", argv[0]);
 
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-		PrintTypeInDetail(pSymbol, 0);
+		PrintHelpOptions();
 
-		pSymbol->Release();
+		return false;
 	}
 
-	pEnumSymbols->Release();
+	return bReturn;
+}
 
-	putwchar(L'\n');
+////////////////////////////////////////////////////////////
+// Display the usage
+//
+void PrintHelpOptions()
+{
+	static const wchar_t * const helpString = L"usage: Dia2Dump.exe [ options ] <filename>\n"
+		L"  -?                : print this help\n"
+		L"  -all              : print all the debug info\n"
+		L"  -m                : print all the mods\n"
+		L"  -p                : print all the publics\n"
+		L"  -g                : print all the globals\n"
+		L"  -t                : print all the types\n"
+		L"  -f                : print all the files\n"
+		L"  -s                : print symbols\n"
+		L"  -l [RVA [bytes]]  : print line number info at RVA address in the bytes range\n"
+		L"  -c                : print section contribution info\n"
+		L"  -dbg              : dump debug streams\n"
+		L"  -injsrc [file]    : dump injected source\n"
+		L"  -sf               : dump all source files\n"
+		L"  -oem              : dump all OEM specific types\n"
+		L"  -fpo [RVA]        : dump frame pointer omission information for a func addr\n"
+		L"  -fpo [symbolname] : dump frame pointer omission information for a func symbol\n"
+		L"  -image <file>     : read x64 unwind info from this image for -fpo\n"
+		L"  -fpoprog [RVA]    : dump compiled frame program for a func addr, or index stats\n"
+		L"  -inline <RVA>     : dump the chain of inlined calls at this address\n"
+		L"  -compiland [name] : dump symbols for this compiland\n"
+		L"  -compcontr [name] : dump symbols for this compiland contrib\n"
+		L"  -lines <funcname> : dump line numbers for this function\n"
+		L"  -lines <RVA>      : dump line numbers for this address\n"
+		L"  -type <symbolname>: dump this type in detail\n"
+		L"  -label <RVA>      : dump label at RVA\n"
+		L"  -sym <symbolname> [childname] : dump child information of this symbol\n"
+		L"  -sym <RVA> [childname]        : dump child information of symbol at this addr\n"
+		L"  -lsrc  <file> [line]          : dump line numbers for this source file\n"
+		L"  -ps <RVA> [-n <number>]       : dump symbols after this address, default 16\n"
+		L"  -psr <RVA> [-n <number>]      : dump symbols before this address, default 16\n"
+		L"  -annotations <RVA>: dump annotation symbol for this RVA\n"
+		L"  -maptosrc <RVA>   : dump src RVA for this image RVA\n"
+		L"  -mapfromsrc <RVA> : dump image RVA for src RVA\n"
+		L"  -scrubbench [n]   : benchmark name scrubbing over all the publics, n passes\n"
+		L"  -base <addr>      : load address for printed and exported addresses, default 400000\n"
+		L"  -perfmap <pid> [file] : write a perf map relocated to -base, default /tmp/perf-<pid>.map\n"
+		L"  -jitdump <pid> [file] : write a perf jitdump relocated to -base, default jit-<pid>.dump\n"
+		L"  -profile <samples> [collapsed] : aggregate RVA or perf script samples, write flame graph stacks\n"
+		L"  -order <samples> <file>        : write an /ORDER file clustering the hot COMDATs\n"
+		L"  -sizes [n] [file] : size per compiland, library, section, kind and template family\n"
+		L"  -icf [n]          : identical code contributions /OPT:ICF did not fold\n"
+		L"  -odr [n]          : UDT names defined with more than one layout, with the differing fields\n"
+		L"  -padding [n] [weights] : UDT holes, tail padding and cache line straddles, weights as \"<type> <count>\" lines\n"
+		L"  -field <RVA|file> : global variable member path at an RVA, or at each RVA of a file\n"
+		L"  -render <dump|raw@base> <address|file> <type> [depth] : objects of a type in a minidump or raw memory dump\n"
+		L"  -header <type[,type...]|*> <basename> [n] : compilable C++ headers of the types, split in n files\n"
+		L"  -hierarchy <class|*> [n] : bases and derived classes of a class, or the n deepest classes and diamonds\n"
+		L"  -vtables <class|*> [n]   : vftable slots, introducers, overriders and thunks of a class, or the n largest\n"
+		L"  -staticinit [n] [samples] : static initializers in init order, by compiland, weighted by startup samples\n"
+		L"  -stackframes <function|*> [n] : largest frames and locals, alloca and /GS functions, deepest call chains\n"
+		L"  -buildflags <arch|*> [file] : audit optimization, /GL, /arch and CRT of every compiland, by library\n"
+		L"  -heapsites <file> [n]    : write a sorted, mappable return RVA to allocated type index of the heap allocation sites\n"
+		L"  Or -minidump [-map <file>] <dump|dir>... to symbolize the stacks of minidumps\n"
+		L"  Or -pdbdiff <old.pdb> <new.pdb> [n] to diff the symbols, sizes and contents of two builds\n"
+		L"  Or Specify two pdbs to compare types in them\n"
+		L"  Or -typebaseline <baseline> <pdb> to save its type layouts, -typecheck <baseline> <pdb> [exclusions] to compare against them\n"
+		L"  Or Specify a typename, exe and pdb to print specific dwords\n"
+		;
 
-	return true;
+	wprintf(helpString);
 }
 
 ////////////////////////////////////////////////////////////
-// For each compiland in the PDB dump all the source files
+// Dump all the data stored in a PDB
 //
-bool DumpAllFiles(IDiaSession * pSession, IDiaSymbol * pGlobal)
+void DumpAllPdbInfo(IDiaSession * pSession, IDiaSymbol * pGlobal)
 {
-	wprintf(L"\n\n*** FILES\n\n");
+	DumpAllMods(pGlobal);
+	DumpAllPublics(pGlobal);
+	DumpAllSymbols(pGlobal);
+	DumpAllGlobals(pGlobal);
+	DumpAllTypes(pGlobal);
+	DumpAllFiles(pSession, pGlobal);
+	DumpAllLines(pSession, pGlobal);
+	DumpAllSecContribs(pSession);
+	DumpAllDebugStreams(pSession);
+	DumpAllInjectedSources(pSession);
+	DumpAllFPO(pSession);
+	DumpAllOEMs(pGlobal);
+}
 
-	// In order to find the source files, we have to look at the image's compilands/modules
+////////////////////////////////////////////////////////////
+// Dump all the modules information
+//
+bool DumpAllMods(IDiaSymbol * pGlobal)
+{
+	wprintf(L"\n\n*** MODULES\n\n");
+
+	// Retrieve all the compiland symbols
 
 	IDiaEnumSymbols * pEnumSymbols;
 
@@ -1194,81 +1352,75 @@ bool DumpAllFiles(IDiaSession * pSession, IDiaSymbol * pGlobal)
 
 	IDiaSymbol * pCompiland;
 	ULONG celt = 0;
+	ULONG iMod = 1;
 
 	while (SUCCEEDED(pEnumSymbols->Next(1, &pCompiland, &celt)) && (celt == 1)) {
 		BSTR bstrName;
 
-		if (pCompiland->get_name(&bstrName) == S_OK) {
-			wprintf(L"\nCompiland = %s\n\n", bstrName);
-
-			SysFreeString(bstrName);
-		}
-
-		// Every compiland could contain multiple references to the source files which were used to build it
-		// Retrieve all source files by compiland by passing NULL for the name of the source file
-
-		IDiaEnumSourceFiles * pEnumSourceFiles;
+		if (pCompiland->get_name(&bstrName) != S_OK) {
+			wprintf(L"ERROR - Failed to get the compiland's name\n");
 
-		if (SUCCEEDED(pSession->findFile(pCompiland, NULL, nsNone, &pEnumSourceFiles))) {
-			IDiaSourceFile * pSourceFile;
+			pCompiland->Release();
+			pEnumSymbols->Release();
 
-			while (SUCCEEDED(pEnumSourceFiles->Next(1, &pSourceFile, &celt)) && (celt == 1)) {
-				PrintSourceFile(pSourceFile, nullptr);
-				putwchar(L'\n');
+			return false;
+		}
 
-				pSourceFile->Release();
-			}
+		wprintf(L"%04X %s\n", iMod++, bstrName);
 
-			pEnumSourceFiles->Release();
-		}
+		// Deallocate the string allocated previously by the call to get_name
 
-		putwchar(L'\n');
+		SysFreeString(bstrName);
 
 		pCompiland->Release();
 	}
 
 	pEnumSymbols->Release();
 
+	putwchar(L'\n');
+
 	return true;
 }
 
 ////////////////////////////////////////////////////////////
-// Dump all the line numbering information contained in the PDB
-//  Only function symbols have corresponding line numbering information
-bool DumpAllLines(IDiaSession * pSession, IDiaSymbol * pGlobal)
+// Dump all the public symbols - SymTagPublicSymbol
+//
+bool DumpAllPublics(IDiaSymbol * pGlobal)
 {
-	wprintf(L"\n\n*** LINES\n\n");
+	wprintf(L"\n\n*** PUBLICS\n\n");
 
-#if 1
-	IDiaEnumSectionContribs * pEnumSecContribs;
+	// Retrieve all the public symbols
 
-	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
+	IDiaEnumSymbols * pEnumSymbols;
+
+	if (FAILED(pGlobal->findChildren(SymTagPublicSymbol, NULL, nsNone, &pEnumSymbols))) {
 		return false;
 	}
 
-	IDiaSectionContrib * pSecContrib;
+	IDiaSymbol * pSymbol;
 	ULONG celt = 0;
 
-	while (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
-
-		DWORD dwRVA;
-		DWORD dwLength;
-
-		if (SUCCEEDED(pSecContrib->get_relativeVirtualAddress(&dwRVA)) &&
-			SUCCEEDED(pSecContrib->get_length(&dwLength))) {
-
-			DumpAllLines(pSession, dwRVA, dwLength);
-		}
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+		PrintPublicSymbol(pSymbol);
 
-		pSecContrib->Release();
+		pSymbol->Release();
 	}
 
-	pEnumSecContribs->Release();
+	pEnumSymbols->Release();
 
 	putwchar(L'\n');
-#else
 
-  // First retrieve the compilands/modules
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump all the symbol information stored in the compilands
+//
+bool DumpAllSymbols(IDiaSymbol * pGlobal)
+{
+	wprintf(L"\n\n*** SYMBOLS\n\n\n");
+
+	// Retrieve the compilands first
 
 	IDiaEnumSymbols * pEnumSymbols;
 
@@ -1280,21 +1432,36 @@ bool DumpAllLines(IDiaSession * pSession, IDiaSymbol * pGlobal)
 	ULONG celt = 0;
 
 	while (SUCCEEDED(pEnumSymbols->Next(1, &pCompiland, &celt)) && (celt == 1)) {
-		IDiaEnumSymbols * pEnumFunction;
+		wprintf(L"\n** Module: ");
 
-		// For every function symbol defined in the compiland, retrieve and print the line numbering info
+		// Retrieve the name of the module
 
-		if (SUCCEEDED(pCompiland->findChildren(SymTagFunction, NULL, nsNone, &pEnumFunction))) {
-			IDiaSymbol * pFunction;
-			ULONG celt = 0;
+		BSTR bstrName;
 
-			while (SUCCEEDED(pEnumFunction->Next(1, &pFunction, &celt)) && (celt == 1)) {
-				PrintLines(pSession, pFunction);
+		if (pCompiland->get_name(&bstrName) != S_OK) {
+			wprintf(L"(???)\n\n");
+		}
 
-				pFunction->Release();
+		else {
+			wprintf(L"%s\n\n", bstrName);
+
+			SysFreeString(bstrName);
+		}
+
+		// Find all the symbols defined in this compiland and print their info
+
+		IDiaEnumSymbols * pEnumChildren;
+
+		if (SUCCEEDED(pCompiland->findChildren(SymTagNull, NULL, nsNone, &pEnumChildren))) {
+			IDiaSymbol * pSymbol;
+			ULONG celtChildren = 0;
+
+			while (SUCCEEDED(pEnumChildren->Next(1, &pSymbol, &celtChildren)) && (celtChildren == 1)) {
+				PrintSymbol(pSymbol, 0);
+				pSymbol->Release();
 			}
 
-			pEnumFunction->Release();
+			pEnumChildren->Release();
 		}
 
 		pCompiland->Release();
@@ -1303,109 +1470,141 @@ bool DumpAllLines(IDiaSession * pSession, IDiaSymbol * pGlobal)
 	pEnumSymbols->Release();
 
 	putwchar(L'\n');
-#endif
 
 	return true;
 }
 
 ////////////////////////////////////////////////////////////
-// Dump all the line numbering information for a given RVA
-// and a given range
+// Dump all the global symbols - SymTagFunction,
+//  SymTagThunk and SymTagData
 //
-bool DumpAllLines(IDiaSession * pSession, DWORD dwRVA, DWORD dwRange)
+bool DumpAllGlobals(IDiaSymbol * pGlobal)
 {
-  // Retrieve and print the lines that corresponds to a specified RVA
+	IDiaEnumSymbols * pEnumSymbols;
+	IDiaSymbol * pSymbol;
+	enum SymTagEnum dwSymTags[] = {SymTagFunction, SymTagThunk, SymTagData};
+	ULONG celt = 0;
 
-	IDiaEnumLineNumbers * pLines;
+	wprintf(L"\n\n*** GLOBALS\n\n");
 
-	if (FAILED(pSession->findLinesByRVA(dwRVA, dwRange, &pLines))) {
-		return false;
-	}
+	for (size_t i = 0; i < _countof(dwSymTags); i++, pEnumSymbols = NULL) {
+		if (SUCCEEDED(pGlobal->findChildren(dwSymTags[i], NULL, nsNone, &pEnumSymbols))) {
+			while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+				PrintGlobalSymbol(pSymbol);
 
-	PrintLines(pLines, nullptr);
+				pSymbol->Release();
+			}
 
-	pLines->Release();
+			pEnumSymbols->Release();
+		}
+
+		else {
+			wprintf(L"ERROR - DumpAllGlobals() returned no symbols\n");
+
+			return false;
+		}
+	}
 
 	putwchar(L'\n');
 
 	return true;
 }
 
-struct Contribs
-{
-	uint32_t rva;
-	uint32_t size;
-	uint32_t crc;
-};
-
-std::vector<Contribs> contribs;
 
 ////////////////////////////////////////////////////////////
-// Dump all the section contributions from the PDB
-//
-//  Section contributions are stored in a table which will
-//  be retrieved via IDiaSession->getEnumTables through
-//  QueryInterface()using the REFIID of the IDiaEnumSectionContribs
+// Dump all the typedef and constant symbols - SymTagTypedef,
+//  SymTagData
 //
-bool DumpAllSecContribs(IDiaSession * pSession)
+bool DumpAllTypedefsAndConsts(IDiaSymbol * pGlobal)
 {
-	wprintf(L"\n\n*** SECTION CONTRIBUTION\n\n");
+	IDiaEnumSymbols * pEnumSymbols;
+	IDiaSymbol * pSymbol;
+	enum SymTagEnum dwSymTags[] = {SymTagTypedef, SymTagData};
+	ULONG celt = 0;
 
-	IDiaEnumSectionContribs * pEnumSecContribs;
+	wprintf(L"\n\n*** TYPEDEFS AND CONSTANTS\n\n");
 
-	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
-		return false;
-	}
+	for (size_t i = 0; i < _countof(dwSymTags); i++, pEnumSymbols = NULL) {
+		if (SUCCEEDED(pGlobal->findChildrenEx(dwSymTags[i], NULL, nsNone, &pEnumSymbols))) {
+			while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+				PrintSymbol(pSymbol, 0);
+#if 0
+				IDiaSymbol * pLSymbol;
+				if (pSymbol->get_coffGroup(&pLSymbol) == S_OK) {
+					wprintf(L"    ");
+					PrintSymbol(pLSymbol, 4);
+					pLSymbol->Release();
+				}
+#endif
+				pSymbol->Release();
+			}
 
-	//wprintf(L"    RVA        Address       Size    Module\n");
+			pEnumSymbols->Release();
+		}
 
-	IDiaSectionContrib * pSecContrib;
-	ULONG celt = 0;
+		else {
+			wprintf(L"ERROR - DumpAllTypedefsAndConsts() returned no symbols\n");
 
-	DWORD sect = 0;
-	while (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
-		pSecContrib->get_addressSection(&sect);
-		//only care about text
-		//if (sect != 1) {
-		//  break;
-		//}
-		PrintSecContribs(pSession, pSecContrib);
-		pSecContrib->Release();
-		//putwchar(L'\n');
+			return false;
+		}
 	}
 
-	pEnumSecContribs->Release();
-
 	putwchar(L'\n');
 
 	return true;
 }
 
 ////////////////////////////////////////////////////////////
-// Dump all debug data streams contained in the PDB
+// Dump all the types information
+//  (type symbols can be UDTs, enums or typedefs)
 //
-bool DumpAllDebugStreams(IDiaSession * pSession)
+bool DumpAllTypes(IDiaSymbol * pGlobal)
 {
-	IDiaEnumDebugStreams * pEnumStreams;
+	wprintf(L"\n\n*** TYPES\n");
 
-	wprintf(L"\n\n*** DEBUG STREAMS\n\n");
+	bool f1 = DumpAllUDTs(pGlobal);
+	bool f2 = DumpAllEnums(pGlobal);
+	bool f3 = DumpAllTypedefs(pGlobal);
 
-	// Retrieve an enumerated sequence of debug data streams
+	return f1 && f2 && f3;
+}
+
+////////////////////////////////////////////////////////////
+// Dump all the user defined types (UDT)
+//
+bool DumpAllUDTs(IDiaSymbol * pGlobal)
+{
+	wprintf(L"\n\n** User Defined Types\n\n");
+
+	IDiaEnumSymbols * pEnumSymbols;
+
+	if (FAILED(pGlobal->findChildren(SymTagUDT, NULL, nsNone, &pEnumSymbols))) {
+		wprintf(L"ERROR - DumpAllUDTs() returned no symbols\n");
 
-	if (FAILED(pSession->getEnumDebugStreams(&pEnumStreams))) {
 		return false;
 	}
 
-	IDiaEnumDebugStreamData * pStream;
+	IDiaSymbol * pSymbol;
 	ULONG celt = 0;
+	std::multimap<std::wstring, IDiaSymbol*> types;
 
-	for (; SUCCEEDED(pEnumStreams->Next(1, &pStream, &celt)) && (celt == 1); pStream = NULL) {
-		PrintStreamData(pStream);
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+		BSTR bstrName;
+		if (pSymbol->get_name(&bstrName) != S_OK) {
+			break;
+		}
 
-		pStream->Release();
+		types.insert(std::make_pair(bstrName, pSymbol));
+		SysFreeString(bstrName);
 	}
 
-	pEnumStreams->Release();
+	for (auto& sym : types)
+	{
+		PrintTypeInDetail(sym.second, 0);
+		sym.second->Release();
+	}
+
+	pEnumSymbols->Release();
 
 	putwchar(L'\n');
 
@@ -1413,32 +1612,42 @@ bool DumpAllDebugStreams(IDiaSession * pSession)
 }
 
 ////////////////////////////////////////////////////////////
-// Dump all the injected source from the PDB
-//
-//  Injected sources data is stored in a table which will
-//  be retrieved via IDiaSession->getEnumTables through
-//  QueryInterface()using the REFIID of the IDiaEnumSectionContribs
+// Dump all the enum types from the pdb
 //
-bool DumpAllInjectedSources(IDiaSession * pSession)
+bool DumpAllEnums(IDiaSymbol * pGlobal)
 {
-	wprintf(L"\n\n*** INJECTED SOURCES TABLE\n\n");
+	wprintf(L"\n\n** ENUMS\n\n");
 
-	IDiaEnumInjectedSources * pEnumInjSources = NULL;
+	IDiaEnumSymbols * pEnumSymbols;
+
+	if (FAILED(pGlobal->findChildren(SymTagEnum, NULL, nsNone, &pEnumSymbols))) {
+		wprintf(L"ERROR - DumpAllEnums() returned no symbols\n");
 
-	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumInjectedSources), (void **)&pEnumInjSources))) {
 		return false;
 	}
 
-	IDiaInjectedSource * pInjSource;
+	IDiaSymbol * pSymbol;
 	ULONG celt = 0;
 
-	while (SUCCEEDED(pEnumInjSources->Next(1, &pInjSource, &celt)) && (celt == 1)) {
-		PrintGeneric(pInjSource);
+	std::multimap<std::wstring, IDiaSymbol*> types;
 
-		pInjSource->Release();
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+		BSTR bstrName;
+		if (pSymbol->get_name(&bstrName) != S_OK) {
+			break;
+		}
+
+		types.insert(std::make_pair(bstrName, pSymbol));
+		SysFreeString(bstrName);
 	}
 
-	pEnumInjSources->Release();
+	for (auto& sym : types)
+	{
+		PrintTypeInDetail(sym.second, 0);
+		sym.second->Release();
+	}
+
+	pEnumSymbols->Release();
 
 	putwchar(L'\n');
 
@@ -1446,194 +1655,96 @@ bool DumpAllInjectedSources(IDiaSession * pSession)
 }
 
 ////////////////////////////////////////////////////////////
-// Dump info corresponing to a given injected source filename
+// Dump all the typedef types from the pdb
 //
-bool DumpInjectedSource(IDiaSession * pSession, const wchar_t * szName)
+bool DumpAllTypedefs(IDiaSymbol * pGlobal)
 {
-  // Retrieve a source that has been placed into the symbol store by attribute providers or
-  //  other components of the compilation process
+	wprintf(L"\n\n** TYPEDEFS\n\n");
 
-	IDiaEnumInjectedSources * pEnumInjSources;
+	IDiaEnumSymbols * pEnumSymbols;
 
-	if (FAILED(pSession->findInjectedSource(szName, &pEnumInjSources))) {
-		wprintf(L"ERROR - DumpInjectedSources() could not find %s\n", szName);
+	if (FAILED(pGlobal->findChildren(SymTagTypedef, NULL, nsNone, &pEnumSymbols))) {
+		wprintf(L"ERROR - DumpAllTypedefs() returned no symbols\n");
 
 		return false;
 	}
 
-	IDiaInjectedSource * pInjSource;
+	IDiaSymbol * pSymbol;
 	ULONG celt = 0;
 
-	while (SUCCEEDED(pEnumInjSources->Next(1, &pInjSource, &celt)) && (celt == 1)) {
-		PrintGeneric(pInjSource);
+	std::multimap<std::wstring, IDiaSymbol*> types;
 
-		pInjSource->Release();
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+		BSTR bstrName;
+		if (pSymbol->get_name(&bstrName) != S_OK) {
+			break;
+		}
+
+		types.insert(std::make_pair(bstrName, pSymbol));
+		SysFreeString(bstrName);
 	}
 
-	pEnumInjSources->Release();
+	for (auto& sym : types)
+	{
+		PrintTypeInDetail(sym.second, 0);
+		sym.second->Release();
+	}
+
+	pEnumSymbols->Release();
+
+	putwchar(L'\n');
 
 	return true;
 }
 
+////////////////////////////////////////////////////////////
+// Dump OEM specific types
+//
+bool DumpAllOEMs(IDiaSymbol * pGlobal)
+{
+	wprintf(L"\n\n*** OEM Specific types\n\n");
 
-class CSourceFile {
-	public:
-	const std::wstring & GetSourceFileName();
-	CV_SourceChksum_t GetCheckSumType() const;
-	const char * GetCheckSum() const;
+	IDiaEnumSymbols * pEnumSymbols;
 
-	CSourceFile(IDiaSourceFile *);
-	virtual ~CSourceFile();
+	if (FAILED(pGlobal->findChildren(SymTagCustomType, NULL, nsNone, &pEnumSymbols))) {
+		wprintf(L"ERROR - DumpAllOEMs() returned no symbols\n");
 
-	private:
-	IDiaSourceFile * m_pIDiaSourceFile;
+		return false;
+	}
 
-	std::wstring m_fileName;
+	IDiaSymbol * pSymbol;
+	ULONG celt = 0;
 
-	// Checksum
-	CV_SourceChksum_t m_checkSumType;
-	char m_checkSum[32 + 1];
-};
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+		PrintTypeInDetail(pSymbol, 0);
 
-CSourceFile::CSourceFile(IDiaSourceFile * file) :
-	m_pIDiaSourceFile(file),
-	m_checkSumType(CHKSUM_TYPE_NONE),
-	m_checkSum()
-{
-	if (m_pIDiaSourceFile == NULL) {
-		return;
+		pSymbol->Release();
 	}
 
-	BSTR filename;
-	if (m_pIDiaSourceFile->get_fileName(&filename) == S_OK) {
-		m_fileName = filename;
-		SysFreeString(filename);
-	}
+	pEnumSymbols->Release();
 
-	memset(m_checkSum, 0, sizeof(m_checkSum));
+	putwchar(L'\n');
 
-	DWORD checksumType = CHKSUM_TYPE_NONE;
-	if (m_pIDiaSourceFile->get_checksumType(&checksumType) == S_OK) {
-		switch (checksumType) {
-			case CHKSUM_TYPE_NONE:
-				m_checkSumType = CHKSUM_TYPE_NONE;
-				break;
+	return true;
+}
 
-			case CHKSUM_TYPE_MD5:
-				m_checkSumType = CHKSUM_TYPE_MD5;
-				break;
+////////////////////////////////////////////////////////////
+// For each compiland in the PDB dump all the source files
+//
+bool DumpAllFiles(IDiaSession * pSession, IDiaSymbol * pGlobal)
+{
+	wprintf(L"\n\n*** FILES\n\n");
 
-			case CHKSUM_TYPE_SHA1:
-				m_checkSumType = CHKSUM_TYPE_SHA1;
-				break;
+	// In order to find the source files, we have to look at the image's compilands/modules
 
-			case CHKSUM_TYPE_SHA_256:
-				m_checkSumType = CHKSUM_TYPE_SHA_256;
-				break;
+	IDiaEnumSymbols * pEnumSymbols;
 
-			default:
-				m_checkSumType = CHKSUM_TYPE_NONE;
-				break;
-		}
+	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL, nsNone, &pEnumSymbols))) {
+		return false;
 	}
 
-	char buffer[MAX_PATH] = {0};
-	DWORD size = sizeof(buffer);
-	if (m_checkSumType == CHKSUM_TYPE_MD5 && file->get_checksum(size, &size, (BYTE *)buffer) == S_OK) {
-		char hexlut[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
-		for (int i = 0; i < sizeof(hexlut); i++) {
-			m_checkSum[i * 2] = hexlut[((buffer[i] >> 4) & 0xF)];
-			m_checkSum[(i * 2) + 1] = hexlut[(buffer[i]) & 0x0F];
-		}
-	} else {
-		strncpy_s(m_checkSum, "BAD HASH TYPE", sizeof(m_checkSum) - 1);
-	}
-}
-
-CSourceFile::~CSourceFile()
-{
-/*
-	if (m_pIDiaSourceFile) {
-		m_pIDiaSourceFile->Release();
-		m_pIDiaSourceFile = NULL;
-	}
-*/
-}
-
-const std::wstring & CSourceFile::GetSourceFileName()
-{
-	return m_fileName;
-}
-
-CV_SourceChksum_t CSourceFile::GetCheckSumType() const
-{
-	return m_checkSumType;
-}
-
-const char * CSourceFile::GetCheckSum() const
-{
-	return m_checkSum;
-}
-
-std::map<std::wstring, CSourceFile *> source_files_;
-
-void CacheSourceFile(const std::wstring & file, CSourceFile * src)
-{
-	source_files_[file] = src;
-}
-
-bool IsSourceFileCached(const std::wstring & file)
-{
-	return source_files_.find(file) != source_files_.end();
-}
-
-std::vector< CSourceFile *>	m_vectorSources;
-
-//dont need anything msvc or sdk
-bool IsSkipableSourceFile(std::wstring & name)
-{
-	if (name.find(L"f:\\rtm\\") != std::string::npos ||
-		name.find(L"f:\\sp\\public\\") != std::string::npos ||
-		name.find(L"F:\\RTM\\vctools\\") != std::string::npos ||
-		name.find(L"F:\\SP\\vctools\\") != std::string::npos ||
-		name.find(L"f:\\sp\\vctools\\") != std::string::npos ||
-		name.find(L"f:\\binaries.x86ret\\") != std::string::npos ||
-		name.find(L"e:\\wm.obj.x86fre\\") != std::string::npos ||
-		name.find(L"d:\\winmain\\") != std::string::npos ||
-		name.find(L"d:\\winmain.public.x86fre\\") != std::string::npos ||
-		name.find(L"microsoft visual studio") != std::string::npos ||
-		name.find(L"\\DXSDK\\") != std::string::npos ||
-		name.find(L"microsoft directx sdk") != std::string::npos) {
-		return true;
-	}
-	return false;
-}
-
-////////////////////////////////////////////////////////////
-// Dump all the source file information stored in the PDB
-// We have to go through every compiland in order to retrieve
-//   all the information otherwise checksums for instance
-//   will not be available
-// Compilands can have multiple source files with the same
-//   name but different content which produces diffrent
-//   checksums
-//
-bool DumpAllSourceFiles(IDiaSession * pSession, IDiaSymbol * pGlobal)
-{
-#if 0
-	wprintf(L"\n\n*** SOURCE FILES\n\n");
-
-	// To get the complete source file info we must go through the compiland first
-	// by passing NULL instead all the source file names only will be retrieved
-
-	IDiaEnumSymbols * pEnumSymbols;
-
-	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL, nsNone, &pEnumSymbols))) {
-		return false;
-	}
-
-	IDiaSymbol * pCompiland;
-	ULONG celt = 0;
+	IDiaSymbol * pCompiland;
+	ULONG celt = 0;
 
 	while (SUCCEEDED(pEnumSymbols->Next(1, &pCompiland, &celt)) && (celt == 1)) {
 		BSTR bstrName;
@@ -1653,7 +1764,7 @@ bool DumpAllSourceFiles(IDiaSession * pSession, IDiaSymbol * pGlobal)
 			IDiaSourceFile * pSourceFile;
 
 			while (SUCCEEDED(pEnumSourceFiles->Next(1, &pSourceFile, &celt)) && (celt == 1)) {
-				PrintSourceFile(pSourceFile);
+				PrintSourceFile(pSourceFile, nullptr);
 				putwchar(L'\n');
 
 				pSourceFile->Release();
@@ -1668,347 +1779,217 @@ bool DumpAllSourceFiles(IDiaSession * pSession, IDiaSymbol * pGlobal)
 	}
 
 	pEnumSymbols->Release();
-#endif
 
-#if 0
-	ULONG celt = 0;
+	return true;
+}
 
-	IDiaEnumSymbols * pEnumSymbols;
-	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL, nsNone, &pEnumSymbols))) {
+////////////////////////////////////////////////////////////
+// Dump all the line numbering information contained in the PDB
+//  Only function symbols have corresponding line numbering information
+bool DumpAllLines(IDiaSession * pSession, IDiaSymbol * pGlobal)
+{
+	wprintf(L"\n\n*** LINES\n\n");
+
+#if 1
+	IDiaEnumSectionContribs * pEnumSecContribs;
+
+	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
 		return false;
 	}
-	IDiaEnumSourceFiles * pEnumSourceFiles;
-	if (SUCCEEDED(pSession->findFile(NULL, NULL, nsNone, &pEnumSourceFiles))) {
-		LONG lCount = 0;
-		pEnumSourceFiles->get_Count(&lCount);
-		IDiaSourceFile * pSourceFile = 0;
-		for (int i = 0; i < lCount - 1; i++) {
-			ULONG res;
-			if (SUCCEEDED(pEnumSourceFiles->Next(1, &pSourceFile, &res)) && res == 1) {
-				PrintSourceFile(pSourceFile);
-				putwchar(L'\n');
 
-				pSourceFile->Release();
-			}
+	IDiaSectionContrib * pSecContrib;
+	ULONG celt = 0;
 
-		}
-		if (pEnumSourceFiles) {
-			pEnumSourceFiles->Release();
-		}
+	while (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
+
+		DWORD dwRVA;
+		DWORD dwLength;
 
+		if (SUCCEEDED(pSecContrib->get_relativeVirtualAddress(&dwRVA)) &&
+			SUCCEEDED(pSecContrib->get_length(&dwLength))) {
+
+			DumpAllLines(pSession, dwRVA, dwLength);
+		}
 
+		pSecContrib->Release();
 	}
 
-#endif
+	pEnumSecContribs->Release();
 
-#if 1
-	IDiaSymbol * global;
-	if (FAILED(pSession->get_globalScope(&global))) {
-		fprintf(stderr, "get_globalScope failed\n");
+	putwchar(L'\n');
+#else
+
+  // First retrieve the compilands/modules
+
+	IDiaEnumSymbols * pEnumSymbols;
+
+	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL, nsNone, &pEnumSymbols))) {
 		return false;
 	}
 
+	IDiaSymbol * pCompiland;
+	ULONG celt = 0;
 
-	BSTR pdbname;
-	if (SUCCEEDED(global->get_name(&pdbname))) {
-		wprintf(L";PDB: %s\n", pdbname);
-		SysReleaseString(pdbname);
-	}
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pCompiland, &celt)) && (celt == 1)) {
+		IDiaEnumSymbols * pEnumFunction;
 
-	DWORD time;
-	if (SUCCEEDED(global->get_signature(&time))) {
-		__time32_t now = time;
-		std::tm ptm;
-		_localtime32_s(&ptm, &now);
-		wchar_t buffer[32];
-		// Format: Mo, 15.06.2009 20:20:00
-		//DebugBreak();
-		wcsftime(buffer, 32, L"%d.%m.%Y %H:%M:%S", &ptm);
+		// For every function symbol defined in the compiland, retrieve and print the line numbering info
 
-		wprintf(L";TimeStamp: %s (%x)\n", buffer, time);
-	}
+		if (SUCCEEDED(pCompiland->findChildren(SymTagFunction, NULL, nsNone, &pEnumFunction))) {
+			IDiaSymbol * pFunction;
+			ULONG celt = 0;
 
-	GUID guid;
-	if (SUCCEEDED(global->get_guid(&guid))) {
-		const int maxGUIDStrLen = 64 + 1;
-		std::vector<wchar_t> guidStr(maxGUIDStrLen);
-		if (StringFromGUID2(guid, guidStr.data(), maxGUIDStrLen) > 0) {
-			wprintf(L";GUID: %ls\n", guidStr.data());
+			while (SUCCEEDED(pEnumFunction->Next(1, &pFunction, &celt)) && (celt == 1)) {
+				PrintLines(pSession, pFunction);
+
+				pFunction->Release();
+			}
+
+			pEnumFunction->Release();
 		}
+
+		pCompiland->Release();
 	}
 
+	pEnumSymbols->Release();
 
-	IDiaEnumSymbols * compilands;
-	if (FAILED(global->findChildren(SymTagCompiland, NULL,
-		nsNone, &compilands))) {
-		fprintf(stderr, "findChildren failed\n");
-		return false;
-	}
+	putwchar(L'\n');
+#endif
 
-	LONG c;
-	;
+	return true;
+}
 
-	if (FAILED(compilands->get_Count(&c))) {
-		fprintf(stderr, "compilands->get_Count failed\n");
+////////////////////////////////////////////////////////////
+// Dump all the line numbering information for a given RVA
+// and a given range
+//
+bool DumpAllLines(IDiaSession * pSession, DWORD dwRVA, DWORD dwRange)
+{
+  // Retrieve and print the lines that corresponds to a specified RVA
+
+	IDiaEnumLineNumbers * pLines;
+
+	if (FAILED(pSession->findLinesByRVA(dwRVA, dwRange, &pLines))) {
 		return false;
 	}
-	//ULONG count;
 
-	IDiaEnumSourceFiles * source_files;
-	IDiaSymbol * compiland = NULL;
+	PrintLines(pLines, nullptr);
 
-	wprintf(L";Compilands: %d\n", c);
-	for (int cidx = 0; cidx < c; cidx++) {
-	//while (SUCCEEDED(compilands->Next(i, &compiland, &count))) {
-	  //if (count > 1) {
-	  //    fprintf(stderr, "Next failed %d\n", count);
-	  //    return false;
-	  //}
+	pLines->Release();
 
-		if (FAILED(compilands->Item(cidx, &compiland))) {
-			fprintf(stderr, "compilands->Item(%d) failed\n", cidx);
-			return false;
-		}
+	putwchar(L'\n');
 
-		if (FAILED(pSession->findFile(compiland, NULL, nsNone, &source_files))) {
-			fprintf(stderr, "pSession->findFile(%d) failed\n", cidx);
-			return false;
-		}
+	return true;
+}
 
-		LONG sc;
-		if (FAILED(source_files->get_Count(&sc))) {
-			fprintf(stderr, "source_files->get_Count failed\n");
-			return false;
-		}
-		//fprintf(stderr, "source_files %d\n", sc);
+struct Contribs
+{
+	uint32_t rva;
+	uint32_t size;
+	uint32_t crc;
+};
 
-		BSTR cname;
-		if (FAILED(compiland->get_name(&cname))) {
-			fprintf(stderr, "compiland->get_name failed\n");
-			return false;
-		}
-		//wprintf(L";Compiland \"%s\" source_files %d\n", cname, sc);
-		if (sc == 0) {
-			wprintf(L";WARNING No Symbols in Compiland \"%s\"\n", cname);
-		}
-		SysFreeString(cname);
+std::vector<Contribs> contribs;
 
-		IDiaSourceFile * source_file;
-		for (int sidx = 0; sidx < sc; sidx++) {
-			if (FAILED(source_files->Item(sidx, &source_file))) {
-				fprintf(stderr, "source_files->Item(%d) failed\n", sidx);
-				return false;
-			}
-
-			BSTR file_name;
-			if (FAILED(source_file->get_fileName(&file_name))) {
-				fprintf(stderr, "source_file->get_fileName(%d) failed\n", sidx);
-				return false;
-			}
-
-			std::wstring file_name_string(file_name);
-			if (!IsSourceFileCached(file_name_string)) {
-				// this is a new file name, cache it and output a FILE line.
-				CSourceFile * pCSourceFile = new CSourceFile(source_file);
-				CacheSourceFile(file_name_string, pCSourceFile);
-			}
-			SysFreeString(file_name);
-			source_file->Release();
-		}
-		compiland->Release();
-	}
-
-	for (auto it = source_files_.begin(); it != source_files_.end(); it++) {
-		CSourceFile * src = it->second;
-		if (src != nullptr) {
-			std::wstring name = src->GetSourceFileName();
-			auto checksumType = src->GetCheckSumType();
-			auto checksum = src->GetCheckSum();
-			bool skip = false;
-#if 1
-	  // skip msvc
-			if (IsSkipableSourceFile(name)) {
-				skip = true;
-			}
-#endif
-			if (!name.empty()) {
-#if 0
-				if (checksumType == CHKSUM_TYPE_MD5) {
-					//wprintf(L"%hs *%ls\n", checksum, name.c_str());
-					wprintf(L"%s*%ls %hs\n", skip ? L";" : L"", name.c_str(), checksum);
-				} else {
-					wprintf(L"%s*%ls %hs\n", skip ? L";" : L"", name.c_str(), "ERRRRRRRRRRRRRRRRRRRRR");
-				}
-#endif				
-				
-				if (checksumType != CHKSUM_TYPE_MD5) {
-					checksum = "ERRRRRRRRRRRRRRRRRRRRR";
-					fprintf(stderr, "Unhandled checksum(%d)\n", checksumType);
-					skip = true;
-				}
-				//wprintf(L"%s*%ls %hs\n", skip ? L";" : L"", name.c_str(), checksum);
-				wprintf(L"%s %hs *%ls\n", skip ? L";" : L"", checksum, name.c_str());
-			}
-		}
-	}
-#endif
-#if 0
-	wprintf(L"\n\n*** FILES\n\n");
+////////////////////////////////////////////////////////////
+// Dump all the section contributions from the PDB
+//
+//  Section contributions are stored in a table which will
+//  be retrieved via IDiaSession->getEnumTables through
+//  QueryInterface()using the REFIID of the IDiaEnumSectionContribs
+//
+bool DumpAllSecContribs(IDiaSession * pSession)
+{
+	wprintf(L"\n\n*** SECTION CONTRIBUTION\n\n");
 
-	IDiaEnumSourceFiles * pEnumSourceFiles;
+	IDiaEnumSectionContribs * pEnumSecContribs;
 
-	if (FAILED(GetTable(g_pDiaSession, __uuidof(IDiaEnumSourceFiles), (void **)&pEnumSourceFiles))) {
+	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
 		return false;
 	}
 
-	IDiaSourceFile * pSourceFile;
+	//wprintf(L"    RVA        Address       Size    Module\n");
+
+	IDiaSectionContrib * pSecContrib;
 	ULONG celt = 0;
 
-	IDiaEnumSymbols * compilands;
-	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL,
-		nsNone, &compilands))) {
-		fprintf(stderr, "findChildren failed\n");
-		return false;
+	DWORD sect = 0;
+	while (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
+		pSecContrib->get_addressSection(&sect);
+		//only care about text
+		//if (sect != 1) {
+		//  break;
+		//}
+		PrintSecContribs(pSession, pSecContrib);
+		pSecContrib->Release();
+		//putwchar(L'\n');
 	}
 
-	while (SUCCEEDED(pEnumSourceFiles->Next(1, &pSourceFile, &celt)) && (celt == 1)) {
-
-		BSTR file_name;
-		if (FAILED(pSourceFile->get_fileName(&file_name))) {
-			return false;
-		}
-
-		std::wstring file_name_string(file_name);
-		if (!IsSourceFileCached(file_name_string)) {
-		  // this is a new file name, cache it and output a FILE line.
-			CSourceFile * pCSourceFile = new CSourceFile(pSourceFile);
-			CacheSourceFile(file_name_string, pCSourceFile);
-		}
-		SysFreeString(file_name);
+	pEnumSecContribs->Release();
 
-		pSourceFile->Release();
-	}
+	putwchar(L'\n');
 
-	pEnumSourceFiles->Release();
+	return true;
+}
 
-	for (auto it = source_files_.begin(); it != source_files_.end(); it++) {
-		CSourceFile * src = it->second;
-		if (src != nullptr) {
-			std::wstring name = src->GetSourceFileName();
-			auto checksumType = src->GetCheckSumType();
-			auto checksum = src->GetCheckSum();
-			// skip msvc
-			if (IsSkipableSourceFile(name)) {
-				continue;
-			}
-			if (!name.empty() && checksumType == CheckSumType_MD5) {
-				wprintf(L"%hs *%ls\n", checksum, name.c_str());
-			}
-		}
-	}
-#endif
+////////////////////////////////////////////////////////////
+// Dump all debug data streams contained in the PDB
+//
+bool DumpAllDebugStreams(IDiaSession * pSession)
+{
+	IDiaEnumDebugStreams * pEnumStreams;
 
-#if 0
-	IDiaSymbol * global;
-	if (FAILED(pSession->get_globalScope(&global))) {
-		fprintf(stderr, "get_globalScope failed\n");
-		return false;
-	}
+	wprintf(L"\n\n*** DEBUG STREAMS\n\n");
 
-	IDiaEnumSourceFiles * pEnumSourceFiles;
+	// Retrieve an enumerated sequence of debug data streams
 
-	if (FAILED(GetTable(g_pDiaSession, __uuidof(IDiaEnumSourceFiles), (void **)&pEnumSourceFiles))) {
+	if (FAILED(pSession->getEnumDebugStreams(&pEnumStreams))) {
 		return false;
 	}
 
-	IDiaSession * pIDiaSession = pSession;
-	if (pIDiaSession) {
-
-		if (1) {
-			LONG lCount = 0;
-			pEnumSourceFiles->get_Count(&lCount);
-			if (lCount == 0) {
-				DebugBreak();
-			}
-
-			for (DWORD dw = 0; dw < (DWORD)lCount; dw++) {
-				IDiaSourceFile * pIDiaSourceFile = NULL;
-				if (pEnumSourceFiles->Item(dw, &pIDiaSourceFile) == S_OK) {
-					BSTR file_name;
-					if (FAILED(pIDiaSourceFile->get_fileName(&file_name))) {
-						DebugBreak();
-						return false;
-					}
+	IDiaEnumDebugStreamData * pStream;
+	ULONG celt = 0;
 
-					std::wstring file_name_string(file_name);
-					if (!IsSourceFileCached(file_name_string)) {
-						//DebugBreak();
-					  // this is a new file name, cache it and output a FILE line.
-						CSourceFile * pCSourceFile = new CSourceFile(pIDiaSourceFile);
-						CacheSourceFile(file_name_string, pCSourceFile);
-					}
-					SysFreeString(file_name);
+	for (; SUCCEEDED(pEnumStreams->Next(1, &pStream, &celt)) && (celt == 1); pStream = NULL) {
+		PrintStreamData(pStream);
 
-				} else {
-					DebugBreak();
-				}
-			}
-		}
-		if (pEnumSourceFiles) {
-			pEnumSourceFiles->Release();
-		}
+		pStream->Release();
 	}
 
+	pEnumStreams->Release();
 
-	for (auto it = source_files_.begin(); it != source_files_.end(); it++) {
-		CSourceFile * src = it->second;
-		if (src != nullptr) {
-			std::wstring name = src->GetSourceFileName();
-			auto checksumType = src->GetCheckSumType();
-			auto checksum = src->GetCheckSum();
-			// skip msvc
-			if (IsSkipableSourceFile(name)) {
-				continue;
-			}
-			if (!name.empty() && checksumType == CheckSumType_MD5) {
-				wprintf(L"%hs *%ls\n", checksum, name.c_str());
-			} else {
-				wprintf(L"%hs *%ls\n", "0", name.c_str());
+	putwchar(L'\n');
 
-			}
-		}
-	}
-#endif
 	return true;
 }
 
 ////////////////////////////////////////////////////////////
-// Dump all the FPO info
+// Dump all the injected source from the PDB
 //
-//  FPO data stored in a table which will be retrieved via
-//    IDiaSession->getEnumTables through QueryInterface()
-//    using the REFIID of the IDiaEnumFrameData
+//  Injected sources data is stored in a table which will
+//  be retrieved via IDiaSession->getEnumTables through
+//  QueryInterface()using the REFIID of the IDiaEnumSectionContribs
 //
-bool DumpAllFPO(IDiaSession * pSession)
+bool DumpAllInjectedSources(IDiaSession * pSession)
 {
-	IDiaEnumFrameData * pEnumFrameData;
+	wprintf(L"\n\n*** INJECTED SOURCES TABLE\n\n");
 
-	wprintf(L"\n\n*** FPO\n\n");
+	IDiaEnumInjectedSources * pEnumInjSources = NULL;
 
-	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumFrameData), (void **)&pEnumFrameData))) {
+	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumInjectedSources), (void **)&pEnumInjSources))) {
 		return false;
 	}
 
-	IDiaFrameData * pFrameData;
+	IDiaInjectedSource * pInjSource;
 	ULONG celt = 0;
 
-	while (SUCCEEDED(pEnumFrameData->Next(1, &pFrameData, &celt)) && (celt == 1)) {
-		PrintFrameData(pFrameData);
+	while (SUCCEEDED(pEnumInjSources->Next(1, &pInjSource, &celt)) && (celt == 1)) {
+		PrintGeneric(pInjSource);
 
-		pFrameData->Release();
+		pInjSource->Release();
 	}
 
-	pEnumFrameData->Release();
+	pEnumInjSources->Release();
 
 	putwchar(L'\n');
 
@@ -2016,94 +1997,189 @@ bool DumpAllFPO(IDiaSession * pSession)
 }
 
 ////////////////////////////////////////////////////////////
-// Dump FPO info for a function at the specified RVA
+// Dump info corresponing to a given injected source filename
 //
-bool DumpFPO(IDiaSession * pSession, DWORD dwRVA)
+bool DumpInjectedSource(IDiaSession * pSession, const wchar_t * szName)
 {
-	IDiaEnumFrameData * pEnumFrameData;
+  // Retrieve a source that has been placed into the symbol store by attribute providers or
+  //  other components of the compilation process
 
-	// Retrieve first the table holding all the FPO info
+	IDiaEnumInjectedSources * pEnumInjSources;
 
-	if ((dwRVA != 0) && SUCCEEDED(GetTable(pSession, __uuidof(IDiaEnumFrameData), (void **)&pEnumFrameData))) {
-		IDiaFrameData * pFrameData;
+	if (FAILED(pSession->findInjectedSource(szName, &pEnumInjSources))) {
+		wprintf(L"ERROR - DumpInjectedSources() could not find %s\n", szName);
 
-		// Retrieve the frame data corresponding to the given RVA
+		return false;
+	}
 
-		if (SUCCEEDED(pEnumFrameData->frameByRVA(dwRVA, &pFrameData))) {
-			PrintGeneric(pFrameData);
+	IDiaInjectedSource * pInjSource;
+	ULONG celt = 0;
 
-			pFrameData->Release();
-		}
+	while (SUCCEEDED(pEnumInjSources->Next(1, &pInjSource, &celt)) && (celt == 1)) {
+		PrintGeneric(pInjSource);
 
-		else {
-		  // Some function might not have FPO data available (see ASM funcs like strcpy)
+		pInjSource->Release();
+	}
 
-			wprintf(L"ERROR - DumpFPO() frameByRVA invalid RVA: 0x%08X\n", dwRVA);
+	pEnumInjSources->Release();
 
-			pEnumFrameData->Release();
+	return true;
+}
 
-			return false;
-		}
 
-		pEnumFrameData->Release();
-	}
+class CSourceFile {
+	public:
+	const std::wstring & GetSourceFileName();
+	CV_SourceChksum_t GetCheckSumType() const;
+	const char * GetCheckSum() const;
 
-	else {
-		wprintf(L"ERROR - DumpFPO() GetTable\n");
+	CSourceFile(IDiaSourceFile *);
+	virtual ~CSourceFile();
 
-		return false;
-	}
+	private:
+	IDiaSourceFile * m_pIDiaSourceFile;
 
-	putwchar(L'\n');
+	std::wstring m_fileName;
 
-	return true;
-}
+	// Checksum
+	CV_SourceChksum_t m_checkSumType;
+	char m_checkSum[32 + 1];
+};
 
-////////////////////////////////////////////////////////////
-// Dump FPO info for a specified function symbol using its
-//  name (a regular expression string is used for the search)
-//
-bool DumpFPO(IDiaSession * pSession, IDiaSymbol * pGlobal, const wchar_t * szSymbolName)
+CSourceFile::CSourceFile(IDiaSourceFile * file) :
+	m_pIDiaSourceFile(file),
+	m_checkSumType(CHKSUM_TYPE_NONE),
+	m_checkSum()
 {
-	IDiaEnumSymbols * pEnumSymbols;
-	IDiaSymbol * pSymbol;
-	ULONG celt = 0;
-	DWORD dwRVA;
+	if (m_pIDiaSourceFile == NULL) {
+		return;
+	}
 
-	// Find first all the function symbols that their names matches the search criteria
+	BSTR filename;
+	if (m_pIDiaSourceFile->get_fileName(&filename) == S_OK) {
+		m_fileName = filename;
+		SysFreeString(filename);
+	}
 
-	if (FAILED(pGlobal->findChildren(SymTagFunction, szSymbolName, nsRegularExpression, &pEnumSymbols))) {
-		wprintf(L"ERROR - DumpFPO() findChildren could not find symol %s\n", szSymbolName);
+	memset(m_checkSum, 0, sizeof(m_checkSum));
 
-		return false;
-	}
+	DWORD checksumType = CHKSUM_TYPE_NONE;
+	if (m_pIDiaSourceFile->get_checksumType(&checksumType) == S_OK) {
+		switch (checksumType) {
+			case CHKSUM_TYPE_NONE:
+				m_checkSumType = CHKSUM_TYPE_NONE;
+				break;
 
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-		if (pSymbol->get_relativeVirtualAddress(&dwRVA) == S_OK) {
-			PrintPublicSymbol(pSymbol);
+			case CHKSUM_TYPE_MD5:
+				m_checkSumType = CHKSUM_TYPE_MD5;
+				break;
 
-			DumpFPO(pSession, dwRVA);
+			case CHKSUM_TYPE_SHA1:
+				m_checkSumType = CHKSUM_TYPE_SHA1;
+				break;
+
+			case CHKSUM_TYPE_SHA_256:
+				m_checkSumType = CHKSUM_TYPE_SHA_256;
+				break;
+
+			default:
+				m_checkSumType = CHKSUM_TYPE_NONE;
+				break;
 		}
+	}
 
-		pSymbol->Release();
+	char buffer[MAX_PATH] = {0};
+	DWORD size = sizeof(buffer);
+	if (m_checkSumType == CHKSUM_TYPE_MD5 && file->get_checksum(size, &size, (BYTE *)buffer) == S_OK) {
+		char hexlut[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+		for (int i = 0; i < sizeof(hexlut); i++) {
+			m_checkSum[i * 2] = hexlut[((buffer[i] >> 4) & 0xF)];
+			m_checkSum[(i * 2) + 1] = hexlut[(buffer[i]) & 0x0F];
+		}
+	} else {
+		strncpy_s(m_checkSum, "BAD HASH TYPE", sizeof(m_checkSum) - 1);
 	}
+}
 
-	pEnumSymbols->Release();
+CSourceFile::~CSourceFile()
+{
+/*
+	if (m_pIDiaSourceFile) {
+		m_pIDiaSourceFile->Release();
+		m_pIDiaSourceFile = NULL;
+	}
+*/
+}
 
-	putwchar(L'\n');
+const std::wstring & CSourceFile::GetSourceFileName()
+{
+	return m_fileName;
+}
 
-	return true;
+CV_SourceChksum_t CSourceFile::GetCheckSumType() const
+{
+	return m_checkSumType;
+}
+
+const char * CSourceFile::GetCheckSum() const
+{
+	return m_checkSum;
+}
+
+std::map<std::wstring, CSourceFile *> source_files_;
+
+void CacheSourceFile(const std::wstring & file, CSourceFile * src)
+{
+	source_files_[file] = src;
+}
+
+bool IsSourceFileCached(const std::wstring & file)
+{
+	return source_files_.find(file) != source_files_.end();
+}
+
+std::vector< CSourceFile *>	m_vectorSources;
+
+//dont need anything msvc or sdk
+bool IsSkipableSourceFile(std::wstring & name)
+{
+	if (name.find(L"f:\\rtm\\") != std::string::npos ||
+		name.find(L"f:\\sp\\public\\") != std::string::npos ||
+		name.find(L"F:\\RTM\\vctools\\") != std::string::npos ||
+		name.find(L"F:\\SP\\vctools\\") != std::string::npos ||
+		name.find(L"f:\\sp\\vctools\\") != std::string::npos ||
+		name.find(L"f:\\binaries.x86ret\\") != std::string::npos ||
+		name.find(L"e:\\wm.obj.x86fre\\") != std::string::npos ||
+		name.find(L"d:\\winmain\\") != std::string::npos ||
+		name.find(L"d:\\winmain.public.x86fre\\") != std::string::npos ||
+		name.find(L"microsoft visual studio") != std::string::npos ||
+		name.find(L"\\DXSDK\\") != std::string::npos ||
+		name.find(L"microsoft directx sdk") != std::string::npos) {
+		return true;
+	}
+	return false;
 }
 
 ////////////////////////////////////////////////////////////
-// Dump a specified compiland and all the symbols defined in it
+// Dump all the source file information stored in the PDB
+// We have to go through every compiland in order to retrieve
+//   all the information otherwise checksums for instance
+//   will not be available
+// Compilands can have multiple source files with the same
+//   name but different content which produces diffrent
+//   checksums
 //
-bool DumpCompiland(IDiaSymbol * pGlobal, const wchar_t * szCompName)
+bool DumpAllSourceFiles(IDiaSession * pSession, IDiaSymbol * pGlobal)
 {
+#if 0
+	wprintf(L"\n\n*** SOURCE FILES\n\n");
+
+	// To get the complete source file info we must go through the compiland first
+	// by passing NULL instead all the source file names only will be retrieved
+
 	IDiaEnumSymbols * pEnumSymbols;
 
-	// was nsCaseInsensitive
-	if (FAILED(pGlobal->findChildren(SymTagCompiland, szCompName, nsCaseInRegularExpression, &pEnumSymbols))) {
+	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL, nsNone, &pEnumSymbols))) {
 		return false;
 	}
 
@@ -2111,128 +2187,4161 @@ bool DumpCompiland(IDiaSymbol * pGlobal, const wchar_t * szCompName)
 	ULONG celt = 0;
 
 	while (SUCCEEDED(pEnumSymbols->Next(1, &pCompiland, &celt)) && (celt == 1)) {
-		wprintf(L"\n** Module: ");
-
-		// Retrieve the name of the module
-
 		BSTR bstrName;
 
-		if (pCompiland->get_name(&bstrName) != S_OK) {
-			wprintf(L"(???)\n\n");
-		}
-
-		else {
-			wprintf(L"%s\n\n", bstrName);
+		if (pCompiland->get_name(&bstrName) == S_OK) {
+			wprintf(L"\nCompiland = %s\n\n", bstrName);
 
 			SysFreeString(bstrName);
 		}
 
-		IDiaEnumSymbols * pEnumChildren;
+		// Every compiland could contain multiple references to the source files which were used to build it
+		// Retrieve all source files by compiland by passing NULL for the name of the source file
 
-		if (SUCCEEDED(pCompiland->findChildren(SymTagNull, NULL, nsNone, &pEnumChildren))) {
-			IDiaSymbol * pSymbol;
-			ULONG celt_ = 0;
+		IDiaEnumSourceFiles * pEnumSourceFiles;
 
-			while (SUCCEEDED(pEnumChildren->Next(1, &pSymbol, &celt_)) && (celt_ == 1)) {
-				PrintSymbol(pSymbol, 0);
+		if (SUCCEEDED(pSession->findFile(pCompiland, NULL, nsNone, &pEnumSourceFiles))) {
+			IDiaSourceFile * pSourceFile;
 
-				pSymbol->Release();
+			while (SUCCEEDED(pEnumSourceFiles->Next(1, &pSourceFile, &celt)) && (celt == 1)) {
+				PrintSourceFile(pSourceFile);
+				putwchar(L'\n');
+
+				pSourceFile->Release();
 			}
 
-			pEnumChildren->Release();
+			pEnumSourceFiles->Release();
 		}
 
+		putwchar(L'\n');
+
 		pCompiland->Release();
 	}
-#if 0
-	if (celt)
-	{
-		DebugBreak();
-	}
-#endif
-	pEnumSymbols->Release();
 
-	return true;
-}
+	pEnumSymbols->Release();
+#endif
 
-////////////////////////////////////////////////////////////
-// Dump the line numbering information for a specified RVA
-//
-bool DumpLines(IDiaSession * pSession, DWORD dwRVA)
-{
-	IDiaEnumLineNumbers * pLines;
+#if 0
+	ULONG celt = 0;
 
-	if (FAILED(pSession->findLinesByRVA(dwRVA, MAX_RVA_LINES_BYTES_RANGE, &pLines))) {
+	IDiaEnumSymbols * pEnumSymbols;
+	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL, nsNone, &pEnumSymbols))) {
 		return false;
 	}
+	IDiaEnumSourceFiles * pEnumSourceFiles;
+	if (SUCCEEDED(pSession->findFile(NULL, NULL, nsNone, &pEnumSourceFiles))) {
+		LONG lCount = 0;
+		pEnumSourceFiles->get_Count(&lCount);
+		IDiaSourceFile * pSourceFile = 0;
+		for (int i = 0; i < lCount - 1; i++) {
+			ULONG res;
+			if (SUCCEEDED(pEnumSourceFiles->Next(1, &pSourceFile, &res)) && res == 1) {
+				PrintSourceFile(pSourceFile);
+				putwchar(L'\n');
 
-	PrintLines(pLines, nullptr);
+				pSourceFile->Release();
+			}
 
-	pLines->Release();
+		}
+		if (pEnumSourceFiles) {
+			pEnumSourceFiles->Release();
+		}
 
-	return true;
-}
 
-////////////////////////////////////////////////////////////
-// Dump the all line numbering information for a specified
-//  function symbol name (as a regular expression string)
-//
-bool DumpLines(IDiaSession * pSession, IDiaSymbol * pGlobal, const wchar_t * szFuncName)
-{
-	IDiaEnumSymbols * pEnumSymbols;
+	}
 
-	if (FAILED(pGlobal->findChildren(SymTagFunction, szFuncName, nsRegularExpression, &pEnumSymbols))) {
+#endif
+
+#if 1
+	IDiaSymbol * global;
+	if (FAILED(pSession->get_globalScope(&global))) {
+		fprintf(stderr, "get_globalScope failed\n");
+		return false;
+	}
+
+
+	BSTR pdbname;
+	if (SUCCEEDED(global->get_name(&pdbname))) {
+		wprintf(L";PDB: %s\n", pdbname);
+		SysReleaseString(pdbname);
+	}
+
+	DWORD time;
+	if (SUCCEEDED(global->get_signature(&time))) {
+		__time32_t now = time;
+		std::tm ptm;
+		_localtime32_s(&ptm, &now);
+		wchar_t buffer[32];
+		// Format: Mo, 15.06.2009 20:20:00
+		//DebugBreak();
+		wcsftime(buffer, 32, L"%d.%m.%Y %H:%M:%S", &ptm);
+
+		wprintf(L";TimeStamp: %s (%x)\n", buffer, time);
+	}
+
+	GUID guid;
+	if (SUCCEEDED(global->get_guid(&guid))) {
+		const int maxGUIDStrLen = 64 + 1;
+		std::vector<wchar_t> guidStr(maxGUIDStrLen);
+		if (StringFromGUID2(guid, guidStr.data(), maxGUIDStrLen) > 0) {
+			wprintf(L";GUID: %ls\n", guidStr.data());
+		}
+	}
+
+
+	IDiaEnumSymbols * compilands;
+	if (FAILED(global->findChildren(SymTagCompiland, NULL,
+		nsNone, &compilands))) {
+		fprintf(stderr, "findChildren failed\n");
+		return false;
+	}
+
+	LONG c;
+	;
+
+	if (FAILED(compilands->get_Count(&c))) {
+		fprintf(stderr, "compilands->get_Count failed\n");
+		return false;
+	}
+	//ULONG count;
+
+	IDiaEnumSourceFiles * source_files;
+	IDiaSymbol * compiland = NULL;
+
+	wprintf(L";Compilands: %d\n", c);
+	for (int cidx = 0; cidx < c; cidx++) {
+	//while (SUCCEEDED(compilands->Next(i, &compiland, &count))) {
+	  //if (count > 1) {
+	  //    fprintf(stderr, "Next failed %d\n", count);
+	  //    return false;
+	  //}
+
+		if (FAILED(compilands->Item(cidx, &compiland))) {
+			fprintf(stderr, "compilands->Item(%d) failed\n", cidx);
+			return false;
+		}
+
+		if (FAILED(pSession->findFile(compiland, NULL, nsNone, &source_files))) {
+			fprintf(stderr, "pSession->findFile(%d) failed\n", cidx);
+			return false;
+		}
+
+		LONG sc;
+		if (FAILED(source_files->get_Count(&sc))) {
+			fprintf(stderr, "source_files->get_Count failed\n");
+			return false;
+		}
+		//fprintf(stderr, "source_files %d\n", sc);
+
+		BSTR cname;
+		if (FAILED(compiland->get_name(&cname))) {
+			fprintf(stderr, "compiland->get_name failed\n");
+			return false;
+		}
+		//wprintf(L";Compiland \"%s\" source_files %d\n", cname, sc);
+		if (sc == 0) {
+			wprintf(L";WARNING No Symbols in Compiland \"%s\"\n", cname);
+		}
+		SysFreeString(cname);
+
+		IDiaSourceFile * source_file;
+		for (int sidx = 0; sidx < sc; sidx++) {
+			if (FAILED(source_files->Item(sidx, &source_file))) {
+				fprintf(stderr, "source_files->Item(%d) failed\n", sidx);
+				return false;
+			}
+
+			BSTR file_name;
+			if (FAILED(source_file->get_fileName(&file_name))) {
+				fprintf(stderr, "source_file->get_fileName(%d) failed\n", sidx);
+				return false;
+			}
+
+			std::wstring file_name_string(file_name);
+			if (!IsSourceFileCached(file_name_string)) {
+				// this is a new file name, cache it and output a FILE line.
+				CSourceFile * pCSourceFile = new CSourceFile(source_file);
+				CacheSourceFile(file_name_string, pCSourceFile);
+			}
+			SysFreeString(file_name);
+			source_file->Release();
+		}
+		compiland->Release();
+	}
+
+	for (auto it = source_files_.begin(); it != source_files_.end(); it++) {
+		CSourceFile * src = it->second;
+		if (src != nullptr) {
+			std::wstring name = src->GetSourceFileName();
+			auto checksumType = src->GetCheckSumType();
+			auto checksum = src->GetCheckSum();
+			bool skip = false;
+#if 1
+	  // skip msvc
+			if (IsSkipableSourceFile(name)) {
+				skip = true;
+			}
+#endif
+			if (!name.empty()) {
+#if 0
+				if (checksumType == CHKSUM_TYPE_MD5) {
+					//wprintf(L"%hs *%ls\n", checksum, name.c_str());
+					wprintf(L"%s*%ls %hs\n", skip ? L";" : L"", name.c_str(), checksum);
+				} else {
+					wprintf(L"%s*%ls %hs\n", skip ? L";" : L"", name.c_str(), "ERRRRRRRRRRRRRRRRRRRRR");
+				}
+#endif				
+				
+				if (checksumType != CHKSUM_TYPE_MD5) {
+					checksum = "ERRRRRRRRRRRRRRRRRRRRR";
+					fprintf(stderr, "Unhandled checksum(%d)\n", checksumType);
+					skip = true;
+				}
+				//wprintf(L"%s*%ls %hs\n", skip ? L";" : L"", name.c_str(), checksum);
+				wprintf(L"%s %hs *%ls\n", skip ? L";" : L"", checksum, name.c_str());
+			}
+		}
+	}
+#endif
+#if 0
+	wprintf(L"\n\n*** FILES\n\n");
+
+	IDiaEnumSourceFiles * pEnumSourceFiles;
+
+	if (FAILED(GetTable(g_pDiaSession, __uuidof(IDiaEnumSourceFiles), (void **)&pEnumSourceFiles))) {
+		return false;
+	}
+
+	IDiaSourceFile * pSourceFile;
+	ULONG celt = 0;
+
+	IDiaEnumSymbols * compilands;
+	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL,
+		nsNone, &compilands))) {
+		fprintf(stderr, "findChildren failed\n");
+		return false;
+	}
+
+	while (SUCCEEDED(pEnumSourceFiles->Next(1, &pSourceFile, &celt)) && (celt == 1)) {
+
+		BSTR file_name;
+		if (FAILED(pSourceFile->get_fileName(&file_name))) {
+			return false;
+		}
+
+		std::wstring file_name_string(file_name);
+		if (!IsSourceFileCached(file_name_string)) {
+		  // this is a new file name, cache it and output a FILE line.
+			CSourceFile * pCSourceFile = new CSourceFile(pSourceFile);
+			CacheSourceFile(file_name_string, pCSourceFile);
+		}
+		SysFreeString(file_name);
+
+		pSourceFile->Release();
+	}
+
+	pEnumSourceFiles->Release();
+
+	for (auto it = source_files_.begin(); it != source_files_.end(); it++) {
+		CSourceFile * src = it->second;
+		if (src != nullptr) {
+			std::wstring name = src->GetSourceFileName();
+			auto checksumType = src->GetCheckSumType();
+			auto checksum = src->GetCheckSum();
+			// skip msvc
+			if (IsSkipableSourceFile(name)) {
+				continue;
+			}
+			if (!name.empty() && checksumType == CheckSumType_MD5) {
+				wprintf(L"%hs *%ls\n", checksum, name.c_str());
+			}
+		}
+	}
+#endif
+
+#if 0
+	IDiaSymbol * global;
+	if (FAILED(pSession->get_globalScope(&global))) {
+		fprintf(stderr, "get_globalScope failed\n");
 		return false;
 	}
 
-	IDiaSymbol * pFunction;
-	ULONG celt = 0;
+	IDiaEnumSourceFiles * pEnumSourceFiles;
+
+	if (FAILED(GetTable(g_pDiaSession, __uuidof(IDiaEnumSourceFiles), (void **)&pEnumSourceFiles))) {
+		return false;
+	}
+
+	IDiaSession * pIDiaSession = pSession;
+	if (pIDiaSession) {
+
+		if (1) {
+			LONG lCount = 0;
+			pEnumSourceFiles->get_Count(&lCount);
+			if (lCount == 0) {
+				DebugBreak();
+			}
+
+			for (DWORD dw = 0; dw < (DWORD)lCount; dw++) {
+				IDiaSourceFile * pIDiaSourceFile = NULL;
+				if (pEnumSourceFiles->Item(dw, &pIDiaSourceFile) == S_OK) {
+					BSTR file_name;
+					if (FAILED(pIDiaSourceFile->get_fileName(&file_name))) {
+						DebugBreak();
+						return false;
+					}
+
+					std::wstring file_name_string(file_name);
+					if (!IsSourceFileCached(file_name_string)) {
+						//DebugBreak();
+					  // this is a new file name, cache it and output a FILE line.
+						CSourceFile * pCSourceFile = new CSourceFile(pIDiaSourceFile);
+						CacheSourceFile(file_name_string, pCSourceFile);
+					}
+					SysFreeString(file_name);
+
+				} else {
+					DebugBreak();
+				}
+			}
+		}
+		if (pEnumSourceFiles) {
+			pEnumSourceFiles->Release();
+		}
+	}
+
+
+	for (auto it = source_files_.begin(); it != source_files_.end(); it++) {
+		CSourceFile * src = it->second;
+		if (src != nullptr) {
+			std::wstring name = src->GetSourceFileName();
+			auto checksumType = src->GetCheckSumType();
+			auto checksum = src->GetCheckSum();
+			// skip msvc
+			if (IsSkipableSourceFile(name)) {
+				continue;
+			}
+			if (!name.empty() && checksumType == CheckSumType_MD5) {
+				wprintf(L"%hs *%ls\n", checksum, name.c_str());
+			} else {
+				wprintf(L"%hs *%ls\n", "0", name.c_str());
+
+			}
+		}
+	}
+#endif
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump all the FPO info
+//
+//  FPO data stored in a table which will be retrieved via
+//    IDiaSession->getEnumTables through QueryInterface()
+//    using the REFIID of the IDiaEnumFrameData
+//
+bool DumpAllFPO(IDiaSession * pSession)
+{
+	IDiaEnumFrameData * pEnumFrameData;
+
+	wprintf(L"\n\n*** FPO\n\n");
+
+	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumFrameData), (void **)&pEnumFrameData))) {
+		return false;
+	}
+
+	IDiaFrameData * pFrameData;
+	ULONG celt = 0;
+
+	while (SUCCEEDED(pEnumFrameData->Next(1, &pFrameData, &celt)) && (celt == 1)) {
+		PrintFrameData(pFrameData);
+
+		pFrameData->Release();
+	}
+
+	pEnumFrameData->Release();
+
+	RequireImage();
+
+	for (size_t i = 0; i < g_unwindIndex.Count(); i++) {
+		PrintUnwindX64(g_unwindIndex.Function(i));
+	}
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump FPO info for a function at the specified RVA
+//
+bool DumpFPO(IDiaSession * pSession, DWORD dwRVA)
+{
+	IDiaEnumFrameData * pEnumFrameData;
+
+	// x64 functions rarely have frame data, their unwind info in the
+	//  image follows whatever frame data there is
+
+	bool fUnwindX64 = RequireImage() && g_image.Is64();
+
+	// Retrieve first the table holding all the FPO info
+
+	if ((dwRVA != 0) && SUCCEEDED(GetTable(pSession, __uuidof(IDiaEnumFrameData), (void **)&pEnumFrameData))) {
+		IDiaFrameData * pFrameData;
+
+		// Retrieve the frame data corresponding to the given RVA
+
+		if (SUCCEEDED(pEnumFrameData->frameByRVA(dwRVA, &pFrameData))) {
+			PrintGeneric(pFrameData);
+
+			pFrameData->Release();
+		}
+
+		else if (!fUnwindX64) {
+		  // Some function might not have FPO data available (see ASM funcs like strcpy)
+
+			wprintf(L"ERROR - DumpFPO() frameByRVA invalid RVA: 0x%08X\n", dwRVA);
+
+			pEnumFrameData->Release();
+
+			return false;
+		}
+
+		pEnumFrameData->Release();
+	}
+
+	else if (!fUnwindX64) {
+		wprintf(L"ERROR - DumpFPO() GetTable\n");
+
+		return false;
+	}
+
+	putwchar(L'\n');
+
+	return fUnwindX64 ? DumpUnwindX64(dwRVA) : true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump FPO info for a specified function symbol using its
+//  name (a regular expression string is used for the search)
+//
+bool DumpFPO(IDiaSession * pSession, IDiaSymbol * pGlobal, const wchar_t * szSymbolName)
+{
+	IDiaEnumSymbols * pEnumSymbols;
+	IDiaSymbol * pSymbol;
+	ULONG celt = 0;
+	DWORD dwRVA;
+
+	// Find first all the function symbols that their names matches the search criteria
+
+	if (FAILED(pGlobal->findChildren(SymTagFunction, szSymbolName, nsRegularExpression, &pEnumSymbols))) {
+		wprintf(L"ERROR - DumpFPO() findChildren could not find symol %s\n", szSymbolName);
+
+		return false;
+	}
+
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+		if (pSymbol->get_relativeVirtualAddress(&dwRVA) == S_OK) {
+			PrintPublicSymbol(pSymbol);
+
+			DumpFPO(pSession, dwRVA);
+		}
+
+		pSymbol->Release();
+	}
+
+	pEnumSymbols->Release();
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Load the PE image matching the PDB and index its x64
+//  function table
+//
+bool LoadPeImage(const wchar_t * szFilename, bool fReportErrors)
+{
+	g_szImage = NULL;
+	g_unwindIndex = X64UnwindIndex();
+
+	if (!g_image.Load(szFilename)) {
+		if (fReportErrors) {
+			wprintf(L"ERROR - LoadPeImage() could not read image %s\n", szFilename);
+		}
+
+		return false;
+	}
+
+	if (g_image.Machine() == PE_MACHINE_AMD64 && !g_unwindIndex.Load(g_image) && fReportErrors) {
+		wprintf(L"ERROR - LoadPeImage() no exception directory in %s\n", szFilename);
+
+		return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Load the image given in place of the PDB the first time a
+//  mode reads it, -image loads one right away
+//
+bool RequireImage()
+{
+	if (g_szImage != NULL) {
+		LoadPeImage(g_szImage, false);
+	}
+
+	return g_image.IsLoaded();
+}
+
+////////////////////////////////////////////////////////////
+// Print a RUNTIME_FUNCTION with its decoded unwind info and
+//  the unwind info chained to it
+//
+static bool PrintUnwindX64(const X64RuntimeFunction & function)
+{
+	X64UnwindInfo info;
+	std::string text;
+	uint32_t rvaUnwind = function.rvaUnwind;
+
+	wprintf(L"Function      : [0x%08X][0x%08X] unwind 0x%08X\n", function.rvaBegin, function.rvaEnd, function.rvaUnwind);
+
+	for (int cChain = 0; cChain < X64_CHAIN_MAX; cChain++) {
+		if (!DecodeX64UnwindInfo(g_image, rvaUnwind, info)) {
+			wprintf(L"ERROR - PrintUnwindX64() bad unwind info at 0x%08X\n", rvaUnwind);
+
+			return false;
+		}
+
+		text.clear();
+		FormatX64UnwindInfo(info, text);
+		wprintf(L"%S", text.c_str());
+
+		if (!(info.flags & X64_UNW_FLAG_CHAININFO)) {
+			break;
+		}
+
+		rvaUnwind = info.chained.rvaUnwind;
+	}
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the x64 unwind info of the function at the specified RVA
+//
+bool DumpUnwindX64(DWORD dwRVA)
+{
+	RequireImage();
+
+	if (g_unwindIndex.Count() == 0) {
+		wprintf(L"ERROR - DumpUnwindX64() no x64 image loaded, use -image <file>\n");
+
+		return false;
+	}
+
+	const X64RuntimeFunction * pFunction = g_unwindIndex.Find(dwRVA);
+
+	if (pFunction == NULL) {
+	  // Leaf functions have no unwind info, the return address is at rsp
+
+		wprintf(L"ERROR - DumpUnwindX64() no function entry for RVA: 0x%08X (leaf function?)\n", dwRVA);
+
+		return false;
+	}
+
+	return PrintUnwindX64(*pFunction);
+}
+
+////////////////////////////////////////////////////////////
+// Read all the frame data records into a FrameIndex
+//
+bool LoadFrameIndex(IDiaSession * pSession, FrameIndex & index)
+{
+	IDiaEnumFrameData * pEnumFrameData;
+
+	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumFrameData), (void **)&pEnumFrameData))) {
+		wprintf(L"ERROR - LoadFrameIndex() GetTable\n");
+
+		return false;
+	}
+
+	IDiaFrameData * pFrameData;
+	ULONG celt = 0;
+	std::string program;
+
+	while (SUCCEEDED(pEnumFrameData->Next(1, &pFrameData, &celt)) && (celt == 1)) {
+		FrameRecord rec = {};
+		DWORD dwValue;
+		BOOL fUsesBasePointer = FALSE;
+		BSTR bstrProgram;
+
+		if (pFrameData->get_relativeVirtualAddress(&rec.rva) == S_OK) {
+			pFrameData->get_lengthBlock(&rec.cbBlock);
+			pFrameData->get_lengthLocals(&rec.cbLocals);
+			pFrameData->get_lengthParams(&rec.cbParams);
+			pFrameData->get_lengthSavedRegisters(&rec.cbSavedRegs);
+			pFrameData->get_lengthProlog(&rec.cbProlog);
+			pFrameData->get_allocatesBasePointer(&fUsesBasePointer);
+
+			if (pFrameData->get_maxStack(&dwValue) == S_OK) {
+				rec.cbMaxStack = dwValue;
+			}
+
+			// Programs are plain ASCII
+
+			program.clear();
+
+			if (pFrameData->get_program(&bstrProgram) == S_OK) {
+				for (UINT i = 0, cch = SysStringLen(bstrProgram); i < cch; i++) {
+					program += (char)bstrProgram[i];
+				}
+
+				SysFreeString(bstrProgram);
+			}
+
+			index.Add(rec, program.c_str(), fUsesBasePointer != FALSE);
+		}
+
+		pFrameData->Release();
+	}
+
+	pEnumFrameData->Release();
+
+	index.Finish();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the compiled frame program covering an RVA, or with
+//  no RVA the index statistics and the evaluation speed of
+//  all the records against a zeroed stack
+//
+bool DumpFrameProgram(IDiaSession * pSession, DWORD dwRVA)
+{
+	FrameIndex index;
+	LARGE_INTEGER freq, t0, t1;
+
+	QueryPerformanceFrequency(&freq);
+
+	QueryPerformanceCounter(&t0);
+	if (!LoadFrameIndex(pSession, index)) {
+		return false;
+	}
+	QueryPerformanceCounter(&t1);
+
+	double msLoad = (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart;
+
+	if (dwRVA != 0) {
+		const FrameRecord * pRec = index.Find(dwRVA);
+
+		if (pRec == NULL) {
+			wprintf(L"ERROR - DumpFrameProgram() no frame data for RVA: 0x%08X\n", dwRVA);
+
+			return false;
+		}
+
+		wprintf(L"\n\n*** FRAME PROGRAM 0x%08X\n\n", dwRVA);
+		wprintf(L"Block         : [0x%08X][0x%08X]\n", pRec->rva, pRec->rva + pRec->cbBlock);
+		wprintf(L"Locals        : 0x%X\n", pRec->cbLocals);
+		wprintf(L"Params        : 0x%X\n", pRec->cbParams);
+		wprintf(L"Saved regs    : 0x%X\n", pRec->cbSavedRegs);
+		wprintf(L"Max stack     : 0x%X\n", pRec->cbMaxStack);
+		wprintf(L"Prolog        : 0x%X\n", pRec->cbProlog);
+
+		const uint8_t * pCode = index.Code(*pRec);
+
+		if (pCode == NULL) {
+			wprintf(L"\nProgram failed to compile\n");
+
+			return false;
+		}
+
+		std::string text;
+
+		DisasmFrameProgram(pCode, text);
+		wprintf(L"\n%S\n", text.c_str());
+
+		return true;
+	}
+
+	wprintf(L"\n\n*** FRAME PROGRAMS\n\n");
+	wprintf(L"Records        : %u\n", (DWORD)index.Count());
+	wprintf(L"Programs       : %u\n", (DWORD)index.CountPrograms());
+	wprintf(L"Failed         : %u\n", (DWORD)index.CountFailed());
+	wprintf(L"Bytecode       : %u bytes\n", (DWORD)index.CodeSize());
+	wprintf(L"Load + compile : %.2f ms\n", msLoad);
+
+	if (index.Count() == 0) {
+		putwchar(L'\n');
+
+		return true;
+	}
+
+	// Every record unwinds from the bottom of a zeroed 1MB stack
+
+	const uint32_t dwStackBase = 0x00100000;
+	std::vector<uint8_t> stack(0x100000);
+	MemorySnapshot mem;
+	X86Context callee = {};
+	X86Context caller;
+
+	mem.AddRange(dwStackBase, stack.data(), stack.size());
+
+	for (DWORD i = 0; i < FRAME_REG_COUNT; i++) {
+		callee.rgReg[i] = dwStackBase;
+	}
+
+	callee.rgReg[FrameVarEbp] = dwStackBase + 0x1000;
+	callee.fValid = (1u << FRAME_REG_COUNT) - 1;
+
+	const DWORD dwIterations = 100;
+	DWORD cEval = 0;
+	DWORD cFailed = 0;
+
+	QueryPerformanceCounter(&t0);
+	for (DWORD iter = 0; iter < dwIterations; iter++) {
+		for (size_t i = 0; i < index.Count(); i++) {
+			const FrameRecord & rec = index.Record(i);
+			const uint8_t * pCode = index.Code(rec);
+
+			if (pCode == NULL) {
+				continue;
+			}
+
+			cEval++;
+
+			if (!EvalFrameProgram(pCode, rec, 0, mem, callee, caller)) {
+				cFailed++;
+			}
+		}
+	}
+	QueryPerformanceCounter(&t1);
+
+	double nsEval = (double)(t1.QuadPart - t0.QuadPart) * 1e9 / (double)freq.QuadPart;
+
+	wprintf(L"Evaluations    : %u, %u failed\n", cEval, cFailed);
+	wprintf(L"Evaluation     : %.1f ns/frame\n", (cEval != 0) ? nsEval / cEval : 0.0);
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Open the PDB behind the DIA session for the native readers,
+//  for the records DIA does not expose
+//
+static bool LoadNativePdb(IDiaSymbol * pGlobal)
+{
+	if (g_pdb.IsLoaded()) {
+		return true;
+	}
+
+	BSTR bstrPdb;
+
+	if (pGlobal->get_symbolsFileName(&bstrPdb) != S_OK) {
+		wprintf(L"ERROR - LoadNativePdb() get_symbolsFileName() failed\n");
+
+		return false;
+	}
+
+	bool fLoaded = g_pdb.Load(bstrPdb);
+
+	if (!fLoaded) {
+		wprintf(L"ERROR - LoadNativePdb() could not read %s\n", bstrPdb);
+	}
+
+	SysFreeString(bstrPdb);
+
+	return fLoaded;
+}
+
+////////////////////////////////////////////////////////////
+// Index the TPI stream, and the IPI stream when there is one
+//
+static bool LoadTypeStreams(IDiaSymbol * pGlobal)
+{
+	if (g_tpi.CountTypes() != 0) {
+		return true;
+	}
+
+	if (!LoadNativePdb(pGlobal)) {
+		return false;
+	}
+
+	if (!g_tpi.Load(g_pdb, PDB_STREAM_TPI)) {
+		wprintf(L"ERROR - LoadTypeStreams() could not read the TPI stream\n");
+
+		return false;
+	}
+
+	g_ipi.Load(g_pdb, PDB_STREAM_IPI);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Flatten the layouts of all the UDT definitions
+//
+static bool LoadLayoutCache(IDiaSymbol * pGlobal)
+{
+	if (!g_layouts.Layouts().empty()) {
+		return true;
+	}
+
+	if (!LoadTypeStreams(pGlobal)) {
+		return false;
+	}
+
+	unsigned cThreads = std::thread::hardware_concurrency();
+
+	return g_layouts.Build(g_tpi, (cThreads != 0) ? cThreads : 1);
+}
+
+////////////////////////////////////////////////////////////
+// Index the inheritance of all the classes
+//
+static bool LoadClassHierarchy(IDiaSymbol * pGlobal)
+{
+	if (g_hierarchy.CountClasses() != 0) {
+		return true;
+	}
+
+	if (!LoadTypeStreams(pGlobal)) {
+		return false;
+	}
+
+	unsigned cThreads = std::thread::hardware_concurrency();
+
+	return g_hierarchy.Build(g_tpi, (cThreads != 0) ? cThreads : 1);
+}
+
+////////////////////////////////////////////////////////////
+// Dump the chain of inlined calls at an RVA, innermost first
+//
+//  DIA does not expose the raw binary annotations, so the
+//  inline sites are decoded from the PDB streams directly.
+//
+bool DumpInlineFrames(IDiaSymbol * pGlobal, DWORD dwRVA)
+{
+	if (!g_inlineIndex.CountFunctions()) {
+		if (!LoadNativePdb(pGlobal)) {
+			return false;
+		}
+
+		if (!g_inlineIndex.Load(g_pdb)) {
+			wprintf(L"ERROR - DumpInlineFrames() could not read the inline sites\n");
+
+			return false;
+		}
+	}
+
+	std::vector<InlineFrame> frames;
+
+	g_inlineIndex.Lookup(dwRVA, frames);
+
+	if (frames.empty()) {
+		wprintf(L"ERROR - DumpInlineFrames() no function at RVA: 0x%08X\n", dwRVA);
+
+		return false;
+	}
+
+	wprintf(L"\n\n*** INLINE FRAMES 0x%08X\n\n", dwRVA);
+
+	for (const InlineFrame & frame : frames) {
+		wprintf(L"%s %S", frame.fInlined ? L"inline  " : L"function", frame.szName);
+
+		if (frame.line != 0) {
+			wprintf(L" [%S @ %u]", frame.szFile, frame.line);
+		}
+
+		putwchar(L'\n');
+	}
+
+	wprintf(L"\nFunctions : %u, inline sites : %u, ranges : %u\n\n",
+		(DWORD)g_inlineIndex.CountFunctions(), (DWORD)g_inlineIndex.CountSites(), (DWORD)g_inlineIndex.CountRanges());
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump a specified compiland and all the symbols defined in it
+//
+bool DumpCompiland(IDiaSymbol * pGlobal, const wchar_t * szCompName)
+{
+	IDiaEnumSymbols * pEnumSymbols;
+
+	// was nsCaseInsensitive
+	if (FAILED(pGlobal->findChildren(SymTagCompiland, szCompName, nsCaseInRegularExpression, &pEnumSymbols))) {
+		return false;
+	}
+
+	IDiaSymbol * pCompiland;
+	ULONG celt = 0;
+
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pCompiland, &celt)) && (celt == 1)) {
+		wprintf(L"\n** Module: ");
+
+		// Retrieve the name of the module
+
+		BSTR bstrName;
+
+		if (pCompiland->get_name(&bstrName) != S_OK) {
+			wprintf(L"(???)\n\n");
+		}
+
+		else {
+			wprintf(L"%s\n\n", bstrName);
+
+			SysFreeString(bstrName);
+		}
+
+		IDiaEnumSymbols * pEnumChildren;
+
+		if (SUCCEEDED(pCompiland->findChildren(SymTagNull, NULL, nsNone, &pEnumChildren))) {
+			IDiaSymbol * pSymbol;
+			ULONG celt_ = 0;
+
+			while (SUCCEEDED(pEnumChildren->Next(1, &pSymbol, &celt_)) && (celt_ == 1)) {
+				PrintSymbol(pSymbol, 0);
+
+				pSymbol->Release();
+			}
+
+			pEnumChildren->Release();
+		}
+
+		pCompiland->Release();
+	}
+#if 0
+	if (celt)
+	{
+		DebugBreak();
+	}
+#endif
+	pEnumSymbols->Release();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the line numbering information for a specified RVA
+//
+bool DumpLines(IDiaSession * pSession, DWORD dwRVA)
+{
+	IDiaEnumLineNumbers * pLines;
+
+	if (FAILED(pSession->findLinesByRVA(dwRVA, MAX_RVA_LINES_BYTES_RANGE, &pLines))) {
+		return false;
+	}
+
+	PrintLines(pLines, nullptr);
+
+	pLines->Release();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the all line numbering information for a specified
+//  function symbol name (as a regular expression string)
+//
+bool DumpLines(IDiaSession * pSession, IDiaSymbol * pGlobal, const wchar_t * szFuncName)
+{
+	IDiaEnumSymbols * pEnumSymbols;
+
+	if (FAILED(pGlobal->findChildren(SymTagFunction, szFuncName, nsRegularExpression, &pEnumSymbols))) {
+		return false;
+	}
+
+	IDiaSymbol * pFunction;
+	ULONG celt = 0;
+
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pFunction, &celt)) && (celt == 1)) {
+		PrintLines(pSession, pFunction);
+
+		pFunction->Release();
+	}
+
+	pEnumSymbols->Release();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the symbol information corresponding to a specified RVA
+//
+bool DumpSymbolWithRVA(IDiaSession * pSession, DWORD dwRVA, const wchar_t * szChildname)
+{
+	IDiaSymbol * pSymbol;
+	LONG lDisplacement;
+
+	if (FAILED(pSession->findSymbolByRVAEx(dwRVA, SymTagNull, &pSymbol, &lDisplacement))) {
+		return false;
+	}
+
+	wprintf(L"Displacement = 0x%X\n", lDisplacement);
+
+	PrintGeneric(pSymbol);
+
+	DumpSymbolWithChildren(pSymbol, szChildname);
+
+	while (pSymbol != NULL) {
+		IDiaSymbol * pParent;
+
+		if ((pSymbol->get_lexicalParent(&pParent) == S_OK) && pParent) {
+			wprintf(L"\nParent\n");
+
+			PrintSymbol(pParent, 0);
+
+			pSymbol->Release();
+
+			pSymbol = pParent;
+		}
+
+		else {
+			pSymbol->Release();
+			break;
+		}
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the symbols information where their names matches a
+//  specified regular expression string
+//
+bool DumpSymbolsWithRegEx(IDiaSymbol * pGlobal, const wchar_t * szRegEx, const wchar_t * szChildname)
+{
+	IDiaEnumSymbols * pEnumSymbols;
+
+	if (FAILED(pGlobal->findChildren(SymTagNull, szRegEx, nsRegularExpression, &pEnumSymbols))) {
+		return false;
+	}
+
+	bool bReturn = true;
+
+	IDiaSymbol * pSymbol;
+	ULONG celt = 0;
+
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+		PrintGeneric(pSymbol);
+
+		bReturn = DumpSymbolWithChildren(pSymbol, szChildname);
+
+		pSymbol->Release();
+	}
+
+	pEnumSymbols->Release();
+
+	return bReturn;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the information corresponding to a symbol name which
+//  is a children of the specified parent symbol
+//
+bool DumpSymbolWithChildren(IDiaSymbol * pSymbol, const wchar_t * szChildname)
+{
+	if (szChildname != NULL) {
+		IDiaEnumSymbols * pEnumSyms;
+
+		if (FAILED(pSymbol->findChildren(SymTagNull, szChildname, nsRegularExpression, &pEnumSyms))) {
+			return false;
+		}
+
+		IDiaSymbol * pChild;
+		DWORD celt = 1;
+
+		while (SUCCEEDED(pEnumSyms->Next(celt, &pChild, &celt)) && (celt == 1)) {
+			PrintGeneric(pChild);
+			PrintSymbol(pChild, 0);
+
+			pChild->Release();
+		}
+
+		pEnumSyms->Release();
+	}
+
+	else {
+	  // If the specified name is NULL then only the parent symbol data is displayed
+
+		DWORD dwSymTag;
+
+		if ((pSymbol->get_symTag(&dwSymTag) == S_OK) && (dwSymTag == SymTagPublicSymbol)) {
+			PrintPublicSymbol(pSymbol);
+		}
+
+		else {
+			PrintSymbol(pSymbol, 0);
+		}
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump all the type symbols information that matches their
+//  names to a specified regular expression string
+//
+bool DumpType(IDiaSymbol * pGlobal, const wchar_t * szRegEx)
+{
+	IDiaEnumSymbols * pEnumSymbols;
+
+	if (FAILED(pGlobal->findChildren(SymTagUDT, szRegEx, nsRegularExpression, &pEnumSymbols))) {
+		return false;
+	}
+
+	IDiaSymbol * pSymbol;
+	ULONG celt = 0;
+
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+		PrintTypeInDetail(pSymbol, 0);
+
+		pSymbol->Release();
+	}
+
+	pEnumSymbols->Release();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump line numbering information for a given file name and
+//  an optional line number
+//
+bool DumpLinesForSourceFile(IDiaSession * pSession, const wchar_t * szFileName, DWORD dwLine)
+{
+	IDiaEnumSourceFiles * pEnumSrcFiles;
+
+	if (FAILED(pSession->findFile(NULL, szFileName, nsFNameExt, &pEnumSrcFiles))) {
+		return false;
+	}
+
+	IDiaSourceFile * pSrcFile;
+	ULONG celt = 0;
+
+	while (SUCCEEDED(pEnumSrcFiles->Next(1, &pSrcFile, &celt)) && (celt == 1)) {
+		IDiaEnumSymbols * pEnumCompilands;
+
+		if (pSrcFile->get_compilands(&pEnumCompilands) == S_OK) {
+			IDiaSymbol * pCompiland;
+
+			celt = 0;
+			while (SUCCEEDED(pEnumCompilands->Next(1, &pCompiland, &celt)) && (celt == 1)) {
+				BSTR bstrName;
+
+				if (pCompiland->get_name(&bstrName) == S_OK) {
+					wprintf(L"//Compiland = %s\n", bstrName);
+
+					SysFreeString(bstrName);
+				}
+
+				else {
+					wprintf(L"//Compiland = (???)\n");
+				}
+
+				IDiaEnumLineNumbers * pLines;
+
+				if (dwLine != 0) {
+					if (SUCCEEDED(pSession->findLinesByLinenum(pCompiland, pSrcFile, dwLine, 0, &pLines))) {
+						PrintLines(pLines, szFileName);
+
+						pLines->Release();
+					}
+				}
+
+				else {
+					if (SUCCEEDED(pSession->findLines(pCompiland, pSrcFile, &pLines))) {
+						PrintLines(pLines, szFileName);
+
+						pLines->Release();
+					}
+				}
+
+				pCompiland->Release();
+			}
+
+			pEnumCompilands->Release();
+		}
+
+		pSrcFile->Release();
+	}
+
+	pEnumSrcFiles->Release();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump public symbol information for a given number of
+//  symbols around a given RVA address
+//
+bool DumpPublicSymbolsSorted(IDiaSession * pSession, DWORD dwRVA, DWORD dwRange, bool bReverse)
+{
+	IDiaEnumSymbolsByAddr * pEnumSymsByAddr;
+
+	if (FAILED(pSession->getSymbolsByAddr(&pEnumSymsByAddr))) {
+		return false;
+	}
+
+	IDiaSymbol * pSymbol;
+
+	if (SUCCEEDED(pEnumSymsByAddr->symbolByRVA(dwRVA, &pSymbol))) {
+		if (dwRange == 0) {
+			PrintPublicSymbol(pSymbol);
+		}
+
+		ULONG celt;
+		ULONG i;
+
+		if (bReverse) {
+			pSymbol->Release();
+
+			i = 0;
+
+			for (pSymbol = NULL; (i < dwRange) && SUCCEEDED(pEnumSymsByAddr->Next(1, &pSymbol, &celt)) && (celt == 1); i++) {
+				PrintPublicSymbol(pSymbol);
+
+				pSymbol->Release();
+			}
+		}
+
+		else {
+			PrintPublicSymbol(pSymbol);
+
+			pSymbol->Release();
+
+			i = 1;
+
+			for (pSymbol = NULL; (i < dwRange) && SUCCEEDED(pEnumSymsByAddr->Prev(1, &pSymbol, &celt)) && (celt == 1); i++) {
+				PrintPublicSymbol(pSymbol);
+			}
+		}
+	}
+
+	pEnumSymsByAddr->Release();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Convert a DIA string for the portable modules, reusing the
+//  buffer of str
+//
+static void ToUtf8(const wchar_t * wsz, std::string & str)
+{
+	int cch = WideCharToMultiByte(CP_UTF8, 0, wsz, -1, NULL, 0, NULL, NULL);
+
+	str.resize(cch > 0 ? cch : 1);
+	WideCharToMultiByte(CP_UTF8, 0, wsz, -1, &str[0], cch, NULL, NULL);
+	str.resize(strlen(str.c_str()));
+}
+
+////////////////////////////////////////////////////////////
+// Write the functions and code publics as a perf map or
+//  jitdump, relocated to g_dwloadAddress
+//
+//  The symbols come from an address ordered walk, so every
+//  entry can be written as soon as the next symbol is seen;
+//  that symbol bounds the size when the entry has no length.
+//  A function and a public at the same address are written
+//  once, under the function's name.
+//
+bool DumpPerfMap(IDiaSession * pSession, DWORD dwPid, const wchar_t * szFilename, bool fJitDump)
+{
+	wchar_t wszDefault[MAX_PATH];
+
+	if (szFilename == NULL) {
+		if (fJitDump) {
+			swprintf_s(wszDefault, L"jit-%u.dump", dwPid);
+		}
+
+		else {
+			swprintf_s(wszDefault, L"/tmp/perf-%u.map", dwPid);
+		}
+
+		szFilename = wszDefault;
+	}
+
+	LARGE_INTEGER freq, t0, t1;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	// jitdump timestamps must be on the clock perf records with;
+	//  under Wine the performance counter is CLOCK_MONOTONIC based
+
+	uint64_t timestamp = (uint64_t)((double)t0.QuadPart * 1e9 / (double)freq.QuadPart);
+	uint16_t wElfMachine = (g_dwMachineType == CV_CFL_AMD64) ? PERF_ELF_MACHINE_X86_64 : PERF_ELF_MACHINE_386;
+	PerfMapWriter writer;
+
+	if (!writer.Open(szFilename, fJitDump ? PERF_MAP_JITDUMP : PERF_MAP_TEXT, dwPid, wElfMachine, timestamp)) {
+		wprintf(L"ERROR - DumpPerfMap() could not create %s\n", szFilename);
+
+		return false;
+	}
+
+	IDiaEnumSymbolsByAddr * pEnumSymsByAddr;
+	IDiaSymbol * pSymbol;
+
+	if (FAILED(pSession->getSymbolsByAddr(&pEnumSymsByAddr))) {
+		wprintf(L"ERROR - DumpPerfMap() getSymbolsByAddr() failed\n");
+
+		return false;
+	}
+
+	if (pEnumSymsByAddr->symbolByAddr(1, 0, &pSymbol) != S_OK) {
+		wprintf(L"ERROR - DumpPerfMap() no symbols\n");
+
+		pEnumSymsByAddr->Release();
+
+		return false;
+	}
+
+	bool fPending = false;
+	bool fPendingFunction = false;
+	DWORD dwPendingRVA = 0;
+	ULONGLONG ulPendingLen = 0;
+	std::string pendingName;
+	bool fOk = true;
+
+	auto flush = [&](DWORD dwNextRVA) {
+		ULONGLONG cb = ulPendingLen ? ulPendingLen : (dwNextRVA > dwPendingRVA ? dwNextRVA - dwPendingRVA : 1);
+		const void * pCode = (fJitDump && RequireImage()) ? g_image.Ptr(dwPendingRVA, (uint32_t)cb) : NULL;
+
+		fOk = writer.Add(g_dwloadAddress + dwPendingRVA, cb, pendingName.c_str(), pCode) && fOk;
+		fPending = false;
+	};
+
+	ULONG celt = 1;
+
+	do {
+		DWORD dwTag;
+		DWORD dwRVA;
+
+		if (pSymbol->get_symTag(&dwTag) == S_OK && pSymbol->get_relativeVirtualAddress(&dwRVA) == S_OK) {
+			BOOL fCode = dwTag == SymTagFunction;
+
+			if (dwTag == SymTagPublicSymbol && pSymbol->get_code(&fCode) != S_OK) {
+				fCode = FALSE;
+			}
+
+			if (fPending && dwRVA > dwPendingRVA) {
+				flush(dwRVA);
+			}
+
+			if (fCode && (!fPending || (!fPendingFunction && dwTag == SymTagFunction))) {
+				BSTR bstrName = NULL;
+				HRESULT hr = (dwTag == SymTagPublicSymbol) ? pSymbol->get_undecoratedName(&bstrName) : S_FALSE;
+
+				if (hr != S_OK) {
+					hr = pSymbol->get_name(&bstrName);
+				}
+
+				if (hr == S_OK) {
+					ToUtf8(bstrName, pendingName);
+
+					SysFreeString(bstrName);
+
+					if (pSymbol->get_length(&ulPendingLen) != S_OK) {
+						ulPendingLen = 0;
+					}
+
+					fPending = true;
+					fPendingFunction = dwTag == SymTagFunction;
+					dwPendingRVA = dwRVA;
+				}
+			}
+		}
+
+		pSymbol->Release();
+	} while (SUCCEEDED(pEnumSymsByAddr->Next(1, &pSymbol, &celt)) && (celt == 1));
+
+	if (fPending) {
+		flush(dwPendingRVA);
+	}
+
+	pEnumSymsByAddr->Release();
+
+	fOk = writer.Close() && fOk;
+
+	QueryPerformanceCounter(&t1);
+
+	if (!fOk) {
+		wprintf(L"ERROR - DumpPerfMap() could not write %s\n", szFilename);
+
+		return false;
+	}
+
+	wprintf(L"Wrote %llu symbols at base 0x%llX to %s in %.2f ms\n",
+		writer.Count(), g_dwloadAddress, szFilename, (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Collect the functions and line records of every compiland
+//
+bool LoadProfileSymbols(IDiaSession * pSession, IDiaSymbol * pGlobal, ProfileSymbols & symbols)
+{
+	IDiaEnumSymbols * pEnumCompilands;
+
+	if (FAILED(pGlobal->findChildren(SymTagCompiland, NULL, nsNone, &pEnumCompilands))) {
+		wprintf(L"ERROR - LoadProfileSymbols() findChildren() failed\n");
+
+		return false;
+	}
+
+	std::unordered_map<DWORD, uint32_t> files;
+	std::string name;
+	IDiaSymbol * pCompiland;
+	ULONG celt = 0;
+
+	while (SUCCEEDED(pEnumCompilands->Next(1, &pCompiland, &celt)) && (celt == 1)) {
+		uint32_t iCompiland = PROFILE_NO_INDEX;
+		BSTR bstrName;
+
+		if (pCompiland->get_name(&bstrName) == S_OK) {
+			ToUtf8(PathFindFileNameW(bstrName), name);
+			iCompiland = symbols.AddCompiland(name);
+
+			SysFreeString(bstrName);
+		}
+
+		IDiaEnumSymbols * pEnumFunctions;
+
+		if (SUCCEEDED(pCompiland->findChildren(SymTagFunction, NULL, nsNone, &pEnumFunctions))) {
+			IDiaSymbol * pFunction;
+
+			while (SUCCEEDED(pEnumFunctions->Next(1, &pFunction, &celt)) && (celt == 1)) {
+				DWORD dwRVA;
+				ULONGLONG ulLength;
+
+				if (pFunction->get_relativeVirtualAddress(&dwRVA) == S_OK &&
+					pFunction->get_length(&ulLength) == S_OK &&
+					pFunction->get_name(&bstrName) == S_OK) {
+					ToUtf8(bstrName, name);
+					symbols.AddFunction(dwRVA, (uint32_t)ulLength, symbols.AddName(name), iCompiland);
+
+					SysFreeString(bstrName);
+				}
+
+				pFunction->Release();
+			}
+
+			pEnumFunctions->Release();
+		}
+
+		IDiaEnumLineNumbers * pLines;
+
+		if (SUCCEEDED(pSession->findLines(pCompiland, NULL, &pLines))) {
+			IDiaLineNumber * pLine;
+
+			while (SUCCEEDED(pLines->Next(1, &pLine, &celt)) && (celt == 1)) {
+				DWORD dwRVA, dwLength, dwLinenum, dwSrcId;
+
+				if (pLine->get_relativeVirtualAddress(&dwRVA) == S_OK &&
+					pLine->get_length(&dwLength) == S_OK &&
+					pLine->get_lineNumber(&dwLinenum) == S_OK &&
+					pLine->get_sourceFileId(&dwSrcId) == S_OK) {
+					auto it = files.find(dwSrcId);
+
+					if (it == files.end()) {
+						IDiaSourceFile * pSource;
+
+						name.clear();
+
+						if (pLine->get_sourceFile(&pSource) == S_OK) {
+							if (pSource->get_fileName(&bstrName) == S_OK) {
+								ToUtf8(bstrName, name);
+
+								SysFreeString(bstrName);
+							}
+
+							pSource->Release();
+						}
+
+						it = files.insert(std::make_pair(dwSrcId, symbols.AddFile(name))).first;
+					}
+
+					symbols.AddLine(dwRVA, dwLength, dwLinenum, it->second);
+				}
+
+				pLine->Release();
+			}
+
+			pLines->Release();
+		}
+
+		pCompiland->Release();
+	}
+
+	pEnumCompilands->Release();
+
+	symbols.Finish();
+
+	return true;
+}
+
+#define PROFILE_REPORT_ROWS 50
+
+////////////////////////////////////////////////////////////
+// Aggregate a sample file into self counts per function, line
+//  and compiland, and optionally write the collapsed stacks
+//
+//  perf script addresses are relocated with -base.
+//
+bool DumpProfile(IDiaSession * pSession, IDiaSymbol * pGlobal, const wchar_t * szSamples, const wchar_t * szCollapsed)
+{
+	LARGE_INTEGER freq, t0, t1, t2, t3;
+	ProfileSymbols symbols;
+	ProfileSamples samples;
+	ProfileReport report;
+
+	QueryPerformanceFrequency(&freq);
+
+	QueryPerformanceCounter(&t0);
+	if (!LoadProfileSymbols(pSession, pGlobal, symbols)) {
+		return false;
+	}
+	QueryPerformanceCounter(&t1);
+
+	// Without the image, the module ends after its last function
+
+	uint64_t cbModule = RequireImage() ? g_image.SizeOfImage() : 0;
+
+	if (cbModule == 0 && !symbols.Functions().empty()) {
+		cbModule = (uint64_t)symbols.Functions().back().rva + symbols.Functions().back().cb;
+	}
+
+	if (!samples.Load(szSamples, g_dwloadAddress, cbModule)) {
+		wprintf(L"ERROR - DumpProfile() could not read samples from %s\n", szSamples);
+
+		return false;
+	}
+	QueryPerformanceCounter(&t2);
+
+	AggregateProfile(symbols, samples, report);
+	QueryPerformanceCounter(&t3);
+
+	double scale = 1000.0 / (double)freq.QuadPart;
+	double total = (report.cSamples != 0) ? (double)report.cSamples : 1.0;
+
+	wprintf(L"\n\n*** PROFILE\n\n");
+	wprintf(L"Samples        : %llu, %llu unresolved\n", report.cSamples, report.cUnresolved);
+	wprintf(L"Stacks         : %u distinct\n", (DWORD)samples.Stacks().size());
+	wprintf(L"Symbols        : %.2f ms\n", (double)(t1.QuadPart - t0.QuadPart) * scale);
+	wprintf(L"Read samples   : %.2f ms\n", (double)(t2.QuadPart - t1.QuadPart) * scale);
+	wprintf(L"Aggregate      : %.2f ms\n", (double)(t3.QuadPart - t2.QuadPart) * scale);
+
+	wprintf(L"\n** FUNCTIONS\n\n");
+
+	for (size_t i = 0; i < report.functions.size() && i < PROFILE_REPORT_ROWS; i++) {
+		const ProfileFunction & function = symbols.Functions()[report.functions[i].index];
+
+		wprintf(L"%10llu %6.2f%% [%08X] %S\n", report.functions[i].count, report.functions[i].count * 100.0 / total,
+			function.rva, symbols.Name(function.iName).c_str());
+	}
+
+	wprintf(L"\n** LINES\n\n");
+
+	for (size_t i = 0; i < report.lines.size() && i < PROFILE_REPORT_ROWS; i++) {
+		const ProfileLine & line = symbols.Lines()[report.lines[i].index];
+
+		wprintf(L"%10llu %6.2f%% [%08X] %S @ %u\n", report.lines[i].count, report.lines[i].count * 100.0 / total,
+			line.rva, symbols.File(line.iFile).c_str(), line.line);
+	}
+
+	wprintf(L"\n** COMPILANDS\n\n");
+
+	for (size_t i = 0; i < report.compilands.size() && i < PROFILE_REPORT_ROWS; i++) {
+		wprintf(L"%10llu %6.2f%% %S\n", report.compilands[i].count, report.compilands[i].count * 100.0 / total,
+			symbols.Compiland(report.compilands[i].index).c_str());
+	}
+
+	putwchar(L'\n');
+
+	if (szCollapsed == NULL) {
+		return true;
+	}
+
+	if (samples.Stacks().empty()) {
+		wprintf(L"No stacks in %s, %s not written\n", szSamples, szCollapsed);
+
+		return true;
+	}
+
+	FILE * pFile;
+	std::string module;
+
+	if (_wfopen_s(&pFile, szCollapsed, L"w") || !pFile) {
+		wprintf(L"ERROR - DumpProfile() could not create %s\n", szCollapsed);
+
+		return false;
+	}
+
+	ToUtf8(PathFindFileNameW(g_szFilename), module);
+
+	bool fOk = WriteCollapsedStacks(symbols, samples, module.c_str(), pFile);
+
+	fOk = (fclose(pFile) == 0) && fOk;
+
+	if (!fOk) {
+		wprintf(L"ERROR - DumpProfile() could not write %s\n", szCollapsed);
+	}
+
+	return fOk;
+}
+
+////////////////////////////////////////////////////////////
+// Write an /ORDER file for the hot COMDATs of a sample or call
+//  count profile, clustered along the sampled call chains, and
+//  report the working set it should save
+//
+bool DumpLinkOrder(IDiaSession * pSession, const wchar_t * szSamples, const wchar_t * szOrderFile)
+{
+	IDiaEnumSectionContribs * pEnumSecContribs;
+
+	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
+		wprintf(L"ERROR - DumpLinkOrder() no section contributions\n");
+
+		return false;
+	}
+
+	std::vector<OrderContrib> contribs;
+	IDiaSectionContrib * pSecContrib;
+	ULONG celt = 0;
+
+	while (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
+		OrderContrib contrib;
+		DWORD dwRVA, dwLen;
+		BOOL fCode, fExecute, fComdat;
+
+		if (pSecContrib->get_relativeVirtualAddress(&dwRVA) == S_OK &&
+			pSecContrib->get_length(&dwLen) == S_OK &&
+			pSecContrib->get_code(&fCode) == S_OK &&
+			pSecContrib->get_execute(&fExecute) == S_OK &&
+			pSecContrib->get_comdat(&fComdat) == S_OK &&
+			(fCode || fExecute) && dwLen != 0) {
+			IDiaSymbol * pSymbol = NULL;
+			long displ = 0;
+
+			contrib.rva = dwRVA;
+			contrib.cb = dwLen;
+			contrib.fComdat = fComdat != FALSE;
+			contrib.samples = 0;
+
+			// /ORDER takes the decorated names, which only the publics have
+
+			if (SUCCEEDED(pSession->findSymbolByRVAEx(contrib.rva, SymTagPublicSymbol, &pSymbol, &displ)) && pSymbol) {
+				BSTR bstrName;
+
+				if (displ == 0 && pSymbol->get_name(&bstrName) == S_OK) {
+					ToUtf8(bstrName, contrib.name);
+
+					SysFreeString(bstrName);
+				}
+
+				pSymbol->Release();
+			}
+
+			contribs.push_back(contrib);
+		}
+
+		pSecContrib->Release();
+	}
+
+	pEnumSecContribs->Release();
+
+	SortOrderContribs(contribs);
+
+	uint64_t cbModule = RequireImage() ? g_image.SizeOfImage() : 0;
+
+	if (cbModule == 0 && !contribs.empty()) {
+		cbModule = (uint64_t)contribs.back().rva + contribs.back().cb;
+	}
+
+	ProfileSamples samples;
+
+	if (!samples.Load(szSamples, g_dwloadAddress, cbModule)) {
+		wprintf(L"ERROR - DumpLinkOrder() could not read samples from %s\n", szSamples);
+
+		return false;
+	}
+
+	std::vector<OrderEdge> edges;
+	std::vector<uint32_t> order;
+	OrderWorkingSet ws;
+
+	CountOrderSamples(contribs, samples, edges);
+	ClusterOrderContribs(contribs, edges, order);
+	EstimateOrderWorkingSet(contribs, order, ws);
+
+	FILE * pFile;
+
+	if (_wfopen_s(&pFile, szOrderFile, L"w") || !pFile) {
+		wprintf(L"ERROR - DumpLinkOrder() could not create %s\n", szOrderFile);
+
+		return false;
+	}
+
+	DWORD cOrdered = 0;
+	DWORD cFixed = 0;
+
+	for (uint32_t i : order) {
+		if (contribs[i].fComdat && !contribs[i].name.empty()) {
+			fprintf(pFile, "%s\n", contribs[i].name.c_str());
+			cOrdered++;
+		}
+
+		else {
+			cFixed++;
+		}
+	}
+
+	if (fclose(pFile) != 0) {
+		wprintf(L"ERROR - DumpLinkOrder() could not write %s\n", szOrderFile);
+
+		return false;
+	}
+
+	auto reduction = [](uint64_t before, uint64_t after) {
+		return (before != 0) ? 100.0 - (double)after * 100.0 / (double)before : 0.0;
+	};
+
+	wprintf(L"\n\n*** LINK ORDER\n\n");
+	wprintf(L"Code contribs  : %u\n", (DWORD)contribs.size());
+	wprintf(L"Samples        : %llu\n", samples.CountSamples());
+	wprintf(L"Call edges     : %u\n", (DWORD)edges.size());
+	wprintf(L"Hot contribs   : %u, %u ordered, %u not COMDAT or unnamed\n", (DWORD)order.size(), cOrdered, cFixed);
+	wprintf(L"Pages          : %llu -> %llu (%.1f%% fewer)\n", ws.cPagesBefore, ws.cPagesAfter, reduction(ws.cPagesBefore, ws.cPagesAfter));
+	wprintf(L"Cache lines    : %llu -> %llu (%.1f%% fewer)\n", ws.cLinesBefore, ws.cLinesAfter, reduction(ws.cLinesBefore, ws.cLinesAfter));
+	wprintf(L"Order file     : %s\n\n", szOrderFile);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Read the section names from the SECTIONHEADERS debug stream,
+//  names[i] belongs to section i + 1
+//
+bool LoadSectionNames(IDiaSession * pSession, std::vector<std::string> & names)
+{
+	IDiaEnumDebugStreams * pEnumStreams;
+
+	names.clear();
+
+	if (FAILED(pSession->getEnumDebugStreams(&pEnumStreams))) {
+		return false;
+	}
+
+	IDiaEnumDebugStreamData * pStream;
+	ULONG celt = 0;
+
+	for (; SUCCEEDED(pEnumStreams->Next(1, &pStream, &celt)) && (celt == 1); pStream = NULL) {
+		BSTR bstrName;
+
+		if (pStream->get_name(&bstrName) == S_OK) {
+			if (!wcscmp(bstrName, L"SECTIONHEADERS")) {
+				IMAGE_SECTION_HEADER header;
+				DWORD cbData;
+
+				while (SUCCEEDED(pStream->Next(1, sizeof(header), &cbData, (BYTE *)&header, &celt)) && (celt == 1)) {
+					names.push_back(std::string((const char *)header.Name, strnlen((const char *)header.Name, IMAGE_SIZEOF_SHORT_NAME)));
+				}
+			}
+
+			SysFreeString(bstrName);
+		}
+
+		pStream->Release();
+	}
+
+	pEnumStreams->Release();
+
+	return !names.empty();
+}
+
+#define SIZE_REPORT_ROWS 25
+
+#ifndef UNDNAME_NAME_ONLY
+#define UNDNAME_NAME_ONLY 0x1000     // from dbghelp.h
+#endif
+
+////////////////////////////////////////////////////////////
+// Undecorated name of the function, or else the public, that
+//  starts at an RVA
+//
+static bool GetContribName(IDiaSession * pSession, DWORD dwRVA, std::string & name)
+{
+	IDiaSymbol * pSymbol = NULL;
+	long displ = 0;
+	BSTR bstrName = NULL;
+
+	if (pSession->findSymbolByRVAEx(dwRVA, SymTagFunction, &pSymbol, &displ) == S_OK && pSymbol != NULL && displ == 0) {
+		pSymbol->get_name(&bstrName);
+	}
+
+	else {
+		if (pSymbol != NULL) {
+			pSymbol->Release();
+			pSymbol = NULL;
+		}
+
+		if (pSession->findSymbolByRVAEx(dwRVA, SymTagPublicSymbol, &pSymbol, &displ) == S_OK && pSymbol != NULL && displ == 0) {
+			pSymbol->get_undecoratedNameEx(UNDNAME_NAME_ONLY, &bstrName);
+		}
+	}
+
+	if (pSymbol != NULL) {
+		pSymbol->Release();
+	}
+
+	if (bstrName == NULL) {
+		return false;
+	}
+
+	ToUtf8(bstrName, name);
+
+	SysFreeString(bstrName);
+
+	return true;
+}
+
+static void PrintSizeTable(const wchar_t * szTitle, const SizeTable & table, DWORD dwRows)
+{
+	std::vector<const SizeRow *> rows;
+	double total = table.Total() ? (double)table.Total() : 1.0;
+
+	table.Sorted(rows);
+
+	wprintf(L"\n** %s (%u)\n\n", szTitle, (DWORD)rows.size());
+
+	for (size_t i = 0; i < rows.size() && i < dwRows; i++) {
+		wprintf(L"%12llu %6.2f%% %8llu  %S\n", rows[i]->cb, rows[i]->cb * 100.0 / total, rows[i]->count, rows[i]->key.c_str());
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Attribute every section contribution's bytes to its
+//  compiland, library, section, kind and template family
+//
+//  The library is the archive the compiland was pulled from,
+//  or the directory of the object file. The contributions are
+//  walked once, compilands are resolved once per id. With no
+//  dwRows, SIZE_REPORT_ROWS rows of each table are printed.
+//
+bool DumpSizeReport(IDiaSession * pSession, DWORD dwRows, const wchar_t * szFilename)
+{
+	struct CompilandNames
+	{
+		std::string name;
+		std::string library;
+	};
+
+	IDiaEnumSectionContribs * pEnumSecContribs;
+
+	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
+		wprintf(L"ERROR - DumpSizeReport() no section contributions\n");
+
+		return false;
+	}
+
+	std::vector<std::string> sections;
+	std::unordered_map<DWORD, CompilandNames> compilands;
+	SizeTable byCompiland, byLibrary, bySection, byKind, byFamily;
+	std::string name, family;
+	char szSection[32];
+	IDiaSectionContrib * pSecContrib;
+	ULONG celt = 0;
+
+	LoadSectionNames(pSession, sections);
+
+	while (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
+		DWORD dwRVA, dwSect, dwLen, dwCompilandId;
+		BOOL fCode, fComdat, fUninitialized;
+
+		if (pSecContrib->get_relativeVirtualAddress(&dwRVA) != S_OK ||
+			pSecContrib->get_addressSection(&dwSect) != S_OK ||
+			pSecContrib->get_length(&dwLen) != S_OK ||
+			pSecContrib->get_compilandId(&dwCompilandId) != S_OK) {
+			pSecContrib->Release();
+			continue;
+		}
+
+		auto it = compilands.find(dwCompilandId);
+
+		if (it == compilands.end()) {
+			CompilandNames names;
+			IDiaSymbol * pCompiland;
+			BSTR bstrName;
+
+			if (pSecContrib->get_compiland(&pCompiland) == S_OK) {
+				if (pCompiland->get_name(&bstrName) == S_OK) {
+					ToUtf8(bstrName, names.name);
+
+					SysFreeString(bstrName);
+				}
+
+				if (pCompiland->get_libraryName(&bstrName) == S_OK) {
+					ToUtf8(bstrName, names.library);
+
+					SysFreeString(bstrName);
+				}
+
+				pCompiland->Release();
+			}
+
+			if (names.library.empty() || names.library == names.name) {
+				size_t iSlash = names.name.find_last_of("\\/");
+
+				names.library = (iSlash != std::string::npos) ? names.name.substr(0, iSlash) : "(none)";
+			}
+
+			it = compilands.insert(std::make_pair(dwCompilandId, names)).first;
+		}
+
+		byCompiland.Add(it->second.name, dwLen);
+		byLibrary.Add(it->second.library, dwLen);
+
+		if (dwSect != 0 && dwSect <= sections.size()) {
+			bySection.Add(sections[dwSect - 1], dwLen);
+		}
+
+		else {
+			sprintf_s(szSection, "section %u", dwSect);
+			bySection.Add(szSection, dwLen);
+		}
+
+		if (pSecContrib->get_code(&fCode) != S_OK) {
+			fCode = FALSE;
+		}
+
+		if (pSecContrib->get_comdat(&fComdat) != S_OK) {
+			fComdat = FALSE;
+		}
+
+		if (pSecContrib->get_uninitializedData(&fUninitialized) != S_OK) {
+			fUninitialized = FALSE;
+		}
+
+		name = fCode ? "code" : (fUninitialized ? "bss" : "data");
+		byKind.Add(fComdat ? name + " comdat" : name, dwLen);
+
+		// Template families, from the function or public at the start
+
+		if (GetContribName(pSession, dwRVA, name)) {
+			byFamily.Add(TemplateFamily(name.c_str(), family) ? family : "(not a template)", dwLen);
+		}
+
+		else {
+			byFamily.Add("(no symbol)", dwLen);
+		}
+
+		pSecContrib->Release();
+	}
+
+	pEnumSecContribs->Release();
+
+	if (dwRows == 0) {
+		dwRows = SIZE_REPORT_ROWS;
+	}
+
+	wprintf(L"\n\n*** SIZE ATTRIBUTION\n\n");
+	wprintf(L"Total bytes    : %llu\n", byCompiland.Total());
+
+	PrintSizeTable(L"COMPILANDS", byCompiland, dwRows);
+	PrintSizeTable(L"LIBRARIES", byLibrary, dwRows);
+	PrintSizeTable(L"SECTIONS", bySection, dwRows);
+	PrintSizeTable(L"KINDS", byKind, dwRows);
+	PrintSizeTable(L"TEMPLATE FAMILIES", byFamily, dwRows);
+
+	putwchar(L'\n');
+
+	if (szFilename == NULL) {
+		return true;
+	}
+
+	FILE * pFile;
+
+	if (_wfopen_s(&pFile, szFilename, L"w") || !pFile) {
+		wprintf(L"ERROR - DumpSizeReport() could not create %s\n", szFilename);
+
+		return false;
+	}
+
+	bool fOk = fprintf(pFile, "table\tkey\tbytes\tcount\n") > 0 &&
+		WriteSizeTable(pFile, "compiland", byCompiland) &&
+		WriteSizeTable(pFile, "library", byLibrary) &&
+		WriteSizeTable(pFile, "section", bySection) &&
+		WriteSizeTable(pFile, "kind", byKind) &&
+		WriteSizeTable(pFile, "family", byFamily);
+
+	fOk = (fclose(pFile) == 0) && fOk;
+
+	if (!fOk) {
+		wprintf(L"ERROR - DumpSizeReport() could not write %s\n", szFilename);
+	}
+
+	return fOk;
+}
+
+#define ICF_MEMBERS_SHOWN 8
+
+////////////////////////////////////////////////////////////
+// Report the code contributions /OPT:ICF could have folded
+//
+//  Folded COMDATs share one contribution, so every remaining
+//  group of identical contributions is a missed fold, e.g. of
+//  functions whose address is taken or that were kept with
+//  /OPT:NOICF. The image (-image, or the dumped exe) is needed
+//  to verify the groups.
+//
+bool DumpIcfCandidates(IDiaSession * pSession, DWORD dwRows)
+{
+	IDiaEnumSectionContribs * pEnumSecContribs;
+
+	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
+		wprintf(L"ERROR - DumpIcfCandidates() no section contributions\n");
+
+		return false;
+	}
+
+	std::vector<IcfContrib> contribs;
+	IDiaSectionContrib * pSecContrib;
+	ULONG celt = 0;
+
+	while (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
+		DWORD dwRVA, dwLen, dwDataCRC;
+		BOOL fCode;
+
+		if (pSecContrib->get_relativeVirtualAddress(&dwRVA) == S_OK &&
+			pSecContrib->get_length(&dwLen) == S_OK &&
+			pSecContrib->get_dataCrc(&dwDataCRC) == S_OK &&
+			pSecContrib->get_code(&fCode) == S_OK && fCode) {
+			IcfContrib contrib;
+
+			contrib.rva = dwRVA;
+			contrib.cb = dwLen;
+			contrib.crc = dwDataCRC;
+			contribs.push_back(contrib);
+		}
+
+		pSecContrib->Release();
+	}
+
+	pEnumSecContribs->Release();
+
+	std::vector<IcfGroup> groups;
+	IcfStats stats;
+
+	FindIcfGroups(contribs, RequireImage() ? &g_image : NULL, groups, stats);
+
+	// Only the members of the groups need names
+
+	SizeTable byFamily;
+	std::string family;
+	uint64_t cbVerified = 0;
+	uint64_t cbUnverified = 0;
+	DWORD cVerified = 0;
+
+	for (const IcfGroup & group : groups) {
+		for (uint32_t i : group.members) {
+			GetContribName(pSession, contribs[i].rva, contribs[i].name);
+		}
+
+		const std::string & name = contribs[group.members[0]].name;
+
+		if (group.fVerified) {
+			cbVerified += group.cbSavings;
+			cVerified++;
+		}
+
+		else {
+			cbUnverified += group.cbSavings;
+		}
+
+		if (name.empty()) {
+			byFamily.Add("(no symbol)", group.cbSavings);
+		}
+
+		else {
+			byFamily.Add(TemplateFamily(name.c_str(), family) ? family : name, group.cbSavings);
+		}
+	}
+
+	if (dwRows == 0) {
+		dwRows = SIZE_REPORT_ROWS;
+	}
+
+	wprintf(L"\n\n*** IDENTICAL CODE\n\n");
+	wprintf(L"Code contribs  : %u\n", (DWORD)contribs.size());
+	wprintf(L"Same len + CRC : %u groups, %u split by the image bytes\n", stats.cCandidates, stats.cSplit);
+	wprintf(L"Verified       : %u groups, %llu bytes foldable\n", cVerified, cbVerified);
+	wprintf(L"Unverified     : %u groups, %llu bytes%s\n", (DWORD)groups.size() - cVerified, cbUnverified,
+		RequireImage() ? L"" : L", load the image with -image to verify");
+
+	PrintSizeTable(L"SAVINGS BY TEMPLATE FAMILY", byFamily, dwRows);
+
+	wprintf(L"\n** GROUPS\n\n");
+
+	for (size_t i = 0; i < groups.size() && i < dwRows; i++) {
+		const IcfGroup & group = groups[i];
+
+		wprintf(L"%10llu bytes, %u x 0x%X%s\n", group.cbSavings, (DWORD)group.members.size(),
+			contribs[group.members[0]].cb, group.fVerified ? L"" : L" (unverified)");
+
+		for (size_t j = 0; j < group.members.size() && j < ICF_MEMBERS_SHOWN; j++) {
+			const IcfContrib & contrib = contribs[group.members[j]];
+
+			wprintf(L"    [%08X] %S\n", contrib.rva, contrib.name.empty() ? "???" : contrib.name.c_str());
+		}
+
+		if (group.members.size() > ICF_MEMBERS_SHOWN) {
+			wprintf(L"    ... %u more\n", (DWORD)(group.members.size() - ICF_MEMBERS_SHOWN));
+		}
+	}
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the UDT names defined with more than one layout
+//
+//  Compilands disagreeing on a type corrupt memory silently. The
+//  definitions are compared from the TPI stream, every layout is
+//  printed as its differences with the most common one.
+//
+bool DumpOdrViolations(IDiaSymbol * pGlobal, DWORD dwRows)
+{
+	if (!LoadTypeStreams(pGlobal)) {
+		return false;
+	}
+
+	unsigned cThreads = std::thread::hardware_concurrency();
+	std::vector<OdrViolation> violations;
+	std::vector<std::string> differences;
+	OdrStats stats;
+	LARGE_INTEGER freq, t0, t1;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	FindOdrViolations(g_pdb, g_tpi, g_ipi, (cThreads != 0) ? cThreads : 1, violations, stats);
+
+	QueryPerformanceCounter(&t1);
+
+	wprintf(L"\n\n*** ODR VIOLATIONS\n\n");
+	wprintf(L"%u UDT definitions, %u names, %u with more than one layout, %.2f s\n",
+		stats.cDefinitions, stats.cNames, (DWORD)violations.size(),
+		(double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart);
+
+	for (size_t i = 0; i < violations.size() && (dwRows == 0 || i < dwRows); i++) {
+		const OdrViolation & violation = violations[i];
+
+		wprintf(L"\n%S : %u layouts\n", violation.name.c_str(), (DWORD)violation.definitions.size());
+
+		for (size_t j = 0; j < violation.definitions.size(); j++) {
+			const OdrDefinition & definition = violation.definitions[j];
+
+			wprintf(L"  layout %u, size 0x%llX, %u types\n", (DWORD)j + 1, definition.layout.cb, (DWORD)definition.types.size());
+
+			for (const std::string & source : definition.sources) {
+				wprintf(L"    %S\n", source.c_str());
+			}
+
+			if (j != 0) {
+				DiffOdrLayouts(violation.definitions[0].layout, definition.layout, differences);
+
+				for (const std::string & difference : differences) {
+					wprintf(L"      %S\n", difference.c_str());
+				}
+			}
+		}
+	}
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the UDTs wasting the most bytes to padding
+//
+//  Holes between members and tail padding are weighted by the
+//  instance counts when given, so the types that are allocated
+//  the most come first. Every type is followed by its holes, its
+//  members straddling a cache line and the member order sorted
+//  by alignment when that makes it smaller.
+//
+bool DumpPadding(IDiaSymbol * pGlobal, DWORD dwRows, const wchar_t * szWeights)
+{
+	std::unordered_map<std::string, double> weights;
+
+	if (szWeights != NULL && !LoadPaddingWeights(szWeights, weights)) {
+		wprintf(L"ERROR - DumpPadding() could not read %s\n", szWeights);
+
+		return false;
+	}
+
+	LARGE_INTEGER freq, t0, t1;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	if (!LoadLayoutCache(pGlobal)) {
+		return false;
+	}
+
+	unsigned cThreads = std::thread::hardware_concurrency();
+	std::vector<PaddingResult> results;
+	PaddingDetail detail;
+	ULONGLONG cbWasted = 0;
+
+	AnalyzePadding(g_layouts, weights, (cThreads != 0) ? cThreads : 1, results);
+
+	QueryPerformanceCounter(&t1);
+
+	for (const PaddingResult & result : results) {
+		cbWasted += result.cbHoles + result.cbTail;
+	}
+
+	if (dwRows == 0) {
+		dwRows = SIZE_REPORT_ROWS;
+	}
+
+	wprintf(L"\n\n*** PADDING\n\n");
+	wprintf(L"%u UDT definitions, %u with padding or straddles, 0x%llX bytes of padding, %.2f s\n\n",
+		(DWORD)g_layouts.Layouts().size(), (DWORD)results.size(), cbWasted,
+		(double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart);
+
+	wprintf(L"  Padding      Score       Size    Reorder  Type\n");
+
+	for (size_t i = 0; i < results.size() && i < dwRows; i++) {
+		const PaddingResult & result = results[i];
+		const UdtLayout & layout = g_layouts.Layouts()[result.iLayout];
+
+		wprintf(L"%9llX %10.0f %10llX %10llX  %S\n",
+			result.cbHoles + result.cbTail, result.score, layout.cb, result.cbMin, layout.szName);
+	}
+
+	for (size_t i = 0; i < results.size() && i < dwRows; i++) {
+		const PaddingResult & result = results[i];
+		const UdtLayout & layout = g_layouts.Layouts()[result.iLayout];
+		const LayoutMember * pMembers = g_layouts.Members(layout);
+
+		DescribePadding(g_layouts, layout, detail);
+
+		wprintf(L"\n%S : size 0x%llX, align %u\n", layout.szName, layout.cb, layout.align);
+
+		for (const PaddingHole & hole : detail.holes) {
+			wprintf(L"  hole     +0x%04llX  0x%llX bytes\n", hole.offset, hole.cb);
+		}
+
+		if (result.cbTail != 0) {
+			wprintf(L"  tail     +0x%04llX  0x%llX bytes\n", layout.cb - result.cbTail, result.cbTail);
+		}
+
+		for (DWORD iMember : detail.straddles) {
+			const LayoutMember & member = pMembers[iMember];
+
+			wprintf(L"  straddle +0x%04llX  0x%llX bytes  %S\n", member.offset, member.cb, member.szName);
+		}
+
+		if (result.cbMin < layout.cb) {
+			wprintf(L"  reordered to 0x%llX bytes:", result.cbMin);
+
+			for (DWORD iMember : detail.order) {
+				wprintf(L" %S", pMembers[iMember].szName);
+			}
+
+			putwchar(L'\n');
+		}
+	}
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// The addresses of a file, one per line, or a hexadecimal address
+//
+//  The argument is tried as a file first, so a file named like a
+//  number is still read, and is an address only when all of it is
+//  hexadecimal, with or without 0x.
+//
+static bool ReadAddresses(const wchar_t * szArg, std::vector<uint64_t> & addresses)
+{
+	FILE * pFile;
+	wchar_t wszLine[256];
+
+	if (_wfopen_s(&pFile, szArg, L"r") || !pFile) {
+		wchar_t * pEnd;
+		uint64_t address = wcstoull(szArg, &pEnd, 16);
+
+		if (!iswxdigit(*szArg) || *pEnd != L'\0') {
+			return false;
+		}
+
+		addresses.push_back(address);
+
+		return true;
+	}
+
+	while (fgetws(wszLine, _countof(wszLine), pFile) != NULL) {
+		if (iswxdigit(*wszLine)) {
+			addresses.push_back(wcstoull(wszLine, NULL, 16));
+		}
+	}
+
+	fclose(pFile);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the global variable member at an RVA, or at every RVA of a
+//  file, one hexadecimal RVA per line
+//
+//  The paths follow nested structures, base classes and arrays
+//  down to the scalar the address lands in.
+//
+bool DumpFieldPaths(IDiaSymbol * pGlobal, const wchar_t * szArg)
+{
+	std::vector<uint64_t> addresses;
+	std::vector<uint32_t> rvas;
+	std::vector<std::string> paths;
+
+	if (!ReadAddresses(szArg, addresses)) {
+		wprintf(L"ERROR - DumpFieldPaths() %s is neither a file nor an address\n", szArg);
+
+		return false;
+	}
+
+	for (uint64_t address : addresses) {
+		rvas.push_back((uint32_t)address);
+	}
+
+	unsigned cThreads = std::thread::hardware_concurrency();
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	if (g_fields.CountGlobals() == 0) {
+		if (!LoadLayoutCache(pGlobal)) {
+			return false;
+		}
+
+		if (!g_fields.Build(g_pdb, g_layouts, cThreads)) {
+			wprintf(L"ERROR - DumpFieldPaths() could not read the global variables\n");
+
+			return false;
+		}
+	}
+
+	LARGE_INTEGER freq, t0, t1;
+	DWORD cResolved = 0;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	g_fields.ResolveBatch(rvas, cThreads, paths);
+
+	QueryPerformanceCounter(&t1);
+
+	for (size_t i = 0; i < rvas.size(); i++) {
+		if (paths[i].empty()) {
+			wprintf(L"%08X  <no global variable>\n", rvas[i]);
+		}
+
+		else {
+			wprintf(L"%08X  %S\n", rvas[i], paths[i].c_str());
+			cResolved++;
+		}
+	}
+
+	if (rvas.size() > 1) {
+		wprintf(L"\n%u of %u addresses in %u global variables, %u leaf fields, %.3f s\n",
+			cResolved, (DWORD)rvas.size(), g_fields.CountGlobals(), g_fields.CountLeaves(),
+			(double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart);
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump typed objects out of a minidump, or out of a raw memory
+//  dump given as <file>@<base address>
+//
+//  Every address of szAddresses is rendered as an object of the
+//  named UDT or enum, following pointers dwDepth levels deep. The
+//  type descriptions are shared by all the objects.
+//
+bool DumpTypedMemory(IDiaSymbol * pGlobal, const wchar_t * szDump, const wchar_t * szAddresses, const wchar_t * szType, DWORD dwDepth)
+{
+	std::vector<uint64_t> addresses;
+	std::wstring path(szDump);
+	size_t iAt = path.rfind(L'@');
+	Minidump dump;
+	std::vector<uint8_t> raw;
+	MemorySnapshot rawMemory;
+	const MemorySnapshot * pMemory = &rawMemory;
+
+	if (iAt != std::wstring::npos) {
+		uint64_t qwBase = wcstoull(path.c_str() + iAt + 1, NULL, 16);
+
+		path.resize(iAt);
+
+		if (!ReadWholeFile(path.c_str(), raw)) {
+			wprintf(L"ERROR - DumpTypedMemory() could not read %s\n", path.c_str());
+
+			return false;
+		}
+
+		rawMemory.AddRange(qwBase, raw.data(), raw.size());
+	}
+
+	else if (dump.Load(szDump)) {
+		pMemory = &dump.Memory();
+	}
+
+	else {
+		wprintf(L"ERROR - DumpTypedMemory() could not read the minidump %s\n", szDump);
+
+		return false;
+	}
+
+	if (!ReadAddresses(szAddresses, addresses)) {
+		wprintf(L"ERROR - DumpTypedMemory() %s is neither a file nor an address\n", szAddresses);
+
+		return false;
+	}
+
+	if (!LoadLayoutCache(pGlobal)) {
+		return false;
+	}
+
+	std::string typeName;
+
+	ToUtf8(szType, typeName);
+
+	uint32_t type = g_tpi.FindType(typeName.c_str());
+
+	if (type == 0) {
+		wprintf(L"ERROR - DumpTypedMemory() no definition of %s\n", szType);
+
+		return false;
+	}
+
+	ValueRenderer renderer(g_layouts, *pMemory);
+	std::string text;
+	LARGE_INTEGER freq, t0, t1;
+
+	renderer.SetPointerDepth((int)dwDepth);
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	for (uint64_t address : addresses) {
+		text.clear();
+		renderer.Render(address, type, typeName.c_str(), text);
+		wprintf(L"%S", text.c_str());
+	}
+
+	QueryPerformanceCounter(&t1);
+
+	wprintf(L"\n%u objects, %u types described, %.2f s\n", (DWORD)addresses.size(), renderer.CountTypes(),
+		(double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Write C++ headers declaring a comma separated list of UDTs,
+//  enums and typedefs, or every UDT and enum for "*"
+//
+//  The types they need are added, definitions before their users.
+//  Each structure is followed by static_asserts on its size and
+//  member offsets.
+//
+bool DumpHeaders(IDiaSymbol * pGlobal, const wchar_t * szTypes, const wchar_t * szBaseName, DWORD dwFiles)
+{
+	if (!LoadLayoutCache(pGlobal)) {
+		return false;
+	}
+
+	HeaderGenerator generator(g_layouts);
+	std::string types;
+	std::string baseName;
+
+	generator.LoadTypedefs(g_pdb);
+	ToUtf8(szTypes, types);
+	ToUtf8(szBaseName, baseName);
+
+	if (types == "*") {
+		generator.SelectAll();
+	}
+
+	else {
+		size_t iFirst = 0;
+
+		while (iFirst <= types.size()) {
+			size_t iEnd = types.find(',', iFirst);
+
+			if (iEnd == std::string::npos) {
+				iEnd = types.size();
+			}
+
+			std::string name = types.substr(iFirst, iEnd - iFirst);
+
+			if (!name.empty() && !generator.Select(name.c_str())) {
+				wprintf(L"ERROR - DumpHeaders() no definition of %S\n", name.c_str());
+
+				return false;
+			}
+
+			iFirst = iEnd + 1;
+		}
+	}
+
+	unsigned cThreads = std::thread::hardware_concurrency();
+	std::vector<HeaderFile> files;
+	LARGE_INTEGER freq, t0, t1;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	generator.Generate(baseName.c_str(), (dwFiles != 0) ? dwFiles : 1, (cThreads != 0) ? cThreads : 1, files);
+
+	QueryPerformanceCounter(&t1);
+
+	for (const HeaderFile & file : files) {
+		FILE * pFile;
+
+		if (fopen_s(&pFile, file.name.c_str(), "wb") || !pFile) {
+			wprintf(L"ERROR - DumpHeaders() could not create %S\n", file.name.c_str());
+
+			return false;
+		}
+
+		fwrite(file.text.data(), 1, file.text.size(), pFile);
+		fclose(pFile);
+
+		wprintf(L"%S : %u types\n", file.name.c_str(), file.cTypes);
+	}
+
+	wprintf(L"\n%u types defined, %u forward declared only, %.2f s\n", generator.CountDefined(), generator.CountDeclared(),
+		(double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the inheritance of a class, or with "*" the deepest classes
+//  and every class inheriting a base along more than one path
+//
+//  The graph of the whole TPI stream is built on first use and kept
+//  for the later queries.
+//
+bool DumpHierarchy(IDiaSymbol * pGlobal, const wchar_t * szClass, DWORD dwRows)
+{
+	static const wchar_t * const rgKinds[] = {L"", L"virtual ", L"indirect virtual "};
+	LARGE_INTEGER freq, t0, t1;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	if (!LoadClassHierarchy(pGlobal)) {
+		return false;
+	}
+
+	QueryPerformanceCounter(&t1);
+
+	wprintf(L"%u classes, %u base edges, %u diamond sites, %.2f s\n", g_hierarchy.CountClasses(),
+		g_hierarchy.CountEdges(), (DWORD)g_hierarchy.Diamonds().size(),
+		(double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart);
+
+	if (dwRows == 0) {
+		dwRows = SIZE_REPORT_ROWS;
+	}
+
+	if (!wcscmp(szClass, L"*")) {
+		std::vector<DWORD> classes;
+
+		for (DWORD iClass = 0; iClass < g_hierarchy.CountClasses(); iClass++) {
+			classes.push_back(iClass);
+		}
+
+		std::stable_sort(classes.begin(), classes.end(),
+			[](DWORD a, DWORD b) { return g_hierarchy.Depth(a) > g_hierarchy.Depth(b); });
+
+		wprintf(L"\n\n*** DEEPEST CLASSES\n\n");
+		wprintf(L"  Depth  Ancestors  Class\n");
+
+		for (size_t i = 0; i < classes.size() && i < dwRows; i++) {
+			uint32_t cAncestors;
+
+			g_hierarchy.Ancestors(classes[i], &cAncestors);
+			wprintf(L"%7u %10u  %S\n", g_hierarchy.Depth(classes[i]), cAncestors, g_hierarchy.Name(classes[i]));
+		}
+
+		std::vector<DiamondSite> diamonds(g_hierarchy.Diamonds());
+
+		std::stable_sort(diamonds.begin(), diamonds.end(),
+			[](const DiamondSite & a, const DiamondSite & b) { return a.cPaths > b.cPaths; });
+
+		wprintf(L"\n\n*** DIAMONDS\n\n");
+		wprintf(L"  Paths  Kind       Class  from  Base\n");
+
+		for (size_t i = 0; i < diamonds.size() && i < dwRows; i++) {
+			const DiamondSite & site = diamonds[i];
+
+			wprintf(L"%7u  %-9s  %S  from  %S\n", site.cPaths, site.fVirtual ? L"virtual" : L"repeated",
+				g_hierarchy.Name(site.iClass), g_hierarchy.Name(site.iBase));
+		}
+
+		putwchar(L'\n');
+
+		return true;
+	}
+
+	std::string name;
+
+	ToUtf8(szClass, name);
+
+	DWORD iClass = g_hierarchy.Find(g_tpi.FindType(name.c_str()));
+
+	if (iClass == HIERARCHY_NONE) {
+		wprintf(L"ERROR - DumpHierarchy() no class %s\n", szClass);
+
+		return false;
+	}
+
+	std::vector<uint32_t> derived;
+	uint32_t cBases, cDerived, cAncestors;
+	const HierarchyEdge * pBases = g_hierarchy.Bases(iClass, &cBases);
+	const HierarchyEdge * pDerived = g_hierarchy.Derived(iClass, &cDerived);
+	const uint32_t * pAncestors = g_hierarchy.Ancestors(iClass, &cAncestors);
+
+	QueryPerformanceCounter(&t0);
+	g_hierarchy.AllDerived(iClass, derived);
+	QueryPerformanceCounter(&t1);
+
+	wprintf(L"\n%S : depth %u\n", g_hierarchy.Name(iClass), g_hierarchy.Depth(iClass));
+	wprintf(L"\nBases (%u)\n", cBases);
+
+	for (DWORD i = 0; i < cBases; i++) {
+		const HierarchyEdge & edge = pBases[i];
+
+		if (edge.kind == HIERARCHY_BASE) {
+			wprintf(L"  %S  +0x%llX\n", g_hierarchy.Name(edge.iClass), edge.offset);
+		}
+
+		else {
+			wprintf(L"  %s%S  vbtable index %lld\n", rgKinds[edge.kind], g_hierarchy.Name(edge.iClass), edge.offset);
+		}
+	}
+
+	wprintf(L"\nAncestors (%u)\n", cAncestors);
+
+	for (DWORD i = 0; i < cAncestors; i++) {
+		wprintf(L"  %S\n", g_hierarchy.Name(pAncestors[i]));
+	}
+
+	wprintf(L"\nDirectly derived (%u)\n", cDerived);
+
+	for (DWORD i = 0; i < cDerived; i++) {
+		wprintf(L"  %s%S\n", rgKinds[pDerived[i].kind], g_hierarchy.Name(pDerived[i].iClass));
+	}
+
+	wprintf(L"\nAll derived (%u, %.1f us)\n", (DWORD)derived.size(),
+		(double)(t1.QuadPart - t0.QuadPart) * 1000000.0 / (double)freq.QuadPart);
+
+	for (uint32_t iDerived : derived) {
+		wprintf(L"  %S\n", g_hierarchy.Name(iDerived));
+	}
+
+	wprintf(L"\nDiamonds\n");
+
+	for (const DiamondSite & site : g_hierarchy.Diamonds()) {
+		if (site.iClass == iClass || site.iBase == iClass) {
+			wprintf(L"  %S inherits %S %s through %u bases\n", g_hierarchy.Name(site.iClass), g_hierarchy.Name(site.iBase),
+				site.fVirtual ? L"virtually" : L"repeatedly", site.cPaths);
+		}
+	}
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the vftables of a class, or with "*" the classes with the
+//  most slots
+//
+//  Every slot shows the class introducing it and the class whose
+//  function fills it, and the this adjustment when the slot holds
+//  a thunk. When the image is loaded with -image, the functions the
+//  matched vftable really points to are shown next to them.
+//
+bool DumpVTables(IDiaSymbol * pGlobal, const wchar_t * szClass, DWORD dwRows)
+{
+	LARGE_INTEGER freq, t0, t1;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	if (g_vtables.CountTables() == 0) {
+		if (!LoadClassHierarchy(pGlobal)) {
+			return false;
+		}
+
+		unsigned cThreads = std::thread::hardware_concurrency();
+		uint32_t cbPointer = (g_pdb.Machine() == PE_MACHINE_AMD64 || (RequireImage() && g_image.Is64())) ? 8 : 4;
+
+		g_vtables.Build(g_hierarchy, g_tpi, cbPointer, (cThreads != 0) ? cThreads : 1);
+		g_vtables.MatchPublics(g_pdb);
+	}
+
+	QueryPerformanceCounter(&t1);
+
+	DWORD cMatched = 0;
+
+	for (DWORD iClass = 0; iClass < g_hierarchy.CountClasses(); iClass++) {
+		uint32_t cTables;
+		const VTable * pTables = g_vtables.Tables(iClass, &cTables);
+
+		for (DWORD i = 0; i < cTables; i++) {
+			cMatched += (pTables[i].rva != 0) ? 1 : 0;
+		}
+	}
+
+	wprintf(L"%u vftables, %u slots, %u matched to vftable publics, %.2f s\n", g_vtables.CountTables(), g_vtables.CountSlots(),
+		cMatched, (double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart);
+
+	if (!wcscmp(szClass, L"*")) {
+		std::vector<std::pair<DWORD, DWORD> > classes;
+
+		for (DWORD iClass = 0; iClass < g_hierarchy.CountClasses(); iClass++) {
+			uint32_t cTables;
+			const VTable * pTables = g_vtables.Tables(iClass, &cTables);
+			DWORD cSlots = 0;
+
+			for (DWORD i = 0; i < cTables; i++) {
+				cSlots += pTables[i].cSlots;
+			}
+
+			if (cTables != 0) {
+				classes.push_back(std::make_pair(cSlots, iClass));
+			}
+		}
+
+		std::stable_sort(classes.begin(), classes.end(),
+			[](const std::pair<DWORD, DWORD> & a, const std::pair<DWORD, DWORD> & b) { return a.first > b.first; });
+
+		if (dwRows == 0) {
+			dwRows = SIZE_REPORT_ROWS;
+		}
+
+		wprintf(L"\n\n*** VFTABLES\n\n");
+		wprintf(L"%u polymorphic classes\n\n", (DWORD)classes.size());
+		wprintf(L"  Slots  Tables  Class\n");
+
+		for (size_t i = 0; i < classes.size() && i < dwRows; i++) {
+			uint32_t cTables;
+
+			g_vtables.Tables(classes[i].second, &cTables);
+			wprintf(L"%7u %7u  %S\n", classes[i].first, cTables, g_hierarchy.Name(classes[i].second));
+		}
+
+		putwchar(L'\n');
+
+		return true;
+	}
+
+	std::string name;
+
+	ToUtf8(szClass, name);
+
+	DWORD iClass = g_hierarchy.Find(g_tpi.FindType(name.c_str()));
+
+	if (iClass == HIERARCHY_NONE) {
+		wprintf(L"ERROR - DumpVTables() no class %s\n", szClass);
+
+		return false;
+	}
+
+	uint32_t cTables;
+	const VTable * pTables = g_vtables.Tables(iClass, &cTables);
+	DWORD cbPointer = (RequireImage() && g_image.Is64()) ? 8 : 4;
+	std::string target;
+
+	wprintf(L"\n%S : %u vftables\n", g_hierarchy.Name(iClass), cTables);
+
+	for (DWORD iTable = 0; iTable < cTables; iTable++) {
+		const VTable & table = pTables[iTable];
+		const VTableSlot * pSlots = g_vtables.Slots(table);
+
+		if (table.iVirtualBase != VTABLE_NONE) {
+			wprintf(L"\nvftable in virtual base %S +0x%llX", g_hierarchy.Name(table.iVirtualBase), table.offset);
+		}
+
+		else {
+			wprintf(L"\nvftable at +0x%llX", table.offset);
+		}
+
+		if (table.iFrom != VTABLE_NONE) {
+			wprintf(L", from %S", g_hierarchy.Name(table.iFrom));
+		}
+
+		if (table.rva != 0) {
+			wprintf(L", RVA %08X", table.rva);
+		}
+
+		wprintf(L", %u slots\n", table.cSlots);
+
+		for (DWORD iSlot = 0; iSlot < table.cSlots; iSlot++) {
+			const VTableSlot & slot = pSlots[iSlot];
+
+			if (slot.szName == NULL) {
+				wprintf(L"  [%3u] <unknown>", iSlot);
+			}
+
+			else {
+				wprintf(L"  [%3u] %S::%S%s", iSlot, g_hierarchy.Name(slot.iOverrider), slot.szName, slot.fPure ? L" = 0" : L"");
+
+				if (slot.iIntroducer != slot.iOverrider) {
+					wprintf(L", introduced by %S", g_hierarchy.Name(slot.iIntroducer));
+				}
+
+				// The vtordisp is the int in front of the virtual base
+
+				if (slot.fVtordisp) {
+					wprintf(L", thunk vtordisp{%lld,%lld}", -(int64_t)(table.offset + 4), slot.thisAdjust);
+				}
+
+				else if (slot.thisAdjust != 0) {
+					wprintf(L", thunk this -= 0x%llX", slot.thisAdjust);
+				}
+			}
+
+			// What the vftable in the image holds
+
+			uint64_t qwTarget = 0;
+
+			if (table.rva != 0 && RequireImage() && g_image.Read(table.rva + iSlot * cbPointer, &qwTarget, cbPointer) &&
+				qwTarget >= g_image.ImageBase()) {
+				DWORD dwTarget = (DWORD)(qwTarget - g_image.ImageBase());
+
+				if (GetContribName(g_pDiaSession, dwTarget, target)) {
+					wprintf(L"  -> %08X %S", dwTarget, target.c_str());
+				}
+
+				else {
+					wprintf(L"  -> %08X", dwTarget);
+				}
+			}
+
+			putwchar(L'\n');
+		}
+	}
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump the static initializers in the order the CRT runs them
+//
+//  With a profile of the startup, the samples in each initializer
+//  show where the time before main goes.
+//
+bool DumpStaticInit(IDiaSymbol * pGlobal, DWORD dwRows, const wchar_t * szSamples)
+{
+	LARGE_INTEGER freq, t0, t1;
+	StaticInitInventory inventory;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	if (!LoadNativePdb(pGlobal)) {
+		return false;
+	}
+
+	if (!inventory.Build(g_pdb, RequireImage() ? &g_image : NULL)) {
+		wprintf(L"ERROR - DumpStaticInit() no symbol records\n");
+
+		return false;
+	}
+
+	QueryPerformanceCounter(&t1);
+
+	if (szSamples != NULL) {
+		ProfileSamples samples;
+		uint64_t cbModule = RequireImage() ? g_image.SizeOfImage() : 0;
+
+		if (!samples.Load(szSamples, g_dwloadAddress, cbModule)) {
+			wprintf(L"ERROR - DumpStaticInit() could not read samples from %s\n", szSamples);
+
+			return false;
+		}
+
+		inventory.Weight(samples);
+	}
+
+	const std::vector<StaticInitializer> & initializers = inventory.Initializers();
+	const std::vector<PdbModule> & modules = g_pdb.Modules();
+	SizeTable byCompiland, bySamples;
+	uint64_t cbTotal = 0, cSamples = 0;
+	DWORD cPlaced = 0;
+
+	for (const StaticInitializer & initializer : initializers) {
+		const char * szCompiland = (initializer.iModule < modules.size()) ? modules[initializer.iModule].name.c_str() : "(no compiland)";
+
+		byCompiland.Add(szCompiland, initializer.cb);
+		bySamples.Add(szCompiland, initializer.cSamples);
+		cbTotal += initializer.cb;
+		cSamples += initializer.cSamples;
+		cPlaced += (initializer.iEntry != STATIC_INIT_NONE) ? 1 : 0;
+	}
+
+	wprintf(L"\n\n*** STATIC INITIALIZERS\n\n");
+	wprintf(L"Initializers   : %u, %llu bytes, %u in init order\n", (DWORD)initializers.size(), cbTotal, cPlaced);
+	wprintf(L"Table entries  : %u\n", (DWORD)inventory.Entries().size());
+	wprintf(L"Scan           : %.2f ms\n", (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart);
+
+	if (szSamples != NULL) {
+		wprintf(L"Samples        : %llu in initializers\n", cSamples);
+	}
+
+	if (dwRows == 0) {
+		dwRows = SIZE_REPORT_ROWS;
+	}
+
+	PrintSizeTable(L"COMPILANDS", byCompiland, dwRows);
+
+	if (szSamples != NULL) {
+		PrintSizeTable(L"SAMPLES BY COMPILAND", bySamples, dwRows);
+	}
+
+	wprintf(L"\n** INIT ORDER\n\n");
+
+	for (size_t i = 0; i < initializers.size(); i++) {
+		const StaticInitializer & initializer = initializers[i];
+
+		if (initializer.iEntry != STATIC_INIT_NONE) {
+			wprintf(L"%5u+%-4X ", initializer.iEntry, initializer.offSlot);
+		}
+
+		else {
+			wprintf(L"    ?      ");
+		}
+
+		wprintf(L"[%08X] %6u ", initializer.rva, initializer.cb);
+
+		if (szSamples != NULL) {
+			wprintf(L"%10llu ", initializer.cSamples);
+		}
+
+		wprintf(L"%s %S  (%S)\n", (initializer.kind == STATIC_INIT_DESTRUCTOR) ? L"atexit" : L"init  ",
+			initializer.global.c_str(),
+			(initializer.iModule < modules.size()) ? modules[initializer.iModule].name.c_str() : "(no compiland)");
+	}
+
+	wprintf(L"\n** TABLE ENTRIES\n\n");
+
+	for (size_t i = 0; i < inventory.Entries().size(); i++) {
+		const StaticInitEntry & entry = inventory.Entries()[i];
+
+		wprintf(L"%5u [%08X] %6u %-10S %S\n", (DWORD)i, entry.rva, entry.cb, entry.group.c_str(),
+			(entry.iModule < modules.size()) ? modules[entry.iModule].name.c_str() : "(no compiland)");
+	}
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Flags of a frame as letters: alloca, /GS, EH and recursive
+//
+static void StackFrameFlags(const StackFrame & frame, wchar_t * szFlags)
+{
+	szFlags[0] = (frame.flags & STACK_FRAME_ALLOCA) ? L'A' : L'-';
+	szFlags[1] = (frame.flags & STACK_FRAME_GS) ? L'G' : L'-';
+	szFlags[2] = (frame.flags & STACK_FRAME_EH) ? L'E' : L'-';
+	szFlags[3] = (frame.flags & STACK_FRAME_RECURSIVE) ? L'R' : L'-';
+	szFlags[4] = L'\0';
+}
+
+////////////////////////////////////////////////////////////
+// Dump stack frame sizes and the worst case stack depth
+//
+//  With *, the largest frames, the deepest call chains and the
+//  largest locals. With a function, its locals by size and its
+//  deepest call chain. The image adds its direct calls to the
+//  S_CALLEES records.
+//
+bool DumpStackFrames(IDiaSymbol * pGlobal, const wchar_t * szFunction, DWORD dwRows)
+{
+	LARGE_INTEGER freq, t0, t1;
+	wchar_t szFlags[5];
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	if (g_frames.Frames().empty()) {
+		if (!LoadTypeStreams(pGlobal)) {
+			return false;
+		}
+
+		unsigned cThreads = std::thread::hardware_concurrency();
+		uint32_t cbPointer = (g_pdb.Machine() == PE_MACHINE_AMD64 || (RequireImage() && g_image.Is64())) ? 8 : 4;
+
+		cThreads = (cThreads != 0) ? cThreads : 1;
+
+		if (!g_frames.Build(g_pdb, &g_tpi, cbPointer, cThreads)) {
+			wprintf(L"ERROR - DumpStackFrames() no procedures\n");
+
+			return false;
+		}
+
+		if (RequireImage()) {
+			g_frames.AddImageCalls(g_image, cThreads);
+		}
+
+		g_frames.ComputeDepths();
+	}
+
+	QueryPerformanceCounter(&t1);
+
+	const std::vector<StackFrame> & frames = g_frames.Frames();
+	const std::vector<PdbModule> & modules = g_pdb.Modules();
+	DWORD cAlloca = 0, cGs = 0, cRecursive = 0;
+
+	for (const StackFrame & frame : frames) {
+		cAlloca += (frame.flags & STACK_FRAME_ALLOCA) ? 1 : 0;
+		cGs += (frame.flags & STACK_FRAME_GS) ? 1 : 0;
+		cRecursive += (frame.flags & STACK_FRAME_RECURSIVE) ? 1 : 0;
+	}
+
+	wprintf(L"%u functions, %u calls, %u unresolved callees, %u with alloca, %u with /GS checks, %u recursive, %.2f s\n",
+		(DWORD)frames.size(), g_frames.CountCalls(), g_frames.CountUnresolved(), cAlloca, cGs, cRecursive,
+		(double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart);
+
+	if (dwRows == 0) {
+		dwRows = SIZE_REPORT_ROWS;
+	}
+
+	if (!wcscmp(szFunction, L"*")) {
+		std::vector<DWORD> order(frames.size());
+
+		for (DWORD i = 0; i < frames.size(); i++) {
+			order[i] = i;
+		}
+
+		std::stable_sort(order.begin(), order.end(),
+			[&](DWORD a, DWORD b) { return g_frames.FrameBytes(frames[a]) > g_frames.FrameBytes(frames[b]); });
+
+		wprintf(L"\n\n*** LARGEST FRAMES\n\n");
+		wprintf(L"     Frame     Locals  Saved  Flags  Function (compiland)\n");
+
+		for (size_t i = 0; i < order.size() && i < dwRows; i++) {
+			const StackFrame & frame = frames[order[i]];
+
+			StackFrameFlags(frame, szFlags);
+			wprintf(L"%10llu %10u %6u  %s   %S  (%S)\n", g_frames.FrameBytes(frame), frame.cbFrame, frame.cbSavedRegs, szFlags,
+				frame.name.c_str(), modules[frame.iModule].name.c_str());
+		}
+
+		std::stable_sort(order.begin(), order.end(),
+			[&](DWORD a, DWORD b) { return frames[a].cbDepth > frames[b].cbDepth; });
+
+		wprintf(L"\n\n*** DEEPEST CALL CHAINS\n\n");
+		wprintf(L"     Depth  Calls  Flags  Function\n");
+
+		for (size_t i = 0; i < order.size() && i < dwRows; i++) {
+			const StackFrame & frame = frames[order[i]];
+			DWORD cCalls = 0;
+
+			for (uint32_t iCallee = frame.iDeepest; iCallee != STACK_FRAME_NONE; iCallee = frames[iCallee].iDeepest) {
+				cCalls++;
+			}
+
+			StackFrameFlags(frame, szFlags);
+			wprintf(L"%10llu %6u  %s   %S\n", frame.cbDepth, cCalls, szFlags, frame.name.c_str());
+		}
+
+		// The locals taking the most of a frame
+
+		std::vector<std::pair<DWORD, DWORD> > locals;
+
+		for (DWORD iFrame = 0; iFrame < frames.size(); iFrame++) {
+			for (DWORD iLocal = 0; iLocal < frames[iFrame].cLocals; iLocal++) {
+				if (!g_frames.Locals(frames[iFrame])[iLocal].fParam) {
+					locals.push_back(std::make_pair(iFrame, iLocal));
+				}
+			}
+		}
+
+		std::stable_sort(locals.begin(), locals.end(),
+			[&](const std::pair<DWORD, DWORD> & a, const std::pair<DWORD, DWORD> & b) {
+				return g_frames.Locals(frames[a.first])[a.second].cb > g_frames.Locals(frames[b.first])[b.second].cb;
+			});
+
+		wprintf(L"\n\n*** LARGEST LOCALS\n\n");
+		wprintf(L"     Bytes  Local : type  in  function\n");
+
+		std::string type;
+
+		for (size_t i = 0; i < locals.size() && i < dwRows; i++) {
+			const StackFrame & frame = frames[locals[i].first];
+			const StackLocal & local = g_frames.Locals(frame)[locals[i].second];
+
+			g_tpi.TypeName(local.type, type);
+			wprintf(L"%10llu  %S : %S  in  %S\n", local.cb, local.name.c_str(), type.c_str(), frame.name.c_str());
+		}
+
+		putwchar(L'\n');
+
+		return true;
+	}
+
+	std::string name;
+
+	ToUtf8(szFunction, name);
+
+	DWORD iFrame = g_frames.Find(name.c_str());
+
+	if (iFrame == STACK_FRAME_NONE) {
+		wprintf(L"ERROR - DumpStackFrames() no function %s\n", szFunction);
+
+		return false;
+	}
+
+	const StackFrame & frame = frames[iFrame];
+	uint64_t cbFrame = g_frames.FrameBytes(frame);
+
+	StackFrameFlags(frame, szFlags);
+	wprintf(L"\n%S  (%S)\n", frame.name.c_str(), modules[frame.iModule].name.c_str());
+	wprintf(L"  RVA          : 0x%08X, %u bytes of code\n", frame.rva, frame.cb);
+	wprintf(L"  Frame        : %llu bytes, %u locals, %u saved registers, %u params\n", cbFrame, frame.cbFrame,
+		frame.cbSavedRegs, frame.cbParams);
+	wprintf(L"  Flags        : %s%s%s%s\n", szFlags, (frame.flags & STACK_FRAME_ALLOCA) ? L"  alloca, the frame can grow" : L"",
+		(frame.flags & STACK_FRAME_GS) ? L"  /GS buffers" : L"", (frame.flags & STACK_FRAME_RECURSIVE) ? L"  recursive" : L"");
+
+	if (frame.cbMaxStack != 0) {
+		wprintf(L"  Max stack    : %u\n", frame.cbMaxStack);
+	}
+
+	std::vector<DWORD> order;
+
+	for (DWORD i = 0; i < frame.cLocals; i++) {
+		order.push_back(i);
+	}
+
+	const StackLocal * pLocals = g_frames.Locals(frame);
+
+	std::stable_sort(order.begin(), order.end(), [&](DWORD a, DWORD b) { return pLocals[a].cb > pLocals[b].cb; });
+
+	wprintf(L"\nLocals (%u)\n", frame.cLocals);
+
+	std::string type;
+
+	for (DWORD i = 0; i < order.size() && i < dwRows; i++) {
+		const StackLocal & local = pLocals[order[i]];
+
+		g_tpi.TypeName(local.type, type);
+		wprintf(L"%10llu %6.2f%%  %s%+d  %S : %S%s\n", local.cb, (cbFrame != 0) ? local.cb * 100.0 / (double)cbFrame : 0.0,
+			(local.reg == STACK_REG_FRAME) ? L"frame" : SzNameC7Reg(local.reg), local.offset, local.name.c_str(), type.c_str(),
+			local.fParam ? L"  (param)" : L"");
+	}
+
+	wprintf(L"\nDeepest call chain : %llu bytes\n", frame.cbDepth);
+
+	uint64_t cbTotal = 0;
+
+	for (uint32_t i = iFrame; i != STACK_FRAME_NONE; i = frames[i].iDeepest) {
+		cbTotal += g_frames.FrameBytes(frames[i]);
+		StackFrameFlags(frames[i], szFlags);
+		wprintf(L"%10llu %10llu  %s   %S\n", g_frames.FrameBytes(frames[i]), cbTotal, szFlags, frames[i].name.c_str());
+	}
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Issues of a compiland as letters: not optimized, no /GL,
+//  other /arch, debug CRT and runtime checks
+//
+static void BuildIssueFlags(uint16_t issues, char * szIssues)
+{
+	szIssues[0] = (issues & BUILD_ISSUE_NOT_OPTIMIZED) ? 'O' : '-';
+	szIssues[1] = (issues & BUILD_ISSUE_NO_LTCG) ? 'L' : '-';
+	szIssues[2] = (issues & BUILD_ISSUE_ARCH) ? 'A' : '-';
+	szIssues[3] = (issues & BUILD_ISSUE_DEBUG_CRT) ? 'D' : '-';
+	szIssues[4] = (issues & BUILD_ISSUE_RTC) ? 'R' : '-';
+	szIssues[5] = '\0';
+}
+
+////////////////////////////////////////////////////////////
+// Audit the build flags of the C and C++ compilands
+//
+//  szArch is the /arch every compiland should have, "default"
+//  for none, or * to skip the check. The compilands with issues
+//  are listed by library, all of them go to szFilename.
+//
+bool DumpBuildFlags(IDiaSymbol * pGlobal, const wchar_t * szArch, const wchar_t * szFilename)
+{
+	LARGE_INTEGER freq, t0, t1;
+	BuildFlagAudit audit;
+	std::string arch;
+	char szIssues[6];
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	if (!LoadTypeStreams(pGlobal)) {
+		return false;
+	}
+
+	unsigned cThreads = std::thread::hardware_concurrency();
+
+	if (!audit.Build(g_pdb, (g_ipi.CountTypes() != 0) ? &g_ipi : NULL, (cThreads != 0) ? cThreads : 1)) {
+		wprintf(L"ERROR - DumpBuildFlags() no C or C++ compilands\n");
+
+		return false;
+	}
+
+	ToUtf8(szArch, arch);
+
+	if (arch == "default") {
+		arch.clear();
+	}
+
+	DWORD cIssues = audit.Audit(wcscmp(szArch, L"*") ? arch.c_str() : NULL);
+
+	QueryPerformanceCounter(&t1);
+
+	const std::vector<BuildFlags> & compilands = audit.Compilands();
+	const std::vector<PdbModule> & modules = g_pdb.Modules();
+	std::map<std::string, std::vector<DWORD> > libraries;
+	std::map<std::string, DWORD> compilers;
+	DWORD cCommandLines = 0, rgcIssues[5] = {0};
+
+	for (DWORD i = 0; i < compilands.size(); i++) {
+		const BuildFlags & flags = compilands[i];
+		char szVersion[64];
+
+		if (flags.flags & BUILD_FLAG_COMMAND_LINE) {
+			cCommandLines++;
+		}
+
+		for (DWORD iIssue = 0; iIssue < 5; iIssue++) {
+			rgcIssues[iIssue] += (flags.issues & (1 << iIssue)) ? 1 : 0;
+		}
+
+		if (flags.issues != 0) {
+			libraries[flags.library].push_back(i);
+		}
+
+		sprintf_s(szVersion, "%u.%u.%u.%u", flags.verMajor, flags.verMinor, flags.verBuild, flags.verQfe);
+		compilers[szVersion]++;
+	}
+
+	wprintf(L"\n\n*** BUILD FLAGS\n\n");
+	wprintf(L"Compilands     : %u C and C++, %u with a command line\n", (DWORD)compilands.size(), cCommandLines);
+	wprintf(L"With issues    : %u\n", cIssues);
+	wprintf(L"  Not /O2      : %u\n", rgcIssues[0]);
+	wprintf(L"  No /GL       : %u\n", rgcIssues[1]);
+	wprintf(L"  Other /arch  : %u\n", rgcIssues[2]);
+	wprintf(L"  Debug CRT    : %u\n", rgcIssues[3]);
+	wprintf(L"  /RTC         : %u\n", rgcIssues[4]);
+	wprintf(L"Scan           : %.2f ms\n", (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart);
+
+	wprintf(L"\n** COMPILERS\n\n");
+
+	for (const auto & compiler : compilers) {
+		wprintf(L"%8u  %S\n", compiler.second, compiler.first.c_str());
+	}
+
+	// The libraries with the most compilands with issues first
+
+	std::vector<const std::pair<const std::string, std::vector<DWORD> > *> byCount;
+
+	for (const auto & library : libraries) {
+		byCount.push_back(&library);
+	}
+
+	std::stable_sort(byCount.begin(), byCount.end(),
+		[](const std::pair<const std::string, std::vector<DWORD> > * a, const std::pair<const std::string, std::vector<DWORD> > * b) {
+			return a->second.size() > b->second.size();
+		});
+
+	wprintf(L"\n** ISSUES BY LIBRARY (O not /O2, L no /GL, A other /arch, D debug CRT, R /RTC)\n");
+
+	for (const auto * pLibrary : byCount) {
+		wprintf(L"\n%S (%u)\n", pLibrary->first.empty() ? "(no directory)" : pLibrary->first.c_str(), (DWORD)pLibrary->second.size());
+
+		for (DWORD i : pLibrary->second) {
+			const BuildFlags & flags = compilands[i];
+
+			BuildIssueFlags(flags.issues, szIssues);
+			wprintf(L"  %S  /%-3S %-12S %S\n", szIssues, flags.optimization.empty() ? "-" : flags.optimization.c_str(),
+				flags.arch.empty() ? "default" : flags.arch.c_str(), modules[flags.iModule].name.c_str());
+		}
+	}
+
+	putwchar(L'\n');
+
+	if (szFilename == NULL) {
+		return true;
+	}
+
+	FILE * pFile;
+
+	if (_wfopen_s(&pFile, szFilename, L"w") || !pFile) {
+		wprintf(L"ERROR - DumpBuildFlags() could not create %s\n", szFilename);
+
+		return false;
+	}
+
+	bool fOk = fprintf(pFile, "library\tcompiland\tlanguage\tversion\toptimization\tarch\tltcg\tcrt\tissues\tcommand\n") > 0;
+
+	for (size_t i = 0; i < compilands.size() && fOk; i++) {
+		const BuildFlags & flags = compilands[i];
+
+		BuildIssueFlags(flags.issues, szIssues);
+
+		fOk = fprintf(pFile, "%s\t%s\t%s\t%u.%u.%u.%u\t%s\t%s\t%s\t%s\t%s\t%s\n", flags.library.c_str(),
+			modules[flags.iModule].name.c_str(), flags.language ? "C++" : "C", flags.verMajor, flags.verMinor, flags.verBuild,
+			flags.verQfe, flags.optimization.c_str(), flags.arch.c_str(), (flags.flags & BUILD_FLAG_LTCG) ? "GL" : "",
+			(flags.flags & BUILD_FLAG_DEBUG_CRT) ? "debug" : "", szIssues, flags.commandLine.c_str()) >= 0;
+	}
+
+	fOk = (fclose(pFile) == 0) && fOk;
+
+	if (!fOk) {
+		wprintf(L"ERROR - DumpBuildFlags() could not write %s\n", szFilename);
+	}
+
+	return fOk;
+}
+
+////////////////////////////////////////////////////////////
+// Write the heap allocation sites to a file for profilers
+//
+//  The file maps a return address to the allocated type, see
+//  HeapSites.h. The types with the most sites are printed.
+//
+bool DumpHeapSites(IDiaSymbol * pGlobal, const wchar_t * szFilename, DWORD dwRows)
+{
+	LARGE_INTEGER freq, t0, t1;
+	HeapSiteIndex sites;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	if (!LoadTypeStreams(pGlobal)) {
+		return false;
+	}
+
+	unsigned cThreads = std::thread::hardware_concurrency();
+
+	if (!sites.Build(g_pdb, g_tpi, (cThreads != 0) ? cThreads : 1)) {
+		wprintf(L"ERROR - DumpHeapSites() no heap allocation sites\n");
+
+		return false;
+	}
+
+	QueryPerformanceCounter(&t1);
+
+	if (!sites.Save(szFilename)) {
+		wprintf(L"ERROR - DumpHeapSites() could not write %s\n", szFilename);
+
+		return false;
+	}
+
+	SizeTable byType;
+
+	for (const HeapSiteRecord & site : sites.Sites()) {
+		byType.Add(sites.Name(site), site.cb);
+	}
+
+	wprintf(L"%u heap allocation sites of %u types written to %s, %.2f ms\n", (DWORD)sites.Sites().size(),
+		(DWORD)byType.Count(), szFilename, (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart);
+
+	if (dwRows == 0) {
+		dwRows = SIZE_REPORT_ROWS;
+	}
+
+	std::vector<const SizeRow *> rows;
+
+	byType.Sorted(rows);
+
+	std::stable_sort(rows.begin(), rows.end(), [](const SizeRow * a, const SizeRow * b) { return a->count > b->count; });
+
+	wprintf(L"\n** TYPES BY SITES\n\n");
+	wprintf(L"   Sites       Size  Type\n");
+
+	for (size_t i = 0; i < rows.size() && i < dwRows; i++) {
+		wprintf(L"%8llu %10llu  %S\n", rows[i]->count, (rows[i]->count != 0) ? rows[i]->cb / rows[i]->count : 0, rows[i]->key.c_str());
+	}
+
+	putwchar(L'\n');
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump label symbol information at a given RVA
+//
+bool DumpLabel(IDiaSession * pSession, DWORD dwRVA)
+{
+	IDiaSymbol * pSymbol;
+	LONG lDisplacement;
+
+	if (FAILED(pSession->findSymbolByRVAEx(dwRVA, SymTagLabel, &pSymbol, &lDisplacement)) || (pSymbol == NULL)) {
+		return false;
+	}
+
+	wprintf(L"Displacement = 0x%X\n", lDisplacement);
+
+	PrintGeneric(pSymbol);
+
+	pSymbol->Release();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Dump annotation symbol information at a given RVA
+//
+bool DumpAnnotations(IDiaSession * pSession, DWORD dwRVA)
+{
+	IDiaSymbol * pSymbol;
+	LONG lDisplacement;
+
+	if (FAILED(pSession->findSymbolByRVAEx(dwRVA, SymTagAnnotation, &pSymbol, &lDisplacement)) || (pSymbol == NULL)) {
+		return false;
+	}
+
+	wprintf(L"Displacement = 0x%X\n", lDisplacement);
+
+	PrintGeneric(pSymbol);
+
+	pSymbol->Release();
+
+	return true;
+}
+
+struct OMAP_DATA
+{
+	DWORD dwRVA;
+	DWORD dwRVATo;
+};
+
+////////////////////////////////////////////////////////////
+//
+bool DumpMapToSrc(IDiaSession * pSession, DWORD dwRVA)
+{
+	IDiaEnumDebugStreams * pEnumStreams;
+	IDiaEnumDebugStreamData * pStream;
+	ULONG celt;
+
+	if (FAILED(pSession->getEnumDebugStreams(&pEnumStreams))) {
+		return false;
+	}
+
+	celt = 0;
+
+	for (; SUCCEEDED(pEnumStreams->Next(1, &pStream, &celt)) && (celt == 1); pStream = NULL) {
+		BSTR bstrName;
+
+		if (pStream->get_name(&bstrName) != S_OK) {
+			bstrName = NULL;
+		}
+
+		if (bstrName && wcscmp(bstrName, L"OMAPTO") == 0) {
+			OMAP_DATA data, datasav;
+			DWORD cbData;
+			DWORD dwRVATo = 0;
+			unsigned int i;
+
+			datasav.dwRVATo = 0;
+			datasav.dwRVA = 0;
+
+			while (SUCCEEDED(pStream->Next(1, sizeof(data), &cbData, (BYTE *)&data, &celt)) && (celt == 1)) {
+				if (dwRVA > data.dwRVA) {
+					datasav = data;
+					continue;
+				}
+
+				else if (dwRVA == data.dwRVA) {
+					dwRVATo = data.dwRVATo;
+				}
+
+				else if (datasav.dwRVATo) {
+					dwRVATo = datasav.dwRVATo + (dwRVA - datasav.dwRVA);
+				}
+				break;
+			}
+
+			wprintf(L"image rva = %08X ==> source rva = %08X\n\nRelated OMAP entries:\n", dwRVA, dwRVATo);
+			wprintf(L"image rva ==> source rva\n");
+			wprintf(L"%08X  ==> %08X\n", datasav.dwRVA, datasav.dwRVATo);
+
+			i = 0;
+
+			do {
+				wprintf(L"%08X  ==> %08X\n", data.dwRVA, data.dwRVATo);
+			} while ((++i) < 5 && SUCCEEDED(pStream->Next(1, sizeof(data), &cbData, (BYTE *)&data, &celt)) && (celt == 1));
+		}
+
+		if (bstrName != NULL) {
+			SysFreeString(bstrName);
+		}
+
+		pStream->Release();
+	}
+
+	pEnumStreams->Release();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+//
+bool DumpMapFromSrc(IDiaSession * pSession, DWORD dwRVA)
+{
+	IDiaEnumDebugStreams * pEnumStreams;
+
+	if (FAILED(pSession->getEnumDebugStreams(&pEnumStreams))) {
+		return false;
+	}
+
+	IDiaEnumDebugStreamData * pStream;
+	ULONG celt = 0;
+
+	for (; SUCCEEDED(pEnumStreams->Next(1, &pStream, &celt)) && (celt == 1); pStream = NULL) {
+		BSTR bstrName;
+
+		if (pStream->get_name(&bstrName) != S_OK) {
+			bstrName = NULL;
+		}
+
+		if (bstrName && wcscmp(bstrName, L"OMAPFROM") == 0) {
+			OMAP_DATA data;
+			OMAP_DATA datasav;
+			DWORD cbData;
+			DWORD dwRVATo = 0;
+			unsigned int i;
+
+			datasav.dwRVATo = 0;
+			datasav.dwRVA = 0;
+
+			while (SUCCEEDED(pStream->Next(1, sizeof(data), &cbData, (BYTE *)&data, &celt)) && (celt == 1)) {
+				if (dwRVA > data.dwRVA) {
+					datasav = data;
+					continue;
+				}
+
+				else if (dwRVA == data.dwRVA) {
+					dwRVATo = data.dwRVATo;
+				}
+
+				else if (datasav.dwRVATo) {
+					dwRVATo = datasav.dwRVATo + (dwRVA - datasav.dwRVA);
+				}
+				break;
+			}
+
+			wprintf(L"source rva = %08X ==> image rva = %08X\n\nRelated OMAP entries:\n", dwRVA, dwRVATo);
+			wprintf(L"source rva ==> image rva\n");
+			wprintf(L"%08X  ==> %08X\n", datasav.dwRVA, datasav.dwRVATo);
+
+			i = 0;
+
+			do {
+				wprintf(L"%08X  ==> %08X\n", data.dwRVA, data.dwRVATo);
+			} while ((++i) < 5 && SUCCEEDED(pStream->Next(1, sizeof(data), &cbData, (BYTE *)&data, &celt)) && (celt == 1));
+		}
+
+		if (bstrName != NULL) {
+			SysFreeString(bstrName);
+		}
+
+		pStream->Release();
+	}
+
+	pEnumStreams->Release();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Retreive the table that matches the given iid
+//
+//  A PDB table could store the section contributions, the frame data,
+//  the injected sources
+//
+HRESULT GetTable(IDiaSession * pSession, REFIID iid, void ** ppUnk)
+{
+	IDiaEnumTables * pEnumTables;
+
+	if (FAILED(pSession->getEnumTables(&pEnumTables))) {
+		wprintf(L"ERROR - GetTable() getEnumTables\n");
+
+		return E_FAIL;
+	}
+
+	IDiaTable * pTable;
+	ULONG celt = 0;
+
+	while (SUCCEEDED(pEnumTables->Next(1, &pTable, &celt)) && (celt == 1)) {
+	  // There's only one table that matches the given IID
+
+		if (SUCCEEDED(pTable->QueryInterface(iid, (void **)ppUnk))) {
+			pTable->Release();
+			pEnumTables->Release();
+
+			return S_OK;
+		}
+
+		pTable->Release();
+	}
+
+	pEnumTables->Release();
+
+	return E_FAIL;
+}
+
+//PDBTypeMatch code
+//from https://github.com/dotnet/coreclr/tree/release/1.1.0/src/ToolBox/PdbTypeMatch
+
+
+
+
+#define DEBUG_VERBOSE 0
+
+#pragma warning (disable : 4100)
+
+const wchar_t * g_szFilename1, * g_szFilename2;
+IDiaDataSource * g_pDiaDataSource1, * g_pDiaDataSource2;
+IDiaSession * g_pDiaSession1, * g_pDiaSession2;
+IDiaSymbol * g_pGlobalSymbol1, * g_pGlobalSymbol2;
+
+typedef std::set<std::wstring> IDiaSymbolSet;
+TypeFilter g_typeFilter;
+
+bool InitDiaSource(IDiaDataSource ** ppSource);
+void Cleanup2();
+LPSTR UnicodeToAnsi(LPCWSTR s);
+bool EnumTypesInPdb(IDiaSymbolSet * types, IDiaSession * pSession, IDiaSymbol * pGlobal);
+bool LayoutMatches(IDiaSymbol * pSymbol1, IDiaSymbol * pSymbol2);
+bool LoadExcludedTypes(const wchar_t * szFilename);
+bool IsTypeExcluded(const std::wstring & typeName);
+bool WriteTypeBaseline(IDiaSymbol * pGlobal, const wchar_t * szBaseline);
+bool CheckTypeBaseline(IDiaSymbol * pGlobal, const wchar_t * szBaseline);
+void PrintHelpOptions2();
+
+////////////////////////////////////////////////////////////
+//
+int __cdecl wmain2(int argc, wchar_t * argv[])
+{
+	FILE * pFile;
+
+	if (argc < 3) {
+		PrintHelpOptions2();
+		return -1;
+	}
+
+	if (!_wcsicmp(argv[1], L"-ptype")) {
+
+	  // -type <symbolname> <pdbfilename>: dump this type in detail
+
+		if (argc < 4) {
+			PrintHelpOptions2();
+			return -1;
+		}
+
+		if ((argc > 1) && (*argv[2] != L'-')) {
+
+			if (_wfopen_s(&pFile, argv[3], L"r") || !pFile) {
+			// invalid file name or file does not exist
+
+				PrintHelpOptions2();
+				return -1;
+			}
+			fclose(pFile);
+			// CoCreate() and initialize COM objects
+			if (!InitDiaSource(&g_pDiaDataSource1)) {
+				return -1;
+			}
+			if (!LoadDataFromPdb(argv[3], &g_pDiaDataSource1, &g_pDiaSession1, &g_pGlobalSymbol1)) {
+				return -1;
+			}
+
+			DumpType(g_pGlobalSymbol1, argv[2]);
+
+			// release COM objects and CoUninitialize()
+			Cleanup2();
+
+			return 0;
+		}
+	}
+
+	if (!_wcsicmp(argv[1], L"-typebaseline") || !_wcsicmp(argv[1], L"-typecheck")) {
+
+	  // -typebaseline <baseline> <pdb>: save the UDT layouts of the pdb
+	  // -typecheck <baseline> <pdb> [exclusions]: compare the pdb against a saved baseline
+
+		if (argc < 4) {
+			PrintHelpOptions2();
+			return -1;
+		}
+
+		if (argc > 4 && !LoadExcludedTypes(argv[4])) {
+			return -1;
+		}
+
+		g_szFilename1 = argv[2];
+		g_szFilename2 = argv[3];
+
+		if (!InitDiaSource(&g_pDiaDataSource2)) {
+			return -1;
+		}
+		if (!LoadDataFromPdb(g_szFilename2, &g_pDiaDataSource2, &g_pDiaSession2, &g_pGlobalSymbol2)) {
+			return -1;
+		}
+
+		bool fOk = !_wcsicmp(argv[1], L"-typebaseline") ?
+			WriteTypeBaseline(g_pGlobalSymbol2, g_szFilename1) : CheckTypeBaseline(g_pGlobalSymbol2, g_szFilename1);
+
+		// release COM objects and CoUninitialize()
+		Cleanup2();
+
+		return fOk ? 0 : -1;
+	}
+
+	if (argc < 3) {
+		PrintHelpOptions2();
+		return -1;
+	}
+
+	if (_wfopen_s(&pFile, argv[1], L"r") || !pFile) {
+	  // invalid file name or file does not exist
+
+		PrintHelpOptions2();
+		return -1;
+	}
+
+	fclose(pFile);
+
+	if (_wfopen_s(&pFile, argv[2], L"r") || !pFile) {
+	  // invalid file name or file does not exist
+
+		PrintHelpOptions2();
+		return -1;
+	}
+
+	fclose(pFile);
+
+	g_szFilename1 = argv[1];
+
+	// CoCreate() and initialize COM objects
+	if (!InitDiaSource(&g_pDiaDataSource1)) {
+		return -1;
+	}
+	if (!LoadDataFromPdb(g_szFilename1, &g_pDiaDataSource1, &g_pDiaSession1, &g_pGlobalSymbol1)) {
+		return -1;
+	}
+
+	g_szFilename2 = argv[2];
+
+	InitDiaSource(&g_pDiaDataSource2);
+	if (!LoadDataFromPdb(g_szFilename2, &g_pDiaDataSource2, &g_pDiaSession2, &g_pGlobalSymbol2)) {
+		return -1;
+	}
+
+	if (argv[3] && !LoadExcludedTypes(argv[3])) {
+		return -1;
+	}
+
+	IDiaSymbolSet types1;
+	IDiaSymbolSet types2;
+	if (!EnumTypesInPdb(&types1, g_pDiaSession1, g_pGlobalSymbol1)) {
+		return -1;
+	}
+
+	if (!EnumTypesInPdb(&types2, g_pDiaSession2, g_pGlobalSymbol2)) {
+		return -1;
+	}
+
+	IDiaSymbolSet commonTypes;
+
+	// Filter the excluded types on all the cores, then intersect
+	std::vector<std::string> utf8Names;
+	std::vector<uint8_t> excluded;
+	unsigned cThreads = std::thread::hardware_concurrency();
+
+	utf8Names.reserve(types1.size());
+
+	for (IDiaSymbolSet::iterator i = types1.begin(); i != types1.end(); i++) {
+		utf8Names.push_back(std::string());
+		ToUtf8(i->c_str(), utf8Names.back());
+	}
+
+	g_typeFilter.Filter(utf8Names, (cThreads != 0) ? cThreads : 1, excluded);
+
+	size_t iType = 0;
+
+	for (IDiaSymbolSet::iterator i = types1.begin(); i != types1.end(); i++, iType++) {
+		std::wstring typeName = *i;
+
+		/// Skip excluded types
+		if (excluded[iType]) {
+			continue;
+		}
+
+		if (types2.find(typeName) != types2.end()) {
+			commonTypes.insert(typeName);
+		}
+	}
+
+	bool matchedSymbols = true;
+	ULONG failuresNb = 0;
+
+
+	// Compare layout for common types
+	for (IDiaSymbolSet::iterator i = commonTypes.begin(); i != commonTypes.end(); i++) {
+		std::wstring typeName = *i;
+
+		IDiaEnumSymbols * pEnumSymbols1;
+		BSTR pwstrTypeName = SysAllocString(typeName.c_str());
+		if (FAILED(g_pGlobalSymbol1->findChildren(SymTagUDT, pwstrTypeName, nsNone, &pEnumSymbols1))) {
+			SysFreeString(pwstrTypeName);
+			return false;
+		}
+
+		IDiaEnumSymbols * pEnumSymbols2;
+		if (FAILED(g_pGlobalSymbol2->findChildren(SymTagUDT, pwstrTypeName, nsNone, &pEnumSymbols2))) {
+			SysFreeString(pwstrTypeName);
+			return false;
+		}
+
+		IDiaSymbol * pSymbol1;
+		IDiaSymbol * pSymbol2;
+		ULONG celt = 0;
+
+
+		while (SUCCEEDED(pEnumSymbols1->Next(1, &pSymbol1, &celt)) && (celt == 1)) {
+			if (SUCCEEDED(pEnumSymbols2->Next(1, &pSymbol2, &celt)) && (celt == 1)) {
+
+				BSTR bstrSymbol1Name;
+				if (pSymbol1->get_name(&bstrSymbol1Name) != S_OK) {
+					bstrSymbol1Name = NULL;
+					pSymbol2->Release();
+					continue;
+				}
+				BSTR bstrSymbol2Name;
+				if (pSymbol2->get_name(&bstrSymbol2Name) != S_OK) {
+					bstrSymbol2Name = NULL;
+					pSymbol2->Release();
+					continue;
+				}
+				if (_wcsicmp(bstrSymbol1Name, bstrSymbol2Name) != 0) {
+					pSymbol2->Release();
+					continue;
+				}
+				ULONGLONG sym1Size;
+				ULONGLONG sym2Size;
+				if (pSymbol1->get_length(&sym1Size) != S_OK) {
+					wprintf(L"ERROR - can't retrieve the symbol's length\n");
+					pSymbol2->Release();
+					continue;
+				}
+				//wprintf(L"sym1Size = %x\n", sym1Size);
+				if (pSymbol2->get_length(&sym2Size) != S_OK) {
+					wprintf(L"ERROR - can't retrieve the symbol's length\n");
+					pSymbol2->Release();
+					continue;
+				}
+				//wprintf(L"sym2Size = %x\n", sym2Size);
+				if (sym1Size == 0 || sym2Size == 2) {
+					pSymbol2->Release();
+					continue;
+				}
+
+				if (!LayoutMatches(pSymbol1, pSymbol2)) {
+					wprintf(L"Type \"%s\" is not matching in %s and %s\n", pwstrTypeName, g_szFilename1, g_szFilename2);
+					pSymbol2->Release();
+
+					matchedSymbols = false;
+					failuresNb++;
+					// Continue to compare and report all inconsistencies.
+					continue;
+				} else {
+#if	DEBUG_VERBOSE
+					wprintf(L"Matched type: %s\n", pwstrTypeName);
+#endif
+				}
+
+				pSymbol2->Release();
+			}
+
+			pSymbol1->Release();
+		}
+
+		SysFreeString(pwstrTypeName);
+		pEnumSymbols1->Release();
+		pEnumSymbols2->Release();
+	}
+
+	// release COM objects and CoUninitialize()
+	Cleanup2();
+
+	if (matchedSymbols) {
+		wprintf(L"OK: All %d common types of %s and %s match!\n", commonTypes.size(), g_szFilename1, g_szFilename2);
+		return 0;
+	} else {
+		wprintf(L"FAIL: Failed to match %d common types of %s and %s!\n", failuresNb, g_szFilename1, g_szFilename2);
+		wprintf(L"Matched %d common types!\n", commonTypes.size() - failuresNb);
+		return -1;
+	}
+}
+
+LPSTR UnicodeToAnsi(LPCWSTR s)
+{
+	if (s == NULL) return NULL;
+	int cw = lstrlenW(s);
+	if (cw == 0) {
+		CHAR * psz = new CHAR[1]; *psz = '\0'; return psz;
+	}
+	int cc = WideCharToMultiByte(CP_ACP, 0, s, cw, NULL, 0, NULL, NULL);
+	if (cc == 0) return NULL;
+	CHAR * psz = new CHAR[cc + 1];
+	cc = WideCharToMultiByte(CP_ACP, 0, s, cw, psz, cc, NULL, NULL);
+	if (cc == 0) { delete[] psz; return NULL; }
+	psz[cc] = '\0';
+	return psz;
+}
+
 
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pFunction, &celt)) && (celt == 1)) {
-		PrintLines(pSession, pFunction);
+bool InitDiaSource(IDiaDataSource ** ppSource)
+{
+	HRESULT hr = CoInitialize(NULL);
 
-		pFunction->Release();
+	// Obtain access to the provider
+
+	hr = CoCreateInstance(__uuidof(DiaSource),
+						NULL,
+						CLSCTX_INPROC_SERVER,
+						__uuidof(IDiaDataSource),
+						(void **)ppSource);
+
+	if (FAILED(hr)) {
+		ACTCTX actCtx;
+		memset((void *)&actCtx, 0, sizeof(ACTCTX));
+		actCtx.cbSize = sizeof(ACTCTX);
+		WCHAR   dllPath[MAX_PATH * 2];
+		GetModuleFileName(NULL, dllPath, _countof(dllPath));
+		PathRemoveFileSpec(dllPath);
+		wcscat_s(dllPath, L"\\msdia100.sxs.manifest");
+		actCtx.lpSource = dllPath;
+
+		HANDLE hCtx = ::CreateActCtx(&actCtx);
+		if (hCtx == INVALID_HANDLE_VALUE)
+			wprintf(L"CreateActCtx returned: INVALID_HANDLE_VALUE\n");
+		else {
+			ULONG_PTR cookie;
+			if (::ActivateActCtx(hCtx, &cookie)) {
+				hr = CoCreateInstance(__uuidof(DiaSource),
+						   NULL,
+						   CLSCTX_INPROC_SERVER,
+						   __uuidof(IDiaDataSource),
+						   (void **)ppSource);
+				::DeactivateActCtx(0, cookie);
+				if (FAILED(hr)) {
+					wprintf(L"CoCreateInstance failed - HRESULT = %08X\n", hr);
+					return false;
+				}
+			}
+		}
 	}
+	if (FAILED(hr)) {
+		wprintf(L"CoCreateInstance failed - HRESULT = %08X\n", hr);
 
-	pEnumSymbols->Release();
+		return false;
+	}
 
 	return true;
 }
-
-////////////////////////////////////////////////////////////
-// Dump the symbol information corresponding to a specified RVA
-//
-bool DumpSymbolWithRVA(IDiaSession * pSession, DWORD dwRVA, const wchar_t * szChildname)
+bool LayoutMatches(IDiaSymbol * pSymbol1, IDiaSymbol * pSymbol2)
 {
-	IDiaSymbol * pSymbol;
-	LONG lDisplacement;
+	DWORD dwTag1, dwTag2;
+	DWORD dwLocType1, dwLocType2;
+	LONG lOffset1, lOffset2;
+	DWORD lType1, lType2;
 
-	if (FAILED(pSession->findSymbolByRVAEx(dwRVA, SymTagNull, &pSymbol, &lDisplacement))) {
+	if (pSymbol1->get_symTag(&dwTag1) != S_OK) {
+		wprintf(L"ERROR - can't retrieve the symbol's SymTag\n");
+		return false;
+	}
+	if (pSymbol2->get_symTag(&dwTag2) != S_OK) {
+		wprintf(L"ERROR - can't retrieve the symbol's SymTag\n");
 		return false;
 	}
 
-	wprintf(L"Displacement = 0x%X\n", lDisplacement);
+	if (dwTag1 == SymTagUDT) {
+		if (dwTag2 != SymTagUDT) {
 
-	PrintGeneric(pSymbol);
+			// The symbols come from two sessions, their ids overlap
 
-	DumpSymbolWithChildren(pSymbol, szChildname);
+			wprintf(L"ERROR - symbols don't match\n");
+			wprintf(L"Symbol 1:\n");
+			ClearTypeNames();
+			PrintTypeInDetail(pSymbol1, 0);
+			wprintf(L"Symbol 2:\n");
+			ClearTypeNames();
+			PrintTypeInDetail(pSymbol2, 0);
+			return false;
+		}
 
-	while (pSymbol != NULL) {
-		IDiaSymbol * pParent;
+		// First check that types size match
+		ULONGLONG sym1Size;
+		ULONGLONG sym2Size;
+		if (pSymbol1->get_length(&sym1Size) != S_OK) {
+			wprintf(L"ERROR - can't retrieve the symbol's length\n");
+			return false;
+		}
+		if (pSymbol2->get_length(&sym2Size) != S_OK) {
+			wprintf(L"ERROR - can't retrieve the symbol's length\n");
+			return false;
+		}
+		if (sym1Size == 0 || sym2Size == 0) {
+			return true;
+		}
+		if (sym1Size != sym2Size) {
+			wprintf(L"Failed to match type size: (sizeof(sym1)=%llu) != (sizeof(sym2)=%llu)\n", sym1Size, sym2Size);
+			return false;
+		}
+		IDiaEnumSymbols * pEnumChildren1, * pEnumChildren2;
+		IDiaSymbol * pChild1, * pChild2;
+		ULONG celt = 0;
+		BSTR bstrName1, bstrName2;
+		IDiaSymbol * pBaseType1, * pBaseType2;
 
-		if ((pSymbol->get_lexicalParent(&pParent) == S_OK) && pParent) {
-			wprintf(L"\nParent\n");
+		if (SUCCEEDED(pSymbol1->findChildren(SymTagNull, NULL, nsNone, &pEnumChildren1))) {
+			while (SUCCEEDED(pEnumChildren1->Next(1, &pChild1, &celt)) && (celt == 1)) {
+				if (pChild1->get_symTag(&dwTag1) != S_OK) {
+					wprintf(L"ERROR - can't retrieve the symbol's SymTag\n");
+					pChild1->Release();
+					return false;
+				}
+				if (dwTag1 != SymTagData) { pChild1->Release(); continue; }
+				if (pChild1->get_locationType(&dwLocType1) != S_OK) {
+					wprintf(L"symbol in optmized code");
+					pChild1->Release();
+					return false;
+				}
+				if (dwLocType1 != LocIsThisRel) { pChild1->Release(); continue; }
+				if (pChild1->get_offset(&lOffset1) != S_OK) {
+					wprintf(L"ERROR - geting field offset\n");
+					pChild1->Release();
+					return false;
+				}
+				if (pChild1->get_type(&pBaseType1) != S_OK || pBaseType1->get_baseType(&lType1) != S_OK) {
+					//wprintf(L"ERROR - geting field type\n");
+					//pChild1->Release();
+					//return false;
+				}
 
-			PrintSymbol(pParent, 0);
+				if (pChild1->get_name(&bstrName1) != S_OK) {
+					bstrName1 = NULL;
+				}
+				/// Search in the second symbol the field at lOffset1
+				bool fieldMatched = false;
+				if (SUCCEEDED(pSymbol2->findChildren(SymTagNull, NULL, nsNone, &pEnumChildren2))) {
+					while (SUCCEEDED(pEnumChildren2->Next(1, &pChild2, &celt)) && (celt == 1)) {
+						if (pChild2->get_symTag(&dwTag2) != S_OK) {
+							wprintf(L"ERROR - can't retrieve the symbol's SymTag\n");
+							pChild2->Release();
+							return false;
+						}
+						if (dwTag2 != SymTagData) { pChild2->Release(); continue; }
+						if (pChild2->get_locationType(&dwLocType2) != S_OK) {
+							wprintf(L"symbol in optmized code");
+							pChild2->Release();
+							return false;
+						}
+						if (dwLocType2 != LocIsThisRel) { pChild2->Release(); continue; }
+						if (pChild2->get_offset(&lOffset2) != S_OK) {
+							wprintf(L"ERROR - geting field offset\n");
+							pChild2->Release();
+							return false;
+						}
 
-			pSymbol->Release();
+						if (pChild2->get_type(&pBaseType2) != S_OK || pBaseType2->get_baseType(&lType2) != S_OK) {
+							//wprintf(L"ERROR - geting field type\n");
+							//pChild2->Release();
+							//return false;
+						}
 
-			pSymbol = pParent;
-		}
+						// my addition
+						if (lType1 != lType2) {
+							wprintf(L"Failed to match type of field %s at offset %x\n", bstrName1, lOffset1);
+							pChild1->Release();
+							pChild2->Release();
+							return false;
+						}
 
-		else {
-			pSymbol->Release();
-			break;
+
+						if (pChild2->get_name(&bstrName2) != S_OK) {
+							bstrName2 = NULL;
+						}
+						if (lOffset2 == lOffset1) {
+							if (_wcsicmp(bstrName1, bstrName2) == 0
+							|| wcsstr(bstrName1, bstrName2) == bstrName1
+							|| wcsstr(bstrName2, bstrName1) == bstrName2) {
+								//wprintf(L"Matched field %s at offset %x\n", bstrName1, lOffset2);
+								fieldMatched = true;
+								pChild2->Release();
+								break;
+							}
+						}
+						pChild2->Release();
+					}
+					pEnumChildren2->Release();
+				}
+				if (!fieldMatched) {
+					BSTR bstrSymbol1Name;
+					if (pSymbol1->get_name(&bstrSymbol1Name) != S_OK) {
+						bstrSymbol1Name = NULL;
+					}
+					wprintf(L"Failed to match %s field %s at offset %x\n", bstrSymbol1Name, bstrName1, lOffset1);
+					pChild1->Release();
+					return false;
+				}
+				pChild1->Release();
+			}
+
+			pEnumChildren1->Release();
 		}
 	}
 
@@ -2240,1103 +6349,1140 @@ bool DumpSymbolWithRVA(IDiaSession * pSession, DWORD dwRVA, const wchar_t * szCh
 }
 
 ////////////////////////////////////////////////////////////
-// Dump the symbols information where their names matches a
-//  specified regular expression string
+// Release DIA objects and CoUninitialize
 //
-bool DumpSymbolsWithRegEx(IDiaSymbol * pGlobal, const wchar_t * szRegEx, const wchar_t * szChildname)
+void Cleanup2()
+{
+	if (g_pGlobalSymbol1) {
+		g_pGlobalSymbol1->Release();
+		g_pGlobalSymbol1 = NULL;
+	}
+
+	if (g_pGlobalSymbol2) {
+		g_pGlobalSymbol2->Release();
+		g_pGlobalSymbol2 = NULL;
+	}
+
+	if (g_pDiaSession1) {
+		g_pDiaSession1->Release();
+		g_pDiaSession1 = NULL;
+	}
+
+	if (g_pDiaSession2) {
+		g_pDiaSession2->Release();
+		g_pDiaSession2 = NULL;
+	}
+
+	CoUninitialize();
+}
+
+
+////////////////////////////////////////////////////////////
+// Display the usage
+//
+void PrintHelpOptions2()
+{
+	static const wchar_t * const helpString = L"usage: PdbTypeMatch.exe <pdb_filename_1> <pdb_filename_2> <type_exclusion_list_file> : compare all common types by size and fields\n"
+		L"       PdbTypeMatch.exe -type <symbolname>  <pdb_filename_1>: dump this type in detail\n"
+		L"       PdbTypeMatch.exe -typebaseline <baseline_file> <pdb_filename>: save the layouts of all types\n"
+		L"       PdbTypeMatch.exe -typecheck <baseline_file> <pdb_filename> [type_exclusion_list_file] : compare all types against a saved baseline\n";
+
+	wprintf(helpString);
+}
+
+bool EnumTypesInPdb(IDiaSymbolSet * types, IDiaSession * pSession, IDiaSymbol * pGlobal)
 {
 	IDiaEnumSymbols * pEnumSymbols;
 
-	if (FAILED(pGlobal->findChildren(SymTagNull, szRegEx, nsRegularExpression, &pEnumSymbols))) {
+	if (FAILED(pGlobal->findChildren(SymTagUDT, NULL, nsNone, &pEnumSymbols))) {
+		wprintf(L"ERROR - EnumTypesInPdb() returned no symbols\n");
+
 		return false;
 	}
 
-	bool bReturn = true;
-
 	IDiaSymbol * pSymbol;
 	ULONG celt = 0;
 
 	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-		PrintGeneric(pSymbol);
-
-		bReturn = DumpSymbolWithChildren(pSymbol, szChildname);
-
+		std::wstring typeName;
+		GetSymbolName(typeName, pSymbol);
+		types->insert(std::wstring(typeName));
 		pSymbol->Release();
 	}
 
 	pEnumSymbols->Release();
 
-	return bReturn;
+	return true;
 }
 
 ////////////////////////////////////////////////////////////
-// Dump the information corresponding to a symbol name which
-//  is a children of the specified parent symbol
+// Read the type exclusion list, one type per line, "*str"
+//  excludes every type whose name contains str
 //
-bool DumpSymbolWithChildren(IDiaSymbol * pSymbol, const wchar_t * szChildname)
+bool LoadExcludedTypes(const wchar_t * szFilename)
 {
-	if (szChildname != NULL) {
-		IDiaEnumSymbols * pEnumSyms;
-
-		if (FAILED(pSymbol->findChildren(SymTagNull, szChildname, nsRegularExpression, &pEnumSyms))) {
-			return false;
-		}
-
-		IDiaSymbol * pChild;
-		DWORD celt = 1;
-
-		while (SUCCEEDED(pEnumSyms->Next(celt, &pChild, &celt)) && (celt == 1)) {
-			PrintGeneric(pChild);
-			PrintSymbol(pChild, 0);
-
-			pChild->Release();
-		}
-
-		pEnumSyms->Release();
+	struct stat fileStatus;
+	if (stat(UnicodeToAnsi(szFilename), &fileStatus) != 0) {
+		wprintf(L"Could not open type_exclusion_list file!\n");
+		return false;
 	}
 
-	else {
-	  // If the specified name is NULL then only the parent symbol data is displayed
-
-		DWORD dwSymTag;
-
-		if ((pSymbol->get_symTag(&dwSymTag) == S_OK) && (dwSymTag == SymTagPublicSymbol)) {
-			PrintPublicSymbol(pSymbol);
+	char linec[2048];
+	FILE * file;
+	fopen_s(&file, UnicodeToAnsi(szFilename), "r");
+	while (fgets(linec, sizeof(linec), file) != NULL) {
+		std::string line(linec);
+		line.erase(std::remove_if(line.begin(), line.end(), isspace), line.end());
+		if (line.empty() || line.length() <= 1) {
+			continue;
 		}
-
-		else {
-			PrintSymbol(pSymbol, 0);
+		if (line.front() == '#') continue;
+		int len;
+		int slength = (int)line.length() + 1;
+		len = MultiByteToWideChar(CP_ACP, 0, line.c_str(), slength, 0, 0);
+		wchar_t * buf = new wchar_t[len];
+		MultiByteToWideChar(CP_ACP, 0, line.c_str(), slength, buf, len);
+		std::string utf8Line;
+		ToUtf8(buf, utf8Line);
+		delete[] buf;
+
+		/// Add *str in the patterns list.
+		if (line.front() == '*') {
+			g_typeFilter.AddPattern(utf8Line.substr(1));
+		} else {
+			g_typeFilter.AddName(utf8Line);
 		}
 	}
+	fclose(file);
+
+	g_typeFilter.Build();
 
 	return true;
 }
 
-////////////////////////////////////////////////////////////
-// Dump all the type symbols information that matches their
-//  names to a specified regular expression string
-//
-bool DumpType(IDiaSymbol * pGlobal, const wchar_t * szRegEx)
+bool IsTypeExcluded(const std::wstring & typeName)
 {
-	IDiaEnumSymbols * pEnumSymbols;
+	std::string name;
 
-	if (FAILED(pGlobal->findChildren(SymTagUDT, szRegEx, nsRegularExpression, &pEnumSymbols))) {
+	if (g_typeFilter.Empty()) {
 		return false;
 	}
 
-	IDiaSymbol * pSymbol;
-	ULONG celt = 0;
-
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-		PrintTypeInDetail(pSymbol, 0);
-
-		pSymbol->Release();
-	}
-
-	pEnumSymbols->Release();
+	ToUtf8(typeName.c_str(), name);
 
-	return true;
+	return g_typeFilter.IsExcluded(name);
 }
 
 ////////////////////////////////////////////////////////////
-// Dump line numbering information for a given file name and
-//  an optional line number
+// The canonical layout of a UDT: its size and the this relative
+//  fields LayoutMatches() compares
 //
-bool DumpLinesForSourceFile(IDiaSession * pSession, const wchar_t * szFileName, DWORD dwLine)
+static bool GetTypeLayout(IDiaSymbol * pSymbol, const std::wstring & typeName, TypeLayout & layout)
 {
-	IDiaEnumSourceFiles * pEnumSrcFiles;
+	ULONGLONG ulLen;
 
-	if (FAILED(pSession->findFile(NULL, szFileName, nsFNameExt, &pEnumSrcFiles))) {
+	if (pSymbol->get_length(&ulLen) != S_OK) {
+		wprintf(L"ERROR - can't retrieve the symbol's length\n");
 		return false;
 	}
 
-	IDiaSourceFile * pSrcFile;
-	ULONG celt = 0;
-
-	while (SUCCEEDED(pEnumSrcFiles->Next(1, &pSrcFile, &celt)) && (celt == 1)) {
-		IDiaEnumSymbols * pEnumCompilands;
-
-		if (pSrcFile->get_compilands(&pEnumCompilands) == S_OK) {
-			IDiaSymbol * pCompiland;
-
-			celt = 0;
-			while (SUCCEEDED(pEnumCompilands->Next(1, &pCompiland, &celt)) && (celt == 1)) {
-				BSTR bstrName;
-
-				if (pCompiland->get_name(&bstrName) == S_OK) {
-					wprintf(L"//Compiland = %s\n", bstrName);
+	ToUtf8(typeName.c_str(), layout.name);
+	layout.cb = ulLen;
+	layout.fields.clear();
 
-					SysFreeString(bstrName);
-				}
+	IDiaEnumSymbols * pEnumChildren;
 
-				else {
-					wprintf(L"//Compiland = (???)\n");
-				}
+	if (SUCCEEDED(pSymbol->findChildren(SymTagData, NULL, nsNone, &pEnumChildren))) {
+		IDiaSymbol * pChild;
+		ULONG celt = 0;
 
-				IDiaEnumLineNumbers * pLines;
+		while (SUCCEEDED(pEnumChildren->Next(1, &pChild, &celt)) && (celt == 1)) {
+			DWORD dwLocType;
+			LONG lOffset;
 
-				if (dwLine != 0) {
-					if (SUCCEEDED(pSession->findLinesByLinenum(pCompiland, pSrcFile, dwLine, 0, &pLines))) {
-						PrintLines(pLines, szFileName);
+			if (pChild->get_locationType(&dwLocType) == S_OK && dwLocType == LocIsThisRel && pChild->get_offset(&lOffset) == S_OK) {
+				TypeField field;
+				IDiaSymbol * pType;
+				DWORD dwBaseType = 0;
+				BSTR bstrName;
 
-						pLines->Release();
+				if (pChild->get_type(&pType) == S_OK) {
+					if (pType->get_baseType(&dwBaseType) != S_OK) {
+						dwBaseType = 0;
 					}
-				}
 
-				else {
-					if (SUCCEEDED(pSession->findLines(pCompiland, pSrcFile, &pLines))) {
-						PrintLines(pLines, szFileName);
+					pType->Release();
+				}
 
-						pLines->Release();
-					}
+				if (pChild->get_name(&bstrName) == S_OK) {
+					ToUtf8(bstrName, field.name);
+					SysFreeString(bstrName);
 				}
 
-				pCompiland->Release();
+				field.offset = lOffset;
+				field.baseType = dwBaseType;
+				layout.fields.push_back(field);
 			}
 
-			pEnumCompilands->Release();
+			pChild->Release();
 		}
 
-		pSrcFile->Release();
+		pEnumChildren->Release();
 	}
 
-	pEnumSrcFiles->Release();
+	HashTypeLayout(layout);
 
 	return true;
 }
 
 ////////////////////////////////////////////////////////////
-// Dump public symbol information for a given number of
-//  symbols around a given RVA address
+// The layouts of all the defined UDTs of a PDB that are not
+//  excluded, the first definition of a name is kept
 //
-bool DumpPublicSymbolsSorted(IDiaSession * pSession, DWORD dwRVA, DWORD dwRange, bool bReverse)
+static bool EnumTypeLayouts(IDiaSymbol * pGlobal, TypeBaseline & layouts)
 {
-	IDiaEnumSymbolsByAddr * pEnumSymsByAddr;
+	IDiaEnumSymbols * pEnumSymbols;
+
+	if (FAILED(pGlobal->findChildren(SymTagUDT, NULL, nsNone, &pEnumSymbols))) {
+		wprintf(L"ERROR - EnumTypeLayouts() returned no symbols\n");
 
-	if (FAILED(pSession->getSymbolsByAddr(&pEnumSymsByAddr))) {
 		return false;
 	}
 
 	IDiaSymbol * pSymbol;
+	ULONG celt = 0;
 
-	if (SUCCEEDED(pEnumSymsByAddr->symbolByRVA(dwRVA, &pSymbol))) {
-		if (dwRange == 0) {
-			PrintPublicSymbol(pSymbol);
-		}
-
-		ULONG celt;
-		ULONG i;
-
-		if (bReverse) {
-			pSymbol->Release();
-
-			i = 0;
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
+		std::wstring typeName;
+		TypeLayout layout;
 
-			for (pSymbol = NULL; (i < dwRange) && SUCCEEDED(pEnumSymsByAddr->Next(1, &pSymbol, &celt)) && (celt == 1); i++) {
-				PrintPublicSymbol(pSymbol);
+		GetSymbolName(typeName, pSymbol);
 
-				pSymbol->Release();
-			}
+		if (!IsTypeExcluded(typeName) && GetTypeLayout(pSymbol, typeName, layout) && layout.cb != 0) {
+			layouts.Add(layout);
 		}
 
-		else {
-			PrintPublicSymbol(pSymbol);
-
-			pSymbol->Release();
-
-			i = 1;
-
-			for (pSymbol = NULL; (i < dwRange) && SUCCEEDED(pEnumSymsByAddr->Prev(1, &pSymbol, &celt)) && (celt == 1); i++) {
-				PrintPublicSymbol(pSymbol);
-			}
-		}
+		pSymbol->Release();
 	}
 
-	pEnumSymsByAddr->Release();
+	pEnumSymbols->Release();
 
 	return true;
 }
 
 ////////////////////////////////////////////////////////////
-// Dump label symbol information at a given RVA
+// Save the layouts of a PDB as the baseline of later checks
 //
-bool DumpLabel(IDiaSession * pSession, DWORD dwRVA)
+bool WriteTypeBaseline(IDiaSymbol * pGlobal, const wchar_t * szBaseline)
 {
-	IDiaSymbol * pSymbol;
-	LONG lDisplacement;
+	TypeBaseline baseline;
 
-	if (FAILED(pSession->findSymbolByRVAEx(dwRVA, SymTagLabel, &pSymbol, &lDisplacement)) || (pSymbol == NULL)) {
+	if (!EnumTypeLayouts(pGlobal, baseline)) {
 		return false;
 	}
 
-	wprintf(L"Displacement = 0x%X\n", lDisplacement);
+	if (!baseline.Save(szBaseline)) {
+		wprintf(L"ERROR - WriteTypeBaseline() could not write %s\n", szBaseline);
 
-	PrintGeneric(pSymbol);
+		return false;
+	}
 
-	pSymbol->Release();
+	wprintf(L"OK: Saved %u types of %s to %s\n", (DWORD)baseline.Count(), g_szFilename2, szBaseline);
 
 	return true;
 }
 
 ////////////////////////////////////////////////////////////
-// Dump annotation symbol information at a given RVA
+// Compare a PDB against a saved baseline
 //
-bool DumpAnnotations(IDiaSession * pSession, DWORD dwRVA)
+//  Only the new PDB is walked. A type whose hash equals the
+//  baseline's is identical; the others get the field by field
+//  comparison, with the same messages as a pairwise run.
+//
+bool CheckTypeBaseline(IDiaSymbol * pGlobal, const wchar_t * szBaseline)
 {
-	IDiaSymbol * pSymbol;
-	LONG lDisplacement;
+	TypeBaseline baseline;
+	TypeBaseline layouts;
+
+	if (!baseline.Load(szBaseline)) {
+		wprintf(L"ERROR - CheckTypeBaseline() could not read baseline %s\n", szBaseline);
 
-	if (FAILED(pSession->findSymbolByRVAEx(dwRVA, SymTagAnnotation, &pSymbol, &lDisplacement)) || (pSymbol == NULL)) {
 		return false;
 	}
 
-	wprintf(L"Displacement = 0x%X\n", lDisplacement);
+	if (!EnumTypeLayouts(pGlobal, layouts)) {
+		return false;
+	}
 
-	PrintGeneric(pSymbol);
+	ULONG commonNb = 0;
+	ULONG comparedNb = 0;
+	ULONG failuresNb = 0;
+	std::string reason;
 
-	pSymbol->Release();
+	for (size_t i = 0; i < layouts.Count(); i++) {
+		const TypeLayout & layout = layouts.Layout(i);
+		const TypeLayout * pOld = baseline.Find(layout.name);
 
-	return true;
+		if (pOld == NULL) {
+			continue;
+		}
+
+		commonNb++;
+
+		if (pOld->hash == layout.hash) {
+			continue;
+		}
+
+		comparedNb++;
+
+		if (!TypeLayoutsMatch(*pOld, layout, reason)) {
+			wprintf(L"%S\n", reason.c_str());
+			wprintf(L"Type \"%S\" is not matching in %s and %s\n", layout.name.c_str(), g_szFilename1, g_szFilename2);
+
+			failuresNb++;
+		}
+	}
+
+	if (failuresNb == 0) {
+		wprintf(L"OK: All %u common types of %s and %s match! (%u compared field by field)\n", commonNb, g_szFilename1, g_szFilename2, comparedNb);
+		return true;
+	} else {
+		wprintf(L"FAIL: Failed to match %u common types of %s and %s!\n", failuresNb, g_szFilename1, g_szFilename2);
+		wprintf(L"Matched %u common types!\n", commonNb - failuresNb);
+		return false;
+	}
 }
 
-struct OMAP_DATA
+//my addition
+bool DumpAllSpecificDwords(IDiaSession * pSession, wchar_t * filename, wchar_t *name)
 {
-	DWORD dwRVA;
-	DWORD dwRVATo;
-};
+	wprintf(L"\n\n*** SPECIFIC DWORDS\n");
 
-////////////////////////////////////////////////////////////
-//
-bool DumpMapToSrc(IDiaSession * pSession, DWORD dwRVA)
-{
-	IDiaEnumDebugStreams * pEnumStreams;
-	IDiaEnumDebugStreamData * pStream;
-	ULONG celt;
+	IDiaEnumSectionContribs * pEnumSecContribs;
 
-	if (FAILED(pSession->getEnumDebugStreams(&pEnumStreams))) {
+	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
 		return false;
 	}
 
-	celt = 0;
+	IDiaSectionContrib * pSecContrib;
+	ULONG celt = 0;
 
-	for (; SUCCEEDED(pEnumStreams->Next(1, &pStream, &celt)) && (celt == 1); pStream = NULL) {
-		BSTR bstrName;
+	if (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
+		PrintSpecificDword(pSession, pSecContrib, filename, name);
+		pSecContrib->Release();
+		putwchar(L'\n');
+	}
 
-		if (pStream->get_name(&bstrName) != S_OK) {
-			bstrName = NULL;
-		}
+	pEnumSecContribs->Release();
 
-		if (bstrName && wcscmp(bstrName, L"OMAPTO") == 0) {
-			OMAP_DATA data, datasav;
-			DWORD cbData;
-			DWORD dwRVATo = 0;
-			unsigned int i;
+	putwchar(L'\n');
 
-			datasav.dwRVATo = 0;
-			datasav.dwRVA = 0;
+	return true;
+}
 
-			while (SUCCEEDED(pStream->Next(1, sizeof(data), &cbData, (BYTE *)&data, &celt)) && (celt == 1)) {
-				if (dwRVA > data.dwRVA) {
-					datasav = data;
-					continue;
-				}
+bool DumpCompilandContrib(IDiaSession * pSession, IDiaSymbol * pGlobal, const wchar_t * szCompName)
+{
+	wprintf(L"\n\n*** COMPILAND SECTION CONTRIBUTION\n\n");
 
-				else if (dwRVA == data.dwRVA) {
-					dwRVATo = data.dwRVATo;
-				}
+	std::wstring s = szCompName;
+	bool wasfound = false;
 
-				else if (datasav.dwRVATo) {
-					dwRVATo = datasav.dwRVATo + (dwRVA - datasav.dwRVA);
-				}
-				break;
-			}
+	IDiaEnumSectionContribs * pEnumSecContribs;
 
-			wprintf(L"image rva = %08X ==> source rva = %08X\n\nRelated OMAP entries:\n", dwRVA, dwRVATo);
-			wprintf(L"image rva ==> source rva\n");
-			wprintf(L"%08X  ==> %08X\n", datasav.dwRVA, datasav.dwRVATo);
+	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
+		return false;
+	}
 
-			i = 0;
+	//wprintf(L"    RVA        Address       Size      Module\n");
 
-			do {
-				wprintf(L"%08X  ==> %08X\n", data.dwRVA, data.dwRVATo);
-			} while ((++i) < 5 && SUCCEEDED(pStream->Next(1, sizeof(data), &cbData, (BYTE *)&data, &celt)) && (celt == 1));
+	IDiaSectionContrib * pSecContrib;
+	ULONG celt = 0;
+
+	DWORD sect = 0;
+	while (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
+		IDiaSymbol *pCompiland;
+		if (FAILED(pSecContrib->get_compiland(&pCompiland))) {
+			continue;
 		}
+		pSecContrib->get_addressSection(&sect);
+		//only care about text
+		//if (sect != 1) {
+		//  break;
+		//}
 
-		if (bstrName != NULL) {
+		BSTR bstrName;
+		std::wstring n;
+		n.clear();
+		if (pCompiland->get_name(&bstrName) == S_OK) {
+			n = bstrName;
 			SysFreeString(bstrName);
 		}
 
-		pStream->Release();
+		if (!n.empty() && n.find(s) != std::string::npos) {
+			if (!wasfound) {
+				wprintf(L"%s\n", n.c_str());
+				wasfound = true;
+			}
+			PrintSecContribs(pSession, pSecContrib);
+			putwchar(L'\n');
+
+		}
+
+		pSecContrib->Release();
+
 	}
 
-	pEnumStreams->Release();
+	pEnumSecContribs->Release();
+
+	if (!wasfound)
+	{
+		wprintf(L"Could not find %s\n\n", s.c_str());
+	}
+
+	putwchar(L'\n');
 
 	return true;
 }
 
 ////////////////////////////////////////////////////////////
+// The original find/replace CleanupSymbol, only kept as the
+//  baseline for DumpScrubBenchmark
 //
-bool DumpMapFromSrc(IDiaSession * pSession, DWORD dwRVA)
+static void CleanupSymbolFindReplace(std::wstring & str)
 {
-	IDiaEnumDebugStreams * pEnumStreams;
+	auto pos = str.find(L"A0x");
+	while (pos != std::wstring::npos) {
+		str.replace(pos + 3, 8, L"xxxxxxxx");
+		pos = str.find(L"A0x", pos + 1);
+	}
+}
 
-	if (FAILED(pSession->getEnumDebugStreams(&pEnumStreams))) {
+////////////////////////////////////////////////////////////
+// Time ScrubSymbolName against the find/replace cleanup over
+//  the names of all the public symbols
+//
+bool DumpScrubBenchmark(IDiaSymbol * pGlobal, DWORD dwIterations)
+{
+	wprintf(L"\n\n*** NAME SCRUBBING BENCHMARK\n\n");
+
+	IDiaEnumSymbols * pEnumSymbols;
+
+	if (FAILED(pGlobal->findChildren(SymTagPublicSymbol, NULL, nsNone, &pEnumSymbols))) {
 		return false;
 	}
 
-	IDiaEnumDebugStreamData * pStream;
+	// Flatten all the names in one buffer, NUL separated
+
+	std::vector<wchar_t> corpus;
+	std::vector<size_t> offsets;
+	IDiaSymbol * pSymbol;
 	ULONG celt = 0;
 
-	for (; SUCCEEDED(pEnumStreams->Next(1, &pStream, &celt)) && (celt == 1); pStream = NULL) {
+	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
 		BSTR bstrName;
 
-		if (pStream->get_name(&bstrName) != S_OK) {
-			bstrName = NULL;
-		}
+		if (pSymbol->get_name(&bstrName) == S_OK) {
+			offsets.push_back(corpus.size());
+			corpus.insert(corpus.end(), bstrName, bstrName + SysStringLen(bstrName));
+			corpus.push_back(L'\0');
 
-		if (bstrName && wcscmp(bstrName, L"OMAPFROM") == 0) {
-			OMAP_DATA data;
-			OMAP_DATA datasav;
-			DWORD cbData;
-			DWORD dwRVATo = 0;
-			unsigned int i;
+			SysFreeString(bstrName);
+		}
 
-			datasav.dwRVATo = 0;
-			datasav.dwRVA = 0;
+		pSymbol->Release();
+	}
 
-			while (SUCCEEDED(pStream->Next(1, sizeof(data), &cbData, (BYTE *)&data, &celt)) && (celt == 1)) {
-				if (dwRVA > data.dwRVA) {
-					datasav = data;
-					continue;
-				}
+	pEnumSymbols->Release();
 
-				else if (dwRVA == data.dwRVA) {
-					dwRVATo = data.dwRVATo;
-				}
+	if (offsets.empty() || dwIterations == 0) {
+		wprintf(L"Nothing to benchmark\n");
+		return true;
+	}
 
-				else if (datasav.dwRVATo) {
-					dwRVATo = datasav.dwRVATo + (dwRVA - datasav.dwRVA);
-				}
-				break;
-			}
+	size_t cNames = offsets.size();
+	offsets.push_back(corpus.size());
 
-			wprintf(L"source rva = %08X ==> image rva = %08X\n\nRelated OMAP entries:\n", dwRVA, dwRVATo);
-			wprintf(L"source rva ==> image rva\n");
-			wprintf(L"%08X  ==> %08X\n", datasav.dwRVA, datasav.dwRVATo);
+	LARGE_INTEGER freq, t0, t1;
+	QueryPerformanceFrequency(&freq);
 
-			i = 0;
+	// Baseline: a std::wstring per name, as PrintName used to do
 
-			do {
-				wprintf(L"%08X  ==> %08X\n", data.dwRVA, data.dwRVATo);
-			} while ((++i) < 5 && SUCCEEDED(pStream->Next(1, sizeof(data), &cbData, (BYTE *)&data, &celt)) && (celt == 1));
-		}
+	size_t cchLegacy = 0;
 
-		if (bstrName != NULL) {
-			SysFreeString(bstrName);
+	QueryPerformanceCounter(&t0);
+	for (DWORD iter = 0; iter < dwIterations; iter++) {
+		for (size_t n = 0; n < cNames; n++) {
+			std::wstring str(&corpus[offsets[n]]);
+			CleanupSymbolFindReplace(str);
+			cchLegacy += str.size();
 		}
-
-		pStream->Release();
 	}
+	QueryPerformanceCounter(&t1);
 
-	pEnumStreams->Release();
+	double msLegacy = (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart;
 
-	return true;
-}
+	// Scrubber: one working copy of the corpus, scrubbed in place
 
-////////////////////////////////////////////////////////////
-// Retreive the table that matches the given iid
-//
-//  A PDB table could store the section contributions, the frame data,
-//  the injected sources
-//
-HRESULT GetTable(IDiaSession * pSession, REFIID iid, void ** ppUnk)
-{
-	IDiaEnumTables * pEnumTables;
+	std::vector<wchar_t> work(corpus.size());
+	size_t cScrubbed = 0;
 
-	if (FAILED(pSession->getEnumTables(&pEnumTables))) {
-		wprintf(L"ERROR - GetTable() getEnumTables\n");
+	QueryPerformanceCounter(&t0);
+	for (DWORD iter = 0; iter < dwIterations; iter++) {
+		memcpy(work.data(), corpus.data(), corpus.size() * sizeof(wchar_t));
 
-		return E_FAIL;
+		for (size_t n = 0; n < cNames; n++) {
+			cScrubbed += ScrubSymbolName(&work[offsets[n]], offsets[n + 1] - offsets[n] - 1);
+		}
 	}
+	QueryPerformanceCounter(&t1);
 
-	IDiaTable * pTable;
-	ULONG celt = 0;
+	double msScrub = (double)(t1.QuadPart - t0.QuadPart) * 1000.0 / (double)freq.QuadPart;
 
-	while (SUCCEEDED(pEnumTables->Next(1, &pTable, &celt)) && (celt == 1)) {
-	  // There's only one table that matches the given IID
+	// Names where the extra rules made a difference
 
-		if (SUCCEEDED(pTable->QueryInterface(iid, (void **)ppUnk))) {
-			pTable->Release();
-			pEnumTables->Release();
+	DWORD cDiffer = 0;
 
-			return S_OK;
-		}
+	for (size_t n = 0; n < cNames; n++) {
+		std::wstring str(&corpus[offsets[n]]);
+		CleanupSymbolFindReplace(str);
 
-		pTable->Release();
+		if (wcscmp(str.c_str(), &work[offsets[n]]) != 0) {
+			cDiffer++;
+		}
 	}
 
-	pEnumTables->Release();
+	double mbPass = (double)(corpus.size() * sizeof(wchar_t)) / (1024.0 * 1024.0);
+	double mbTotal = mbPass * dwIterations;
 
-	return E_FAIL;
-}
+	wprintf(L"Names: %u, corpus: %.2f MB, passes: %u\n\n", (DWORD)cNames, mbPass, dwIterations);
+	wprintf(L"find/replace : %10.2f ms %10.1f MB/s\n", msLegacy, (msLegacy > 0) ? mbTotal * 1000.0 / msLegacy : 0.0);
+	wprintf(L"scrub        : %10.2f ms %10.1f MB/s\n", msScrub, (msScrub > 0) ? mbTotal * 1000.0 / msScrub : 0.0);
+	wprintf(L"\nFragments masked per pass: %u\n", (DWORD)(cScrubbed / dwIterations));
+	wprintf(L"Names differing from the find/replace cleanup: %u\n", cDiffer);
 
-//PDBTypeMatch code
-//from https://github.com/dotnet/coreclr/tree/release/1.1.0/src/ToolBox/PdbTypeMatch
+	putwchar(L'\n');
 
+	return true;
+}
 
+////////////////////////////////////////////////////////////
+// Minidump symbolization
+//
+//  Every module PDB (and for x64 the image, for its unwind
+//  data) is loaded once and kept for all the dumps of a batch.
+//
 
+#define MINIDUMP_FRAMES_MAX 256
 
-#define DEBUG_VERBOSE 0
+struct MinidumpModuleSession
+{
+	IDiaDataSource * pSource;
+	IDiaSession * pSession;
+	FrameIndex frames;
+	PeImage image;
+	X64UnwindIndex unwind;
+	PdbFile pdb;
+	InlineIndex inlines;
+};
 
-#pragma warning (disable : 4100)
+struct MinidumpPathMap
+{
+	std::unordered_map<std::wstring, std::wstring> paths;   // "name" or "name/signature", lowercase
+	std::vector<std::wstring> dirs;                         // searched flat and in symbol store layout
+};
 
-const wchar_t * g_szFilename1, * g_szFilename2;
-IDiaDataSource * g_pDiaDataSource1, * g_pDiaDataSource2;
-IDiaSession * g_pDiaSession1, * g_pDiaSession2;
-IDiaSymbol * g_pGlobalSymbol1, * g_pGlobalSymbol2;
+static std::unordered_map<std::wstring, MinidumpModuleSession *> g_minidumpSessions;
+static DWORD g_cMinidumpSessionLoads;
+static DWORD g_cMinidumpSessionHits;
 
-typedef std::set<std::wstring> IDiaSymbolSet;
-IDiaSymbolSet g_excludedTypes;
-IDiaSymbolSet g_excludedTypePatterns;
+static std::wstring ToLower(const std::wstring & str)
+{
+	std::wstring lower(str);
 
-bool InitDiaSource(IDiaDataSource ** ppSource);
-void Cleanup2();
-LPSTR UnicodeToAnsi(LPCWSTR s);
-bool EnumTypesInPdb(IDiaSymbolSet * types, IDiaSession * pSession, IDiaSymbol * pGlobal);
-bool LayoutMatches(IDiaSymbol * pSymbol1, IDiaSymbol * pSymbol2);
-void PrintHelpOptions2();
+	std::transform(lower.begin(), lower.end(), lower.begin(), towlower);
+
+	return lower;
+}
 
 ////////////////////////////////////////////////////////////
+// Read a path map, one "name[/signature] = path" per line;
+//  "* = directory" adds a directory to search
 //
-int __cdecl wmain2(int argc, wchar_t * argv[])
+static bool LoadMinidumpPathMap(const wchar_t * szFilename, MinidumpPathMap & map)
 {
 	FILE * pFile;
+	wchar_t wszLine[MAX_PATH * 2];
 
-	if (argc < 3) {
-		PrintHelpOptions2();
-		return -1;
-	}
+	if (_wfopen_s(&pFile, szFilename, L"r") || !pFile) {
+		wprintf(L"ERROR - LoadMinidumpPathMap() could not open %s\n", szFilename);
 
-	if (!_wcsicmp(argv[1], L"-ptype")) {
+		return false;
+	}
 
-	  // -type <symbolname> <pdbfilename>: dump this type in detail
+	while (fgetws(wszLine, _countof(wszLine), pFile) != NULL) {
+		std::wstring line(wszLine);
+		size_t iEqual = line.find(L'=');
 
-		if (argc < 4) {
-			PrintHelpOptions2();
-			return -1;
+		if (line.empty() || line[0] == L'#' || iEqual == std::wstring::npos) {
+			continue;
 		}
 
-		if ((argc > 1) && (*argv[2] != L'-')) {
-
-			if (_wfopen_s(&pFile, argv[3], L"r") || !pFile) {
-			// invalid file name or file does not exist
-
-				PrintHelpOptions2();
-				return -1;
-			}
-			fclose(pFile);
-			// CoCreate() and initialize COM objects
-			if (!InitDiaSource(&g_pDiaDataSource1)) {
-				return -1;
-			}
-			if (!LoadDataFromPdb(argv[3], &g_pDiaDataSource1, &g_pDiaSession1, &g_pGlobalSymbol1)) {
-				return -1;
-			}
-
-			DumpType(g_pGlobalSymbol1, argv[2]);
+		std::wstring key = line.substr(0, iEqual);
+		std::wstring path = line.substr(iEqual + 1);
 
-			// release COM objects and CoUninitialize()
-			Cleanup2();
+		key.erase(key.find_last_not_of(L" \t") + 1);
+		key.erase(0, key.find_first_not_of(L" \t"));
+		path.erase(path.find_last_not_of(L" \t\r\n") + 1);
+		path.erase(0, path.find_first_not_of(L" \t"));
 
-			return 0;
+		if (key == L"*") {
+			map.dirs.push_back(path);
 		}
-	}
-
-	if (argc < 3) {
-		PrintHelpOptions2();
-		return -1;
-	}
-
-	if (_wfopen_s(&pFile, argv[1], L"r") || !pFile) {
-	  // invalid file name or file does not exist
 
-		PrintHelpOptions2();
-		return -1;
+		else if (!key.empty() && !path.empty()) {
+			map.paths[ToLower(key)] = path;
+		}
 	}
 
 	fclose(pFile);
 
-	if (_wfopen_s(&pFile, argv[2], L"r") || !pFile) {
-	  // invalid file name or file does not exist
-
-		PrintHelpOptions2();
-		return -1;
-	}
-
-	fclose(pFile);
+	return true;
+}
 
-	g_szFilename1 = argv[1];
+////////////////////////////////////////////////////////////
+// Find the local copy of a PDB or image by name and signature
+//
+static bool ResolveMinidumpFile(const MinidumpPathMap & map, const std::wstring & name, const std::wstring & sig, std::wstring & path)
+{
+	std::wstring key = ToLower(name);
+	auto it = map.paths.find(key + L"/" + ToLower(sig));
 
-	// CoCreate() and initialize COM objects
-	if (!InitDiaSource(&g_pDiaDataSource1)) {
-		return -1;
-	}
-	if (!LoadDataFromPdb(g_szFilename1, &g_pDiaDataSource1, &g_pDiaSession1, &g_pGlobalSymbol1)) {
-		return -1;
+	if (it == map.paths.end()) {
+		it = map.paths.find(key);
 	}
 
-	g_szFilename2 = argv[2];
+	if (it != map.paths.end()) {
+		path = it->second;
 
-	InitDiaSource(&g_pDiaDataSource2);
-	if (!LoadDataFromPdb(g_szFilename2, &g_pDiaDataSource2, &g_pDiaSession2, &g_pGlobalSymbol2)) {
-		return -1;
+		return true;
 	}
 
-	if (argv[3]) {
-	  // Read exclusion list.
-		struct stat fileStatus;
-		if (stat(UnicodeToAnsi(argv[3]), &fileStatus) != 0) {
-			wprintf(L"Could not open type_exclusion_list file!\n");
-			return -1;
-		}
+	for (const std::wstring & dir : map.dirs) {
+		path = dir + L"\\" + name + L"\\" + sig + L"\\" + name;
 
-		char linec[2048];
-		FILE * file;
-		fopen_s(&file, UnicodeToAnsi(argv[3]), "r");
-		while (fgets(linec, sizeof(linec), file) != NULL) {
-			std::string line(linec);
-			line.erase(std::remove_if(line.begin(), line.end(), isspace), line.end());
-			if (line.empty() || line.length() <= 1) {
-				continue;
-			}
-			if (line.front() == '#') continue;
-			int len;
-			int slength = (int)line.length() + 1;
-			len = MultiByteToWideChar(CP_ACP, 0, line.c_str(), slength, 0, 0);
-			wchar_t * buf = new wchar_t[len];
-			MultiByteToWideChar(CP_ACP, 0, line.c_str(), slength, buf, len);
-			std::wstring wLine(buf);
-			delete[] buf;
-
-			/// Add *str in the patterns list.
-			if (line.front() == '*') {
-				g_excludedTypePatterns.insert((std::wstring)(wLine.substr(1, wLine.size() - 1)));
-			} else {
-				g_excludedTypes.insert((std::wstring)(wLine));
-			}
+		if (!sig.empty() && PathFileExistsW(path.c_str())) {
+			return true;
 		}
-		fclose(file);
-	}
 
-	IDiaSymbolSet types1;
-	IDiaSymbolSet types2;
-	if (!EnumTypesInPdb(&types1, g_pDiaSession1, g_pGlobalSymbol1)) {
-		return -1;
+		path = dir + L"\\" + name;
+
+		if (PathFileExistsW(path.c_str())) {
+			return true;
+		}
 	}
 
-	if (!EnumTypesInPdb(&types2, g_pDiaSession2, g_pGlobalSymbol2)) {
-		return -1;
-	}
+	return false;
+}
 
-	IDiaSymbolSet commonTypes;
+////////////////////////////////////////////////////////////
+// Get the cached session of a module, loading it on first use.
+//  Modules that could not be loaded are cached as NULL.
+//
+static MinidumpModuleSession * GetMinidumpModuleSession(const MinidumpModule & module, WORD wArchitecture, const MinidumpPathMap & map)
+{
+	std::wstring pdbName = PathFindFileNameW(module.pdbName.c_str());
+	std::wstring sig;
 
-	// Intersect types
-	for (IDiaSymbolSet::iterator i = types1.begin(); i != types1.end(); i++) {
-		std::wstring typeName = *i;
+	FormatPdbSignature(module, sig);
 
-		/// Skip excluded types
-		if (g_excludedTypes.find(typeName) != g_excludedTypes.end()) {
-			continue;
-		}
-		bool skipType = false;
-		/// Skip if includes one pattern string.
-		for (IDiaSymbolSet::iterator j = g_excludedTypePatterns.begin(); j != g_excludedTypePatterns.end(); j++) {
-			std::wstring patternStr = *j;
-			if (wcsstr(typeName.c_str(), patternStr.c_str()) != NULL) {
-				skipType = true;
-				break;
-			}
-		}
+	std::wstring key = ToLower(pdbName + L"/" + sig);
 
-		if (skipType) continue;
+	if (pdbName.empty()) {
+		wchar_t wszStamp[32];
 
-		if (types2.find(typeName) != types2.end()) {
-			commonTypes.insert(typeName);
-		}
+		swprintf_s(wszStamp, L"/%08X%x", module.dwTimeDateStamp, module.cbImage);
+		key = ToLower(PathFindFileNameW(module.name.c_str()) + std::wstring(wszStamp));
 	}
 
-	bool matchedSymbols = true;
-	ULONG failuresNb = 0;
+	auto it = g_minidumpSessions.find(key);
 
+	if (it != g_minidumpSessions.end()) {
+		g_cMinidumpSessionHits++;
 
-	// Compare layout for common types
-	for (IDiaSymbolSet::iterator i = commonTypes.begin(); i != commonTypes.end(); i++) {
-		std::wstring typeName = *i;
+		return it->second;
+	}
 
-		IDiaEnumSymbols * pEnumSymbols1;
-		BSTR pwstrTypeName = SysAllocString(typeName.c_str());
-		if (FAILED(g_pGlobalSymbol1->findChildren(SymTagUDT, pwstrTypeName, nsNone, &pEnumSymbols1))) {
-			SysFreeString(pwstrTypeName);
-			return false;
+	MinidumpModuleSession * pModSession = NULL;
+	std::wstring path;
+
+	if (!pdbName.empty() && ResolveMinidumpFile(map, pdbName, sig, path)) {
+		pModSession = new MinidumpModuleSession();
+		pModSession->pSource = NULL;
+		pModSession->pSession = NULL;
+
+		HRESULT hr = CoCreateInstance(__uuidof(DiaSource),
+									  NULL,
+									  CLSCTX_INPROC_SERVER,
+									  __uuidof(IDiaDataSource),
+									  (void **)&pModSession->pSource);
+
+		if (SUCCEEDED(hr)) {
+			hr = module.fRsds ?
+				pModSession->pSource->loadAndValidateDataFromPdb(path.c_str(), (GUID *)module.rgGuid, 0, module.dwAge) :
+				pModSession->pSource->loadDataFromPdb(path.c_str());
 		}
 
-		IDiaEnumSymbols * pEnumSymbols2;
-		if (FAILED(g_pGlobalSymbol2->findChildren(SymTagUDT, pwstrTypeName, nsNone, &pEnumSymbols2))) {
-			SysFreeString(pwstrTypeName);
-			return false;
+		if (SUCCEEDED(hr)) {
+			hr = pModSession->pSource->openSession(&pModSession->pSession);
 		}
 
-		IDiaSymbol * pSymbol1;
-		IDiaSymbol * pSymbol2;
-		ULONG celt = 0;
+		if (FAILED(hr)) {
+			wprintf(L"ERROR - GetMinidumpModuleSession() could not load %s - HRESULT = %08X\n", path.c_str(), hr);
 
+			if (pModSession->pSource) {
+				pModSession->pSource->Release();
+			}
 
-		while (SUCCEEDED(pEnumSymbols1->Next(1, &pSymbol1, &celt)) && (celt == 1)) {
-			if (SUCCEEDED(pEnumSymbols2->Next(1, &pSymbol2, &celt)) && (celt == 1)) {
+			delete pModSession;
+			pModSession = NULL;
+		}
 
-				BSTR bstrSymbol1Name;
-				if (pSymbol1->get_name(&bstrSymbol1Name) != S_OK) {
-					bstrSymbol1Name = NULL;
-					pSymbol2->Release();
-					continue;
-				}
-				BSTR bstrSymbol2Name;
-				if (pSymbol2->get_name(&bstrSymbol2Name) != S_OK) {
-					bstrSymbol2Name = NULL;
-					pSymbol2->Release();
-					continue;
-				}
-				if (_wcsicmp(bstrSymbol1Name, bstrSymbol2Name) != 0) {
-					pSymbol2->Release();
-					continue;
-				}
-				ULONGLONG sym1Size;
-				ULONGLONG sym2Size;
-				if (pSymbol1->get_length(&sym1Size) != S_OK) {
-					wprintf(L"ERROR - can't retrieve the symbol's length\n");
-					pSymbol2->Release();
-					continue;
-				}
-				//wprintf(L"sym1Size = %x\n", sym1Size);
-				if (pSymbol2->get_length(&sym2Size) != S_OK) {
-					wprintf(L"ERROR - can't retrieve the symbol's length\n");
-					pSymbol2->Release();
-					continue;
-				}
-				//wprintf(L"sym2Size = %x\n", sym2Size);
-				if (sym1Size == 0 || sym2Size == 2) {
-					pSymbol2->Release();
-					continue;
-				}
+		else {
+			g_cMinidumpSessionLoads++;
 
-				if (!LayoutMatches(pSymbol1, pSymbol2)) {
-					wprintf(L"Type \"%s\" is not matching in %s and %s\n", pwstrTypeName, g_szFilename1, g_szFilename2);
-					pSymbol2->Release();
+			if (wArchitecture == MINIDUMP_ARCH_X86) {
+				LoadFrameIndex(pModSession->pSession, pModSession->frames);
+			}
 
-					matchedSymbols = false;
-					failuresNb++;
-					// Continue to compare and report all inconsistencies.
-					continue;
-				} else {
-#if	DEBUG_VERBOSE
-					wprintf(L"Matched type: %s\n", pwstrTypeName);
-#endif
-				}
+			if (pModSession->pdb.Load(path.c_str())) {
+				pModSession->inlines.Load(pModSession->pdb);
+			}
+		}
+	}
 
-				pSymbol2->Release();
+	// x64 stacks can only be walked with the unwind data of the image
+
+	if (wArchitecture == MINIDUMP_ARCH_AMD64) {
+		std::wstring imageName = PathFindFileNameW(module.name.c_str());
+		wchar_t wszImageSig[32];
+
+		swprintf_s(wszImageSig, L"%08X%x", module.dwTimeDateStamp, module.cbImage);
+
+		if (ResolveMinidumpFile(map, imageName, wszImageSig, path)) {
+			if (pModSession == NULL) {
+				pModSession = new MinidumpModuleSession();
+				pModSession->pSource = NULL;
+				pModSession->pSession = NULL;
 			}
 
-			pSymbol1->Release();
+			if (pModSession->image.Load(path.c_str())) {
+				pModSession->unwind.Load(pModSession->image);
+			}
 		}
-
-		SysFreeString(pwstrTypeName);
-		pEnumSymbols1->Release();
-		pEnumSymbols2->Release();
 	}
 
-	// release COM objects and CoUninitialize()
-	Cleanup2();
+	g_minidumpSessions[key] = pModSession;
 
-	if (matchedSymbols) {
-		wprintf(L"OK: All %d common types of %s and %s match!\n", commonTypes.size(), g_szFilename1, g_szFilename2);
-		return 0;
-	} else {
-		wprintf(L"FAIL: Failed to match %d common types of %s and %s!\n", failuresNb, g_szFilename1, g_szFilename2);
-		wprintf(L"Matched %d common types!\n", commonTypes.size() - failuresNb);
-		return -1;
-	}
+	return pModSession;
 }
 
-LPSTR UnicodeToAnsi(LPCWSTR s)
+////////////////////////////////////////////////////////////
+// Print one frame as module!function+offset [file @ line]
+//
+//  Return addresses are looked up one byte back, so a call at
+//  the end of a function or line is attributed correctly.
+//  Calls inlined at the address are printed first, innermost
+//  first, under the same frame number.
+//
+static void PrintMinidumpFrame(DWORD iFrame, ULONGLONG qwAddress, const MinidumpModule * pModule, MinidumpModuleSession * pModSession, bool fReturnAddress)
 {
-	if (s == NULL) return NULL;
-	int cw = lstrlenW(s);
-	if (cw == 0) {
-		CHAR * psz = new CHAR[1]; *psz = '\0'; return psz;
+	if (pModule == NULL) {
+		wprintf(L"  #%02u 0x%016llX ???\n", iFrame, qwAddress);
+
+		return;
 	}
-	int cc = WideCharToMultiByte(CP_ACP, 0, s, cw, NULL, 0, NULL, NULL);
-	if (cc == 0) return NULL;
-	CHAR * psz = new CHAR[cc + 1];
-	cc = WideCharToMultiByte(CP_ACP, 0, s, cw, psz, cc, NULL, NULL);
-	if (cc == 0) { delete[] psz; return NULL; }
-	psz[cc] = '\0';
-	return psz;
-}
 
+	const wchar_t * szModule = PathFindFileNameW(pModule->name.c_str());
+	DWORD dwRVA = (DWORD)(qwAddress - pModule->qwBase);
+	DWORD dwLookup = (fReturnAddress && dwRVA != 0) ? dwRVA - 1 : dwRVA;
+	IDiaSymbol * pSymbol = NULL;
 
-bool InitDiaSource(IDiaDataSource ** ppSource)
-{
-	HRESULT hr = CoInitialize(NULL);
+	if (pModSession == NULL || pModSession->pSession == NULL) {
+		wprintf(L"  #%02u 0x%016llX %s+0x%X\n", iFrame, qwAddress, szModule, dwRVA);
 
-	// Obtain access to the provider
+		return;
+	}
 
-	hr = CoCreateInstance(__uuidof(DiaSource),
-						NULL,
-						CLSCTX_INPROC_SERVER,
-						__uuidof(IDiaDataSource),
-						(void **)ppSource);
+	std::vector<InlineFrame> inlineFrames;
 
-	if (FAILED(hr)) {
-		ACTCTX actCtx;
-		memset((void *)&actCtx, 0, sizeof(ACTCTX));
-		actCtx.cbSize = sizeof(ACTCTX);
-		WCHAR   dllPath[MAX_PATH * 2];
-		GetModuleFileName(NULL, dllPath, _countof(dllPath));
-		PathRemoveFileSpec(dllPath);
-		wcscat_s(dllPath, L"\\msdia100.sxs.manifest");
-		actCtx.lpSource = dllPath;
+	pModSession->inlines.Lookup(dwLookup, inlineFrames);
 
-		HANDLE hCtx = ::CreateActCtx(&actCtx);
-		if (hCtx == INVALID_HANDLE_VALUE)
-			wprintf(L"CreateActCtx returned: INVALID_HANDLE_VALUE\n");
-		else {
-			ULONG_PTR cookie;
-			if (::ActivateActCtx(hCtx, &cookie)) {
-				hr = CoCreateInstance(__uuidof(DiaSource),
-						   NULL,
-						   CLSCTX_INPROC_SERVER,
-						   __uuidof(IDiaDataSource),
-						   (void **)ppSource);
-				::DeactivateActCtx(0, cookie);
-				if (FAILED(hr)) {
-					wprintf(L"CoCreateInstance failed - HRESULT = %08X\n", hr);
-					return false;
-				}
-			}
+	for (const InlineFrame & frame : inlineFrames) {
+		if (!frame.fInlined) {
+			break;
 		}
-	}
-	if (FAILED(hr)) {
-		wprintf(L"CoCreateInstance failed - HRESULT = %08X\n", hr);
 
-		return false;
-	}
+		wprintf(L"  #%02u (inline)           %s!%S", iFrame, szModule, frame.szName);
 
-	return true;
-}
-bool LayoutMatches(IDiaSymbol * pSymbol1, IDiaSymbol * pSymbol2)
-{
-	DWORD dwTag1, dwTag2;
-	DWORD dwLocType1, dwLocType2;
-	LONG lOffset1, lOffset2;
-	DWORD lType1, lType2;
+		if (frame.line != 0) {
+			wprintf(L" [%S @ %u]", frame.szFile, frame.line);
+		}
 
-	if (pSymbol1->get_symTag(&dwTag1) != S_OK) {
-		wprintf(L"ERROR - can't retrieve the symbol's SymTag\n");
-		return false;
+		putwchar(L'\n');
 	}
-	if (pSymbol2->get_symTag(&dwTag2) != S_OK) {
-		wprintf(L"ERROR - can't retrieve the symbol's SymTag\n");
-		return false;
+
+	wprintf(L"  #%02u 0x%016llX", iFrame, qwAddress);
+
+	IDiaSession * pSession = pModSession->pSession;
+
+	if (pSession->findSymbolByRVA(dwLookup, SymTagFunction, &pSymbol) != S_OK || pSymbol == NULL) {
+		pSymbol = NULL;
+		pSession->findSymbolByRVA(dwLookup, SymTagPublicSymbol, &pSymbol);
 	}
 
-	if (dwTag1 == SymTagUDT) {
-		if (dwTag2 != SymTagUDT) {
+	BSTR bstrName;
+	DWORD dwSymRVA;
 
-			wprintf(L"ERROR - symbols don't match\n");
-			wprintf(L"Symbol 1:\n");
-			PrintTypeInDetail(pSymbol1, 0);
-			wprintf(L"Symbol 2:\n");
-			PrintTypeInDetail(pSymbol2, 0);
-			return false;
+	if (pSymbol != NULL && pSymbol->get_name(&bstrName) == S_OK) {
+		if (pSymbol->get_relativeVirtualAddress(&dwSymRVA) != S_OK) {
+			dwSymRVA = dwRVA;
 		}
 
-		// First check that types size match
-		ULONGLONG sym1Size;
-		ULONGLONG sym2Size;
-		if (pSymbol1->get_length(&sym1Size) != S_OK) {
-			wprintf(L"ERROR - can't retrieve the symbol's length\n");
-			return false;
-		}
-		if (pSymbol2->get_length(&sym2Size) != S_OK) {
-			wprintf(L"ERROR - can't retrieve the symbol's length\n");
-			return false;
-		}
-		if (sym1Size == 0 || sym2Size == 0) {
-			return true;
-		}
-		if (sym1Size != sym2Size) {
-			wprintf(L"Failed to match type size: (sizeof(sym1)=%llu) != (sizeof(sym2)=%llu)\n", sym1Size, sym2Size);
-			return false;
-		}
-		IDiaEnumSymbols * pEnumChildren1, * pEnumChildren2;
-		IDiaSymbol * pChild1, * pChild2;
-		ULONG celt = 0;
-		BSTR bstrName1, bstrName2;
-		IDiaSymbol * pBaseType1, * pBaseType2;
+		wprintf(L" %s!%s+0x%X", szModule, bstrName, dwRVA - dwSymRVA);
 
-		if (SUCCEEDED(pSymbol1->findChildren(SymTagNull, NULL, nsNone, &pEnumChildren1))) {
-			while (SUCCEEDED(pEnumChildren1->Next(1, &pChild1, &celt)) && (celt == 1)) {
-				if (pChild1->get_symTag(&dwTag1) != S_OK) {
-					wprintf(L"ERROR - can't retrieve the symbol's SymTag\n");
-					pChild1->Release();
-					return false;
-				}
-				if (dwTag1 != SymTagData) { pChild1->Release(); continue; }
-				if (pChild1->get_locationType(&dwLocType1) != S_OK) {
-					wprintf(L"symbol in optmized code");
-					pChild1->Release();
-					return false;
-				}
-				if (dwLocType1 != LocIsThisRel) { pChild1->Release(); continue; }
-				if (pChild1->get_offset(&lOffset1) != S_OK) {
-					wprintf(L"ERROR - geting field offset\n");
-					pChild1->Release();
-					return false;
-				}
-				if (pChild1->get_type(&pBaseType1) != S_OK || pBaseType1->get_baseType(&lType1) != S_OK) {
-					//wprintf(L"ERROR - geting field type\n");
-					//pChild1->Release();
-					//return false;
-				}
+		SysFreeString(bstrName);
+	}
+
+	else {
+		wprintf(L" %s+0x%X", szModule, dwRVA);
+	}
 
-				if (pChild1->get_name(&bstrName1) != S_OK) {
-					bstrName1 = NULL;
-				}
-				/// Search in the second symbol the field at lOffset1
-				bool fieldMatched = false;
-				if (SUCCEEDED(pSymbol2->findChildren(SymTagNull, NULL, nsNone, &pEnumChildren2))) {
-					while (SUCCEEDED(pEnumChildren2->Next(1, &pChild2, &celt)) && (celt == 1)) {
-						if (pChild2->get_symTag(&dwTag2) != S_OK) {
-							wprintf(L"ERROR - can't retrieve the symbol's SymTag\n");
-							pChild2->Release();
-							return false;
-						}
-						if (dwTag2 != SymTagData) { pChild2->Release(); continue; }
-						if (pChild2->get_locationType(&dwLocType2) != S_OK) {
-							wprintf(L"symbol in optmized code");
-							pChild2->Release();
-							return false;
-						}
-						if (dwLocType2 != LocIsThisRel) { pChild2->Release(); continue; }
-						if (pChild2->get_offset(&lOffset2) != S_OK) {
-							wprintf(L"ERROR - geting field offset\n");
-							pChild2->Release();
-							return false;
-						}
+	if (pSymbol != NULL) {
+		pSymbol->Release();
+	}
 
-						if (pChild2->get_type(&pBaseType2) != S_OK || pBaseType2->get_baseType(&lType2) != S_OK) {
-							//wprintf(L"ERROR - geting field type\n");
-							//pChild2->Release();
-							//return false;
-						}
+	IDiaEnumLineNumbers * pLines;
 
-						// my addition
-						if (lType1 != lType2) {
-							wprintf(L"Failed to match type of field %s at offset %x\n", bstrName1, lOffset1);
-							pChild1->Release();
-							pChild2->Release();
-							return false;
-						}
+	if (SUCCEEDED(pSession->findLinesByRVA(dwLookup, 1, &pLines))) {
+		IDiaLineNumber * pLine;
+		ULONG celt = 0;
 
+		if (SUCCEEDED(pLines->Next(1, &pLine, &celt)) && (celt == 1)) {
+			IDiaSourceFile * pSource;
+			DWORD dwLinenum;
 
-						if (pChild2->get_name(&bstrName2) != S_OK) {
-							bstrName2 = NULL;
-						}
-						if (lOffset2 == lOffset1) {
-							if (_wcsicmp(bstrName1, bstrName2) == 0
-							|| wcsstr(bstrName1, bstrName2) == bstrName1
-							|| wcsstr(bstrName2, bstrName1) == bstrName2) {
-								//wprintf(L"Matched field %s at offset %x\n", bstrName1, lOffset2);
-								fieldMatched = true;
-								pChild2->Release();
-								break;
-							}
-						}
-						pChild2->Release();
-					}
-					pEnumChildren2->Release();
-				}
-				if (!fieldMatched) {
-					BSTR bstrSymbol1Name;
-					if (pSymbol1->get_name(&bstrSymbol1Name) != S_OK) {
-						bstrSymbol1Name = NULL;
-					}
-					wprintf(L"Failed to match %s field %s at offset %x\n", bstrSymbol1Name, bstrName1, lOffset1);
-					pChild1->Release();
-					return false;
+			if (pLine->get_lineNumber(&dwLinenum) == S_OK && pLine->get_sourceFile(&pSource) == S_OK) {
+				BSTR bstrFile;
+
+				if (pSource->get_fileName(&bstrFile) == S_OK) {
+					wprintf(L" [%s @ %u]", bstrFile, dwLinenum);
+
+					SysFreeString(bstrFile);
 				}
-				pChild1->Release();
+
+				pSource->Release();
 			}
 
-			pEnumChildren1->Release();
+			pLine->Release();
 		}
+
+		pLines->Release();
 	}
 
-	return true;
+	putwchar(L'\n');
 }
 
-////////////////////////////////////////////////////////////
-// Release DIA objects and CoUninitialize
-//
-void Cleanup2()
+static DWORD WalkMinidumpThreadX86(const Minidump & dump, const MinidumpThread & thread, const MinidumpPathMap & map)
 {
-	if (g_pGlobalSymbol1) {
-		g_pGlobalSymbol1->Release();
-		g_pGlobalSymbol1 = NULL;
+	static const FrameIndex indexEmpty;
+	X86Context ctx;
+	uint32_t cbCalleeParams = 0;
+	DWORD iFrame = 0;
+
+	if (!dump.GetContext(thread, ctx)) {
+		wprintf(L"  no context\n");
+
+		return 0;
 	}
 
-	if (g_pGlobalSymbol2) {
-		g_pGlobalSymbol2->Release();
-		g_pGlobalSymbol2 = NULL;
+	while (iFrame < MINIDUMP_FRAMES_MAX) {
+		const MinidumpModule * pModule = dump.ModuleOf(ctx.rgReg[FrameVarEip]);
+		MinidumpModuleSession * pModSession = (pModule != NULL) ? GetMinidumpModuleSession(*pModule, MINIDUMP_ARCH_X86, map) : NULL;
+
+		PrintMinidumpFrame(iFrame, ctx.rgReg[FrameVarEip], pModule, pModSession, iFrame != 0);
+		iFrame++;
+
+		// Without frame data the ebp chain is followed
+
+		const FrameIndex & index = (pModSession != NULL) ? pModSession->frames : indexEmpty;
+
+		if (!UnwindX86Frame(index, (pModule != NULL) ? (uint32_t)pModule->qwBase : 0, dump.Memory(), &cbCalleeParams, ctx)) {
+			break;
+		}
 	}
 
-	if (g_pDiaSession1) {
-		g_pDiaSession1->Release();
-		g_pDiaSession1 = NULL;
+	return iFrame;
+}
+
+static DWORD WalkMinidumpThreadX64(const Minidump & dump, const MinidumpThread & thread, const MinidumpPathMap & map)
+{
+	X64Context ctx;
+	DWORD iFrame = 0;
+
+	if (!dump.GetContext(thread, ctx)) {
+		wprintf(L"  no context\n");
+
+		return 0;
 	}
 
-	if (g_pDiaSession2) {
-		g_pDiaSession2->Release();
-		g_pDiaSession2 = NULL;
+	while (iFrame < MINIDUMP_FRAMES_MAX) {
+		const MinidumpModule * pModule = dump.ModuleOf(ctx.rgReg[X64RegRip]);
+		MinidumpModuleSession * pModSession = (pModule != NULL) ? GetMinidumpModuleSession(*pModule, MINIDUMP_ARCH_AMD64, map) : NULL;
+
+		PrintMinidumpFrame(iFrame, ctx.rgReg[X64RegRip], pModule, pModSession, iFrame != 0);
+		iFrame++;
+
+		if (pModSession == NULL || !pModSession->image.IsLoaded()) {
+			if (pModule != NULL) {
+				wprintf(L"  (no image for %s, stack walk stopped)\n", PathFindFileNameW(pModule->name.c_str()));
+			}
+
+			break;
+		}
+
+		if (!UnwindX64Frame(pModSession->unwind, pModSession->image, pModule->qwBase, dump.Memory(), ctx)) {
+			break;
+		}
 	}
 
-	CoUninitialize();
+	return iFrame;
 }
 
-
 ////////////////////////////////////////////////////////////
-// Display the usage
+// Print the symbolized stacks of all the threads of a minidump
 //
-void PrintHelpOptions2()
+static bool DumpMinidump(const wchar_t * szFilename, const MinidumpPathMap & map, DWORD * pcFrames)
 {
-	static const wchar_t * const helpString = L"usage: PdbTypeMatch.exe <pdb_filename_1> <pdb_filename_2> <type_exclusion_list_file> : compare all common types by size and fields\n"
-		L"       PdbTypeMatch.exe -type <symbolname>  <pdb_filename_1>: dump this type in detail\n";
+	Minidump dump;
 
-	wprintf(helpString);
-}
+	if (!dump.Load(szFilename)) {
+		wprintf(L"ERROR - DumpMinidump() could not read minidump %s\n", szFilename);
 
-bool EnumTypesInPdb(IDiaSymbolSet * types, IDiaSession * pSession, IDiaSymbol * pGlobal)
-{
-	IDiaEnumSymbols * pEnumSymbols;
+		return false;
+	}
 
-	if (FAILED(pGlobal->findChildren(SymTagUDT, NULL, nsNone, &pEnumSymbols))) {
-		wprintf(L"ERROR - EnumTypesInPdb() returned no symbols\n");
+	wprintf(L"\n\n*** MINIDUMP %s\n\n", szFilename);
+
+	if (dump.Architecture() != MINIDUMP_ARCH_X86 && dump.Architecture() != MINIDUMP_ARCH_AMD64) {
+		wprintf(L"ERROR - DumpMinidump() unsupported processor architecture %u\n", dump.Architecture());
 
 		return false;
 	}
 
-	IDiaSymbol * pSymbol;
-	ULONG celt = 0;
-
-	while (SUCCEEDED(pEnumSymbols->Next(1, &pSymbol, &celt)) && (celt == 1)) {
-		std::wstring typeName;
-		GetSymbolName(typeName, pSymbol);
-		types->insert(std::wstring(typeName));
-		pSymbol->Release();
+	if (dump.HasException()) {
+		wprintf(L"Exception 0x%08X at 0x%016llX in thread 0x%X\n\n", dump.ExceptionCode(), dump.ExceptionAddress(), dump.ExceptionThreadId());
 	}
 
-	pEnumSymbols->Release();
+	for (const MinidumpThread & thread : dump.Threads()) {
+		wprintf(L"Thread 0x%X%s\n", thread.dwThreadId,
+			(dump.HasException() && thread.dwThreadId == dump.ExceptionThreadId()) ? L" (faulting)" : L"");
+
+		if (dump.Architecture() == MINIDUMP_ARCH_X86) {
+			*pcFrames += WalkMinidumpThreadX86(dump, thread, map);
+		}
+
+		else {
+			*pcFrames += WalkMinidumpThreadX64(dump, thread, map);
+		}
+
+		putwchar(L'\n');
+	}
 
 	return true;
 }
 
-//my addition
-bool DumpAllSpecificDwords(IDiaSession * pSession, wchar_t * filename, wchar_t *name)
+////////////////////////////////////////////////////////////
+// Symbolize a batch of minidumps
+//
+//  Arguments: [-map <file>]... followed by minidump files or
+//  directories, every *.dmp in a directory is processed.
+//
+bool DumpMinidumps(int argc, wchar_t * argv[])
 {
-	wprintf(L"\n\n*** SPECIFIC DWORDS\n");
+	MinidumpPathMap map;
+	std::vector<std::wstring> dumps;
 
-	IDiaEnumSectionContribs * pEnumSecContribs;
+	for (int i = 0; i < argc; i++) {
+		if (!_wcsicmp(argv[i], L"-map")) {
+			if (i + 1 == argc || !LoadMinidumpPathMap(argv[i + 1], map)) {
+				wprintf(L"ERROR - DumpMinidumps(): missing or bad argument for option '-map'\n");
+
+				return false;
+			}
+
+			i++;
+		}
+
+		else if (PathIsDirectoryW(argv[i])) {
+			std::wstring dir(argv[i]);
+			WIN32_FIND_DATAW findData;
+			HANDLE hFind = FindFirstFileW((dir + L"\\*.dmp").c_str(), &findData);
+
+			if (hFind != INVALID_HANDLE_VALUE) {
+				do {
+					dumps.push_back(dir + L"\\" + findData.cFileName);
+				} while (FindNextFileW(hFind, &findData));
+
+				FindClose(hFind);
+			}
+		}
+
+		else {
+			dumps.push_back(argv[i]);
+		}
+	}
+
+	if (dumps.empty()) {
+		wprintf(L"ERROR - DumpMinidumps(): no minidump given\n");
 
-	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
 		return false;
 	}
 
-	IDiaSectionContrib * pSecContrib;
-	ULONG celt = 0;
+	CoInitialize(NULL);
 
-	if (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
-		PrintSpecificDword(pSession, pSecContrib, filename, name);
-		pSecContrib->Release();
-		putwchar(L'\n');
+	LARGE_INTEGER freq, t0, t1;
+	DWORD cFrames = 0;
+	DWORD cFailed = 0;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
+
+	for (const std::wstring & dump : dumps) {
+		if (!DumpMinidump(dump.c_str(), map, &cFrames)) {
+			cFailed++;
+		}
 	}
 
-	pEnumSecContribs->Release();
+	QueryPerformanceCounter(&t1);
 
-	putwchar(L'\n');
+	wprintf(L"*** %u minidumps (%u failed), %u frames, %u PDBs loaded, %u session cache hits, %.2f s\n",
+		(DWORD)dumps.size(), cFailed, cFrames, g_cMinidumpSessionLoads, g_cMinidumpSessionHits,
+		(double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart);
 
-	return true;
+	for (auto & entry : g_minidumpSessions) {
+		MinidumpModuleSession * pModSession = entry.second;
+
+		if (pModSession != NULL) {
+			if (pModSession->pSession) {
+				pModSession->pSession->Release();
+			}
+
+			if (pModSession->pSource) {
+				pModSession->pSource->Release();
+			}
+
+			delete pModSession;
+		}
+	}
+
+	g_minidumpSessions.clear();
+
+	CoUninitialize();
+
+	return cFailed == 0;
 }
 
-bool DumpCompilandContrib(IDiaSession * pSession, IDiaSymbol * pGlobal, const wchar_t * szCompName)
-{
-	wprintf(L"\n\n*** COMPILAND SECTION CONTRIBUTION\n\n");
+#define PDB_DIFF_ROWS 20
 
-	std::wstring s = szCompName;
-	bool wasfound = false;
+static const wchar_t * const g_rgszDiffKinds[PDB_DIFF_KINDS] = {L"Functions", L"Publics", L"Globals", L"Contributions"};
+static const wchar_t * const g_rgszDiffChanges[PDB_DIFF_CHANGES] = {L"added", L"removed", L"resized", L"changed"};
 
-	IDiaEnumSectionContribs * pEnumSecContribs;
+////////////////////////////////////////////////////////////
+// Structural diff of the PDBs of two builds
+//
+//  Arguments: <old.pdb> <new.pdb> [n], n being the number of
+//  changes printed per kind. Prints what was added, removed,
+//  resized or changed, and the compilands whose size changed.
+//
+bool DumpPdbDiff(int argc, wchar_t * argv[])
+{
+	DWORD dwRows = PDB_DIFF_ROWS;
+
+	if (argc < 2 || (argc > 2 && swscanf_s(argv[2], L"%u", &dwRows) != 1)) {
+		wprintf(L"ERROR - DumpPdbDiff(): expected <old.pdb> <new.pdb> [n]\n");
 
-	if (FAILED(GetTable(pSession, __uuidof(IDiaEnumSectionContribs), (void **)&pEnumSecContribs))) {
 		return false;
 	}
 
-	//wprintf(L"    RVA        Address       Size      Module\n");
+	unsigned cThreads = std::thread::hardware_concurrency();
 
-	IDiaSectionContrib * pSecContrib;
-	ULONG celt = 0;
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
 
-	DWORD sect = 0;
-	while (SUCCEEDED(pEnumSecContribs->Next(1, &pSecContrib, &celt)) && (celt == 1)) {
-		IDiaSymbol *pCompiland;
-		if (FAILED(pSecContrib->get_compiland(&pCompiland))) {
-			continue;
-		}
-		pSecContrib->get_addressSection(&sect);
-		//only care about text
-		//if (sect != 1) {
-		//  break;
-		//}
+	PdbFile pdbs[2];
+	PdbSnapshot snapshots[2];
+	bool rgfLoaded[2];
+	LARGE_INTEGER freq, t0, t1, t2;
 
-		BSTR bstrName;
-		std::wstring n;
-		n.clear();
-		if (pCompiland->get_name(&bstrName) == S_OK) {
-			n = bstrName;
-			SysFreeString(bstrName);
-		}
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t0);
 
-		if (!n.empty() && n.find(s) != std::string::npos) {
-			if (!wasfound) {
-				wprintf(L"%s\n", n.c_str());
-				wasfound = true;
-			}
-			PrintSecContribs(pSession, pSecContrib);
-			putwchar(L'\n');
+	// Each build is loaded on its own thread, sharing the workers
 
-		}
+	auto load = [&](int i) {
+		rgfLoaded[i] = pdbs[i].Load(argv[i]) && snapshots[i].Load(pdbs[i], (cThreads > 1) ? cThreads / 2 : 1);
+	};
 
-		pSecContrib->Release();
+	std::thread loadOld(load, 0);
+
+	load(1);
+	loadOld.join();
 
+	for (int i = 0; i < 2; i++) {
+		if (!rgfLoaded[i]) {
+			wprintf(L"ERROR - DumpPdbDiff() could not read %s\n", argv[i]);
+
+			return false;
+		}
 	}
 
-	pEnumSecContribs->Release();
+	QueryPerformanceCounter(&t1);
 
-	if (!wasfound)
-	{
-		wprintf(L"Could not find %s\n\n", s.c_str());
+	PdbDiffResult result;
+
+	DiffPdbSnapshots(snapshots[0], snapshots[1], cThreads, result);
+
+	QueryPerformanceCounter(&t2);
+
+	wprintf(L"*** PDB diff %s -> %s, %u threads, loaded in %.2f s, joined in %.2f s\n", argv[0], argv[1], cThreads,
+		(double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart,
+		(double)(t2.QuadPart - t1.QuadPart) / (double)freq.QuadPart);
+
+	for (int kind = 0; kind < PDB_DIFF_KINDS; kind++) {
+		const std::vector<PdbDiffChange> & changes = result.changes[kind];
+
+		wprintf(L"\n*** %s: %u -> %u, %u added, %u removed, %u resized, %u changed\n\n", g_rgszDiffKinds[kind],
+			(DWORD)snapshots[0].Entities(kind).size(), (DWORD)snapshots[1].Entities(kind).size(),
+			result.rgCount[kind][PDB_DIFF_ADDED], result.rgCount[kind][PDB_DIFF_REMOVED],
+			result.rgCount[kind][PDB_DIFF_RESIZED], result.rgCount[kind][PDB_DIFF_CHANGED]);
+
+		for (size_t i = 0; i < changes.size() && i < dwRows; i++) {
+			const PdbDiffChange & change = changes[i];
+			const PdbDiffEntity * pEntity = (change.pNew != NULL) ? change.pNew : change.pOld;
+
+			wprintf(L"%-8s %+10lld  %S\n", g_rgszDiffChanges[change.change], change.cbDelta, pEntity->name.c_str());
+		}
 	}
 
-	putwchar(L'\n');
+	wprintf(L"\n*** Compilands: %u changed size\n\n", (DWORD)result.modules.size());
+
+	for (size_t i = 0; i < result.modules.size() && i < dwRows; i++) {
+		const PdbDiffModule & module = result.modules[i];
+
+		wprintf(L"%10llu %10llu %+10lld  %S\n", module.cbOld, module.cbNew,
+			(long long)module.cbNew - (long long)module.cbOld, module.name.c_str());
+	}
 
 	return true;
-}
\ No newline at end of file
+}
@@ -5,6 +5,7 @@ extern IDiaDataSource * g_pDiaDataSource;
 extern IDiaSession * g_pDiaSession;
 extern IDiaSymbol * g_pGlobalSymbol;
 extern DWORD g_dwMachineType;
+extern ULONGLONG g_dwloadAddress;
 
 void PrintHelpOptions();
 bool ParseArg(int, wchar_t * []);
@@ -34,6 +35,11 @@ bool DumpAllSourceFiles(IDiaSession *, IDiaSymbol *);
 bool DumpAllFPO(IDiaSession *);
 bool DumpFPO(IDiaSession *, DWORD);
 bool DumpFPO(IDiaSession *, IDiaSymbol *, const wchar_t *);
+bool DumpFrameProgram(IDiaSession *, DWORD);
+bool DumpInlineFrames(IDiaSymbol *, DWORD);
+bool DumpUnwindX64(DWORD);
+bool LoadPeImage(const wchar_t *, bool);
+bool RequireImage();
 bool DumpSymbolWithRVA(IDiaSession *, DWORD, const wchar_t *);
 bool DumpSymbolsWithRegEx(IDiaSymbol *, const wchar_t *, const wchar_t *);
 bool DumpSymbolWithChildren(IDiaSymbol *, const wchar_t *);
@@ -42,6 +48,22 @@ bool DumpLines(IDiaSession *, IDiaSymbol *, const wchar_t *);
 bool DumpType(IDiaSymbol *, const wchar_t *);
 bool DumpLinesForSourceFile(IDiaSession *, const wchar_t *, DWORD);
 bool DumpPublicSymbolsSorted(IDiaSession *, DWORD, DWORD, bool);
+bool DumpPerfMap(IDiaSession *, DWORD, const wchar_t *, bool);
+bool DumpProfile(IDiaSession *, IDiaSymbol *, const wchar_t *, const wchar_t *);
+bool DumpLinkOrder(IDiaSession *, const wchar_t *, const wchar_t *);
+bool DumpSizeReport(IDiaSession *, DWORD, const wchar_t *);
+bool DumpIcfCandidates(IDiaSession *, DWORD);
+bool DumpOdrViolations(IDiaSymbol *, DWORD);
+bool DumpPadding(IDiaSymbol *, DWORD, const wchar_t *);
+bool DumpFieldPaths(IDiaSymbol *, const wchar_t *);
+bool DumpTypedMemory(IDiaSymbol *, const wchar_t *, const wchar_t *, const wchar_t *, DWORD);
+bool DumpHeaders(IDiaSymbol *, const wchar_t *, const wchar_t *, DWORD);
+bool DumpHierarchy(IDiaSymbol *, const wchar_t *, DWORD);
+bool DumpVTables(IDiaSymbol *, const wchar_t *, DWORD);
+bool DumpStaticInit(IDiaSymbol *, DWORD, const wchar_t *);
+bool DumpStackFrames(IDiaSymbol *, const wchar_t *, DWORD);
+bool DumpBuildFlags(IDiaSymbol *, const wchar_t *, const wchar_t *);
+bool DumpHeapSites(IDiaSymbol *, const wchar_t *, DWORD);
 bool DumpLabel(IDiaSession *, DWORD);
 bool DumpAnnotations(IDiaSession *, DWORD);
 bool DumpMapToSrc(IDiaSession *, DWORD);
@@ -58,3 +80,6 @@ const wchar_t * SzNameC7Reg(USHORT);
 bool DumpAllSpecificDwords(IDiaSession *, wchar_t *, wchar_t *);
 bool DumpCompilandContrib(IDiaSession *, IDiaSymbol *, const wchar_t *);
 bool DumpAllTypedefsAndConsts(IDiaSymbol *);
+bool DumpScrubBenchmark(IDiaSymbol *, DWORD);
+bool DumpMinidumps(int, wchar_t * []);
+bool DumpPdbDiff(int, wchar_t * []);
@@ -0,0 +1,339 @@
+// FieldResolver.cpp : Data addresses to global variable member paths
+//
+
+#include "FieldResolver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+#include "Util.h"
+
+#define S_LDATA32                   0x110C
+#define S_GDATA32                   0x110D
+
+#define FIELD_BLOCK_LAYOUTS         256
+#define FIELD_BLOCK_RVAS            4096
+#define FIELD_MAX_DEPTH             32
+
+struct FieldBlock
+{
+	std::vector<FieldLeaf> leaves;
+	std::vector<std::pair<uint32_t, uint32_t> > tables;
+	std::vector<char> paths;
+};
+
+////////////////////////////////////////////////////////////
+// The definition behind the const and volatile modifiers of a type
+//
+static uint32_t UnmodifiedType(const TpiStream & tpi, uint32_t ti)
+{
+	for (int depth = 0; depth < FIELD_MAX_DEPTH && tpi.Leaf(ti) == LF_MODIFIER; depth++) {
+		uint16_t cb;
+		const uint8_t * pb = tpi.Record(ti, &cb);
+
+		if (cb < 4) {
+			break;
+		}
+
+		ti = GetU32(pb);
+	}
+
+	return tpi.Definition(ti);
+}
+
+////////////////////////////////////////////////////////////
+// Append the leaves of a layout at an offset, inlining the nested
+//  UDTs and base classes
+//
+static void AddLeaves(const LayoutCache & cache, const UdtLayout & layout, uint64_t offBase, std::string & path, int depth,
+                      std::vector<FieldLeaf> & leaves, std::vector<char> & paths)
+{
+	const TpiStream & tpi = *cache.Types();
+	const LayoutMember * pMembers = cache.Members(layout);
+
+	for (uint32_t i = 0; i < layout.cMembers; i++) {
+		const LayoutMember & member = pMembers[i];
+		uint32_t type = (member.kind == LAYOUT_MEMBER || member.kind == LAYOUT_BASE) ? UnmodifiedType(tpi, member.type) : 0;
+		const UdtLayout * pNested = (type != 0 && depth < FIELD_MAX_DEPTH) ? cache.Find(type) : NULL;
+		size_t cchPath = path.size();
+
+		// Base class members are reached without naming the base
+
+		if (member.kind != LAYOUT_BASE) {
+			path += '.';
+			path += member.szName;
+		}
+
+		if (pNested != NULL) {
+			AddLeaves(cache, *pNested, offBase + member.offset, path, depth + 1, leaves, paths);
+		}
+
+		else if (member.kind != LAYOUT_BASE) {
+			FieldLeaf leaf = {offBase + member.offset, member.cb, type, (uint32_t)paths.size()};
+
+			leaves.push_back(leaf);
+			paths.insert(paths.end(), path.begin(), path.end());
+			paths.push_back('\0');
+		}
+
+		path.resize(cchPath);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Index the global variables and build the leaf table of every
+//  layout
+//
+bool FieldResolver::Build(const PdbFile & pdb, const LayoutCache & cache, unsigned cThreads)
+{
+	Clear();
+
+	if (cache.Types() == NULL || pdb.SymRecordStream() == PDB_STREAM_NONE || !pdb.ReadStream(pdb.SymRecordStream(), m_records)) {
+		return false;
+	}
+
+	m_pCache = &cache;
+
+	const TpiStream & tpi = *cache.Types();
+
+	for (size_t off = 0; off + 4 <= m_records.size(); ) {
+		const uint8_t * pRecord = &m_records[off];
+		uint16_t cbRecord = GetU16(pRecord);
+		uint16_t kind = GetU16(pRecord + 2);
+
+		if (cbRecord < 2 || off + 2 + cbRecord > m_records.size()) {
+			break;
+		}
+
+		GlobalVariable global;
+
+		if (cbRecord >= 13 && (kind == S_GDATA32 || kind == S_LDATA32) &&
+			pdb.SectionToRva(GetU16(pRecord + 12), GetU32(pRecord + 8), &global.rva) &&
+			memchr(pRecord + 14, '\0', cbRecord - 12) != NULL) {
+			global.type = GetU32(pRecord + 4);
+			global.cb = tpi.TypeSize(global.type);
+			global.szName = (const char *)pRecord + 14;
+			m_globals.push_back(global);
+		}
+
+		off += 2 + cbRecord;
+	}
+
+	// Aliases share an address, keep the largest
+
+	std::sort(m_globals.begin(), m_globals.end(),
+		[](const GlobalVariable & a, const GlobalVariable & b) { return a.rva < b.rva || (a.rva == b.rva && a.cb > b.cb); });
+	m_globals.erase(std::unique(m_globals.begin(), m_globals.end(),
+		[](const GlobalVariable & a, const GlobalVariable & b) { return a.rva == b.rva; }), m_globals.end());
+
+	BuildTables(cThreads);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Build the leaf tables, by blocks of layouts appended in layout
+//  order
+//
+void FieldResolver::BuildTables(unsigned cThreads)
+{
+	const LayoutCache & cache = *m_pCache;
+	const std::vector<UdtLayout> & layouts = cache.Layouts();
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	uint32_t cBlocks = ((uint32_t)layouts.size() + FIELD_BLOCK_LAYOUTS - 1) / FIELD_BLOCK_LAYOUTS;
+	std::vector<FieldBlock> blocks(cBlocks);
+	std::atomic<uint32_t> iNextBlock(0);
+
+	auto worker = [&](unsigned) {
+		std::string path;
+
+		for (uint32_t iBlock; (iBlock = iNextBlock++) < cBlocks; ) {
+			FieldBlock & block = blocks[iBlock];
+			uint32_t iEnd = std::min<uint32_t>((iBlock + 1) * FIELD_BLOCK_LAYOUTS, (uint32_t)layouts.size());
+
+			for (uint32_t iLayout = iBlock * FIELD_BLOCK_LAYOUTS; iLayout < iEnd; iLayout++) {
+				size_t iFirst = block.leaves.size();
+
+				path.clear();
+				AddLeaves(cache, layouts[iLayout], 0, path, 0, block.leaves, block.paths);
+
+				// Overlapping leaves come from unions and bitfields, the
+				//  largest one starting first covers them
+
+				auto itFirst = block.leaves.begin() + iFirst;
+
+				std::stable_sort(itFirst, block.leaves.end(),
+					[](const FieldLeaf & a, const FieldLeaf & b) { return a.offset < b.offset || (a.offset == b.offset && a.cb > b.cb); });
+
+				uint64_t offEnd = 0;
+
+				block.leaves.erase(std::remove_if(itFirst, block.leaves.end(),
+					[&](const FieldLeaf & leaf) {
+						if (leaf.offset < offEnd) {
+							return true;
+						}
+
+						offEnd = leaf.offset + (leaf.cb ? leaf.cb : 1);
+
+						return false;
+					}), block.leaves.end());
+
+				block.tables.push_back(std::make_pair((uint32_t)iFirst, (uint32_t)(block.leaves.size() - iFirst)));
+			}
+		}
+	};
+
+	RunParallel(cThreads, worker);
+
+	for (FieldBlock & block : blocks) {
+		uint32_t iFirstLeaf = (uint32_t)m_leaves.size();
+		uint32_t offFirstPath = (uint32_t)m_paths.size();
+
+		for (FieldLeaf & leaf : block.leaves) {
+			leaf.offPath += offFirstPath;
+		}
+
+		for (const auto & table : block.tables) {
+			m_tables.push_back(std::make_pair(table.first + iFirstLeaf, table.second));
+		}
+
+		m_leaves.insert(m_leaves.end(), block.leaves.begin(), block.leaves.end());
+		m_paths.insert(m_paths.end(), block.paths.begin(), block.paths.end());
+		std::vector<FieldLeaf>().swap(block.leaves);
+		std::vector<char>().swap(block.paths);
+	}
+}
+
+void FieldResolver::Clear()
+{
+	m_pCache = NULL;
+	std::vector<uint8_t>().swap(m_records);
+	std::vector<GlobalVariable>().swap(m_globals);
+	std::vector<FieldLeaf>().swap(m_leaves);
+	std::vector<std::pair<uint32_t, uint32_t> >().swap(m_tables);
+	std::vector<char>().swap(m_paths);
+}
+
+const GlobalVariable * FieldResolver::FindGlobal(uint32_t rva) const
+{
+	auto it = std::upper_bound(m_globals.begin(), m_globals.end(), rva,
+		[](uint32_t rva, const GlobalVariable & global) { return rva < global.rva; });
+
+	if (it == m_globals.begin()) {
+		return NULL;
+	}
+
+	--it;
+
+	return (rva - it->rva < (it->cb ? it->cb : 1)) ? &*it : NULL;
+}
+
+const FieldLeaf * FieldResolver::FindLeaf(uint32_t iLayout, uint64_t offset) const
+{
+	const FieldLeaf * pFirst = m_leaves.data() + m_tables[iLayout].first;
+	const FieldLeaf * pEnd = pFirst + m_tables[iLayout].second;
+	const FieldLeaf * pLeaf = std::upper_bound(pFirst, pEnd, offset,
+		[](uint64_t offset, const FieldLeaf & leaf) { return offset < leaf.offset; });
+
+	if (pLeaf == pFirst) {
+		return NULL;
+	}
+
+	--pLeaf;
+
+	return (offset - pLeaf->offset < (pLeaf->cb ? pLeaf->cb : 1)) ? pLeaf : NULL;
+}
+
+////////////////////////////////////////////////////////////
+// Resolve an RVA to "global.member[index].member+offset"
+//
+//  Returns false when the RVA is not inside a global variable.
+//
+bool FieldResolver::Resolve(uint32_t rva, std::string & path) const
+{
+	const GlobalVariable * pGlobal = FindGlobal(rva);
+
+	if (pGlobal == NULL) {
+		return false;
+	}
+
+	const TpiStream & tpi = *m_pCache->Types();
+	const UdtLayout * pLayouts = m_pCache->Layouts().data();
+	uint64_t offset = rva - pGlobal->rva;
+	uint32_t type = pGlobal->type;
+	char szIndex[32];
+
+	path = pGlobal->szName;
+
+	for (int depth = 0; depth < FIELD_MAX_DEPTH && type != 0; depth++) {
+		type = UnmodifiedType(tpi, type);
+
+		if (tpi.Leaf(type) == LF_ARRAY) {
+			uint16_t cb;
+			const uint8_t * pb = tpi.Record(type, &cb);
+			uint32_t element = (cb >= 4) ? GetU32(pb) : 0;
+			uint64_t cbElement = (element != 0) ? tpi.TypeSize(element) : 0;
+
+			if (cbElement == 0) {
+				break;
+			}
+
+			snprintf(szIndex, sizeof(szIndex), "[%llu]", (unsigned long long)(offset / cbElement));
+			path += szIndex;
+			offset %= cbElement;
+			type = element;
+
+			continue;
+		}
+
+		const UdtLayout * pLayout = m_pCache->Find(type);
+		const FieldLeaf * pLeaf = (pLayout != NULL) ? FindLeaf((uint32_t)(pLayout - pLayouts), offset) : NULL;
+
+		if (pLeaf == NULL) {
+			break;
+		}
+
+		path += &m_paths[pLeaf->offPath];
+		offset -= pLeaf->offset;
+		type = pLeaf->type;
+	}
+
+	if (offset != 0) {
+		snprintf(szIndex, sizeof(szIndex), "+0x%llX", (unsigned long long)offset);
+		path += szIndex;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Resolve many RVAs, "" for the ones outside the global variables
+//
+void FieldResolver::ResolveBatch(const std::vector<uint32_t> & rvas, unsigned cThreads, std::vector<std::string> & paths) const
+{
+	std::atomic<size_t> iNext(0);
+
+	paths.assign(rvas.size(), std::string());
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	auto worker = [&](unsigned) {
+		for (size_t iBegin; (iBegin = iNext.fetch_add(FIELD_BLOCK_RVAS)) < rvas.size(); ) {
+			size_t iEnd = std::min<size_t>(iBegin + FIELD_BLOCK_RVAS, rvas.size());
+
+			for (size_t i = iBegin; i < iEnd; i++) {
+				Resolve(rvas[i], paths[i]);
+			}
+		}
+	};
+
+	RunParallel(cThreads, worker);
+}
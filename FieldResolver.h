@@ -0,0 +1,68 @@
+// FieldResolver.h : Data addresses to global variable member paths
+//
+// Turns an RVA into the access path of the member it lands in, such
+// as "g_World.entities[37].transform.pos.y". The global variables of
+// the globals stream are kept as sorted intervals. Every UDT gets a
+// table of its leaves: nested structures and base classes are inlined
+// with their path, so only arrays of structures need another lookup.
+// The tables are built once on worker threads, after which resolving
+// is read only and batches are split across threads.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "LayoutCache.h"
+#include "PdbFile.h"
+
+struct GlobalVariable
+{
+	uint32_t rva;
+	uint32_t type;
+	uint64_t cb;
+	const char * szName;                 // points into the loaded records
+};
+
+// A scalar, pointer, enum or array member at a fixed offset in its UDT
+struct FieldLeaf
+{
+	uint64_t offset;
+	uint64_t cb;
+	uint32_t type;
+	uint32_t offPath;                    // ".transform.pos" relative to the UDT
+};
+
+////////////////////////////////////////////////////////////
+// Resolves RVAs to global variable member paths
+//
+//  Overlapping members resolve to one of them: the largest member
+//  of a union and the first bitfield of a storage unit. Padding and
+//  virtual base subobjects resolve to the enclosing path and an
+//  offset.
+//
+class FieldResolver
+{
+	public:
+	bool Build(const PdbFile & pdb, const LayoutCache & cache, unsigned cThreads);
+	void Clear();
+
+	uint32_t CountGlobals() const { return (uint32_t)m_globals.size(); }
+	uint32_t CountLeaves() const { return (uint32_t)m_leaves.size(); }
+	const GlobalVariable * FindGlobal(uint32_t rva) const;
+	bool Resolve(uint32_t rva, std::string & path) const;
+	void ResolveBatch(const std::vector<uint32_t> & rvas, unsigned cThreads, std::vector<std::string> & paths) const;
+
+	private:
+	void BuildTables(unsigned cThreads);
+	const FieldLeaf * FindLeaf(uint32_t iLayout, uint64_t offset) const;
+
+	const LayoutCache * m_pCache = NULL;
+	std::vector<uint8_t> m_records;
+	std::vector<GlobalVariable> m_globals;             // by rva
+	std::vector<FieldLeaf> m_leaves;
+	std::vector<std::pair<uint32_t, uint32_t> > m_tables;   // first leaf, count per layout
+	std::vector<char> m_paths;
+};
@@ -0,0 +1,584 @@
+// FrameProgram.cpp : Compiler and evaluator for x86 frame data programs
+//
+// A program is a sequence of postfix expressions, each assigning a value
+// to a register or temporary, e.g.
+//
+//   $T0 $ebp = $eip $T0 4 + ^ = $ebp $T0 ^ = $esp $T0 8 + =
+//
+// Assignments to registers define the register values of the caller.
+//
+
+#include "FrameProgram.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char * const rgFrameVarNames[] =
+{
+	"$eax",
+	"$ecx",
+	"$edx",
+	"$ebx",
+	"$esp",
+	"$ebp",
+	"$esi",
+	"$edi",
+	"$eip",
+	"$T0",
+	"$T1",
+	"$T2",
+	"$T3",
+	"$T4",
+	"$T5",
+	"$T6",
+	"$T7",
+	"$T8",
+	"$T9",
+	"$L",
+	"$P",
+	".raSearch",
+	".raSearchStart",
+	".cbLocals",
+	".cbParams",
+	".cbSavedRegs",
+	".cbCalleeParams",
+	".cbMaxStack",
+};
+
+static_assert(sizeof(rgFrameVarNames) / sizeof(rgFrameVarNames[0]) == FrameVarMax, "rgFrameVarNames out of sync");
+
+// Programs used for FPO_DATA records that have no program string
+static const char szProgramFpo[] = "$T0 .raSearchStart = $eip $T0 ^ = $esp $T0 4 + =";
+static const char szProgramEbp[] = "$T0 $ebp = $eip $T0 4 + ^ = $ebp $T0 ^ = $esp $T0 8 + =";
+
+////////////////////////////////////////////////////////////
+// MemorySnapshot
+//
+void MemorySnapshot::AddRange(uint64_t qwBase, const uint8_t * pb, uint64_t cb)
+{
+	Range range = {qwBase, cb, pb};
+
+	// Keep the ranges sorted, they are usually added in address order
+
+	if (m_ranges.empty() || !(range < m_ranges.back())) {
+		m_ranges.push_back(range);
+	}
+
+	else {
+		m_ranges.insert(std::upper_bound(m_ranges.begin(), m_ranges.end(), range), range);
+	}
+}
+
+void MemorySnapshot::Clear()
+{
+	m_ranges.clear();
+}
+
+bool MemorySnapshot::Read(uint64_t qwAddress, void * pv, uint32_t cb) const
+{
+	const uint8_t * pb = Pointer(qwAddress, cb);
+
+	if (pb == NULL) {
+		return false;
+	}
+
+	memcpy(pv, pb, cb);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// The captured bytes of a range, in place, NULL unless all cb
+//  bytes are in the same range
+//
+const uint8_t * MemorySnapshot::Pointer(uint64_t qwAddress, uint64_t cb) const
+{
+	Range key = {qwAddress, 0, NULL};
+	auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), key);
+
+	if (it == m_ranges.begin()) {
+		return NULL;
+	}
+
+	--it;
+
+	if (qwAddress - it->qwBase > it->cb || it->cb - (qwAddress - it->qwBase) < cb) {
+		return NULL;
+	}
+
+	return it->pb + (qwAddress - it->qwBase);
+}
+
+////////////////////////////////////////////////////////////
+// Map a program token to a FrameVar, FrameVarMax if unknown
+//
+static int LookupFrameVar(const char * szToken, size_t cch)
+{
+	for (int i = 0; i < FrameVarMax; i++) {
+		if (strlen(rgFrameVarNames[i]) == cch && strncmp(rgFrameVarNames[i], szToken, cch) == 0) {
+			return i;
+		}
+	}
+
+	return FrameVarMax;
+}
+
+static bool IsAssignableFrameVar(int var)
+{
+	return var <= FrameVarP;
+}
+
+////////////////////////////////////////////////////////////
+// Compile a program string to bytecode, appending to code
+//
+//  Each stack slot of the compiler remembers the code span
+//  that produces it, so '=' can turn the lvalue push into a
+//  store after the value expression.
+//
+bool CompileFrameProgram(const char * szProgram, std::vector<uint8_t> & code)
+{
+	struct Span
+	{
+		size_t iStart;
+		int var;                         // FrameVarMax unless a lone variable push
+	};
+
+	Span rgStack[FRAME_STACK_MAX];
+	size_t cStack = 0;
+	size_t iBase = code.size();
+	const char * p = szProgram;
+
+	for (;;) {
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+			p++;
+		}
+
+		if (*p == '\0') {
+			break;
+		}
+
+		const char * szToken = p;
+
+		while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+			p++;
+		}
+
+		size_t cch = p - szToken;
+		size_t iStart = code.size();
+
+		if (cch == 1 && strchr("+-*/%^@=", *szToken) != NULL) {
+			FrameOp op;
+
+			switch (*szToken) {
+				case '+': op = FrameOpAdd; break;
+				case '-': op = FrameOpSub; break;
+				case '*': op = FrameOpMul; break;
+				case '/': op = FrameOpDiv; break;
+				case '%': op = FrameOpMod; break;
+				case '@': op = FrameOpAlign; break;
+				case '^': op = FrameOpDeref; break;
+				default:  op = FrameOpStore; break;
+			}
+
+			if (op == FrameOpDeref) {
+				if (cStack < 1) {
+					goto Error;
+				}
+
+				code.push_back((uint8_t)op);
+				rgStack[cStack - 1].var = FrameVarMax;
+			}
+
+			else if (op == FrameOpStore) {
+				if (cStack < 2) {
+					goto Error;
+				}
+
+				Span & lhs = rgStack[cStack - 2];
+
+				if (!IsAssignableFrameVar(lhs.var)) {
+					goto Error;
+				}
+
+				// Drop the 2 byte push of the lvalue, the value is now on top
+
+				code.erase(code.begin() + lhs.iStart, code.begin() + lhs.iStart + 2);
+				code.push_back((uint8_t)FrameOpStore);
+				code.push_back((uint8_t)lhs.var);
+				cStack -= 2;
+			}
+
+			else {
+				if (cStack < 2) {
+					goto Error;
+				}
+
+				code.push_back((uint8_t)op);
+				cStack--;
+				rgStack[cStack - 1].var = FrameVarMax;
+			}
+
+			continue;
+		}
+
+		if (cStack == FRAME_STACK_MAX) {
+			goto Error;
+		}
+
+		if (*szToken == '$' || *szToken == '.') {
+			int var = LookupFrameVar(szToken, cch);
+
+			if (var == FrameVarMax) {
+				goto Error;
+			}
+
+			code.push_back((uint8_t)FrameOpPushVar);
+			code.push_back((uint8_t)var);
+			rgStack[cStack].iStart = iStart;
+			rgStack[cStack].var = var;
+			cStack++;
+		}
+
+		else if (*szToken >= '0' && *szToken <= '9') {
+			char * pEnd;
+			uint32_t value = (uint32_t)strtoul(szToken, &pEnd, 0);
+
+			if (pEnd != p) {
+				goto Error;
+			}
+
+			code.push_back((uint8_t)FrameOpPushConst);
+			code.push_back((uint8_t)(value));
+			code.push_back((uint8_t)(value >> 8));
+			code.push_back((uint8_t)(value >> 16));
+			code.push_back((uint8_t)(value >> 24));
+			rgStack[cStack].iStart = iStart;
+			rgStack[cStack].var = FrameVarMax;
+			cStack++;
+		}
+
+		else {
+			goto Error;
+		}
+	}
+
+	// Every expression must have ended in an assignment
+
+	if (cStack != 0 || code.size() == iBase) {
+		goto Error;
+	}
+
+	code.push_back((uint8_t)FrameOpEnd);
+
+	return true;
+
+Error:
+	code.resize(iBase);
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////
+// Turn bytecode back into text, one instruction per line
+//
+void DisasmFrameProgram(const uint8_t * pCode, std::string & text)
+{
+	static const char * const rgOpNames[] =
+	{
+		"push", "push", "store", "add", "sub", "mul", "div", "mod", "deref", "align", "end"
+	};
+
+	char szLine[64];
+
+	for (;;) {
+		uint8_t op = *pCode++;
+
+		switch (op) {
+			case FrameOpPushVar:
+			case FrameOpStore:
+				snprintf(szLine, sizeof(szLine), "  %-6s %s\n", rgOpNames[op], rgFrameVarNames[*pCode]);
+				pCode++;
+				break;
+
+			case FrameOpPushConst:
+			{
+				uint32_t value = pCode[0] | (pCode[1] << 8) | (pCode[2] << 16) | ((uint32_t)pCode[3] << 24);
+
+				snprintf(szLine, sizeof(szLine), "  %-6s 0x%X\n", rgOpNames[op], value);
+				pCode += 4;
+			}
+			break;
+
+			default:
+				snprintf(szLine, sizeof(szLine), "  %s\n", (op <= FrameOpEnd) ? rgOpNames[op] : "???");
+				break;
+		}
+
+		text += szLine;
+
+		if (op >= FrameOpEnd) {
+			break;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Run a compiled program for the callee frame, producing the
+//  register state of the caller
+//
+//  .raSearch is taken as .raSearchStart, there is no scan for
+//  a plausible return address since code ranges are unknown
+//  at this level.
+//
+bool EvalFrameProgram(const uint8_t * pCode,
+                      const FrameRecord & rec,
+                      uint32_t cbCalleeParams,
+                      const MemoryReader & mem,
+                      const X86Context & callee,
+                      X86Context & caller)
+{
+	uint32_t rgVar[FrameVarMax];
+	uint32_t fValid = callee.fValid & ((1u << FRAME_REG_COUNT) - 1);
+	uint32_t rgStack[FRAME_STACK_MAX];
+	size_t cStack = 0;
+
+	memcpy(rgVar, callee.rgReg, sizeof(callee.rgReg));
+
+	if (!(fValid & (1u << FrameVarEsp))) {
+		return false;
+	}
+
+	rgVar[FrameVarCbLocals] = rec.cbLocals;
+	rgVar[FrameVarCbParams] = rec.cbParams;
+	rgVar[FrameVarCbSavedRegs] = rec.cbSavedRegs;
+	rgVar[FrameVarCbCalleeParams] = cbCalleeParams;
+	rgVar[FrameVarCbMaxStack] = rec.cbMaxStack;
+	rgVar[FrameVarRaSearchStart] = callee.rgReg[FrameVarEsp] + cbCalleeParams + rec.cbLocals + rec.cbSavedRegs;
+	rgVar[FrameVarRaSearch] = rgVar[FrameVarRaSearchStart];
+	fValid |= (1u << FrameVarCbLocals) | (1u << FrameVarCbParams) | (1u << FrameVarCbSavedRegs) |
+		(1u << FrameVarCbCalleeParams) | (1u << FrameVarCbMaxStack) |
+		(1u << FrameVarRaSearchStart) | (1u << FrameVarRaSearch);
+
+	// The compiler guarantees stack depth and operand counts
+
+	for (;;) {
+		uint32_t a, b;
+
+		switch (*pCode++) {
+			case FrameOpPushVar:
+				if (!(fValid & (1u << *pCode))) {
+					return false;
+				}
+
+				rgStack[cStack++] = rgVar[*pCode++];
+				break;
+
+			case FrameOpPushConst:
+				rgStack[cStack++] = pCode[0] | (pCode[1] << 8) | (pCode[2] << 16) | ((uint32_t)pCode[3] << 24);
+				pCode += 4;
+				break;
+
+			case FrameOpStore:
+				rgVar[*pCode] = rgStack[--cStack];
+				fValid |= 1u << *pCode++;
+				break;
+
+			case FrameOpDeref:
+				if (!mem.Read(rgStack[cStack - 1], &a, sizeof(a))) {
+					return false;
+				}
+
+				rgStack[cStack - 1] = a;
+				break;
+
+			case FrameOpEnd:
+				if ((fValid & ((1u << FrameVarEip) | (1u << FrameVarEsp))) != ((1u << FrameVarEip) | (1u << FrameVarEsp))) {
+					return false;
+				}
+
+				memcpy(caller.rgReg, rgVar, sizeof(caller.rgReg));
+				caller.fValid = fValid & ((1u << FRAME_REG_COUNT) - 1);
+
+				return true;
+
+			default:
+				b = rgStack[--cStack];
+				a = rgStack[cStack - 1];
+
+				switch (pCode[-1]) {
+					case FrameOpAdd: a += b; break;
+					case FrameOpSub: a -= b; break;
+					case FrameOpMul: a *= b; break;
+
+					case FrameOpDiv:
+					case FrameOpMod:
+						if (b == 0) {
+							return false;
+						}
+
+						a = (pCode[-1] == FrameOpDiv) ? a / b : a % b;
+						break;
+
+					case FrameOpAlign:
+						if (b == 0 || (b & (b - 1)) != 0) {
+							return false;
+						}
+
+						a &= ~(b - 1);
+						break;
+
+					default:
+						return false;
+				}
+
+				rgStack[cStack - 1] = a;
+				break;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// FrameIndex
+//
+FrameIndex::FrameIndex() :
+	m_cbMaxBlock(0),
+	m_cPrograms(0),
+	m_cFailed(0)
+{
+}
+
+////////////////////////////////////////////////////////////
+// Add a record, compiling its program unless an identical
+//  one was compiled before
+//
+void FrameIndex::Add(const FrameRecord & rec, const char * szProgram, bool fUsesBasePointer)
+{
+	FrameRecord entry = rec;
+
+	if (szProgram == NULL || *szProgram == '\0') {
+		szProgram = fUsesBasePointer ? szProgramEbp : szProgramFpo;
+	}
+
+	auto it = m_programs.find(szProgram);
+
+	if (it != m_programs.end()) {
+		entry.iCode = it->second;
+	}
+
+	else {
+		entry.iCode = (uint32_t)m_code.size();
+
+		if (!CompileFrameProgram(szProgram, m_code)) {
+			entry.iCode = FRAME_CODE_NONE;
+			m_cFailed++;
+		}
+
+		else {
+			m_cPrograms++;
+		}
+
+		m_programs.insert(std::make_pair(std::string(szProgram), entry.iCode));
+	}
+
+	if (entry.cbBlock > m_cbMaxBlock) {
+		m_cbMaxBlock = entry.cbBlock;
+	}
+
+	m_records.push_back(entry);
+}
+
+////////////////////////////////////////////////////////////
+// Sort the records, the program strings are not needed anymore
+//
+void FrameIndex::Finish()
+{
+	std::stable_sort(m_records.begin(), m_records.end(),
+		[](const FrameRecord & a, const FrameRecord & b) { return a.rva < b.rva; });
+
+	std::unordered_map<std::string, uint32_t>().swap(m_programs);
+}
+
+////////////////////////////////////////////////////////////
+// Find the innermost record covering rva
+//
+//  Records may nest (e.g. after a prolog), so walk back from
+//  the last record starting at or below rva while a record of
+//  the largest block size could still reach it.
+//
+const FrameRecord * FrameIndex::Find(uint32_t rva) const
+{
+	auto it = std::upper_bound(m_records.begin(), m_records.end(), rva,
+		[](uint32_t value, const FrameRecord & rec) { return value < rec.rva; });
+
+	while (it != m_records.begin()) {
+		--it;
+
+		if (rva - it->rva >= m_cbMaxBlock) {
+			break;
+		}
+
+		if (rva - it->rva < it->cbBlock) {
+			return &*it;
+		}
+	}
+
+	return NULL;
+}
+
+const uint8_t * FrameIndex::Code(const FrameRecord & rec) const
+{
+	return (rec.iCode == FRAME_CODE_NONE) ? NULL : &m_code[rec.iCode];
+}
+
+////////////////////////////////////////////////////////////
+// Unwind one x86 frame in place
+//
+//  *pcbCalleeParams is the parameter size of the frame being
+//  unwound from on input, and the one of the unwound frame on
+//  output. Without a frame record the ebp chain is followed.
+//
+bool UnwindX86Frame(const FrameIndex & index,
+                    uint32_t dwModuleBase,
+                    const MemoryReader & mem,
+                    uint32_t * pcbCalleeParams,
+                    X86Context & ctx)
+{
+	// Compiled once by the initializer, which unlike filling the
+	//  vector on first use is safe when threads unwind at once
+
+	static const std::vector<uint8_t> codeEbp = [] {
+		std::vector<uint8_t> code;
+
+		CompileFrameProgram(szProgramEbp, code);
+
+		return code;
+	}();
+
+	FrameRecord recNone = {};
+	const FrameRecord * pRec = index.Find(ctx.rgReg[FrameVarEip] - dwModuleBase);
+	const uint8_t * pCode = (pRec != NULL) ? index.Code(*pRec) : NULL;
+
+	if (pCode == NULL) {
+		pRec = &recNone;
+		pCode = codeEbp.data();
+	}
+
+	X86Context caller;
+
+	if (!EvalFrameProgram(pCode, *pRec, *pcbCalleeParams, mem, ctx, caller)) {
+		return false;
+	}
+
+	// The stack only grows down, anything else would loop forever
+
+	if (caller.rgReg[FrameVarEsp] <= ctx.rgReg[FrameVarEsp] || caller.rgReg[FrameVarEip] == 0) {
+		return false;
+	}
+
+	*pcbCalleeParams = pRec->cbParams;
+	ctx = caller;
+
+	return true;
+}
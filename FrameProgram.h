@@ -0,0 +1,161 @@
+// FrameProgram.h : Compiler and evaluator for x86 frame data programs
+//
+// The program strings of IDiaFrameData (e.g. "$T0 $ebp = $eip $T0 4 + ^ =")
+// are compiled once to a small bytecode and evaluated against register
+// and memory snapshots. Nothing in here depends on DIA or Windows, so
+// the stack walker can run wherever the snapshots come from.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Registers, temporaries and pseudo variables a program can reference
+enum FrameVar
+{
+	FrameVarEax,
+	FrameVarEcx,
+	FrameVarEdx,
+	FrameVarEbx,
+	FrameVarEsp,
+	FrameVarEbp,
+	FrameVarEsi,
+	FrameVarEdi,
+	FrameVarEip,
+	FrameVarT0,
+	FrameVarT9 = FrameVarT0 + 9,
+	FrameVarL,                           // $L, locals base
+	FrameVarP,                           // $P, params base
+	FrameVarRaSearch,                    // .raSearch
+	FrameVarRaSearchStart,               // .raSearchStart
+	FrameVarCbLocals,                    // .cbLocals
+	FrameVarCbParams,                    // .cbParams
+	FrameVarCbSavedRegs,                 // .cbSavedRegs
+	FrameVarCbCalleeParams,              // .cbCalleeParams
+	FrameVarCbMaxStack,                  // .cbMaxStack
+	FrameVarMax
+};
+
+#define FRAME_REG_COUNT     (FrameVarEip + 1)
+#define FRAME_STACK_MAX     16
+#define FRAME_CODE_NONE     0xFFFFFFFF
+
+enum FrameOp
+{
+	FrameOpPushVar,                      // FrameVar follows, 1 byte
+	FrameOpPushConst,                    // uint32_t follows, little endian
+	FrameOpStore,                        // FrameVar follows, 1 byte
+	FrameOpAdd,
+	FrameOpSub,
+	FrameOpMul,
+	FrameOpDiv,
+	FrameOpMod,
+	FrameOpDeref,                        // ^
+	FrameOpAlign,                        // @
+	FrameOpEnd
+};
+
+// Register state of one frame, fValid has a bit per FrameVar register
+struct X86Context
+{
+	uint32_t rgReg[FRAME_REG_COUNT];
+	uint32_t fValid;
+};
+
+////////////////////////////////////////////////////////////
+// Read access to the memory of the target
+//
+class MemoryReader
+{
+	public:
+	virtual ~MemoryReader() {}
+	virtual bool Read(uint64_t qwAddress, void * pv, uint32_t cb) const = 0;
+};
+
+////////////////////////////////////////////////////////////
+// A set of captured memory ranges, e.g. the ranges of a
+//  minidump. The bytes are not copied, they must outlive
+//  the snapshot.
+//
+class MemorySnapshot : public MemoryReader
+{
+	public:
+	void AddRange(uint64_t qwBase, const uint8_t * pb, uint64_t cb);
+	void Clear();
+	bool Read(uint64_t qwAddress, void * pv, uint32_t cb) const;
+	const uint8_t * Pointer(uint64_t qwAddress, uint64_t cb) const;
+
+	private:
+	struct Range
+	{
+		uint64_t qwBase;
+		uint64_t cb;
+		const uint8_t * pb;
+
+		bool operator<(const Range & other) const { return qwBase < other.qwBase; }
+	};
+
+	std::vector<Range> m_ranges;
+};
+
+// One frame data record with the offset of its compiled program
+struct FrameRecord
+{
+	uint32_t rva;
+	uint32_t cbBlock;
+	uint32_t cbLocals;
+	uint32_t cbParams;
+	uint32_t cbSavedRegs;
+	uint32_t cbMaxStack;
+	uint32_t cbProlog;
+	uint32_t iCode;
+};
+
+////////////////////////////////////////////////////////////
+// Address sorted frame data records
+//
+//  Every distinct program string is compiled once; records
+//  sharing a program share its bytecode.
+//
+class FrameIndex
+{
+	public:
+	FrameIndex();
+
+	void Add(const FrameRecord & rec, const char * szProgram, bool fUsesBasePointer);
+	void Finish();
+
+	const FrameRecord * Find(uint32_t rva) const;
+	const uint8_t * Code(const FrameRecord & rec) const;
+
+	size_t Count() const { return m_records.size(); }
+	size_t CountPrograms() const { return m_cPrograms; }
+	size_t CountFailed() const { return m_cFailed; }
+	size_t CodeSize() const { return m_code.size(); }
+	const FrameRecord & Record(size_t i) const { return m_records[i]; }
+
+	private:
+	std::vector<FrameRecord> m_records;
+	std::vector<uint8_t> m_code;
+	std::unordered_map<std::string, uint32_t> m_programs;
+	uint32_t m_cbMaxBlock;
+	size_t m_cPrograms;
+	size_t m_cFailed;
+};
+
+bool CompileFrameProgram(const char * szProgram, std::vector<uint8_t> & code);
+void DisasmFrameProgram(const uint8_t * pCode, std::string & text);
+bool EvalFrameProgram(const uint8_t * pCode,
+                      const FrameRecord & rec,
+                      uint32_t cbCalleeParams,
+                      const MemoryReader & mem,
+                      const X86Context & callee,
+                      X86Context & caller);
+bool UnwindX86Frame(const FrameIndex & index,
+                    uint32_t dwModuleBase,
+                    const MemoryReader & mem,
+                    uint32_t * pcbCalleeParams,
+                    X86Context & ctx);
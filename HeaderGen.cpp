@@ -0,0 +1,973 @@
+// HeaderGen.cpp : C++ headers from the TPI types of a PDB
+//
+
+#include "HeaderGen.h"
+
+#include <algorithm>
+#include <atomic>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Util.h"
+
+#define S_UDT                       0x1108
+
+#define HEADER_MAX_DEPTH            32
+
+////////////////////////////////////////////////////////////
+// The spelling of the basic types, fixed width where the size of
+//  the C type differs between compilers
+//
+static const char * SimpleTypeName(uint32_t ti)
+{
+	switch (ti & 0xFF) {
+		case 0x03: return "void";
+		case 0x08: return "int32_t";
+		case 0x10: return "signed char";
+		case 0x11: return "short";
+		case 0x12: return "int32_t";
+		case 0x13: return "int64_t";
+		case 0x20: return "unsigned char";
+		case 0x21: return "unsigned short";
+		case 0x22: return "uint32_t";
+		case 0x23: return "uint64_t";
+		case 0x30: return "bool";
+		case 0x40: return "float";
+		case 0x41: return "double";
+		case 0x42: return "long double";
+		case 0x68: return "int8_t";
+		case 0x69: return "uint8_t";
+		case 0x70: return "char";
+		case 0x71: return "wchar_t";
+		case 0x72: return "int16_t";
+		case 0x73: return "uint16_t";
+		case 0x74: return "int";
+		case 0x75: return "unsigned int";
+		case 0x76: return "int64_t";
+		case 0x77: return "uint64_t";
+		case 0x7A: return "char16_t";
+		case 0x7B: return "char32_t";
+		case 0x7C: return "uint8_t";
+	}
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////
+// A member or enumerator name as an identifier
+//
+static std::string Identifier(const char * szName)
+{
+	std::string id;
+
+	for (const char * pch = szName; *pch != '\0'; pch++) {
+		id += (isalnum((unsigned char)*pch) || *pch == '_') ? *pch : '_';
+	}
+
+	if (id.empty() || isdigit((unsigned char)id[0])) {
+		id.insert(0, "_");
+	}
+
+	return id;
+}
+
+static void AppendFormat(std::string & text, const char * szFormat, unsigned long long value)
+{
+	char szBuffer[64];
+
+	snprintf(szBuffer, sizeof(szBuffer), szFormat, value);
+	text += szBuffer;
+}
+
+HeaderGenerator::HeaderGenerator(const LayoutCache & cache) :
+	m_cache(cache), m_tpi(*cache.Types())
+{
+}
+
+////////////////////////////////////////////////////////////
+// Read the typedefs from the S_UDT records of the globals
+//
+//  The ones naming a UDT or enum after itself only repeat the tag.
+//
+bool HeaderGenerator::LoadTypedefs(const PdbFile & pdb)
+{
+	std::vector<uint8_t> records;
+	TpiUdt udt;
+
+	if (pdb.SymRecordStream() == PDB_STREAM_NONE || !pdb.ReadStream(pdb.SymRecordStream(), records)) {
+		return false;
+	}
+
+	for (size_t off = 0; off + 4 <= records.size(); ) {
+		const uint8_t * pRecord = &records[off];
+		uint16_t cbRecord = GetU16(pRecord);
+
+		if (cbRecord < 2 || off + 2 + cbRecord > records.size()) {
+			break;
+		}
+
+		if (cbRecord >= 7 && GetU16(pRecord + 2) == S_UDT && memchr(pRecord + 8, '\0', cbRecord - 6) != NULL) {
+			const char * szName = (const char *)pRecord + 8;
+			uint32_t ti = GetU32(pRecord + 4);
+
+			if (!(m_tpi.GetUdt(m_tpi.Definition(ti), udt) && !strcmp(udt.szName, szName))) {
+				m_typedefs.emplace(szName, ti);
+			}
+		}
+
+		off += 2 + cbRecord;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Make a type name into an identifier no other type has
+//
+//  "std::pair<int,float>" becomes "std__pair_int_float", unnamed
+//  types are named after their type index.
+//
+std::string HeaderGenerator::MakeIdentifier(const char * szName, uint32_t ti)
+{
+	std::string id;
+
+	if (szName == NULL || szName[0] == '\0' || szName[0] == '<' || strstr(szName, "<unnamed-") != NULL ||
+		strstr(szName, "<anonymous-") != NULL) {
+		AppendFormat(id, "__unnamed_%llX", ti);
+	}
+
+	else {
+		id = Identifier(szName);
+
+		while (id.size() > 1 && id.back() == '_') {
+			id.pop_back();
+		}
+	}
+
+	if (!m_identifiers.emplace(id, ti).second) {
+		AppendFormat(id, "_%llX", ti);
+		m_identifiers.emplace(id, ti);
+	}
+
+	return id;
+}
+
+uint32_t HeaderGenerator::AddNode(uint8_t kind, uint32_t ti, const char * szPdbName)
+{
+	Node node;
+
+	node.kind = kind;
+	node.fDefine = false;
+	node.fVisited = false;
+	node.ti = ti;
+	node.name = MakeIdentifier(szPdbName, ti);
+	node.szPdbName = szPdbName;
+	m_nodes.push_back(std::move(node));
+
+	return (uint32_t)m_nodes.size() - 1;
+}
+
+////////////////////////////////////////////////////////////
+// The node of a UDT or enum, by its definition
+//
+uint32_t HeaderGenerator::NodeOf(uint32_t ti)
+{
+	ti = m_tpi.Definition(ti);
+
+	auto it = m_nodeIndex.find(ti);
+
+	if (it != m_nodeIndex.end()) {
+		return it->second;
+	}
+
+	TpiUdt udt;
+	uint32_t iNode = AddNode((m_tpi.Leaf(ti) == LF_ENUM) ? HEADER_NODE_ENUM : HEADER_NODE_UDT, ti,
+		m_tpi.GetUdt(ti, udt) ? udt.szName : "");
+
+	m_nodeIndex[ti] = iNode;
+
+	return iNode;
+}
+
+////////////////////////////////////////////////////////////
+// Select a UDT, enum or typedef by name, with what it needs
+//
+bool HeaderGenerator::Select(const char * szName)
+{
+	uint32_t ti = m_tpi.FindType(szName);
+
+	if (ti != 0) {
+		m_roots.push_back(NodeOf(ti));
+
+		return true;
+	}
+
+	auto it = m_typedefs.find(szName);
+
+	if (it != m_typedefs.end()) {
+		m_roots.push_back(AddNode(HEADER_NODE_TYPEDEF, it->second, it->first.c_str()));
+
+		return true;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////
+// Select every UDT and enum definition
+//
+void HeaderGenerator::SelectAll()
+{
+	for (const UdtLayout & layout : m_cache.Layouts()) {
+		m_roots.push_back(NodeOf(layout.ti));
+	}
+
+	TpiUdt udt;
+
+	for (uint32_t ti = m_tpi.FirstIndex(); ti < m_tpi.EndIndex(); ti++) {
+		if (m_tpi.Leaf(ti) == LF_ENUM && m_tpi.GetUdt(ti, udt) && !(udt.property & TPI_PROP_FWDREF)) {
+			m_roots.push_back(NodeOf(ti));
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Record what a declaration using a type needs from it
+//
+//  A UDT or enum used by value has to be defined before the user,
+//  one behind a pointer only declared. Arrays and modifiers keep the
+//  use, function signatures only declare their types.
+//
+void HeaderGenerator::Require(uint32_t ti, bool fComplete, uint32_t iUser, std::vector<uint32_t> & pending, int depth)
+{
+	if (ti < m_tpi.FirstIndex() || depth > HEADER_MAX_DEPTH) {
+		return;
+	}
+
+	uint16_t cb;
+	const uint8_t * pb = m_tpi.Record(ti, &cb);
+	uint16_t leaf = m_tpi.Leaf(ti);
+
+	if (pb == NULL) {
+		return;
+	}
+
+	switch (leaf) {
+		case LF_MODIFIER:
+		case LF_ARRAY:
+		case LF_BITFIELD:
+			if (cb >= 4) {
+				Require(GetU32(pb), fComplete, iUser, pending, depth + 1);
+			}
+
+			break;
+
+		case LF_POINTER:
+			// Pointers to members are emitted as their storage
+
+			if (cb >= 8 && ((GetU32(pb + 4) >> 5) & 0x7) != 2 && ((GetU32(pb + 4) >> 5) & 0x7) != 3) {
+				Require(GetU32(pb), false, iUser, pending, depth + 1);
+			}
+
+			break;
+
+		case LF_PROCEDURE:
+			if (cb >= 12) {
+				uint16_t cbArgs;
+				const uint8_t * pbArgs = m_tpi.Record(GetU32(pb + 8), &cbArgs);
+
+				Require(GetU32(pb), false, iUser, pending, depth + 1);
+
+				if (pbArgs != NULL && m_tpi.Leaf(GetU32(pb + 8)) == LF_ARGLIST && cbArgs >= 4) {
+					uint32_t cArgs = std::min<uint32_t>(GetU32(pbArgs), (cbArgs - 4) / 4);
+
+					for (uint32_t i = 0; i < cArgs; i++) {
+						Require(GetU32(pbArgs + 4 + i * 4), false, iUser, pending, depth + 1);
+					}
+				}
+			}
+
+			break;
+
+		default:
+			if (IsUdtLeaf(leaf) || leaf == LF_ENUM) {
+				uint32_t iNode = NodeOf(ti);
+
+				// Without a definition there is nothing to define it with
+
+				if (!fComplete || (m_nodes[iNode].kind == HEADER_NODE_UDT && m_cache.Find(m_nodes[iNode].ti) == NULL &&
+					m_tpi.TypeSize(m_nodes[iNode].ti) == 0)) {
+					break;
+				}
+
+				m_nodes[iUser].uses.push_back(iNode);
+
+				if (!m_nodes[iNode].fDefine) {
+					m_nodes[iNode].fDefine = true;
+					pending.push_back(iNode);
+				}
+			}
+
+			break;
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Add the types the pending definitions need, until none is left
+//
+void HeaderGenerator::Close(std::vector<uint32_t> & pending)
+{
+	while (!pending.empty()) {
+		uint32_t iNode = pending.back();
+		const UdtLayout * pLayout;
+
+		pending.pop_back();
+
+		switch (m_nodes[iNode].kind) {
+			case HEADER_NODE_UDT:
+				if ((pLayout = m_cache.Find(m_nodes[iNode].ti)) != NULL) {
+					const LayoutMember * pMembers = m_cache.Members(*pLayout);
+
+					for (uint32_t i = 0; i < pLayout->cMembers; i++) {
+						if (pMembers[i].kind == LAYOUT_MEMBER || pMembers[i].kind == LAYOUT_BASE) {
+							Require(pMembers[i].type, true, iNode, pending, 0);
+						}
+					}
+				}
+
+				break;
+
+			case HEADER_NODE_TYPEDEF:
+				Require(m_nodes[iNode].ti, true, iNode, pending, 0);
+				break;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Append the definitions a node needs and then the node, in post
+//  order
+//
+void HeaderGenerator::Order(uint32_t iNode, std::vector<uint32_t> & order)
+{
+	if (m_nodes[iNode].fVisited) {
+		return;
+	}
+
+	m_nodes[iNode].fVisited = true;
+
+	for (size_t i = 0; i < m_nodes[iNode].uses.size(); i++) {
+		Order(m_nodes[iNode].uses[i], order);
+	}
+
+	order.push_back(iNode);
+}
+
+////////////////////////////////////////////////////////////
+// Spell the declaration of inner as a type, "int (*inner)[4]"
+//
+//  inner is the declarator built so far, empty for an abstract
+//  declarator.
+//
+void HeaderGenerator::Declarator(uint32_t ti, const std::string & inner, std::string & decl, int depth) const
+{
+	const char * szSeparator = inner.empty() ? "" : " ";
+
+	if (depth > HEADER_MAX_DEPTH) {
+		decl = "void " + inner;
+
+		return;
+	}
+
+	if (ti < m_tpi.FirstIndex()) {
+		const char * szSimple = SimpleTypeName(ti);
+
+		if (((ti >> 8) & 0xF) != 0) {
+			Declarator(ti & 0xFF, "*" + inner, decl, depth + 1);
+		}
+
+		else if (szSimple != NULL) {
+			decl = std::string(szSimple) + szSeparator + inner;
+		}
+
+		// Anything else is kept as its storage
+
+		else {
+			decl = "uint8_t " + inner;
+			AppendFormat(decl, "[%llu]", m_tpi.TypeSize(ti) ? m_tpi.TypeSize(ti) : 1);
+		}
+
+		return;
+	}
+
+	uint16_t cb;
+	const uint8_t * pb = m_tpi.Record(ti, &cb);
+	uint16_t leaf = m_tpi.Leaf(ti);
+	std::string type;
+
+	if (pb == NULL) {
+		decl = "void " + inner;
+
+		return;
+	}
+
+	switch (leaf) {
+		case LF_MODIFIER:
+			if (cb >= 6) {
+				uint16_t modifiers = GetU16(pb + 4);
+				std::string qualifiers = std::string((modifiers & 1) ? "const " : "") + ((modifiers & 2) ? "volatile " : "");
+
+				// The qualifiers of a pointer follow the '*'
+
+				if (m_tpi.Leaf(GetU32(pb)) == LF_POINTER || (GetU32(pb) < m_tpi.FirstIndex() && ((GetU32(pb) >> 8) & 0xF) != 0)) {
+					Declarator(GetU32(pb), qualifiers + inner, decl, depth + 1);
+				}
+
+				else {
+					Declarator(GetU32(pb), inner, type, depth + 1);
+					decl = qualifiers + type;
+				}
+
+				return;
+			}
+
+			break;
+
+		case LF_POINTER:
+			if (cb >= 8) {
+				uint32_t attr = GetU32(pb + 4);
+				uint32_t mode = (attr >> 5) & 0x7;
+				uint16_t leafTarget = m_tpi.Leaf(GetU32(pb));
+				std::string pointer = (mode == 1) ? "&" : (mode == 4) ? "&&" : "*";
+
+				if (mode == 2 || mode == 3) {
+					break;
+				}
+
+				if (attr & (1 << 10)) {
+					pointer += "const ";
+				}
+
+				if (attr & (1 << 9)) {
+					pointer += "volatile ";
+				}
+
+				pointer += inner;
+
+				if (leafTarget == LF_ARRAY || leafTarget == LF_PROCEDURE) {
+					pointer = "(" + pointer + ")";
+				}
+
+				Declarator(GetU32(pb), pointer, decl, depth + 1);
+
+				return;
+			}
+
+			break;
+
+		case LF_ARRAY:
+			if (cb >= 4) {
+				uint64_t cbElement = m_tpi.TypeSize(GetU32(pb));
+				std::string array = inner;
+
+				AppendFormat(array, "[%llu]", cbElement ? m_tpi.TypeSize(ti) / cbElement : 0);
+				Declarator(GetU32(pb), array, decl, depth + 1);
+
+				return;
+			}
+
+			break;
+
+		case LF_BITFIELD:
+			if (cb >= 4) {
+				Declarator(GetU32(pb), inner, decl, depth + 1);
+
+				return;
+			}
+
+			break;
+
+		case LF_PROCEDURE:
+			if (cb >= 12) {
+				uint16_t cbArgs;
+				const uint8_t * pbArgs = m_tpi.Record(GetU32(pb + 8), &cbArgs);
+				std::string function = inner + "(";
+
+				if (pbArgs != NULL && m_tpi.Leaf(GetU32(pb + 8)) == LF_ARGLIST && cbArgs >= 4) {
+					uint32_t cArgs = std::min<uint32_t>(GetU32(pbArgs), (cbArgs - 4) / 4);
+
+					for (uint32_t i = 0; i < cArgs; i++) {
+						uint32_t tiArg = GetU32(pbArgs + 4 + i * 4);
+
+						function += (i != 0) ? ", " : "";
+
+						// A trailing 0 argument is the ellipsis
+
+						if (tiArg == 0) {
+							function += "...";
+						}
+
+						else {
+							Declarator(tiArg, "", type, depth + 1);
+							function += type;
+						}
+					}
+
+					if (cArgs == 0) {
+						function += "void";
+					}
+				}
+
+				function += ")";
+				Declarator(GetU32(pb), function, decl, depth + 1);
+
+				return;
+			}
+
+			break;
+
+		default:
+			if (IsUdtLeaf(leaf) || leaf == LF_ENUM) {
+				auto it = m_nodeIndex.find(m_tpi.Definition(ti));
+
+				if (it != m_nodeIndex.end()) {
+					decl = m_nodes[it->second].name + szSeparator + inner;
+
+					return;
+				}
+			}
+
+			break;
+	}
+
+	// Pointers to members and whatever has no C++ spelling keep
+	//  their storage
+
+	decl = "uint8_t " + inner;
+	AppendFormat(decl, "[%llu]", m_tpi.TypeSize(ti) ? m_tpi.TypeSize(ti) : 1);
+}
+
+////////////////////////////////////////////////////////////
+// Build the definition of a structure, class or union
+//
+//  The members are laid out at their PDB offsets with the gaps
+//  spelled out, under pack(1). Members overlapping an earlier one,
+//  which is how anonymous unions and structures appear, are left
+//  as comments.
+//
+void HeaderGenerator::EmitUdt(Node & node) const
+{
+	const UdtLayout * pLayout = m_cache.Find(node.ti);
+	std::string & text = node.text;
+	std::string asserts;
+	char szLine[64];
+
+	text.clear();
+
+	if (node.name != node.szPdbName) {
+		text += "// ";
+		text += node.szPdbName;
+		text += "\n";
+	}
+
+	// Only the size is known of a type without a definition
+
+	if (pLayout == NULL) {
+		text += "struct " + node.name + "\n{\n";
+		AppendFormat(text, "\tuint8_t __opaque[%llu];\n};\n", m_tpi.TypeSize(node.ti));
+		text += "static_assert(sizeof(" + node.name;
+		AppendFormat(text, ") == 0x%llX, \"", m_tpi.TypeSize(node.ti));
+		text += node.name + "\");\n";
+
+		return;
+	}
+
+	bool fUnion = pLayout->leaf == LF_UNION;
+	const LayoutMember * pMembers = m_cache.Members(*pLayout);
+	std::vector<const LayoutMember *> members;
+
+	for (uint32_t i = 0; i < pLayout->cMembers; i++) {
+		members.push_back(&pMembers[i]);
+	}
+
+	std::stable_sort(members.begin(), members.end(),
+		[](const LayoutMember * a, const LayoutMember * b) { return a->offset < b->offset; });
+
+	text += fUnion ? "union " : "struct ";
+	text += node.name;
+	text += "\n{\n";
+
+	uint64_t offEnd = 0;
+	uint64_t cbLargest = 0;
+	const LayoutMember * pUnit = NULL;   // the last bitfield, while its storage unit is open
+	uint32_t cVbptrs = 0;
+	uint32_t cUnnamed = 0;
+
+	for (const LayoutMember * pMember : members) {
+		const LayoutMember & member = *pMember;
+		std::string name;
+		std::string decl;
+
+		switch (member.kind) {
+			case LAYOUT_BASE: {
+				const UdtLayout * pBase = m_cache.Find(member.type);
+				auto it = m_nodeIndex.find(member.type);
+
+				// Empty bases take no room in the derived class
+
+				if (pBase != NULL && pBase->cMembers == 0) {
+					continue;
+				}
+
+				name = "__base_" + ((it != m_nodeIndex.end()) ? m_nodes[it->second].name : Identifier(member.szName));
+				break;
+			}
+
+			case LAYOUT_VFPTR:
+				name = "__vfptr";
+				break;
+
+			case LAYOUT_VBPTR:
+				name = "__vbptr";
+
+				if (cVbptrs++ != 0) {
+					AppendFormat(name, "%llu", cVbptrs - 1);
+				}
+
+				break;
+
+			// Members without a name, or with a placeholder like
+			//  "<unnamed-tag>", are numbered so they stay distinct
+
+			default:
+				if (*member.szName == '\0' || *member.szName == '<') {
+					name = "_unnamed";
+					AppendFormat(name, "%llu", cUnnamed++);
+				}
+
+				else {
+					name = Identifier(member.szName);
+				}
+
+				break;
+		}
+
+		if (member.kind == LAYOUT_VFPTR || member.kind == LAYOUT_VBPTR) {
+			decl = ((member.kind == LAYOUT_VFPTR) ? "void **" : "int *") + name;
+		}
+
+		else {
+			Declarator(member.type, name, decl, 0);
+		}
+
+		bool fSameUnit = member.cBits != 0 && pUnit != NULL && pUnit->offset == member.offset && pUnit->cb == member.cb &&
+			member.bitPos >= pUnit->bitPos + pUnit->cBits;
+
+		if (fUnion ? member.offset != 0 : (member.offset < offEnd && !fSameUnit)) {
+			text += "\t// " + decl;
+			AppendFormat(text, "; at 0x%llX\n", member.offset);
+
+			continue;
+		}
+
+		if (!fUnion && member.offset > offEnd) {
+			snprintf(szLine, sizeof(szLine), "\tuint8_t __pad%04llX[%llu];\n", (unsigned long long)offEnd,
+				(unsigned long long)(member.offset - offEnd));
+			text += szLine;
+			pUnit = NULL;
+		}
+
+		// Bitfields of one storage unit follow each other with the gaps
+		//  between them as unnamed bitfields, a zero width one closes
+		//  the unit before the next
+
+		if (member.cBits != 0) {
+			std::string unit;
+			unsigned bitFirst = fSameUnit ? pUnit->bitPos + pUnit->cBits : 0;
+
+			Declarator(member.type, "", unit, 0);
+
+			if (!fSameUnit && pUnit != NULL && !fUnion) {
+				text += "\t" + unit + " : 0;\n";
+			}
+
+			if (member.bitPos > bitFirst) {
+				text += "\t" + unit;
+				AppendFormat(text, " : %llu;\n", member.bitPos - bitFirst);
+			}
+
+			text += "\t" + decl;
+			AppendFormat(text, " : %llu;\n", member.cBits);
+			pUnit = &member;
+		}
+
+		else {
+			text += "\t" + decl;
+			AppendFormat(text, "; // 0x%llX\n", member.offset);
+			pUnit = NULL;
+
+			if (!fUnion) {
+				asserts += "static_assert(offsetof(" + node.name + ", " + name;
+				AppendFormat(asserts, ") == 0x%llX, \"", member.offset);
+				asserts += node.name + "::" + name + "\");\n";
+			}
+		}
+
+		offEnd = std::max<uint64_t>(offEnd, member.offset + member.cb);
+		cbLargest = std::max<uint64_t>(cbLargest, member.cb);
+	}
+
+	// Tail padding, which also holds the virtual base subobjects
+
+	if (fUnion && cbLargest < pLayout->cb) {
+		AppendFormat(text, "\tuint8_t __size[%llu];\n", pLayout->cb);
+	}
+
+	else if (!fUnion && offEnd < pLayout->cb) {
+		snprintf(szLine, sizeof(szLine), "\tuint8_t __pad%04llX[%llu];\n", (unsigned long long)offEnd,
+			(unsigned long long)(pLayout->cb - offEnd));
+		text += szLine;
+	}
+
+	text += "};\n";
+	text += "static_assert(sizeof(" + node.name;
+	AppendFormat(text, ") == 0x%llX, \"", pLayout->cb);
+	text += node.name + "\");\n";
+	text += asserts;
+}
+
+////////////////////////////////////////////////////////////
+// Build the definition of an enum, scoped so the enumerators of
+//  different enums cannot clash
+//
+void HeaderGenerator::EmitEnum(Node & node) const
+{
+	std::string & text = node.text;
+	std::vector<TpiField> fields;
+	std::string underlying;
+	TpiUdt udt;
+
+	text.clear();
+
+	if (!m_tpi.GetUdt(node.ti, udt)) {
+		return;
+	}
+
+	Declarator(udt.underlying, "", underlying, 0);
+
+	uint64_t cb = m_tpi.TypeSize(udt.underlying);
+	uint64_t mask = (cb != 0 && cb < 8) ? (1ULL << (cb * 8)) - 1 : ~0ULL;
+	if (node.name != node.szPdbName) {
+		text += "// ";
+		text += node.szPdbName;
+		text += "\n";
+	}
+
+	text += "enum class " + node.name + " : " + underlying + "\n{\n";
+
+	if (m_tpi.GetFields(udt.fieldList, fields)) {
+		for (const TpiField & field : fields) {
+			if (field.leaf != LF_ENUMERATE) {
+				continue;
+			}
+
+			text += "\t" + Identifier(field.szName);
+
+			// Unsigned values in hex, the signed ones as they are
+
+			switch (udt.underlying & 0xFF) {
+				case 0x10: case 0x11: case 0x12: case 0x13: case 0x68: case 0x72: case 0x74: case 0x76: case 0x08: case 0x70:
+					AppendFormat(text, " = %lld,\n", (unsigned long long)field.offset);
+					break;
+
+				default:
+					AppendFormat(text, " = 0x%llX,\n", (unsigned long long)field.offset & mask);
+					break;
+			}
+		}
+	}
+
+	text += "};\n";
+}
+
+////////////////////////////////////////////////////////////
+// Build a typedef
+//
+void HeaderGenerator::EmitTypedef(Node & node) const
+{
+	std::string decl;
+
+	Declarator(node.ti, node.name, decl, 0);
+	node.text = "typedef " + decl + ";\n";
+}
+
+////////////////////////////////////////////////////////////
+// Generate the selected types split into files
+//
+//  The definitions are in dependency order, so a file only needs
+//  the ones before it: file n includes file n - 1, and the first
+//  one declares every type up front.
+//
+void HeaderGenerator::Generate(const char * szBaseName, unsigned cFiles, unsigned cThreads, std::vector<HeaderFile> & files)
+{
+	std::vector<uint32_t> pending;
+	std::vector<uint32_t> order;
+
+	for (uint32_t iRoot : m_roots) {
+		if (!m_nodes[iRoot].fDefine) {
+			m_nodes[iRoot].fDefine = true;
+			pending.push_back(iRoot);
+		}
+	}
+
+	Close(pending);
+
+	for (uint32_t iRoot : m_roots) {
+		Order(iRoot, order);
+	}
+
+	m_cDefined = (uint32_t)order.size();
+	m_cDeclared = 0;
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	// The text of every definition, built once on the workers
+
+	std::atomic<uint32_t> iNext(0);
+
+	auto emitter = [&](unsigned) {
+		for (uint32_t i; (i = iNext++) < order.size(); ) {
+			Node & node = m_nodes[order[i]];
+
+			switch (node.kind) {
+				case HEADER_NODE_UDT:
+					EmitUdt(node);
+					break;
+
+				case HEADER_NODE_ENUM:
+					EmitEnum(node);
+					break;
+
+				case HEADER_NODE_TYPEDEF:
+					EmitTypedef(node);
+					break;
+			}
+		}
+	};
+
+	RunParallel(cThreads, emitter);
+
+	// Every UDT and enum is declared, the defined ones too, so the
+	//  pointers between them need no order
+
+	std::string declarations;
+
+	for (const Node & node : m_nodes) {
+		if (node.kind == HEADER_NODE_UDT) {
+			const UdtLayout * pLayout = m_cache.Find(node.ti);
+
+			declarations += (pLayout != NULL && pLayout->leaf == LF_UNION) ? "union " : "struct ";
+			declarations += node.name + ";\n";
+		}
+
+		else if (node.kind == HEADER_NODE_ENUM) {
+			std::string underlying;
+			TpiUdt udt;
+
+			Declarator(m_tpi.GetUdt(node.ti, udt) ? udt.underlying : 0x74, "", underlying, 0);
+			declarations += "enum class " + node.name + " : " + underlying + ";\n";
+		}
+
+		if (node.kind != HEADER_NODE_TYPEDEF && !node.fDefine) {
+			m_cDeclared++;
+		}
+	}
+
+	if (cFiles == 0) {
+		cFiles = 1;
+	}
+
+	if (cFiles > order.size()) {
+		cFiles = order.size() ? (unsigned)order.size() : 1;
+	}
+
+	files.assign(cFiles, HeaderFile());
+
+	for (unsigned iFile = 0; iFile < cFiles; iFile++) {
+		char szName[32];
+
+		files[iFile].name = szBaseName;
+
+		if (cFiles > 1) {
+			snprintf(szName, sizeof(szName), "_%u", iFile);
+			files[iFile].name += szName;
+		}
+
+		files[iFile].name += ".h";
+	}
+
+	// Contiguous runs of the order, assembled on the workers
+
+	std::atomic<uint32_t> iNextFile(0);
+
+	auto assembler = [&](unsigned) {
+		for (uint32_t iFile; (iFile = iNextFile++) < cFiles; ) {
+			HeaderFile & file = files[iFile];
+			size_t iFirst = order.size() * iFile / cFiles;
+			size_t iEnd = order.size() * (iFile + 1) / cFiles;
+			size_t cch = 0;
+			const char * szFileName = file.name.c_str();
+
+			for (const char * pch = szFileName; *pch != '\0'; pch++) {
+				if (*pch == '/' || *pch == '\\') {
+					szFileName = pch + 1;
+				}
+			}
+
+			for (size_t i = iFirst; i < iEnd; i++) {
+				cch += m_nodes[order[i]].text.size() + 1;
+			}
+
+			file.cTypes = (uint32_t)(iEnd - iFirst);
+			file.text.reserve(cch + declarations.size() + 256);
+			file.text = "// ";
+			file.text += szFileName;
+			file.text += " : generated from the PDB types\n//\n\n#pragma once\n\n";
+
+			if (iFile == 0) {
+				file.text += "#include <stddef.h>\n#include <stdint.h>\n\n";
+				file.text += declarations;
+			}
+
+			else {
+				const char * szPrevious = files[iFile - 1].name.c_str();
+
+				for (const char * pch = szPrevious; *pch != '\0'; pch++) {
+					if (*pch == '/' || *pch == '\\') {
+						szPrevious = pch + 1;
+					}
+				}
+
+				file.text += "#include \"";
+				file.text += szPrevious;
+				file.text += "\"\n";
+			}
+
+			file.text += "\n#pragma pack(push, 1)\n";
+
+			for (size_t i = iFirst; i < iEnd; i++) {
+				if (!m_nodes[order[i]].text.empty()) {
+					file.text += "\n";
+					file.text += m_nodes[order[i]].text;
+				}
+			}
+
+			file.text += "\n#pragma pack(pop)\n";
+		}
+	};
+
+	RunParallel((unsigned)std::min<size_t>(cThreads, cFiles), assembler);
+}
@@ -0,0 +1,89 @@
+// HeaderGen.h : C++ headers from the TPI types of a PDB
+//
+// Emits compilable declarations of selected UDTs, enums and typedefs
+// and of everything they need. Types used by value are defined before
+// their users in dependency order; types only reached through pointers
+// are forward declared, which also breaks the pointer cycles. Every
+// structure spells out its padding and is followed by static_asserts
+// on its size and member offsets, so the header is checked against the
+// PDB when it is compiled. The text of every type is built once, in
+// parallel, and the output can be split across several files.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "LayoutCache.h"
+#include "PdbFile.h"
+
+#define HEADER_NODE_UDT             0
+#define HEADER_NODE_ENUM            1
+#define HEADER_NODE_TYPEDEF         2
+
+struct HeaderFile
+{
+	std::string name;
+	std::string text;
+	uint32_t cTypes;
+};
+
+////////////////////////////////////////////////////////////
+// Generates the headers of a set of types
+//
+//  Names are made into identifiers, so template instances and
+//  nested types get flat names; the PDB name stays in a comment.
+//  Base classes are emitted as members and virtual functions as
+//  the vfptr, so the layout is exact without the declarations
+//  that produced it.
+//
+class HeaderGenerator
+{
+	public:
+	HeaderGenerator(const LayoutCache & cache);
+
+	bool LoadTypedefs(const PdbFile & pdb);
+	bool Select(const char * szName);
+	void SelectAll();
+	void Generate(const char * szBaseName, unsigned cFiles, unsigned cThreads, std::vector<HeaderFile> & files);
+
+	uint32_t CountDefined() const { return m_cDefined; }
+	uint32_t CountDeclared() const { return m_cDeclared; }
+
+	private:
+	struct Node
+	{
+		uint8_t kind;
+		bool fDefine;                    // else only forward declared
+		bool fVisited;
+		uint32_t ti;                     // the target type for typedefs
+		std::string name;
+		const char * szPdbName;
+		std::vector<uint32_t> uses;      // nodes needed complete
+		std::string text;
+	};
+
+	uint32_t NodeOf(uint32_t ti);
+	uint32_t AddNode(uint8_t kind, uint32_t ti, const char * szPdbName);
+	std::string MakeIdentifier(const char * szName, uint32_t ti);
+	void Require(uint32_t ti, bool fComplete, uint32_t iUser, std::vector<uint32_t> & pending, int depth);
+	void Close(std::vector<uint32_t> & pending);
+	void Order(uint32_t iNode, std::vector<uint32_t> & order);
+	void Declarator(uint32_t ti, const std::string & inner, std::string & decl, int depth) const;
+	void EmitUdt(Node & node) const;
+	void EmitEnum(Node & node) const;
+	void EmitTypedef(Node & node) const;
+
+	const LayoutCache & m_cache;
+	const TpiStream & m_tpi;
+	std::vector<Node> m_nodes;
+	std::unordered_map<uint32_t, uint32_t> m_nodeIndex;       // by definition type index
+	std::unordered_map<std::string, uint32_t> m_typedefs;     // S_UDT name to type index
+	std::unordered_map<std::string, uint32_t> m_identifiers;
+	std::vector<uint32_t> m_roots;
+	uint32_t m_cDefined = 0;
+	uint32_t m_cDeclared = 0;
+};
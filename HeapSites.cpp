@@ -0,0 +1,212 @@
+// HeapSites.cpp : Heap allocation site index for allocation profilers
+//
+
+#include "HeapSites.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+
+#include "Util.h"
+
+#define S_HEAPALLOCSITE             0x115E
+
+////////////////////////////////////////////////////////////
+// Collect the sites of every module, one module per thread at
+//  a time, then name and size their types once per type
+//
+bool HeapSiteIndex::Build(const PdbFile & pdb, const TpiStream & tpi, unsigned cThreads)
+{
+	Clear();
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	memcpy(m_rgGuid, pdb.Guid(), sizeof(m_rgGuid));
+	m_dwAge = pdb.Age();
+
+	std::vector<std::vector<HeapSiteRecord> > modules(pdb.Modules().size());
+	std::atomic<uint32_t> iNext(0);
+
+	auto reader = [&](unsigned) {
+		std::vector<uint8_t> data;
+
+		for (uint32_t iModule; (iModule = iNext.fetch_add(1)) < modules.size(); ) {
+			const PdbModule & module = pdb.Modules()[iModule];
+
+			if (module.iStream == PDB_STREAM_NONE || !pdb.ReadStream(module.iStream, data)) {
+				continue;
+			}
+
+			size_t cbSymbols = std::min<size_t>(module.cbSymbols, data.size());
+
+			for (size_t off = 4; off + 4 <= cbSymbols; ) {
+				const uint8_t * pRecord = &data[off];
+				uint16_t cbRecord = GetU16(pRecord);
+				HeapSiteRecord site;
+
+				if (cbRecord < 2 || off + 2 + cbRecord > cbSymbols) {
+					break;
+				}
+
+				off += 2 + cbRecord;
+
+				if (GetU16(pRecord + 2) != S_HEAPALLOCSITE || cbRecord < 14 ||
+					!pdb.SectionToRva(GetU16(pRecord + 8), GetU32(pRecord + 4), &site.rvaCall)) {
+					continue;
+				}
+
+				site.rvaReturn = site.rvaCall + GetU16(pRecord + 10);
+				site.type = GetU32(pRecord + 12);
+				site.offName = 0;
+				site.cb = 0;
+				modules[iModule].push_back(site);
+			}
+		}
+	};
+
+	RunParallel(cThreads, reader);
+
+	for (std::vector<HeapSiteRecord> & sites : modules) {
+		m_sites.insert(m_sites.end(), sites.begin(), sites.end());
+		std::vector<HeapSiteRecord>().swap(sites);
+	}
+
+	// A site of a function several modules kept is the same site
+
+	std::sort(m_sites.begin(), m_sites.end(), [](const HeapSiteRecord & a, const HeapSiteRecord & b) {
+		return a.rvaReturn < b.rvaReturn || (a.rvaReturn == b.rvaReturn && a.type < b.type);
+	});
+	m_sites.erase(std::unique(m_sites.begin(), m_sites.end(), [](const HeapSiteRecord & a, const HeapSiteRecord & b) {
+		return a.rvaReturn == b.rvaReturn && a.type == b.type;
+	}), m_sites.end());
+
+	std::unordered_map<uint32_t, std::pair<uint32_t, uint64_t> > types;
+	std::string name;
+
+	Intern("");
+
+	for (HeapSiteRecord & site : m_sites) {
+		auto it = types.find(site.type);
+
+		if (it == types.end()) {
+			tpi.TypeName(site.type, name);
+			it = types.emplace(site.type, std::make_pair(Intern(name), tpi.TypeSize(site.type))).first;
+		}
+
+		site.offName = it->second.first;
+		site.cb = it->second.second;
+	}
+
+	m_interned.clear();
+
+	return !m_sites.empty();
+}
+
+uint32_t HeapSiteIndex::Intern(const std::string & name)
+{
+	auto it = m_interned.find(name);
+
+	if (it != m_interned.end()) {
+		return it->second;
+	}
+
+	uint32_t offName = (uint32_t)m_names.size();
+
+	m_names.insert(m_names.end(), name.c_str(), name.c_str() + name.size() + 1);
+	m_interned.emplace(name, offName);
+
+	return offName;
+}
+
+void HeapSiteIndex::Clear()
+{
+	memset(m_rgGuid, 0, sizeof(m_rgGuid));
+	m_dwAge = 0;
+	std::vector<HeapSiteRecord>().swap(m_sites);
+	std::vector<char>().swap(m_names);
+	m_interned.clear();
+}
+
+////////////////////////////////////////////////////////////
+// Write the header, the records and the names
+//
+//  The structures are written as they are in memory, which is
+//  the file layout on the little endian targets of the PDBs.
+//
+bool HeapSiteIndex::Save(FILE * pFile) const
+{
+	HeapSiteFileHeader header;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = HEAP_SITE_MAGIC;
+	header.version = HEAP_SITE_VERSION;
+	memcpy(header.rgGuid, m_rgGuid, sizeof(header.rgGuid));
+	header.age = m_dwAge;
+	header.cSites = (uint32_t)m_sites.size();
+	header.offSites = sizeof(header);
+	header.offNames = header.offSites + header.cSites * (uint32_t)sizeof(HeapSiteRecord);
+	header.cbNames = (uint32_t)m_names.size();
+
+	return fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+		(m_sites.empty() || fwrite(m_sites.data(), sizeof(HeapSiteRecord), m_sites.size(), pFile) == m_sites.size()) &&
+		(m_names.empty() || fwrite(m_names.data(), 1, m_names.size(), pFile) == m_names.size());
+}
+
+bool HeapSiteIndex::Save(const char * szPath) const
+{
+	FILE * pFile;
+
+#ifdef _WIN32
+	if (fopen_s(&pFile, szPath, "wb") || !pFile) {
+		return false;
+	}
+#else
+	if ((pFile = fopen(szPath, "wb")) == NULL) {
+		return false;
+	}
+#endif
+
+	bool fSaved = Save(pFile);
+
+	return (fclose(pFile) == 0) && fSaved;
+}
+
+#ifdef _WIN32
+bool HeapSiteIndex::Save(const wchar_t * wszPath) const
+{
+	FILE * pFile;
+
+	if (_wfopen_s(&pFile, wszPath, L"wb") || !pFile) {
+		return false;
+	}
+
+	bool fSaved = Save(pFile);
+
+	return (fclose(pFile) == 0) && fSaved;
+}
+#endif
+
+////////////////////////////////////////////////////////////
+// Look up a return address in a mapped heap site file
+//
+//  Returns NULL when the file is not one or has no site there.
+//  The name of a site is at offNames + offName in the file.
+//
+const HeapSiteRecord * FindHeapSite(const void * pFile, size_t cbFile, uint32_t rvaReturn)
+{
+	const HeapSiteFileHeader * pHeader = (const HeapSiteFileHeader *)pFile;
+
+	if (cbFile < sizeof(HeapSiteFileHeader) || pHeader->magic != HEAP_SITE_MAGIC || pHeader->version != HEAP_SITE_VERSION ||
+		pHeader->offSites > cbFile || (cbFile - pHeader->offSites) / sizeof(HeapSiteRecord) < pHeader->cSites) {
+		return NULL;
+	}
+
+	const HeapSiteRecord * pBegin = (const HeapSiteRecord *)((const uint8_t *)pFile + pHeader->offSites);
+	const HeapSiteRecord * pEnd = pBegin + pHeader->cSites;
+	const HeapSiteRecord * pSite = std::lower_bound(pBegin, pEnd, rvaReturn,
+		[](const HeapSiteRecord & site, uint32_t rva) { return site.rvaReturn < rva; });
+
+	return (pSite != pEnd && pSite->rvaReturn == rvaReturn) ? pSite : NULL;
+}
@@ -0,0 +1,85 @@
+// HeapSites.h : Heap allocation site index for allocation profilers
+//
+// Collects the S_HEAPALLOCSITE records the compiler emits for every
+// call to operator new and the allocators marked __declspec(allocator),
+// reading the modules in parallel, with the type, its name and size
+// from the TPI stream. The sites are saved sorted by the RVA the call
+// returns to, which is what a profiler captures, in a flat file a
+// profiler maps and binary searches without the PDB:
+//
+//   HeapSiteFileHeader
+//   HeapSiteRecord[cSites]          by rvaReturn
+//   char names[cbNames]             NUL terminated type names
+//
+// All the fields are little endian, the records are 8 byte aligned.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PdbFile.h"
+#include "TpiStream.h"
+
+#define HEAP_SITE_MAGIC             0x53504148   // "HAPS"
+#define HEAP_SITE_VERSION           1
+
+struct HeapSiteFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint8_t rgGuid[16];                  // of the PDB, to match the image
+	uint32_t age;
+	uint32_t cSites;
+	uint32_t offSites;                   // from the start of the file
+	uint32_t offNames;
+	uint32_t cbNames;
+	uint32_t reserved;
+};
+
+struct HeapSiteRecord
+{
+	uint32_t rvaReturn;                  // of the instruction after the call
+	uint32_t rvaCall;
+	uint32_t type;                       // TPI index of the allocated type
+	uint32_t offName;                    // into the names
+	uint64_t cb;                         // size of the type, 0 when unknown
+};
+
+static_assert(sizeof(HeapSiteFileHeader) == 48, "HeapSiteFileHeader is a file format");
+static_assert(sizeof(HeapSiteRecord) == 24, "HeapSiteRecord is a file format");
+
+////////////////////////////////////////////////////////////
+// The heap allocation sites of a PDB, by return RVA
+//
+class HeapSiteIndex
+{
+	public:
+	bool Build(const PdbFile & pdb, const TpiStream & tpi, unsigned cThreads);
+	void Clear();
+
+	bool Save(const char * szPath) const;
+#ifdef _WIN32
+	bool Save(const wchar_t * wszPath) const;
+#endif
+	bool Save(FILE * pFile) const;
+
+	const std::vector<HeapSiteRecord> & Sites() const { return m_sites; }
+	const char * Name(const HeapSiteRecord & site) const { return &m_names[site.offName]; }
+
+	private:
+	uint32_t Intern(const std::string & name);
+
+	uint8_t m_rgGuid[16] = {};
+	uint32_t m_dwAge = 0;
+	std::vector<HeapSiteRecord> m_sites;
+	std::vector<char> m_names;
+	std::unordered_map<std::string, uint32_t> m_interned;
+};
+
+const HeapSiteRecord * FindHeapSite(const void * pFile, size_t cbFile, uint32_t rvaReturn);
@@ -0,0 +1,145 @@
+// IcfFinder.cpp : Identical code folding candidates from contribution CRCs
+//
+
+#include "IcfFinder.h"
+
+#include <algorithm>
+#include <string.h>
+#include <unordered_map>
+
+#include "Util.h"
+
+static void AddGroup(const std::vector<IcfContrib> & contribs, std::vector<uint32_t>::const_iterator itBegin,
+                     std::vector<uint32_t>::const_iterator itEnd, bool fVerified, std::vector<IcfGroup> & groups)
+{
+	if (itEnd - itBegin < 2) {
+		return;
+	}
+
+	IcfGroup group;
+
+	group.members.assign(itBegin, itEnd);
+	group.fVerified = fVerified;
+	group.cbSavings = (uint64_t)contribs[*itBegin].cb * (group.members.size() - 1);
+
+	std::sort(group.members.begin(), group.members.end(),
+		[&](uint32_t a, uint32_t b) { return contribs[a].rva < contribs[b].rva; });
+
+	groups.push_back(group);
+}
+
+////////////////////////////////////////////////////////////
+// Compare the linked code of two contributions
+//
+//  A rel32 call or jump, or a RIP relative operand, to the same
+//  target differs by the distance between the copies, so a byte
+//  that differs must be in 4 bytes whose targets from the two
+//  copies are the same. The end of the instruction is at the
+//  same offset in both, so only the RVAs have to be added.
+//
+static bool IsSameCode(const uint8_t * pbA, uint32_t rvaA, const uint8_t * pbB, uint32_t rvaB, uint32_t cb)
+{
+	for (uint32_t off = 0; off < cb; ) {
+		if (pbA[off] == pbB[off]) {
+			off++;
+			continue;
+		}
+
+		uint32_t offField = (off >= 3) ? off - 3 : 0;
+
+		while (offField <= off && offField + 4 <= cb && rvaA + GetU32(pbA + offField) != rvaB + GetU32(pbB + offField)) {
+			offField++;
+		}
+
+		if (offField > off || offField + 4 > cb) {
+			return false;
+		}
+
+		off = offField + 4;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Group the contributions that could be folded, largest
+//  savings first. Without an image, or for members whose bytes
+//  are not in it, the groups are reported unverified.
+//
+void FindIcfGroups(const std::vector<IcfContrib> & contribs, const PeImage * pImage, std::vector<IcfGroup> & groups, IcfStats & stats)
+{
+	std::unordered_map<uint64_t, std::vector<uint32_t> > candidates;
+
+	for (uint32_t i = 0; i < contribs.size(); i++) {
+		if (contribs[i].cb != 0) {
+			candidates[((uint64_t)contribs[i].cb << 32) | contribs[i].crc].push_back(i);
+		}
+	}
+
+	groups.clear();
+	stats.cCandidates = 0;
+	stats.cSplit = 0;
+
+	for (const auto & candidate : candidates) {
+		const std::vector<uint32_t> & members = candidate.second;
+
+		if (members.size() < 2) {
+			continue;
+		}
+
+		stats.cCandidates++;
+
+		uint32_t cb = contribs[members[0]].cb;
+		std::vector<uint32_t> mapped;
+		std::vector<uint32_t> unmapped;
+
+		for (uint32_t i : members) {
+			if (pImage != NULL && pImage->Ptr(contribs[i].rva, cb) != NULL) {
+				mapped.push_back(i);
+			}
+
+			else {
+				unmapped.push_back(i);
+			}
+		}
+
+		// Every run of identical code is split from the members left
+		//  by comparing them with its first
+
+		size_t cRuns = 0;
+
+		while (!mapped.empty()) {
+			const IcfContrib & first = contribs[mapped[0]];
+			const uint8_t * pbFirst = pImage->Ptr(first.rva, cb);
+			std::vector<uint32_t> run(1, mapped[0]);
+			std::vector<uint32_t> rest;
+
+			for (size_t i = 1; i < mapped.size(); i++) {
+				const IcfContrib & contrib = contribs[mapped[i]];
+
+				if (IsSameCode(pbFirst, first.rva, pImage->Ptr(contrib.rva, cb), contrib.rva, cb)) {
+					run.push_back(mapped[i]);
+				}
+
+				else {
+					rest.push_back(mapped[i]);
+				}
+			}
+
+			AddGroup(contribs, run.begin(), run.end(), true, groups);
+			mapped.swap(rest);
+			cRuns++;
+		}
+
+		if (cRuns > 1) {
+			stats.cSplit++;
+		}
+
+		AddGroup(contribs, unmapped.begin(), unmapped.end(), false, groups);
+	}
+
+	std::sort(groups.begin(), groups.end(),
+		[&](const IcfGroup & a, const IcfGroup & b) {
+			return a.cbSavings > b.cbSavings || (a.cbSavings == b.cbSavings && contribs[a.members[0]].rva < contribs[b.members[0]].rva);
+		});
+}
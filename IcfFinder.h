@@ -0,0 +1,40 @@
+// IcfFinder.h : Identical code folding candidates from contribution CRCs
+//
+// Contributions are hash joined on (length, CRC). The CRC is taken
+// over the unrelocated object bytes, so every candidate group is
+// split again by comparing the linked bytes in the image; only the
+// members that are still identical, but for the displacements of
+// the calls, jumps and operands reaching the same targets, could
+// have been folded.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "PeImage.h"
+
+struct IcfContrib
+{
+	uint32_t rva;
+	uint32_t cb;
+	uint32_t crc;
+	std::string name;                    // undecorated, empty if unknown
+};
+
+struct IcfGroup
+{
+	std::vector<uint32_t> members;       // index into the contributions, by rva
+	bool fVerified;                      // the image code is identical
+	uint64_t cbSavings;                  // bytes freed by folding into one member
+};
+
+struct IcfStats
+{
+	uint32_t cCandidates;                // groups sharing length and CRC
+	uint32_t cSplit;                     // groups whose image bytes differ
+};
+
+void FindIcfGroups(const std::vector<IcfContrib> & contribs, const PeImage * pImage, std::vector<IcfGroup> & groups, IcfStats & stats);
@@ -0,0 +1,679 @@
+// InlineIndex.cpp : Inline call chains from S_INLINESITE records
+//
+
+#include "InlineIndex.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "Util.h"
+
+#define S_END                       0x0006
+#define S_THUNK32                   0x1102
+#define S_BLOCK32                   0x1103
+#define S_WITH32                    0x1104
+#define S_LPROC32                   0x110F
+#define S_GPROC32                   0x1110
+#define S_SEPCODE                   0x1132
+#define S_LPROC32_ID                0x1146
+#define S_GPROC32_ID                0x1147
+#define S_INLINESITE                0x114D
+#define S_INLINESITE_END            0x114E
+#define S_PROC_ID_END               0x114F
+#define S_LPROC32_DPC               0x1155
+#define S_LPROC32_DPC_ID            0x1156
+#define S_INLINESITE2               0x115D
+
+#define LF_FUNC_ID                  0x1601
+#define LF_MFUNC_ID                 0x1602
+#define LF_STRING_ID                0x1605
+
+#define DEBUG_S_IGNORE              0x80000000
+#define DEBUG_S_LINES               0xF2
+#define DEBUG_S_FILECHKSMS          0xF4
+#define DEBUG_S_INLINEELINES        0xF6
+
+// Binary annotation opcodes
+enum
+{
+	BA_OP_Invalid,
+	BA_OP_CodeOffset,
+	BA_OP_ChangeCodeOffsetBase,
+	BA_OP_ChangeCodeOffset,
+	BA_OP_ChangeCodeLength,
+	BA_OP_ChangeFile,
+	BA_OP_ChangeLineOffset,
+	BA_OP_ChangeLineEndDelta,
+	BA_OP_ChangeRangeKind,
+	BA_OP_ChangeColumnStart,
+	BA_OP_ChangeColumnEndDelta,
+	BA_OP_ChangeCodeOffsetAndLineOffset,
+	BA_OP_ChangeCodeLengthAndCodeOffset,
+	BA_OP_ChangeColumnEnd,
+};
+
+#define SCOPE_OTHER                 0
+#define SCOPE_PROC                  1
+#define SCOPE_SITE                  2
+#define NO_INDEX                    0xFFFFFFFF
+
+// Line numbers the compiler uses to hide code from the debugger
+#define LINE_HIDDEN_1               0xFEEFEE
+#define LINE_HIDDEN_2               0xF00F00
+
+struct InlineIndex::ModuleLines
+{
+	std::unordered_map<uint32_t, uint32_t> files;                           // checksum offset -> file name
+	std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t> > inlinees;  // item id -> line, file name
+};
+
+////////////////////////////////////////////////////////////
+// Annotation operands are compressed to 1, 2 or 4 bytes
+//
+static bool ReadCompressed(const uint8_t *& pb, const uint8_t * pbEnd, uint32_t * pValue)
+{
+	if (pb >= pbEnd) {
+		return false;
+	}
+
+	uint8_t b = *pb++;
+
+	if ((b & 0x80) == 0) {
+		*pValue = b;
+	}
+
+	else if ((b & 0xC0) == 0x80) {
+		if (pb >= pbEnd) {
+			return false;
+		}
+
+		*pValue = ((b & 0x3F) << 8) | *pb++;
+	}
+
+	else if ((b & 0xE0) == 0xC0) {
+		if (pbEnd - pb < 3) {
+			return false;
+		}
+
+		*pValue = ((uint32_t)(b & 0x1F) << 24) | (pb[0] << 16) | (pb[1] << 8) | pb[2];
+		pb += 3;
+	}
+
+	else {
+		return false;
+	}
+
+	return true;
+}
+
+static int32_t DecodeSigned(uint32_t value)
+{
+	return (value & 1) ? -(int32_t)(value >> 1) : (int32_t)(value >> 1);
+}
+
+void InlineIndex::Clear()
+{
+	m_functions.clear();
+	m_sites.clear();
+	m_ranges.clear();
+	m_lines.clear();
+	m_strings.assign(1, '\0');
+	m_interned.clear();
+	m_funcIds.Clear();
+}
+
+uint32_t InlineIndex::Intern(const char * sz)
+{
+	auto it = m_interned.find(sz);
+
+	if (it != m_interned.end()) {
+		return it->second;
+	}
+
+	uint32_t off = (uint32_t)m_strings.size();
+
+	m_strings.insert(m_strings.end(), sz, sz + strlen(sz) + 1);
+	m_interned.insert(std::make_pair(std::string(sz), off));
+
+	return off;
+}
+
+////////////////////////////////////////////////////////////
+// Decode all the modules of a PDB
+//
+bool InlineIndex::Load(const PdbFile & pdb)
+{
+	Clear();
+
+	if (!m_funcIds.Load(pdb)) {
+		return false;
+	}
+
+	for (const PdbModule & module : pdb.Modules()) {
+		LoadModule(pdb, module);
+	}
+
+	std::sort(m_functions.begin(), m_functions.end(),
+		[](const Function & a, const Function & b) { return a.rvaBegin < b.rvaBegin; });
+	std::sort(m_lines.begin(), m_lines.end(),
+		[](const Line & a, const Line & b) { return a.rva < b.rva; });
+
+	std::unordered_map<std::string, uint32_t>().swap(m_interned);
+	m_funcIds.Clear();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Index the records of the IPI stream by item id
+//
+bool FuncIdIndex::Load(const PdbFile & pdb)
+{
+	Clear();
+
+	if (!pdb.ReadStream(PDB_STREAM_IPI, m_ipi) || m_ipi.size() < 20) {
+		return false;
+	}
+
+	uint32_t cbHeader = GetU32(&m_ipi[4]);
+
+	m_idFirst = GetU32(&m_ipi[8]);
+
+	for (size_t off = cbHeader; off + 4 <= m_ipi.size(); ) {
+		uint16_t cbRecord = GetU16(&m_ipi[off]);
+
+		if (off + 2 + cbRecord > m_ipi.size()) {
+			break;
+		}
+
+		m_items.push_back((uint32_t)off);
+		off += 2 + cbRecord;
+	}
+
+	return true;
+}
+
+void FuncIdIndex::Clear()
+{
+	std::vector<uint8_t>().swap(m_ipi);
+	std::vector<uint32_t>().swap(m_items);
+	m_idFirst = 0;
+}
+
+const uint8_t * FuncIdIndex::Item(uint32_t id, uint16_t * pcb) const
+{
+	uint32_t iItem = id - m_idFirst;
+
+	if (id < m_idFirst || iItem >= m_items.size()) {
+		return NULL;
+	}
+
+	*pcb = GetU16(&m_ipi[m_items[iItem]]);
+
+	return &m_ipi[m_items[iItem]];
+}
+
+////////////////////////////////////////////////////////////
+// The name of a function id, NULL when the item is not one
+//
+//  The name may be followed by LF_PAD bytes, so look for the
+//  terminator rather than checking the last byte.
+//
+const char * FuncIdIndex::Name(uint32_t id) const
+{
+	uint16_t cbRecord;
+	const uint8_t * pRecord = Item(id, &cbRecord);
+
+	if (pRecord == NULL || cbRecord <= 10) {
+		return NULL;
+	}
+
+	uint16_t kind = GetU16(pRecord + 2);
+
+	if ((kind != LF_FUNC_ID && kind != LF_MFUNC_ID) || memchr(pRecord + 12, '\0', cbRecord - 10) == NULL) {
+		return NULL;
+	}
+
+	return (const char *)pRecord + 12;
+}
+
+////////////////////////////////////////////////////////////
+// The name of a function id as its procedure is named, with
+//  the class of a member function or the namespace of the
+//  others, and the type of the function
+//
+bool FuncIdIndex::QualifiedName(uint32_t id, const TpiStream * pTpi, std::string & name, uint32_t * pType) const
+{
+	const char * szName = Name(id);
+
+	if (szName == NULL) {
+		return false;
+	}
+
+	const uint8_t * pRecord = &m_ipi[m_items[id - m_idFirst]];
+	uint32_t scope = GetU32(pRecord + 4);
+
+	name.clear();
+	*pType = GetU32(pRecord + 8);
+
+	if (GetU16(pRecord + 2) == LF_MFUNC_ID) {
+		if (pTpi != NULL) {
+			pTpi->TypeName(scope, name);
+		}
+	}
+
+	else if (scope != 0) {
+		uint16_t cbScope;
+		const uint8_t * pScope = Item(scope, &cbScope);
+
+		if (pScope != NULL && GetU16(pScope + 2) == LF_STRING_ID && cbScope > 6 &&
+			memchr(pScope + 8, '\0', cbScope - 6) != NULL) {
+			name = (const char *)pScope + 8;
+		}
+	}
+
+	if (!name.empty()) {
+		name += "::";
+	}
+
+	name += szName;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Read the file checksums, line blocks and inlinee base lines
+//  of a module's C13 subsections
+//
+void InlineIndex::LoadC13(const PdbFile & pdb, const uint8_t * pb, size_t cb, ModuleLines & lines)
+{
+	// File checksums first, the other subsections refer to them
+
+	for (size_t off = 0; off + 8 <= cb; ) {
+		uint32_t type = GetU32(pb + off);
+		uint32_t cbSub = GetU32(pb + off + 4);
+		const uint8_t * pSub = pb + off + 8;
+
+		if (cbSub > cb - off - 8) {
+			break;
+		}
+
+		if (type == DEBUG_S_FILECHKSMS) {
+			for (uint32_t offEntry = 0; offEntry + 6 <= cbSub; ) {
+				lines.files[offEntry] = Intern(pdb.Name(GetU32(pSub + offEntry)));
+				offEntry = (offEntry + 6 + pSub[offEntry + 4] + 3) & ~3u;
+			}
+		}
+
+		off += 8 + ((cbSub + 3) & ~3u);
+	}
+
+	for (size_t off = 0; off + 8 <= cb; ) {
+		uint32_t type = GetU32(pb + off);
+		uint32_t cbSub = GetU32(pb + off + 4);
+		const uint8_t * pSub = pb + off + 8;
+
+		if (cbSub > cb - off - 8) {
+			break;
+		}
+
+		if (type == DEBUG_S_LINES && cbSub >= 12) {
+			uint32_t offCon = GetU32(pSub);
+			uint16_t iSection = GetU16(pSub + 4);
+			uint32_t rvaCon;
+
+			if (pdb.SectionToRva(iSection, offCon, &rvaCon)) {
+				for (uint32_t offBlock = 12; offBlock + 12 <= cbSub; ) {
+					auto itFile = lines.files.find(GetU32(pSub + offBlock));
+					uint32_t cLines = GetU32(pSub + offBlock + 4);
+					uint32_t cbBlock = GetU32(pSub + offBlock + 8);
+
+					if (cbBlock < 12 || cbBlock > cbSub - offBlock || (uint64_t)cLines * 8 > cbBlock - 12) {
+						break;
+					}
+
+					for (uint32_t i = 0; i < cLines; i++) {
+						const uint8_t * pLine = pSub + offBlock + 12 + i * 8;
+						uint32_t line = GetU32(pLine + 4) & 0xFFFFFF;
+
+						if (line != LINE_HIDDEN_1 && line != LINE_HIDDEN_2) {
+							Line entry = {rvaCon + GetU32(pLine), line, (itFile != lines.files.end()) ? itFile->second : 0};
+
+							m_lines.push_back(entry);
+						}
+					}
+
+					offBlock += cbBlock;
+				}
+			}
+		}
+
+		else if (type == DEBUG_S_INLINEELINES && cbSub >= 4) {
+			bool fExtraFiles = GetU32(pSub) == 1;
+
+			for (uint32_t offEntry = 4; offEntry + 12 <= cbSub; ) {
+				auto itFile = lines.files.find(GetU32(pSub + offEntry + 4));
+
+				lines.inlinees[GetU32(pSub + offEntry)] =
+					std::make_pair(GetU32(pSub + offEntry + 8), (itFile != lines.files.end()) ? itFile->second : 0u);
+				offEntry += 12;
+
+				if (fExtraFiles) {
+					if (offEntry + 4 > cbSub) {
+						break;
+					}
+
+					offEntry += 4 + GetU32(pSub + offEntry) * 4;
+				}
+			}
+		}
+
+		off += 8 + ((cbSub + 3) & ~3u);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Turn the binary annotations of a site into code ranges
+//
+//  Code offsets are relative to the start of the function
+//  the site was inlined into. A range opened by a code offset
+//  change runs to the next one unless a length closes it;
+//  a length also moves the code offset past the range.
+//
+void InlineIndex::DecodeAnnotations(const uint8_t * pb,
+                                    size_t cb,
+                                    const Function & function,
+                                    uint32_t line,
+                                    uint32_t offFile,
+                                    const ModuleLines & lines)
+{
+	const uint8_t * pbEnd = pb + cb;
+	uint32_t codeOffset = 0;
+	uint32_t iOpen = NO_INDEX;
+	uint32_t iFirst = (uint32_t)m_ranges.size();
+
+	auto emit = [&]() {
+		if (iOpen != NO_INDEX) {
+			m_ranges[iOpen].rvaEnd = function.rvaBegin + codeOffset;
+		}
+
+		Range range = {function.rvaBegin + codeOffset, 0, line, offFile};
+
+		iOpen = (uint32_t)m_ranges.size();
+		m_ranges.push_back(range);
+	};
+
+	auto close = [&](uint32_t cbCode) {
+		if (iOpen != NO_INDEX) {
+			m_ranges[iOpen].rvaEnd = m_ranges[iOpen].rvaBegin + cbCode;
+			iOpen = NO_INDEX;
+		}
+
+		codeOffset += cbCode;
+	};
+
+	for (;;) {
+		uint32_t op, value, value2;
+
+		if (!ReadCompressed(pb, pbEnd, &op) || op == BA_OP_Invalid || !ReadCompressed(pb, pbEnd, &value)) {
+			break;
+		}
+
+		switch (op) {
+			case BA_OP_CodeOffset:
+				codeOffset = value;
+				break;
+
+			case BA_OP_ChangeCodeOffset:
+				codeOffset += value;
+				emit();
+				break;
+
+			case BA_OP_ChangeCodeLength:
+				close(value);
+				break;
+
+			case BA_OP_ChangeFile:
+			{
+				auto itFile = lines.files.find(value);
+
+				offFile = (itFile != lines.files.end()) ? itFile->second : 0;
+			}
+			break;
+
+			case BA_OP_ChangeLineOffset:
+				line += DecodeSigned(value);
+				break;
+
+			case BA_OP_ChangeCodeOffsetAndLineOffset:
+				line += DecodeSigned(value >> 4);
+				codeOffset += value & 0xF;
+				emit();
+				break;
+
+			case BA_OP_ChangeCodeLengthAndCodeOffset:
+				if (!ReadCompressed(pb, pbEnd, &value2)) {
+					pb = pbEnd;
+					break;
+				}
+
+				codeOffset += value2;
+				emit();
+				close(value);
+				break;
+
+			default:
+				// Columns, range kinds and the code offset base do not
+				//  affect the ranges
+				break;
+		}
+	}
+
+	if (iOpen != NO_INDEX) {
+		m_ranges[iOpen].rvaEnd = std::max(m_ranges[iOpen].rvaBegin, function.rvaEnd);
+	}
+
+	// Annotations usually come in address order, but lookups rely on it
+
+	std::sort(m_ranges.begin() + iFirst, m_ranges.end(),
+		[](const Range & a, const Range & b) { return a.rvaBegin < b.rvaBegin; });
+}
+
+////////////////////////////////////////////////////////////
+// Walk the symbols of a module, building a site tree for every
+//  function that has inlined code
+//
+bool InlineIndex::LoadModule(const PdbFile & pdb, const PdbModule & module)
+{
+	std::vector<uint8_t> data;
+
+	if (module.iStream == PDB_STREAM_NONE || !pdb.ReadStream(module.iStream, data)) {
+		return false;
+	}
+
+	ModuleLines lines;
+	size_t cbSymbols = std::min<size_t>(module.cbSymbols, data.size());
+	uint64_t offC13 = (uint64_t)module.cbSymbols + module.cbC11Lines;
+
+	if (offC13 + module.cbC13Lines <= data.size()) {
+		LoadC13(pdb, &data[(size_t)offC13], module.cbC13Lines, lines);
+	}
+
+	std::vector<uint8_t> scopes;
+	std::vector<uint32_t> siteStack;
+	uint32_t iFunction = NO_INDEX;
+
+	for (size_t off = 4; off + 4 <= cbSymbols; ) {
+		const uint8_t * pRecord = &data[off];
+		uint16_t cbRecord = GetU16(pRecord);
+		uint16_t kind = GetU16(pRecord + 2);
+
+		if (cbRecord < 2 || off + 2 + cbRecord > cbSymbols) {
+			break;
+		}
+
+		const uint8_t * pEnd = pRecord + 2 + cbRecord;
+
+		switch (kind) {
+			case S_GPROC32:
+			case S_LPROC32:
+			case S_GPROC32_ID:
+			case S_LPROC32_ID:
+			case S_LPROC32_DPC:
+			case S_LPROC32_DPC_ID:
+			{
+				Function function;
+
+				if (cbRecord < 38 || !pdb.SectionToRva(GetU16(pRecord + 36), GetU32(pRecord + 32), &function.rvaBegin)) {
+					scopes.push_back(SCOPE_OTHER);
+					break;
+				}
+
+				std::string name((const char *)pRecord + 39, strnlen((const char *)pRecord + 39, pEnd - pRecord - 39));
+
+				function.rvaEnd = function.rvaBegin + GetU32(pRecord + 16);
+				function.offName = Intern(name.c_str());
+				function.iFirstSite = (uint32_t)m_sites.size();
+				function.iEndSite = function.iFirstSite;
+
+				iFunction = (uint32_t)m_functions.size();
+				m_functions.push_back(function);
+				scopes.push_back(SCOPE_PROC);
+			}
+			break;
+
+			case S_INLINESITE:
+			case S_INLINESITE2:
+			{
+				size_t offAnnotations = (kind == S_INLINESITE2) ? 20 : 16;
+
+				if (iFunction == NO_INDEX || (size_t)(pEnd - pRecord) < offAnnotations) {
+					scopes.push_back(SCOPE_OTHER);
+					break;
+				}
+
+				uint32_t idInlinee = GetU32(pRecord + 12);
+				const char * szInlinee = m_funcIds.Name(idInlinee);
+				auto itBase = lines.inlinees.find(idInlinee);
+				Site site;
+
+				site.offName = (szInlinee != NULL) ? Intern(szInlinee) : 0;
+
+				site.iNext = NO_INDEX;
+				site.iFirstRange = (uint32_t)m_ranges.size();
+
+				DecodeAnnotations(pRecord + offAnnotations, pEnd - pRecord - offAnnotations, m_functions[iFunction],
+					(itBase != lines.inlinees.end()) ? itBase->second.first : 0,
+					(itBase != lines.inlinees.end()) ? itBase->second.second : 0,
+					lines);
+
+				site.iEndRange = (uint32_t)m_ranges.size();
+
+				siteStack.push_back((uint32_t)m_sites.size());
+				m_sites.push_back(site);
+				scopes.push_back(SCOPE_SITE);
+			}
+			break;
+
+			case S_THUNK32:
+			case S_BLOCK32:
+			case S_WITH32:
+			case S_SEPCODE:
+				scopes.push_back(SCOPE_OTHER);
+				break;
+
+			case S_END:
+			case S_PROC_ID_END:
+			case S_INLINESITE_END:
+				if (scopes.empty()) {
+					break;
+				}
+
+				if (scopes.back() == SCOPE_SITE) {
+					m_sites[siteStack.back()].iNext = (uint32_t)m_sites.size();
+					siteStack.pop_back();
+				}
+
+				else if (scopes.back() == SCOPE_PROC) {
+					m_functions[iFunction].iEndSite = (uint32_t)m_sites.size();
+					iFunction = NO_INDEX;
+				}
+
+				scopes.pop_back();
+				break;
+		}
+
+		off += 2 + cbRecord;
+	}
+
+	// Close whatever a truncated stream left open
+
+	while (!siteStack.empty()) {
+		m_sites[siteStack.back()].iNext = (uint32_t)m_sites.size();
+		siteStack.pop_back();
+	}
+
+	if (iFunction != NO_INDEX) {
+		m_functions[iFunction].iEndSite = (uint32_t)m_sites.size();
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Inline chain at rva, innermost first, ending with the real
+//  function; empty when no function covers rva
+//
+void InlineIndex::Lookup(uint32_t rva, std::vector<InlineFrame> & frames) const
+{
+	frames.clear();
+
+	auto itFunction = std::upper_bound(m_functions.begin(), m_functions.end(), rva,
+		[](uint32_t value, const Function & function) { return value < function.rvaBegin; });
+
+	if (itFunction == m_functions.begin() || rva >= (--itFunction)->rvaEnd) {
+		return;
+	}
+
+	const Function & function = *itFunction;
+	uint32_t i = function.iFirstSite;
+	uint32_t iEnd = function.iEndSite;
+
+	// Descend into the sites having a range at rva, outermost first
+
+	while (i < iEnd) {
+		const Site & site = m_sites[i];
+		auto itBegin = m_ranges.begin() + site.iFirstRange;
+		auto itEnd = m_ranges.begin() + site.iEndRange;
+		auto itRange = std::upper_bound(itBegin, itEnd, rva,
+			[](uint32_t value, const Range & range) { return value < range.rvaBegin; });
+
+		if (itRange != itBegin && rva < (itRange - 1)->rvaEnd) {
+			const Range & range = *(itRange - 1);
+			InlineFrame frame = {&m_strings[site.offName], &m_strings[range.offFile], range.line, true};
+
+			frames.push_back(frame);
+			iEnd = site.iNext;
+			i++;
+		}
+
+		else {
+			i = site.iNext;
+		}
+	}
+
+	std::reverse(frames.begin(), frames.end());
+
+	// The function's own line is the outermost call site
+
+	InlineFrame frame = {&m_strings[function.offName], "", 0, false};
+	auto itLine = std::upper_bound(m_lines.begin(), m_lines.end(), rva,
+		[](uint32_t value, const Line & line) { return value < line.rva; });
+
+	if (itLine != m_lines.begin() && (itLine - 1)->rva >= function.rvaBegin) {
+		frame.szFile = &m_strings[(itLine - 1)->offFile];
+		frame.line = (itLine - 1)->line;
+	}
+
+	frames.push_back(frame);
+}
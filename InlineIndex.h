@@ -0,0 +1,119 @@
+// InlineIndex.h : Inline call chains from S_INLINESITE records
+//
+// Decodes the binary annotations of every inline site in a PDB into
+// address ranges with their own file and line, nested per function
+// the same way the sites are nested. A lookup returns the chain of
+// inlined calls at an address, innermost first, ending with the
+// function the code was inlined into.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PdbFile.h"
+#include "TpiStream.h"
+
+struct InlineFrame
+{
+	const char * szName;
+	const char * szFile;                 // "" when unknown
+	uint32_t line;                       // 0 when unknown
+	bool fInlined;                       // false for the outermost, real function
+};
+
+////////////////////////////////////////////////////////////
+// The LF_FUNC_ID and LF_MFUNC_ID records of the IPI stream
+//
+//  Inline sites and S_CALLEES refer to functions by item id,
+//  the procedures of a linked PDB only by name.
+//
+class FuncIdIndex
+{
+	public:
+	bool Load(const PdbFile & pdb);
+	void Clear();
+
+	const char * Name(uint32_t id) const;
+	bool QualifiedName(uint32_t id, const TpiStream * pTpi, std::string & name, uint32_t * pType) const;
+
+	private:
+	const uint8_t * Item(uint32_t id, uint16_t * pcb) const;
+
+	std::vector<uint8_t> m_ipi;
+	std::vector<uint32_t> m_items;       // IPI item id - first id -> offset of its record
+	uint32_t m_idFirst = 0;
+};
+
+////////////////////////////////////////////////////////////
+// Address sorted functions with their inline site trees
+//
+//  The sites of a function are stored in pre-order, iNext
+//  skips a site's subtree, so a lookup descends only into
+//  the sites that contain the address.
+//
+class InlineIndex
+{
+	public:
+	bool Load(const PdbFile & pdb);
+	void Clear();
+
+	void Lookup(uint32_t rva, std::vector<InlineFrame> & frames) const;
+
+	size_t CountFunctions() const { return m_functions.size(); }
+	size_t CountSites() const { return m_sites.size(); }
+	size_t CountRanges() const { return m_ranges.size(); }
+
+	private:
+	struct Function
+	{
+		uint32_t rvaBegin;
+		uint32_t rvaEnd;
+		uint32_t offName;
+		uint32_t iFirstSite;
+		uint32_t iEndSite;
+	};
+
+	struct Site
+	{
+		uint32_t offName;
+		uint32_t iNext;
+		uint32_t iFirstRange;
+		uint32_t iEndRange;
+	};
+
+	struct Range
+	{
+		uint32_t rvaBegin;
+		uint32_t rvaEnd;
+		uint32_t line;
+		uint32_t offFile;
+	};
+
+	struct Line
+	{
+		uint32_t rva;
+		uint32_t line;
+		uint32_t offFile;
+	};
+
+	struct ModuleLines;
+
+	bool LoadModule(const PdbFile & pdb, const PdbModule & module);
+	void LoadC13(const PdbFile & pdb, const uint8_t * pb, size_t cb, ModuleLines & lines);
+	void DecodeAnnotations(const uint8_t * pb, size_t cb, const Function & function, uint32_t line, uint32_t offFile, const ModuleLines & lines);
+	uint32_t Intern(const char * sz);
+
+	std::vector<Function> m_functions;
+	std::vector<Site> m_sites;
+	std::vector<Range> m_ranges;
+	std::vector<Line> m_lines;
+	std::vector<char> m_strings;
+
+	// Only used while loading
+	std::unordered_map<std::string, uint32_t> m_interned;
+	FuncIdIndex m_funcIds;
+};
@@ -0,0 +1,309 @@
+// LayoutCache.cpp : Flattened UDT layouts from the TPI stream
+//
+
+#include "LayoutCache.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "Util.h"
+
+#define LAYOUT_BLOCK_TYPES          4096
+#define LAYOUT_MAX_DEPTH            32
+#define LAYOUT_MAX_SCALAR_ALIGN     8
+
+#define TPI_PROP_PACKED             0x0001
+
+struct LayoutBlock
+{
+	std::vector<UdtLayout> layouts;
+	std::vector<LayoutMember> members;
+};
+
+////////////////////////////////////////////////////////////
+// Strip the modifiers, arrays and bitfields around a type, they
+//  share the alignment of their element
+//
+static uint32_t ElementType(const TpiStream & tpi, uint32_t ti)
+{
+	for (int depth = 0; depth < LAYOUT_MAX_DEPTH; depth++) {
+		uint16_t leaf = tpi.Leaf(ti);
+		uint16_t cb;
+		const uint8_t * pb = tpi.Record(ti, &cb);
+
+		if ((leaf != LF_MODIFIER && leaf != LF_ARRAY && leaf != LF_BITFIELD) || cb < 4) {
+			break;
+		}
+
+		ti = GetU32(pb);
+	}
+
+	return ti;
+}
+
+static bool IsLayoutLeaf(uint16_t leaf)
+{
+	return leaf == LF_CLASS || leaf == LF_STRUCTURE || leaf == LF_UNION || leaf == LF_INTERFACE;
+}
+
+////////////////////////////////////////////////////////////
+// Decode the direct members of a definition
+//
+static void FlattenUdt(const TpiStream & tpi, uint32_t ti, const TpiUdt & udt, const std::vector<TpiField> & fields, LayoutBlock & block)
+{
+	UdtLayout layout;
+	std::vector<std::pair<uint64_t, uint64_t> > vbptrs;      // offset, size
+	TpiUdt base;
+
+	layout.ti = ti;
+	layout.leaf = udt.leaf;
+	layout.fVirtualBases = false;
+	layout.szName = udt.szName;
+	layout.cb = udt.cb;
+	layout.align = 0;
+	layout.iFirstMember = (uint32_t)block.members.size();
+
+	for (const TpiField & field : fields) {
+		LayoutMember member;
+
+		member.szName = field.szName;
+		member.type = tpi.Definition(field.type);
+		member.align = 0;
+		member.offset = (uint64_t)field.offset;
+		member.cb = tpi.TypeSize(field.type);
+		member.kind = LAYOUT_MEMBER;
+		member.bitPos = 0;
+		member.cBits = 0;
+
+		switch (field.leaf) {
+			case LF_MEMBER:
+				if (tpi.Leaf(field.type) == LF_BITFIELD) {
+					uint16_t cb;
+					const uint8_t * pb = tpi.Record(field.type, &cb);
+
+					if (cb >= 6) {
+						member.type = tpi.Definition(GetU32(pb));
+						member.cBits = pb[4];
+						member.bitPos = pb[5];
+					}
+				}
+
+				break;
+
+			case LF_BCLASS:
+			case LF_BINTERFACE:
+				member.kind = LAYOUT_BASE;
+				member.szName = tpi.GetUdt(member.type, base) ? base.szName : "";
+				break;
+
+			case LF_VBCLASS:
+			case LF_IVBCLASS:
+				layout.fVirtualBases = true;
+				vbptrs.push_back(std::make_pair((uint64_t)field.offset, tpi.TypeSize(field.vbptrType)));
+				continue;
+
+			case LF_VFUNCTAB:
+				member.kind = LAYOUT_VFPTR;
+				member.szName = "<vfptr>";
+				member.offset = 0;
+				break;
+
+			default:
+				continue;
+		}
+
+		block.members.push_back(member);
+	}
+
+	// A vbptr inherited from a non-virtual base is already inside
+	//  that base, the class only adds the vbptrs it introduces
+
+	std::sort(vbptrs.begin(), vbptrs.end());
+	vbptrs.erase(std::unique(vbptrs.begin(), vbptrs.end()), vbptrs.end());
+
+	for (const auto & vbptr : vbptrs) {
+		bool fInherited = false;
+
+		for (uint32_t i = layout.iFirstMember; i < block.members.size(); i++) {
+			const LayoutMember & member = block.members[i];
+
+			if (member.kind == LAYOUT_BASE && vbptr.first >= member.offset && vbptr.first < member.offset + member.cb) {
+				fInherited = true;
+			}
+		}
+
+		if (!fInherited) {
+			LayoutMember member = {"<vbptr>", 0, 0, vbptr.first, vbptr.second, LAYOUT_VBPTR, 0, 0};
+
+			block.members.push_back(member);
+		}
+	}
+
+	layout.cMembers = (uint32_t)block.members.size() - layout.iFirstMember;
+	block.layouts.push_back(layout);
+}
+
+////////////////////////////////////////////////////////////
+// Decode all the definitions, then size their alignments
+//
+//  The threads decode blocks of type indices into their own
+//  arrays, which are appended in type index order. Alignments
+//  depend on the member types, so they are computed afterwards,
+//  on one thread, memoized per layout.
+//
+bool LayoutCache::Build(const TpiStream & tpi, unsigned cThreads)
+{
+	Clear();
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	m_pTpi = &tpi;
+
+	uint32_t cBlocks = (tpi.CountTypes() + LAYOUT_BLOCK_TYPES - 1) / LAYOUT_BLOCK_TYPES;
+	std::vector<LayoutBlock> blocks(cBlocks);
+	std::atomic<uint32_t> iNextBlock(0);
+
+	auto worker = [&](unsigned) {
+		std::vector<TpiField> fields;
+		TpiUdt udt;
+
+		for (uint32_t iBlock; (iBlock = iNextBlock++) < cBlocks; ) {
+			uint32_t tiBegin = tpi.FirstIndex() + iBlock * LAYOUT_BLOCK_TYPES;
+			uint32_t tiEnd = std::min<uint32_t>(tiBegin + LAYOUT_BLOCK_TYPES, tpi.EndIndex());
+
+			for (uint32_t ti = tiBegin; ti < tiEnd; ti++) {
+				if (IsLayoutLeaf(tpi.Leaf(ti)) && tpi.GetUdt(ti, udt) && !(udt.property & TPI_PROP_FWDREF) &&
+					tpi.GetFields(udt.fieldList, fields)) {
+					FlattenUdt(tpi, ti, udt, fields, blocks[iBlock]);
+				}
+			}
+		}
+	};
+
+	RunParallel(cThreads, worker);
+
+	m_layoutIndex.assign(tpi.CountTypes(), LAYOUT_NONE);
+
+	for (LayoutBlock & block : blocks) {
+		uint32_t iFirstMember = (uint32_t)m_members.size();
+
+		for (UdtLayout & layout : block.layouts) {
+			layout.iFirstMember += iFirstMember;
+			m_layoutIndex[layout.ti - tpi.FirstIndex()] = (uint32_t)m_layouts.size();
+			m_layouts.push_back(layout);
+		}
+
+		m_members.insert(m_members.end(), block.members.begin(), block.members.end());
+		std::vector<UdtLayout>().swap(block.layouts);
+		std::vector<LayoutMember>().swap(block.members);
+	}
+
+	for (const UdtLayout & layout : m_layouts) {
+		ComputeAlignment(layout.ti, 0);
+	}
+
+	return true;
+}
+
+void LayoutCache::Clear()
+{
+	m_pTpi = NULL;
+	std::vector<UdtLayout>().swap(m_layouts);
+	std::vector<LayoutMember>().swap(m_members);
+	std::vector<uint32_t>().swap(m_layoutIndex);
+}
+
+const UdtLayout * LayoutCache::Find(uint32_t ti) const
+{
+	if (m_pTpi == NULL) {
+		return NULL;
+	}
+
+	ti = m_pTpi->Definition(ti);
+
+	if (ti < m_pTpi->FirstIndex() || ti >= m_pTpi->EndIndex()) {
+		return NULL;
+	}
+
+	uint32_t iLayout = m_layoutIndex[ti - m_pTpi->FirstIndex()];
+
+	return (iLayout != LAYOUT_NONE) ? &m_layouts[iLayout] : NULL;
+}
+
+////////////////////////////////////////////////////////////
+// The natural alignment of any type; scalars are aligned on
+//  their size, up to 8 bytes
+//
+uint32_t LayoutCache::Alignment(uint32_t ti) const
+{
+	if (m_pTpi == NULL) {
+		return 1;
+	}
+
+	ti = ElementType(*m_pTpi, ti);
+
+	uint16_t leaf = m_pTpi->Leaf(ti);
+
+	if (ti < m_pTpi->FirstIndex() || leaf == LF_POINTER || leaf == LF_ENUM) {
+		uint64_t cb = m_pTpi->TypeSize(ti);
+
+		return (cb == 0) ? 1 : (uint32_t)std::min<uint64_t>(cb, LAYOUT_MAX_SCALAR_ALIGN);
+	}
+
+	const UdtLayout * pLayout = Find(ti);
+
+	return (pLayout != NULL && pLayout->align != 0) ? pLayout->align : 1;
+}
+
+uint32_t LayoutCache::ComputeAlignment(uint32_t ti, int depth)
+{
+	const UdtLayout * pLayout = Find(ti);
+
+	if (pLayout == NULL) {
+		return Alignment(ti);
+	}
+
+	UdtLayout & layout = m_layouts[pLayout - m_layouts.data()];
+
+	if (layout.align != 0 || depth > LAYOUT_MAX_DEPTH) {
+		return (layout.align != 0) ? layout.align : 1;
+	}
+
+	TpiUdt udt;
+	uint32_t align = 1;
+
+	layout.align = 1;                    // breaks cycles through bad records
+
+	for (uint32_t i = 0; i < layout.cMembers; i++) {
+		LayoutMember & member = m_members[layout.iFirstMember + i];
+
+		if (member.kind == LAYOUT_VFPTR || member.kind == LAYOUT_VBPTR) {
+			member.align = (member.cb != 0) ? (uint32_t)std::min<uint64_t>(member.cb, LAYOUT_MAX_SCALAR_ALIGN) : 1;
+		}
+
+		else {
+			uint32_t element = ElementType(*m_pTpi, member.type);
+
+			member.align = (Find(element) != NULL) ? ComputeAlignment(element, depth + 1) : Alignment(element);
+		}
+
+		align = std::max(align, member.align);
+	}
+
+	// A size that is not a multiple of the members' alignment means
+	//  the type was packed
+
+	if (m_pTpi->GetUdt(ti, udt) && (udt.property & TPI_PROP_PACKED)) {
+		align = 1;
+	}
+
+	while (align > 1 && layout.cb % align != 0) {
+		align /= 2;
+	}
+
+	layout.align = align;
+
+	return align;
+}
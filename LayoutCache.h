@@ -0,0 +1,71 @@
+// LayoutCache.h : Flattened UDT layouts from the TPI stream
+//
+// Every class, structure and union definition is decoded once, on
+// worker threads, into a flat array of its direct members with their
+// offset, size and alignment: data members, base class subobjects
+// and the vfptr and vbptr the class introduces. Nested UDTs are not
+// expanded, a member refers to the layout of its type instead, so
+// the analyses walking down the members share the decoded layouts.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "TpiStream.h"
+
+#define LAYOUT_NONE                 0xFFFFFFFF
+
+#define LAYOUT_MEMBER               0
+#define LAYOUT_BASE                 1
+#define LAYOUT_VFPTR                2
+#define LAYOUT_VBPTR                3
+
+struct LayoutMember
+{
+	const char * szName;                 // the base class name for bases
+	uint32_t type;                       // forward references resolved
+	uint32_t align;
+	uint64_t offset;
+	uint64_t cb;                         // of the storage unit for bitfields
+	uint8_t kind;
+	uint8_t bitPos;
+	uint8_t cBits;                       // 0 when not a bitfield
+};
+
+struct UdtLayout
+{
+	uint32_t ti;
+	uint16_t leaf;
+	bool fVirtualBases;                  // virtual base subobjects are not in the members
+	const char * szName;
+	uint64_t cb;
+	uint32_t align;
+	uint32_t iFirstMember;
+	uint32_t cMembers;
+};
+
+////////////////////////////////////////////////////////////
+// The layouts of all the UDT definitions, by type index
+//
+class LayoutCache
+{
+	public:
+	bool Build(const TpiStream & tpi, unsigned cThreads);
+	void Clear();
+
+	const std::vector<UdtLayout> & Layouts() const { return m_layouts; }
+	const UdtLayout * Find(uint32_t ti) const;
+	const LayoutMember * Members(const UdtLayout & layout) const { return m_members.data() + layout.iFirstMember; }
+	uint32_t Alignment(uint32_t ti) const;
+	const TpiStream * Types() const { return m_pTpi; }
+
+	private:
+	uint32_t ComputeAlignment(uint32_t ti, int depth);
+
+	const TpiStream * m_pTpi = NULL;
+	std::vector<UdtLayout> m_layouts;
+	std::vector<LayoutMember> m_members;
+	std::vector<uint32_t> m_layoutIndex;   // per type index, LAYOUT_NONE when not a definition
+};
@@ -0,0 +1,251 @@
+// LinkOrder.cpp : Hot code clustering for link order files
+//
+
+#include "LinkOrder.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+// Same limits as the lld call graph sort: clusters stay below 1MB and
+//  a merge may not dilute the caller cluster's density by more than 8x
+#define ORDER_CLUSTER_MAX           (1024 * 1024)
+#define ORDER_DENSITY_DEGRADATION   8
+
+#define ORDER_NO_INDEX              0xFFFFFFFF
+
+static uint32_t FindContrib(const std::vector<OrderContrib> & contribs, uint32_t rva)
+{
+	auto it = std::upper_bound(contribs.begin(), contribs.end(), rva,
+		[](uint32_t value, const OrderContrib & contrib) { return value < contrib.rva; });
+
+	if (rva == PROFILE_NO_RVA || it == contribs.begin() || rva - (it - 1)->rva >= (it - 1)->cb) {
+		return ORDER_NO_INDEX;
+	}
+
+	return (uint32_t)(it - 1 - contribs.begin());
+}
+
+static uint64_t AlignedSize(const OrderContrib & contrib)
+{
+	return ((uint64_t)contrib.cb + ORDER_FUNCTION_ALIGN - 1) & ~(uint64_t)(ORDER_FUNCTION_ALIGN - 1);
+}
+
+void SortOrderContribs(std::vector<OrderContrib> & contribs)
+{
+	std::sort(contribs.begin(), contribs.end(),
+		[](const OrderContrib & a, const OrderContrib & b) { return a.rva < b.rva; });
+}
+
+////////////////////////////////////////////////////////////
+// Count the self samples of every contribution with a merge
+//  pass, and the call edges between them from the stacks
+//
+void CountOrderSamples(std::vector<OrderContrib> & contribs, const ProfileSamples & samples, std::vector<OrderEdge> & edges)
+{
+	std::vector<ProfileSample> leaves(samples.Leaves());
+	size_t iContrib = 0;
+
+	std::sort(leaves.begin(), leaves.end(),
+		[](const ProfileSample & a, const ProfileSample & b) { return a.rva < b.rva; });
+
+	for (OrderContrib & contrib : contribs) {
+		contrib.samples = 0;
+	}
+
+	for (const ProfileSample & sample : leaves) {
+		while (iContrib < contribs.size() && sample.rva - contribs[iContrib].rva >= contribs[iContrib].cb &&
+			sample.rva >= contribs[iContrib].rva) {
+			iContrib++;
+		}
+
+		if (sample.rva != PROFILE_NO_RVA && iContrib < contribs.size() && sample.rva >= contribs[iContrib].rva) {
+			contribs[iContrib].samples += sample.count;
+		}
+	}
+
+	// Callers are return addresses, look them up one byte back
+
+	std::unordered_map<uint64_t, uint64_t> weights;
+
+	for (const ProfileStack & stack : samples.Stacks()) {
+		uint32_t iCallee = FindContrib(contribs, stack.frames[0]);
+
+		for (size_t i = 1; i < stack.frames.size(); i++) {
+			uint32_t rva = stack.frames[i];
+			uint32_t iCaller = FindContrib(contribs, (rva != 0 && rva != PROFILE_NO_RVA) ? rva - 1 : rva);
+
+			if (iCaller != ORDER_NO_INDEX && iCallee != ORDER_NO_INDEX && iCaller != iCallee) {
+				weights[((uint64_t)iCaller << 32) | iCallee] += stack.count;
+			}
+
+			iCallee = iCaller;
+		}
+	}
+
+	edges.clear();
+
+	for (const auto & weight : weights) {
+		OrderEdge edge = {(uint32_t)(weight.first >> 32), (uint32_t)weight.first, weight.second};
+
+		edges.push_back(edge);
+	}
+
+	std::sort(edges.begin(), edges.end(),
+		[](const OrderEdge & a, const OrderEdge & b) { return a.iCaller < b.iCaller || (a.iCaller == b.iCaller && a.iCallee < b.iCallee); });
+}
+
+////////////////////////////////////////////////////////////
+// Order the hot contributions, those with samples or on a
+//  sampled stack, by call-chain clustering
+//
+void ClusterOrderContribs(const std::vector<OrderContrib> & contribs, const std::vector<OrderEdge> & edges, std::vector<uint32_t> & order)
+{
+	struct Cluster
+	{
+		uint64_t samples;
+		uint64_t cb;
+		std::vector<uint32_t> members;
+	};
+
+	std::vector<uint32_t> bestCaller(contribs.size(), ORDER_NO_INDEX);
+	std::vector<uint64_t> bestWeight(contribs.size(), 0);
+	std::vector<bool> hot(contribs.size(), false);
+
+	for (size_t i = 0; i < contribs.size(); i++) {
+		hot[i] = contribs[i].samples != 0;
+	}
+
+	for (const OrderEdge & edge : edges) {
+		hot[edge.iCaller] = true;
+		hot[edge.iCallee] = true;
+
+		if (edge.weight > bestWeight[edge.iCallee]) {
+			bestWeight[edge.iCallee] = edge.weight;
+			bestCaller[edge.iCallee] = edge.iCaller;
+		}
+	}
+
+	std::vector<Cluster> clusters;
+	std::vector<uint32_t> clusterOf(contribs.size(), ORDER_NO_INDEX);
+	std::vector<uint32_t> byHeat;
+
+	for (uint32_t i = 0; i < contribs.size(); i++) {
+		if (hot[i]) {
+			Cluster cluster;
+
+			cluster.samples = contribs[i].samples;
+			cluster.cb = AlignedSize(contribs[i]);
+			cluster.members.push_back(i);
+
+			clusterOf[i] = (uint32_t)clusters.size();
+			clusters.push_back(cluster);
+			byHeat.push_back(i);
+		}
+	}
+
+	std::stable_sort(byHeat.begin(), byHeat.end(),
+		[&](uint32_t a, uint32_t b) { return contribs[a].samples > contribs[b].samples; });
+
+	auto density = [](uint64_t samples, uint64_t cb) { return (double)samples / (double)(cb ? cb : 1); };
+
+	for (uint32_t iCallee : byHeat) {
+		uint32_t iCaller = bestCaller[iCallee];
+
+		if (iCaller == ORDER_NO_INDEX || clusterOf[iCaller] == clusterOf[iCallee]) {
+			continue;
+		}
+
+		Cluster & to = clusters[clusterOf[iCaller]];
+		Cluster & from = clusters[clusterOf[iCallee]];
+
+		if (to.cb + from.cb > ORDER_CLUSTER_MAX ||
+			density(to.samples + from.samples, to.cb + from.cb) * ORDER_DENSITY_DEGRADATION < density(to.samples, to.cb)) {
+			continue;
+		}
+
+		for (uint32_t iMember : from.members) {
+			clusterOf[iMember] = clusterOf[iCaller];
+		}
+
+		to.members.insert(to.members.end(), from.members.begin(), from.members.end());
+		to.samples += from.samples;
+		to.cb += from.cb;
+
+		from.members.clear();
+		from.samples = 0;
+		from.cb = 0;
+	}
+
+	std::vector<uint32_t> sorted;
+
+	for (uint32_t i = 0; i < clusters.size(); i++) {
+		if (!clusters[i].members.empty()) {
+			sorted.push_back(i);
+		}
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[&](uint32_t a, uint32_t b) { return density(clusters[a].samples, clusters[a].cb) > density(clusters[b].samples, clusters[b].cb); });
+
+	order.clear();
+
+	for (uint32_t iCluster : sorted) {
+		order.insert(order.end(), clusters[iCluster].members.begin(), clusters[iCluster].members.end());
+	}
+}
+
+static uint64_t CountUnits(std::vector<uint64_t> & units)
+{
+	std::sort(units.begin(), units.end());
+
+	return std::unique(units.begin(), units.end()) - units.begin();
+}
+
+////////////////////////////////////////////////////////////
+// Pages and cache lines spanned by the hot contributions, in
+//  the current layout and with the ordered COMDATs packed
+//  together; the others stay where they are
+//
+void EstimateOrderWorkingSet(const std::vector<OrderContrib> & contribs, const std::vector<uint32_t> & order, OrderWorkingSet & ws)
+{
+	std::vector<uint64_t> pagesBefore, linesBefore, pagesAfter, linesAfter;
+	uint64_t offPacked = 0;
+
+	auto span = [](uint64_t off, uint64_t cb, uint64_t cbUnit, std::vector<uint64_t> & units) {
+		for (uint64_t unit = off / cbUnit; cb != 0 && unit <= (off + cb - 1) / cbUnit; unit++) {
+			units.push_back(unit);
+		}
+	};
+
+	for (uint32_t i : order) {
+		const OrderContrib & contrib = contribs[i];
+
+		span(contrib.rva, contrib.cb, ORDER_PAGE_SIZE, pagesBefore);
+		span(contrib.rva, contrib.cb, ORDER_CACHE_LINE_SIZE, linesBefore);
+
+		if (contrib.fComdat && !contrib.name.empty()) {
+			span(offPacked, contrib.cb, ORDER_PAGE_SIZE, pagesAfter);
+			span(offPacked, contrib.cb, ORDER_CACHE_LINE_SIZE, linesAfter);
+			offPacked += AlignedSize(contrib);
+		}
+	}
+
+	// The fixed contributions go in a separate range so they can not
+	//  share units with the packed ones
+
+	uint64_t offFixed = (offPacked + ORDER_PAGE_SIZE) & ~(uint64_t)(ORDER_PAGE_SIZE - 1);
+
+	for (uint32_t i : order) {
+		const OrderContrib & contrib = contribs[i];
+
+		if (!contrib.fComdat || contrib.name.empty()) {
+			span(offFixed + contrib.rva, contrib.cb, ORDER_PAGE_SIZE, pagesAfter);
+			span(offFixed + contrib.rva, contrib.cb, ORDER_CACHE_LINE_SIZE, linesAfter);
+		}
+	}
+
+	ws.cPagesBefore = CountUnits(pagesBefore);
+	ws.cLinesBefore = CountUnits(linesBefore);
+	ws.cPagesAfter = CountUnits(pagesAfter);
+	ws.cLinesAfter = CountUnits(linesAfter);
+}
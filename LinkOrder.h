@@ -0,0 +1,49 @@
+// LinkOrder.h : Hot code clustering for link order files
+//
+// Attributes profile samples to the code contributions of an image
+// and orders the hot ones with call-chain clustering (C3): every
+// function is appended to the cluster of its heaviest caller, then
+// the clusters are sorted by sample density. Without call stacks in
+// the profile the result is a plain hotness sort.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Profile.h"
+
+#define ORDER_PAGE_SIZE             4096
+#define ORDER_CACHE_LINE_SIZE       64
+#define ORDER_FUNCTION_ALIGN        16
+
+struct OrderContrib
+{
+	uint32_t rva;
+	uint32_t cb;
+	std::string name;                    // decorated, empty if there is no public at the start
+	bool fComdat;                        // only COMDATs can be placed by /ORDER
+	uint64_t samples;
+};
+
+struct OrderEdge
+{
+	uint32_t iCaller;
+	uint32_t iCallee;
+	uint64_t weight;
+};
+
+struct OrderWorkingSet
+{
+	uint64_t cPagesBefore;
+	uint64_t cPagesAfter;
+	uint64_t cLinesBefore;
+	uint64_t cLinesAfter;
+};
+
+void SortOrderContribs(std::vector<OrderContrib> & contribs);
+void CountOrderSamples(std::vector<OrderContrib> & contribs, const ProfileSamples & samples, std::vector<OrderEdge> & edges);
+void ClusterOrderContribs(const std::vector<OrderContrib> & contribs, const std::vector<OrderEdge> & edges, std::vector<uint32_t> & order);
+void EstimateOrderWorkingSet(const std::vector<OrderContrib> & contribs, const std::vector<uint32_t> & order, OrderWorkingSet & ws);
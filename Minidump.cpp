@@ -0,0 +1,438 @@
+// Minidump.cpp : Reader for Windows minidump files
+//
+
+#include "Minidump.h"
+
+#include <algorithm>
+#include <string.h>
+#include <wchar.h>
+
+#include "PeImage.h"
+#include "Util.h"
+
+#define MINIDUMP_STREAM_THREAD_LIST     3
+#define MINIDUMP_STREAM_MODULE_LIST     4
+#define MINIDUMP_STREAM_MEMORY_LIST     5
+#define MINIDUMP_STREAM_EXCEPTION       6
+#define MINIDUMP_STREAM_SYSTEM_INFO     7
+#define MINIDUMP_STREAM_MEMORY64_LIST   9
+
+// Sizes of the fixed records
+#define CB_MINIDUMP_MODULE              108
+#define CB_MINIDUMP_THREAD              48
+#define CB_MINIDUMP_MEMORY_DESCRIPTOR   16
+#define CB_CONTEXT_X86                  0xCC
+#define CB_CONTEXT_AMD64                0x100
+
+Minidump::Minidump()
+{
+	Clear();
+}
+
+void Minidump::Clear()
+{
+	m_file.clear();
+	m_modules.clear();
+	m_threads.clear();
+	m_memory.Clear();
+	m_wArchitecture = MINIDUMP_ARCH_UNKNOWN;
+	m_fException = false;
+	m_dwExceptionThreadId = 0;
+	m_dwExceptionCode = 0;
+	m_qwExceptionAddress = 0;
+	m_rvaExceptionContext = 0;
+	m_cbExceptionContext = 0;
+}
+
+bool Minidump::Load(const char * szPath)
+{
+	std::vector<uint8_t> file;
+
+	return ReadWholeFile(szPath, file) && Load(file);
+}
+
+#ifdef _WIN32
+bool Minidump::Load(const wchar_t * wszPath)
+{
+	std::vector<uint8_t> file;
+
+	return ReadWholeFile(wszPath, file) && Load(file);
+}
+#endif
+
+////////////////////////////////////////////////////////////
+// Take over the contents of file and parse them
+//
+bool Minidump::Load(std::vector<uint8_t> & file)
+{
+	Clear();
+
+	m_file.swap(file);
+
+	if (!Parse()) {
+		Clear();
+
+		return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Walk the stream directory, streams that are not needed are
+//  skipped and a damaged optional stream is not fatal
+//
+bool Minidump::Parse()
+{
+	const uint8_t * pb = m_file.data();
+	size_t cb = m_file.size();
+
+	if (cb < 32 || memcmp(pb, "MDMP", 4) != 0) {
+		return false;
+	}
+
+	uint32_t cStreams = GetU32(pb + 8);
+	uint32_t rvaDir = GetU32(pb + 12);
+
+	if (rvaDir > cb || (cb - rvaDir) / 12 < cStreams) {
+		return false;
+	}
+
+	bool fModules = false;
+	bool fThreads = false;
+
+	for (uint32_t i = 0; i < cStreams; i++) {
+		const uint8_t * pEntry = pb + rvaDir + i * 12;
+		uint32_t cbStream = GetU32(pEntry + 4);
+		uint32_t rvaStream = GetU32(pEntry + 8);
+
+		if (rvaStream > cb || cb - rvaStream < cbStream) {
+			continue;
+		}
+
+		switch (GetU32(pEntry)) {
+			case MINIDUMP_STREAM_THREAD_LIST:
+				fThreads = ParseThreads(rvaStream, cbStream);
+				break;
+
+			case MINIDUMP_STREAM_MODULE_LIST:
+				fModules = ParseModules(rvaStream, cbStream);
+				break;
+
+			case MINIDUMP_STREAM_MEMORY_LIST:
+				ParseMemory(rvaStream, cbStream);
+				break;
+
+			case MINIDUMP_STREAM_MEMORY64_LIST:
+				ParseMemory64(rvaStream, cbStream);
+				break;
+
+			case MINIDUMP_STREAM_EXCEPTION:
+				ParseException(rvaStream, cbStream);
+				break;
+
+			case MINIDUMP_STREAM_SYSTEM_INFO:
+				if (cbStream >= 2) {
+					m_wArchitecture = GetU16(pb + rvaStream);
+				}
+				break;
+		}
+	}
+
+	return fModules && fThreads;
+}
+
+////////////////////////////////////////////////////////////
+// MINIDUMP_STRING: byte length followed by UTF-16 text
+//
+bool Minidump::ReadString(uint32_t rva, std::wstring & str) const
+{
+	str.clear();
+
+	if (rva > m_file.size() || m_file.size() - rva < 4) {
+		return false;
+	}
+
+	uint32_t cb = GetU32(&m_file[rva]);
+
+	if (m_file.size() - rva - 4 < cb) {
+		return false;
+	}
+
+	const uint8_t * pb = &m_file[rva + 4];
+
+	for (uint32_t i = 0; i + 1 < cb; i += 2) {
+		str += (wchar_t)GetU16(pb + i);
+	}
+
+	return true;
+}
+
+bool Minidump::ParseModules(uint32_t rva, uint32_t cb)
+{
+	if (cb < 4) {
+		return false;
+	}
+
+	const uint8_t * pb = &m_file[rva];
+	uint32_t cModules = GetU32(pb);
+
+	if ((cb - 4) / CB_MINIDUMP_MODULE < cModules) {
+		return false;
+	}
+
+	m_modules.resize(cModules);
+
+	for (uint32_t i = 0; i < cModules; i++) {
+		const uint8_t * pModule = pb + 4 + i * CB_MINIDUMP_MODULE;
+		MinidumpModule & module = m_modules[i];
+
+		module.qwBase = GetU64(pModule);
+		module.cbImage = GetU32(pModule + 8);
+		module.dwChecksum = GetU32(pModule + 12);
+		module.dwTimeDateStamp = GetU32(pModule + 16);
+		module.fRsds = false;
+		module.dwAge = 0;
+		memset(module.rgGuid, 0, sizeof(module.rgGuid));
+		module.pdbName.clear();
+
+		ReadString(GetU32(pModule + 20), module.name);
+
+		// CodeView record, RSDS for every PDB 7.0 image
+
+		uint32_t cbCv = GetU32(pModule + 76);
+		uint32_t rvaCv = GetU32(pModule + 80);
+
+		if (cbCv >= 25 && rvaCv <= m_file.size() && m_file.size() - rvaCv >= cbCv &&
+			memcmp(&m_file[rvaCv], "RSDS", 4) == 0) {
+			const uint8_t * pCv = &m_file[rvaCv];
+
+			memcpy(module.rgGuid, pCv + 4, 16);
+			module.dwAge = GetU32(pCv + 20);
+			module.fRsds = true;
+
+			for (uint32_t ich = 24; ich < cbCv && pCv[ich] != '\0'; ich++) {
+				module.pdbName += (wchar_t)pCv[ich];
+			}
+		}
+	}
+
+	std::sort(m_modules.begin(), m_modules.end(),
+		[](const MinidumpModule & a, const MinidumpModule & b) { return a.qwBase < b.qwBase; });
+
+	return true;
+}
+
+bool Minidump::ParseThreads(uint32_t rva, uint32_t cb)
+{
+	if (cb < 4) {
+		return false;
+	}
+
+	const uint8_t * pb = &m_file[rva];
+	uint32_t cThreads = GetU32(pb);
+
+	if ((cb - 4) / CB_MINIDUMP_THREAD < cThreads) {
+		return false;
+	}
+
+	m_threads.resize(cThreads);
+
+	for (uint32_t i = 0; i < cThreads; i++) {
+		const uint8_t * pThread = pb + 4 + i * CB_MINIDUMP_THREAD;
+		MinidumpThread & thread = m_threads[i];
+		uint32_t rvaStack = GetU32(pThread + 36);
+
+		thread.dwThreadId = GetU32(pThread);
+		thread.qwStackStart = GetU64(pThread + 24);
+		thread.cbStack = GetU32(pThread + 32);
+		thread.cbContext = GetU32(pThread + 40);
+		thread.rvaContext = GetU32(pThread + 44);
+
+		// Stacks are normally in the memory list too, adding them
+		//  again is harmless and covers dumps where they are not
+
+		if (rvaStack <= m_file.size() && m_file.size() - rvaStack >= thread.cbStack) {
+			m_memory.AddRange(thread.qwStackStart, &m_file[rvaStack], thread.cbStack);
+		}
+	}
+
+	return true;
+}
+
+bool Minidump::ParseMemory(uint32_t rva, uint32_t cb)
+{
+	if (cb < 4) {
+		return false;
+	}
+
+	const uint8_t * pb = &m_file[rva];
+	uint32_t cRanges = GetU32(pb);
+
+	if ((cb - 4) / CB_MINIDUMP_MEMORY_DESCRIPTOR < cRanges) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < cRanges; i++) {
+		const uint8_t * pRange = pb + 4 + i * CB_MINIDUMP_MEMORY_DESCRIPTOR;
+		uint32_t cbRange = GetU32(pRange + 8);
+		uint32_t rvaRange = GetU32(pRange + 12);
+
+		if (rvaRange <= m_file.size() && m_file.size() - rvaRange >= cbRange) {
+			m_memory.AddRange(GetU64(pRange), &m_file[rvaRange], cbRange);
+		}
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Full memory dumps: the data of all the ranges follows the
+//  descriptors back to back, starting at BaseRva
+//
+bool Minidump::ParseMemory64(uint32_t rva, uint32_t cb)
+{
+	if (cb < 16) {
+		return false;
+	}
+
+	const uint8_t * pb = &m_file[rva];
+	uint64_t cRanges = GetU64(pb);
+	uint64_t offData = GetU64(pb + 8);
+
+	if ((cb - 16) / CB_MINIDUMP_MEMORY_DESCRIPTOR < cRanges) {
+		return false;
+	}
+
+	for (uint64_t i = 0; i < cRanges; i++) {
+		const uint8_t * pRange = pb + 16 + i * CB_MINIDUMP_MEMORY_DESCRIPTOR;
+		uint64_t cbRange = GetU64(pRange + 8);
+
+		if (offData > m_file.size() || m_file.size() - offData < cbRange) {
+			return false;
+		}
+
+		m_memory.AddRange(GetU64(pRange), &m_file[(size_t)offData], cbRange);
+		offData += cbRange;
+	}
+
+	return true;
+}
+
+bool Minidump::ParseException(uint32_t rva, uint32_t cb)
+{
+	if (cb < 168) {
+		return false;
+	}
+
+	const uint8_t * pb = &m_file[rva];
+
+	m_fException = true;
+	m_dwExceptionThreadId = GetU32(pb);
+	m_dwExceptionCode = GetU32(pb + 8);
+	m_qwExceptionAddress = GetU64(pb + 24);
+	m_cbExceptionContext = GetU32(pb + 160);
+	m_rvaExceptionContext = GetU32(pb + 164);
+
+	return true;
+}
+
+const MinidumpModule * Minidump::ModuleOf(uint64_t qwAddress) const
+{
+	auto it = std::upper_bound(m_modules.begin(), m_modules.end(), qwAddress,
+		[](uint64_t value, const MinidumpModule & module) { return value < module.qwBase; });
+
+	if (it == m_modules.begin()) {
+		return NULL;
+	}
+
+	--it;
+
+	return (qwAddress - it->qwBase < it->cbImage) ? &*it : NULL;
+}
+
+////////////////////////////////////////////////////////////
+// The CONTEXT of a thread, the one captured at the exception
+//  for the faulting thread
+//
+const uint8_t * Minidump::ThreadContext(const MinidumpThread & thread, uint32_t cbMin) const
+{
+	uint32_t rva = thread.rvaContext;
+	uint32_t cb = thread.cbContext;
+
+	if (m_fException && thread.dwThreadId == m_dwExceptionThreadId && m_rvaExceptionContext != 0) {
+		rva = m_rvaExceptionContext;
+		cb = m_cbExceptionContext;
+	}
+
+	if (cb < cbMin || rva > m_file.size() || m_file.size() - rva < cb) {
+		return NULL;
+	}
+
+	return &m_file[rva];
+}
+
+bool Minidump::GetContext(const MinidumpThread & thread, X86Context & ctx) const
+{
+	const uint8_t * pb = ThreadContext(thread, CB_CONTEXT_X86);
+
+	if (pb == NULL || m_wArchitecture != MINIDUMP_ARCH_X86) {
+		return false;
+	}
+
+	ctx.rgReg[FrameVarEdi] = GetU32(pb + 0x9C);
+	ctx.rgReg[FrameVarEsi] = GetU32(pb + 0xA0);
+	ctx.rgReg[FrameVarEbx] = GetU32(pb + 0xA4);
+	ctx.rgReg[FrameVarEdx] = GetU32(pb + 0xA8);
+	ctx.rgReg[FrameVarEcx] = GetU32(pb + 0xAC);
+	ctx.rgReg[FrameVarEax] = GetU32(pb + 0xB0);
+	ctx.rgReg[FrameVarEbp] = GetU32(pb + 0xB4);
+	ctx.rgReg[FrameVarEip] = GetU32(pb + 0xB8);
+	ctx.rgReg[FrameVarEsp] = GetU32(pb + 0xC4);
+	ctx.fValid = (1u << FRAME_REG_COUNT) - 1;
+
+	return true;
+}
+
+bool Minidump::GetContext(const MinidumpThread & thread, X64Context & ctx) const
+{
+	const uint8_t * pb = ThreadContext(thread, CB_CONTEXT_AMD64);
+
+	if (pb == NULL || m_wArchitecture != MINIDUMP_ARCH_AMD64) {
+		return false;
+	}
+
+	// Rax through R15 are stored in unwind code order
+
+	for (int reg = X64RegRax; reg <= X64RegR15; reg++) {
+		ctx.rgReg[reg] = GetU64(pb + 0x78 + reg * 8);
+	}
+
+	ctx.rgReg[X64RegRip] = GetU64(pb + 0xF8);
+	ctx.fValid = (1u << X64RegMax) - 1;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Symbol server key of the module's PDB: GUID then age, in hex
+//
+void FormatPdbSignature(const MinidumpModule & module, std::wstring & sig)
+{
+	wchar_t wsz[48];
+
+	sig.clear();
+
+	if (!module.fRsds) {
+		return;
+	}
+
+	const uint8_t * pb = module.rgGuid;
+
+	swprintf(wsz, sizeof(wsz) / sizeof(wsz[0]), L"%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%X",
+		GetU32(pb), GetU16(pb + 4), GetU16(pb + 6),
+		pb[8], pb[9], pb[10], pb[11], pb[12], pb[13], pb[14], pb[15],
+		module.dwAge);
+
+	sig = wsz;
+}
@@ -0,0 +1,96 @@
+// Minidump.h : Reader for Windows minidump files
+//
+// Decodes the module, thread, exception, system info and memory
+// streams. The memory ranges are exposed as a MemorySnapshot over the
+// file contents, so reads are not copied until a caller asks.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "FrameProgram.h"
+#include "UnwindX64.h"
+
+#define MINIDUMP_ARCH_X86           0
+#define MINIDUMP_ARCH_AMD64         9
+#define MINIDUMP_ARCH_UNKNOWN       0xFFFF
+
+struct MinidumpModule
+{
+	uint64_t qwBase;
+	uint32_t cbImage;
+	uint32_t dwChecksum;
+	uint32_t dwTimeDateStamp;
+	std::wstring name;                   // full path of the image when dumped
+	std::wstring pdbName;                // from the CodeView record, empty if none
+	uint8_t rgGuid[16];
+	uint32_t dwAge;
+	bool fRsds;                          // rgGuid and dwAge are valid
+};
+
+struct MinidumpThread
+{
+	uint32_t dwThreadId;
+	uint64_t qwStackStart;
+	uint32_t cbStack;
+	uint32_t rvaContext;
+	uint32_t cbContext;
+};
+
+////////////////////////////////////////////////////////////
+// A minidump file read into memory
+//
+class Minidump
+{
+	public:
+	Minidump();
+
+	bool Load(const char * szPath);
+#ifdef _WIN32
+	bool Load(const wchar_t * wszPath);
+#endif
+	bool Load(std::vector<uint8_t> & file);
+	void Clear();
+
+	uint16_t Architecture() const { return m_wArchitecture; }
+	const std::vector<MinidumpModule> & Modules() const { return m_modules; }
+	const std::vector<MinidumpThread> & Threads() const { return m_threads; }
+	const MemorySnapshot & Memory() const { return m_memory; }
+
+	bool HasException() const { return m_fException; }
+	uint32_t ExceptionThreadId() const { return m_dwExceptionThreadId; }
+	uint32_t ExceptionCode() const { return m_dwExceptionCode; }
+	uint64_t ExceptionAddress() const { return m_qwExceptionAddress; }
+
+	const MinidumpModule * ModuleOf(uint64_t qwAddress) const;
+
+	bool GetContext(const MinidumpThread & thread, X86Context & ctx) const;
+	bool GetContext(const MinidumpThread & thread, X64Context & ctx) const;
+
+	private:
+	bool Parse();
+	bool ParseModules(uint32_t rva, uint32_t cb);
+	bool ParseThreads(uint32_t rva, uint32_t cb);
+	bool ParseMemory(uint32_t rva, uint32_t cb);
+	bool ParseMemory64(uint32_t rva, uint32_t cb);
+	bool ParseException(uint32_t rva, uint32_t cb);
+	bool ReadString(uint32_t rva, std::wstring & str) const;
+	const uint8_t * ThreadContext(const MinidumpThread & thread, uint32_t cbMin) const;
+
+	std::vector<uint8_t> m_file;
+	std::vector<MinidumpModule> m_modules;
+	std::vector<MinidumpThread> m_threads;
+	MemorySnapshot m_memory;
+	uint16_t m_wArchitecture;
+	bool m_fException;
+	uint32_t m_dwExceptionThreadId;
+	uint32_t m_dwExceptionCode;
+	uint64_t m_qwExceptionAddress;
+	uint32_t m_rvaExceptionContext;
+	uint32_t m_cbExceptionContext;
+};
+
+void FormatPdbSignature(const MinidumpModule & module, std::wstring & sig);
@@ -0,0 +1,389 @@
+// OdrCheck.cpp : One definition rule violations between UDT definitions
+//
+
+#include "OdrCheck.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Util.h"
+
+#define ODR_BLOCK_TYPES             4096
+
+struct OdrInstance
+{
+	uint32_t ti;
+	uint64_t hash;
+	size_t hashName;
+	const char * szName;                 // into the TPI stream data
+};
+
+struct OdrNameKey
+{
+	const char * szName;
+	size_t hash;
+
+	bool operator==(const OdrNameKey & other) const { return hash == other.hash && strcmp(szName, other.szName) == 0; }
+};
+
+struct OdrNameKeyHash
+{
+	size_t operator()(const OdrNameKey & key) const { return key.hash; }
+};
+
+////////////////////////////////////////////////////////////
+// Anonymous types get compiler made names that unrelated types
+//  share, they cannot violate the rule
+//
+static bool IsAnonymousName(const char * szName)
+{
+	return *szName == '\0' || strstr(szName, "<unnamed-") != NULL || strstr(szName, "<anonymous-") != NULL ||
+		strstr(szName, "__unnamed") != NULL;
+}
+
+////////////////////////////////////////////////////////////
+// The canonical layout of a class, structure, union or enum
+//  definition; methods, statics and nested types are left out
+//
+bool GetOdrLayout(const TpiStream & tpi, uint32_t ti, OdrLayout & layout)
+{
+	TpiUdt udt;
+	std::vector<TpiField> fields;
+
+	layout.cb = 0;
+	layout.fields.clear();
+
+	if (!tpi.GetUdt(ti, udt) || !tpi.GetFields(udt.fieldList, fields)) {
+		return false;
+	}
+
+	layout.cb = (udt.leaf == LF_ENUM) ? tpi.TypeSize(udt.underlying) : udt.cb;
+
+	for (const TpiField & field : fields) {
+		OdrField odrField;
+
+		odrField.offset = field.offset;
+		odrField.bitPos = 0;
+		odrField.cBits = 0;
+
+		switch (field.leaf) {
+			case LF_MEMBER:
+				odrField.name = field.szName;
+
+				if (tpi.Leaf(field.type) == LF_BITFIELD) {
+					uint16_t cb;
+					const uint8_t * pb = tpi.Record(field.type, &cb);
+
+					if (cb >= 6) {
+						odrField.cBits = pb[4];
+						odrField.bitPos = pb[5];
+					}
+				}
+
+				break;
+
+			case LF_BCLASS:
+			case LF_BINTERFACE:
+				odrField.name = "<base>";
+				break;
+
+			case LF_VBCLASS:
+			case LF_IVBCLASS:
+				odrField.name = "<virtual base>";
+				break;
+
+			case LF_VFUNCTAB:
+				odrField.name = "<vfptr>";
+				break;
+
+			case LF_ENUMERATE:
+				odrField.name = field.szName;
+				break;
+
+			default:
+				continue;
+		}
+
+		if (field.type != 0) {
+			tpi.TypeName(field.type, odrField.type);
+		}
+
+		layout.fields.push_back(odrField);
+	}
+
+	return true;
+}
+
+uint64_t HashOdrLayout(const OdrLayout & layout)
+{
+	uint64_t hash = HashU64(FNV_OFFSET_BASIS, layout.cb);
+
+	for (const OdrField & field : layout.fields) {
+		hash = HashU64(hash, (uint64_t)field.offset);
+		hash = HashU64(hash, ((uint64_t)field.bitPos << 8) | field.cBits);
+		hash = HashBytes(hash, field.name.c_str(), field.name.size() + 1);
+		hash = HashBytes(hash, field.type.c_str(), field.type.size() + 1);
+	}
+
+	return hash;
+}
+
+static void DescribeField(const OdrField & field, std::string & text)
+{
+	char szBuffer[64];
+
+	if (field.cBits != 0) {
+		snprintf(szBuffer, sizeof(szBuffer), " @ 0x%llx bits %u:%u", (long long)field.offset, field.bitPos, field.cBits);
+	}
+
+	else {
+		snprintf(szBuffer, sizeof(szBuffer), " @ 0x%llx", (long long)field.offset);
+	}
+
+	text = field.name;
+
+	if (!field.type.empty()) {
+		text += " : ";
+		text += field.type;
+	}
+
+	text += szBuffer;
+}
+
+////////////////////////////////////////////////////////////
+// Field level differences, "-" for a field only in the old layout,
+//  "+" only in the new one, "~" moved or retyped. Repeated names,
+//  like several bases, are matched in order.
+//
+void DiffOdrLayouts(const OdrLayout & oldLayout, const OdrLayout & newLayout, std::vector<std::string> & differences)
+{
+	std::unordered_map<std::string, uint32_t> newFields;
+	std::unordered_map<std::string, uint32_t> occurrences;
+	std::vector<uint8_t> matched(newLayout.fields.size(), 0);
+	std::string oldText, newText;
+	char szBuffer[64];
+
+	differences.clear();
+
+	if (oldLayout.cb != newLayout.cb) {
+		snprintf(szBuffer, sizeof(szBuffer), "size 0x%llx -> 0x%llx", (unsigned long long)oldLayout.cb, (unsigned long long)newLayout.cb);
+		differences.push_back(szBuffer);
+	}
+
+	for (uint32_t i = 0; i < newLayout.fields.size(); i++) {
+		std::string key = newLayout.fields[i].name + "#" + std::to_string(occurrences[newLayout.fields[i].name]++);
+
+		newFields[key] = i;
+	}
+
+	occurrences.clear();
+
+	for (const OdrField & oldField : oldLayout.fields) {
+		std::string key = oldField.name + "#" + std::to_string(occurrences[oldField.name]++);
+		auto it = newFields.find(key);
+
+		DescribeField(oldField, oldText);
+
+		if (it == newFields.end()) {
+			differences.push_back("- " + oldText);
+
+			continue;
+		}
+
+		const OdrField & newField = newLayout.fields[it->second];
+
+		matched[it->second] = 1;
+
+		if (newField.offset != oldField.offset || newField.type != oldField.type ||
+			newField.bitPos != oldField.bitPos || newField.cBits != oldField.cBits) {
+			DescribeField(newField, newText);
+			differences.push_back("~ " + oldText + " -> " + newText);
+		}
+	}
+
+	for (uint32_t i = 0; i < newLayout.fields.size(); i++) {
+		if (!matched[i]) {
+			DescribeField(newLayout.fields[i], newText);
+			differences.push_back("+ " + newText);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Where each type was defined, from the LF_UDT_SRC_LINE and
+//  LF_UDT_MOD_SRC_LINE records of the IPI stream
+//
+static void LoadOdrSources(const PdbFile & pdb, const TpiStream & ipi, const std::unordered_set<uint32_t> & types,
+                           std::unordered_map<uint32_t, std::string> & sources)
+{
+	const std::vector<PdbModule> & modules = pdb.Modules();
+	char szLine[32];
+
+	for (uint32_t id = ipi.FirstIndex(); id < ipi.EndIndex(); id++) {
+		uint16_t leaf = ipi.Leaf(id);
+		uint16_t cb;
+		const uint8_t * pb = ipi.Record(id, &cb);
+
+		if ((leaf != LF_UDT_SRC_LINE && leaf != LF_UDT_MOD_SRC_LINE) || cb < 12 || types.count(GetU32(pb)) == 0) {
+			continue;
+		}
+
+		std::string & source = sources[GetU32(pb)];
+		const char * szFile = (leaf == LF_UDT_SRC_LINE) ? ipi.StringId(GetU32(pb + 4)) : pdb.Name(GetU32(pb + 4));
+
+		snprintf(szLine, sizeof(szLine), "(%u)", GetU32(pb + 8));
+		source = (szFile != NULL) ? szFile : "?";
+		source += szLine;
+
+		// The module index is one based
+
+		if (leaf == LF_UDT_MOD_SRC_LINE && cb >= 14) {
+			uint16_t iModule = GetU16(pb + 12);
+
+			if (iModule != 0 && iModule <= modules.size()) {
+				source += " [" + modules[iModule - 1].name + "]";
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Find the names defined with more than one layout
+//
+void FindOdrViolations(const PdbFile & pdb, const TpiStream & tpi, const TpiStream & ipi, unsigned cThreads,
+                       std::vector<OdrViolation> & violations, OdrStats & stats)
+{
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	violations.clear();
+	stats.cDefinitions = 0;
+	stats.cNames = 0;
+
+	// Hash every definition, the threads take blocks of type indices
+
+	std::vector<std::vector<OdrInstance> > threadInstances(cThreads);
+	std::atomic<uint32_t> tiNext(tpi.FirstIndex());
+
+	auto hasher = [&](unsigned iThread) {
+		std::hash<std::string> hashName;
+		OdrLayout layout;
+		TpiUdt udt;
+
+		for (uint32_t tiBegin; (tiBegin = tiNext.fetch_add(ODR_BLOCK_TYPES)) < tpi.EndIndex(); ) {
+			uint32_t tiEnd = std::min<uint32_t>(tiBegin + ODR_BLOCK_TYPES, tpi.EndIndex());
+
+			for (uint32_t ti = tiBegin; ti < tiEnd; ti++) {
+				if (!IsUdtLeaf(tpi.Leaf(ti)) || !tpi.GetUdt(ti, udt) || (udt.property & TPI_PROP_FWDREF) ||
+					IsAnonymousName(udt.szName) || !GetOdrLayout(tpi, ti, layout)) {
+					continue;
+				}
+
+				OdrInstance instance = {ti, HashOdrLayout(layout), hashName(udt.szName), udt.szName};
+
+				threadInstances[iThread].push_back(instance);
+			}
+		}
+	};
+
+	RunParallel(cThreads, hasher);
+
+	// Group by name, thread t owns the names hashing to t
+
+	std::vector<std::vector<std::vector<OdrInstance> > > threadCandidates(cThreads);
+	std::vector<uint32_t> threadNames(cThreads, 0);
+
+	auto grouper = [&](unsigned iThread) {
+		std::unordered_map<OdrNameKey, std::vector<OdrInstance>, OdrNameKeyHash> byName;
+
+		for (const std::vector<OdrInstance> & instances : threadInstances) {
+			for (const OdrInstance & instance : instances) {
+				if (instance.hashName % cThreads == iThread) {
+					OdrNameKey key = {instance.szName, instance.hashName};
+
+					byName[key].push_back(instance);
+				}
+			}
+		}
+
+		threadNames[iThread] = (uint32_t)byName.size();
+
+		for (auto & entry : byName) {
+			std::vector<OdrInstance> & instances = entry.second;
+
+			for (const OdrInstance & instance : instances) {
+				if (instance.hash != instances[0].hash) {
+					threadCandidates[iThread].push_back(std::move(instances));
+					break;
+				}
+			}
+		}
+	};
+
+	RunParallel(cThreads, grouper);
+
+	for (unsigned i = 0; i < cThreads; i++) {
+		stats.cDefinitions += (uint32_t)threadInstances[i].size();
+		stats.cNames += threadNames[i];
+	}
+
+	// Only the violations are decoded again, with their sources
+
+	std::unordered_set<uint32_t> types;
+	std::unordered_map<uint32_t, std::string> sources;
+
+	for (const auto & candidates : threadCandidates) {
+		for (const std::vector<OdrInstance> & instances : candidates) {
+			for (const OdrInstance & instance : instances) {
+				types.insert(instance.ti);
+			}
+		}
+	}
+
+	LoadOdrSources(pdb, ipi, types, sources);
+
+	for (auto & candidates : threadCandidates) {
+		for (std::vector<OdrInstance> & instances : candidates) {
+			OdrViolation violation;
+
+			violation.name = instances[0].szName;
+
+			std::sort(instances.begin(), instances.end(),
+				[](const OdrInstance & a, const OdrInstance & b) { return a.ti < b.ti; });
+
+			for (const OdrInstance & instance : instances) {
+				auto itDef = std::find_if(violation.definitions.begin(), violation.definitions.end(),
+					[&](const OdrDefinition & definition) { return definition.hash == instance.hash; });
+
+				if (itDef == violation.definitions.end()) {
+					violation.definitions.push_back(OdrDefinition());
+					itDef = violation.definitions.end() - 1;
+					itDef->hash = instance.hash;
+					GetOdrLayout(tpi, instance.ti, itDef->layout);
+				}
+
+				auto itSource = sources.find(instance.ti);
+
+				itDef->types.push_back(instance.ti);
+
+				if (itSource != sources.end()) {
+					itDef->sources.push_back(itSource->second);
+				}
+			}
+
+			std::stable_sort(violation.definitions.begin(), violation.definitions.end(),
+				[](const OdrDefinition & a, const OdrDefinition & b) { return a.types.size() > b.types.size(); });
+
+			violations.push_back(std::move(violation));
+		}
+	}
+
+	std::sort(violations.begin(), violations.end(),
+		[](const OdrViolation & a, const OdrViolation & b) { return a.name < b.name; });
+}
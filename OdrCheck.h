@@ -0,0 +1,60 @@
+// OdrCheck.h : One definition rule violations between UDT definitions
+//
+// Every class, structure, union and enum definition of the TPI stream
+// is reduced to a canonical layout - size, bases, vfptr, data members
+// with their offset, bitfield and type spelling, or enumerators - and
+// hashed, on worker threads. The hashes are then grouped by name, one
+// name hash partition per thread, and only the names with more than
+// one distinct layout are decoded again for the report. No layout is
+// kept for the names that agree.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "PdbFile.h"
+#include "TpiStream.h"
+
+struct OdrField
+{
+	std::string name;                    // "<base>", "<virtual base>" and "<vfptr>" for the hidden ones
+	std::string type;
+	int64_t offset;                      // byte offset, vbptr offset or enumerator value
+	uint8_t bitPos;
+	uint8_t cBits;                       // 0 when not a bitfield
+};
+
+struct OdrLayout
+{
+	uint64_t cb;
+	std::vector<OdrField> fields;
+};
+
+struct OdrDefinition
+{
+	uint64_t hash;
+	OdrLayout layout;
+	std::vector<uint32_t> types;         // type indices sharing the layout
+	std::vector<std::string> sources;    // "file(line) [compiland]" from the IPI stream
+};
+
+struct OdrViolation
+{
+	std::string name;
+	std::vector<OdrDefinition> definitions;   // most common layout first
+};
+
+struct OdrStats
+{
+	uint32_t cDefinitions;               // UDT definitions hashed
+	uint32_t cNames;                     // distinct names among them
+};
+
+bool GetOdrLayout(const TpiStream & tpi, uint32_t ti, OdrLayout & layout);
+uint64_t HashOdrLayout(const OdrLayout & layout);
+void DiffOdrLayouts(const OdrLayout & oldLayout, const OdrLayout & newLayout, std::vector<std::string> & differences);
+void FindOdrViolations(const PdbFile & pdb, const TpiStream & tpi, const TpiStream & ipi, unsigned cThreads,
+                       std::vector<OdrViolation> & violations, OdrStats & stats);
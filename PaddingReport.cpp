@@ -0,0 +1,256 @@
+// PaddingReport.cpp : Padding, holes and cache line use of UDT layouts
+//
+
+#include "PaddingReport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Util.h"
+
+#define PADDING_BLOCK_LAYOUTS       1024
+
+struct PaddingUnit
+{
+	uint32_t iFirst;                     // member index, sorted by offset
+	uint32_t cMembers;                   // bitfields sharing a storage unit
+	uint64_t cb;
+	uint32_t align;
+	uint64_t offset;
+};
+
+////////////////////////////////////////////////////////////
+// Measure one layout, filling detail when given
+//
+static void AnalyzeLayout(const LayoutCache & cache, const UdtLayout & layout, PaddingResult & result, PaddingDetail * pDetail)
+{
+	const LayoutMember * pMembers = cache.Members(layout);
+	std::vector<uint32_t> sorted(layout.cMembers);
+	std::vector<PaddingUnit> units;
+	uint64_t cbEnd = 0;
+	uint64_t cbFixedEnd = 0;
+
+	result.cbHoles = 0;
+	result.cbTail = 0;
+	result.cbMin = layout.cb;
+	result.cStraddles = 0;
+
+	for (uint32_t i = 0; i < layout.cMembers; i++) {
+		sorted[i] = i;
+	}
+
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[&](uint32_t a, uint32_t b) { return pMembers[a].offset < pMembers[b].offset; });
+
+	for (uint32_t iSorted = 0; iSorted < sorted.size(); iSorted++) {
+		const LayoutMember & member = pMembers[sorted[iSorted]];
+
+		// Union members all start at 0, only the tail can be padding
+
+		if (layout.leaf != LF_UNION && member.offset > cbEnd) {
+			result.cbHoles += member.offset - cbEnd;
+
+			if (pDetail != NULL) {
+				PaddingHole hole = {cbEnd, member.offset - cbEnd};
+
+				pDetail->holes.push_back(hole);
+			}
+		}
+
+		cbEnd = std::max(cbEnd, member.offset + member.cb);
+
+		if (member.kind != LAYOUT_MEMBER) {
+			cbFixedEnd = std::max(cbFixedEnd, member.offset + member.cb);
+
+			continue;
+		}
+
+		if (member.cBits == 0 && member.cb != 0 && member.cb <= PADDING_CACHE_LINE &&
+			(member.offset % PADDING_CACHE_LINE) + member.cb > PADDING_CACHE_LINE) {
+			result.cStraddles++;
+
+			if (pDetail != NULL) {
+				pDetail->straddles.push_back(sorted[iSorted]);
+			}
+		}
+
+		if (member.cBits != 0 && !units.empty() && units.back().offset == member.offset &&
+			pMembers[sorted[units.back().iFirst]].cBits != 0) {
+			units.back().cMembers++;
+
+			continue;
+		}
+
+		PaddingUnit unit = {iSorted, 1, member.cb, member.align ? member.align : 1, member.offset};
+
+		units.push_back(unit);
+	}
+
+	if (!layout.fVirtualBases && layout.cb > cbEnd) {
+		result.cbTail = layout.cb - cbEnd;
+	}
+
+	if (layout.leaf == LF_UNION || layout.fVirtualBases) {
+		return;
+	}
+
+	// The vfptr, bases and vbptrs stay in front, the data members
+	//  follow by decreasing alignment, then size
+
+	std::stable_sort(units.begin(), units.end(),
+		[](const PaddingUnit & a, const PaddingUnit & b) { return a.align > b.align || (a.align == b.align && a.cb > b.cb); });
+
+	uint64_t cbPacked = cbFixedEnd;
+
+	for (const PaddingUnit & unit : units) {
+		cbPacked = (cbPacked + unit.align - 1) / unit.align * unit.align + unit.cb;
+
+		if (pDetail != NULL) {
+			for (uint32_t i = 0; i < unit.cMembers; i++) {
+				pDetail->order.push_back(sorted[unit.iFirst + i]);
+			}
+		}
+	}
+
+	uint32_t align = (layout.align != 0) ? layout.align : 1;
+
+	cbPacked = (cbPacked + align - 1) / align * align;
+
+	if (cbPacked != 0 && cbPacked < layout.cb) {
+		result.cbMin = cbPacked;
+	}
+}
+
+void DescribePadding(const LayoutCache & cache, const UdtLayout & layout, PaddingDetail & detail)
+{
+	PaddingResult result;
+
+	detail.holes.clear();
+	detail.straddles.clear();
+	detail.order.clear();
+
+	AnalyzeLayout(cache, layout, result, &detail);
+}
+
+////////////////////////////////////////////////////////////
+// Analyze every layout that has padding, straddles or could be
+//  smaller, by decreasing padding times weight
+//
+void AnalyzePadding(const LayoutCache & cache, const std::unordered_map<std::string, double> & weights, unsigned cThreads,
+                    std::vector<PaddingResult> & results)
+{
+	const std::vector<UdtLayout> & layouts = cache.Layouts();
+	std::vector<PaddingResult> all(layouts.size());
+	std::atomic<size_t> iNext(0);
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	auto worker = [&](unsigned) {
+		for (size_t iBegin; (iBegin = iNext.fetch_add(PADDING_BLOCK_LAYOUTS)) < layouts.size(); ) {
+			size_t iEnd = std::min<size_t>(iBegin + PADDING_BLOCK_LAYOUTS, layouts.size());
+
+			for (size_t i = iBegin; i < iEnd; i++) {
+				PaddingResult & result = all[i];
+
+				result.iLayout = (uint32_t)i;
+				AnalyzeLayout(cache, layouts[i], result, NULL);
+
+				auto it = weights.empty() ? weights.end() : weights.find(layouts[i].szName);
+
+				result.weight = (it != weights.end()) ? it->second : 1.0;
+				result.score = (double)(result.cbHoles + result.cbTail) * result.weight;
+			}
+		}
+	};
+
+	RunParallel(cThreads, worker);
+
+	results.clear();
+
+	for (const PaddingResult & result : all) {
+		if (result.cbHoles + result.cbTail != 0 || result.cStraddles != 0 || result.cbMin < layouts[result.iLayout].cb) {
+			results.push_back(result);
+		}
+	}
+
+	std::sort(results.begin(), results.end(),
+		[&](const PaddingResult & a, const PaddingResult & b) {
+			return a.score > b.score || (a.score == b.score && strcmp(layouts[a.iLayout].szName, layouts[b.iLayout].szName) < 0);
+		});
+}
+
+////////////////////////////////////////////////////////////
+// Read instance count weights, "<type name> <count>" per line;
+//  the count is the last field since type names contain spaces
+//
+bool LoadPaddingWeights(FILE * pFile, std::unordered_map<std::string, double> & weights)
+{
+	char szLine[4096];
+
+	while (fgets(szLine, sizeof(szLine), pFile) != NULL) {
+		size_t cch = strlen(szLine);
+
+		while (cch > 0 && (szLine[cch - 1] == '\n' || szLine[cch - 1] == '\r' || szLine[cch - 1] == ' ' || szLine[cch - 1] == '\t')) {
+			szLine[--cch] = '\0';
+		}
+
+		char * pSpace = strrchr(szLine, ' ');
+		char * pTab = strrchr(szLine, '\t');
+
+		if (pTab > pSpace) {
+			pSpace = pTab;
+		}
+
+		if (szLine[0] == '#' || pSpace == NULL) {
+			continue;
+		}
+
+		*pSpace = '\0';
+		weights[szLine] = strtod(pSpace + 1, NULL);
+	}
+
+	return true;
+}
+
+bool LoadPaddingWeights(const char * szPath, std::unordered_map<std::string, double> & weights)
+{
+	FILE * pFile;
+
+#ifdef _WIN32
+	if (fopen_s(&pFile, szPath, "r") || !pFile) {
+		return false;
+	}
+#else
+	if ((pFile = fopen(szPath, "r")) == NULL) {
+		return false;
+	}
+#endif
+
+	bool fLoaded = LoadPaddingWeights(pFile, weights);
+
+	fclose(pFile);
+
+	return fLoaded;
+}
+
+#ifdef _WIN32
+bool LoadPaddingWeights(const wchar_t * wszPath, std::unordered_map<std::string, double> & weights)
+{
+	FILE * pFile;
+
+	if (_wfopen_s(&pFile, wszPath, L"r") || !pFile) {
+		return false;
+	}
+
+	bool fLoaded = LoadPaddingWeights(pFile, weights);
+
+	fclose(pFile);
+
+	return fLoaded;
+}
+#endif
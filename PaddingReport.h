@@ -0,0 +1,56 @@
+// PaddingReport.h : Padding, holes and cache line use of UDT layouts
+//
+// Works on the flattened layouts of LayoutCache. For every structure
+// and class it measures the holes between members, the tail padding,
+// the members straddling a 64 byte cache line (assuming the object
+// starts on one), and the size the data members would take sorted by
+// alignment, which is also the suggested order. Layouts are analyzed
+// in parallel; the holes and orders are only produced on demand for
+// the ones printed.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "LayoutCache.h"
+
+#define PADDING_CACHE_LINE          64
+
+struct PaddingResult
+{
+	uint32_t iLayout;                    // into LayoutCache::Layouts()
+	uint64_t cbHoles;
+	uint64_t cbTail;                     // 0 with virtual bases, they live in the tail
+	uint64_t cbMin;                      // with the data members reordered
+	uint32_t cStraddles;
+	double weight;                       // instance count, 1 by default
+	double score;                        // (cbHoles + cbTail) * weight
+};
+
+struct PaddingHole
+{
+	uint64_t offset;
+	uint64_t cb;
+};
+
+struct PaddingDetail
+{
+	std::vector<PaddingHole> holes;
+	std::vector<uint32_t> straddles;     // member index within the layout
+	std::vector<uint32_t> order;         // suggested data member order, member indices
+};
+
+bool LoadPaddingWeights(const char * szPath, std::unordered_map<std::string, double> & weights);
+#ifdef _WIN32
+bool LoadPaddingWeights(const wchar_t * wszPath, std::unordered_map<std::string, double> & weights);
+#endif
+bool LoadPaddingWeights(FILE * pFile, std::unordered_map<std::string, double> & weights);
+
+void AnalyzePadding(const LayoutCache & cache, const std::unordered_map<std::string, double> & weights, unsigned cThreads,
+                    std::vector<PaddingResult> & results);
+void DescribePadding(const LayoutCache & cache, const UdtLayout & layout, PaddingDetail & detail);
@@ -0,0 +1,427 @@
+// PdbDiff.cpp : Structural diff of two builds' PDBs
+//
+
+#include "PdbDiff.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+
+#include "Util.h"
+
+#define S_LDATA32                   0x110C
+#define S_GDATA32                   0x110D
+#define S_PUB32                     0x110E
+#define S_LPROC32                   0x110F
+#define S_GPROC32                   0x1110
+#define S_LTHREAD32                 0x1112
+#define S_GTHREAD32                 0x1113
+#define S_LPROC32_ID                0x1146
+#define S_GPROC32_ID                0x1147
+#define S_LPROC32_DPC               0x1155
+#define S_LPROC32_DPC_ID            0x1156
+
+struct DiffContrib
+{
+	uint32_t rva;
+	uint32_t cb;
+	uint32_t crc;
+	uint16_t iSection;
+	uint16_t iModule;
+};
+
+static std::string RecordName(const uint8_t * pRecord, size_t offName, const uint8_t * pEnd)
+{
+	if (pRecord + offName >= pEnd) {
+		return std::string();
+	}
+
+	const char * szName = (const char *)pRecord + offName;
+
+	return std::string(szName, strnlen(szName, pEnd - pRecord - offName));
+}
+
+static const char * FileName(const std::string & path)
+{
+	size_t iSlash = path.find_last_of("\\/");
+
+	return path.c_str() + ((iSlash != std::string::npos) ? iSlash + 1 : 0);
+}
+
+////////////////////////////////////////////////////////////
+// Make every name of a list unique; repeats, like statics of
+//  the same name, get " #2", " #3"... in the order they appear
+//
+static void MakeNamesUnique(std::vector<PdbDiffEntity> & entities)
+{
+	std::unordered_map<std::string, uint32_t> seen;
+
+	for (PdbDiffEntity & entity : entities) {
+		uint32_t & count = seen[entity.name];
+
+		if (count++ != 0) {
+			entity.name += " #" + std::to_string(count);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Collect the entities of a PDB
+//
+//  Publics and globals come from the symbol record stream, the
+//  functions from the module streams, which are parsed by
+//  cThreads workers and appended in module order so the result
+//  does not depend on the scheduling.
+//
+bool PdbSnapshot::Load(const PdbFile & pdb, unsigned cThreads)
+{
+	const std::vector<PdbModule> & modules = pdb.Modules();
+	std::vector<DiffContrib> contribs;
+
+	for (int kind = 0; kind < PDB_DIFF_KINDS; kind++) {
+		m_entities[kind].clear();
+	}
+
+	m_moduleSizes.clear();
+
+	for (const PdbSectionContrib & sc : pdb.SectionContribs()) {
+		DiffContrib contrib;
+
+		if (pdb.SectionToRva(sc.iSection, sc.off, &contrib.rva)) {
+			contrib.cb = sc.cb;
+			contrib.crc = sc.dwDataCrc;
+			contrib.iSection = sc.iSection;
+			contrib.iModule = sc.iModule;
+			contribs.push_back(contrib);
+		}
+	}
+
+	std::sort(contribs.begin(), contribs.end(),
+		[](const DiffContrib & a, const DiffContrib & b) { return a.rva < b.rva; });
+
+	auto crcAt = [&](uint32_t rva) {
+		auto it = std::lower_bound(contribs.begin(), contribs.end(), rva,
+			[](const DiffContrib & contrib, uint32_t value) { return contrib.rva < value; });
+
+		return (it != contribs.end() && it->rva == rva) ? it->crc : 0;
+	};
+
+	// Publics and globals
+
+	std::vector<std::pair<uint32_t, uint32_t> > publicRvas;   // rva, index of the public
+	std::vector<uint8_t> data;
+
+	if (pdb.SymRecordStream() == PDB_STREAM_NONE || !pdb.ReadStream(pdb.SymRecordStream(), data)) {
+		return false;
+	}
+
+	for (size_t off = 0; off + 4 <= data.size(); ) {
+		const uint8_t * pRecord = &data[off];
+		uint16_t cbRecord = GetU16(pRecord);
+		uint16_t kind = GetU16(pRecord + 2);
+		const uint8_t * pEnd = pRecord + 2 + cbRecord;
+
+		if (cbRecord < 2 || off + 2 + cbRecord > data.size()) {
+			break;
+		}
+
+		if (cbRecord >= 12 && (kind == S_PUB32 || kind == S_GDATA32 || kind == S_LDATA32 || kind == S_GTHREAD32 || kind == S_LTHREAD32)) {
+			PdbDiffEntity entity;
+			uint32_t rva = 0;
+			bool fRva = pdb.SectionToRva(GetU16(pRecord + 12), GetU32(pRecord + 8), &rva);
+
+			entity.name = RecordName(pRecord, 14, pEnd);
+			entity.cb = 0;
+			entity.crc = fRva ? crcAt(rva) : 0;
+
+			if (kind == S_PUB32) {
+				if (fRva) {
+					publicRvas.push_back(std::make_pair(rva, (uint32_t)m_entities[PDB_DIFF_PUBLICS].size()));
+				}
+
+				m_entities[PDB_DIFF_PUBLICS].push_back(entity);
+			}
+
+			else {
+				m_entities[PDB_DIFF_GLOBALS].push_back(entity);
+			}
+		}
+
+		off += 2 + cbRecord;
+	}
+
+	// Functions, one module at a time per worker
+
+	std::vector<std::vector<PdbDiffEntity> > moduleFunctions(modules.size());
+	std::atomic<size_t> iNextModule(0);
+
+	auto worker = [&](unsigned) {
+		std::vector<uint8_t> stream;
+
+		for (size_t iModule; (iModule = iNextModule++) < modules.size(); ) {
+			const PdbModule & module = modules[iModule];
+
+			if (module.iStream == PDB_STREAM_NONE || !pdb.ReadStream(module.iStream, stream)) {
+				continue;
+			}
+
+			size_t cbSymbols = std::min<size_t>(module.cbSymbols, stream.size());
+
+			for (size_t off = 4; off + 4 <= cbSymbols; ) {
+				const uint8_t * pRecord = &stream[off];
+				uint16_t cbRecord = GetU16(pRecord);
+				uint16_t kind = GetU16(pRecord + 2);
+				const uint8_t * pEnd = pRecord + 2 + cbRecord;
+
+				if (cbRecord < 2 || off + 2 + cbRecord > cbSymbols) {
+					break;
+				}
+
+				bool fGlobal = kind == S_GPROC32 || kind == S_GPROC32_ID;
+				bool fLocal = kind == S_LPROC32 || kind == S_LPROC32_ID || kind == S_LPROC32_DPC || kind == S_LPROC32_DPC_ID;
+				uint32_t rva;
+
+				if ((fGlobal || fLocal) && cbRecord >= 38 && pdb.SectionToRva(GetU16(pRecord + 36), GetU32(pRecord + 32), &rva)) {
+					PdbDiffEntity entity;
+
+					entity.name = RecordName(pRecord, 39, pEnd);
+					entity.cb = GetU32(pRecord + 16);
+					entity.crc = crcAt(rva);
+
+					// Statics are only unique within their compiland
+
+					if (fLocal) {
+						entity.name += " (";
+						entity.name += FileName(module.name);
+						entity.name += ")";
+					}
+
+					moduleFunctions[iModule].push_back(entity);
+				}
+
+				off += 2 + cbRecord;
+			}
+		}
+	};
+
+	RunParallel(cThreads, worker);
+
+	for (std::vector<PdbDiffEntity> & functions : moduleFunctions) {
+		m_entities[PDB_DIFF_FUNCTIONS].insert(m_entities[PDB_DIFF_FUNCTIONS].end(), functions.begin(), functions.end());
+	}
+
+	// Contributions are named by the public at their start, or by
+	//  their compiland, section and position in it
+
+	std::sort(publicRvas.begin(), publicRvas.end());
+
+	std::unordered_map<uint32_t, uint32_t> ordinals;          // module << 16 | section -> next ordinal
+	std::unordered_map<std::string, uint64_t> moduleSizes;
+	const std::vector<std::string> & sectionNames = pdb.SectionNames();
+	char szSuffix[64];
+
+	for (const DiffContrib & contrib : contribs) {
+		auto itPublic = std::lower_bound(publicRvas.begin(), publicRvas.end(), std::make_pair(contrib.rva, 0u));
+		const std::string & moduleName = (contrib.iModule < modules.size()) ? modules[contrib.iModule].name : std::string();
+		uint32_t ordinal = ordinals[((uint32_t)contrib.iModule << 16) | contrib.iSection]++;
+		PdbDiffEntity entity;
+
+		if (itPublic != publicRvas.end() && itPublic->first == contrib.rva) {
+			entity.name = m_entities[PDB_DIFF_PUBLICS][itPublic->second].name;
+		}
+
+		else {
+			snprintf(szSuffix, sizeof(szSuffix), " #%u", ordinal);
+			entity.name = FileName(moduleName);
+			entity.name += ' ';
+			entity.name += (contrib.iSection != 0 && contrib.iSection <= sectionNames.size()) ?
+				sectionNames[contrib.iSection - 1] : std::to_string(contrib.iSection);
+			entity.name += szSuffix;
+		}
+
+		entity.cb = contrib.cb;
+		entity.crc = contrib.crc;
+		m_entities[PDB_DIFF_CONTRIBS].push_back(entity);
+
+		moduleSizes[moduleName] += contrib.cb;
+	}
+
+	for (int kind = 0; kind < PDB_DIFF_KINDS; kind++) {
+		MakeNamesUnique(m_entities[kind]);
+	}
+
+	m_moduleSizes.assign(moduleSizes.begin(), moduleSizes.end());
+
+	return true;
+}
+
+struct DiffKey
+{
+	const std::string * pName;
+	size_t hash;
+
+	bool operator==(const DiffKey & other) const { return hash == other.hash && *pName == *other.pName; }
+};
+
+struct DiffKeyHash
+{
+	size_t operator()(const DiffKey & key) const { return key.hash; }
+};
+
+static bool CompareChanges(const PdbDiffChange & a, const PdbDiffChange & b)
+{
+	int64_t deltaA = (a.cbDelta < 0) ? -a.cbDelta : a.cbDelta;
+	int64_t deltaB = (b.cbDelta < 0) ? -b.cbDelta : b.cbDelta;
+	const std::string & nameA = (a.pNew != NULL) ? a.pNew->name : a.pOld->name;
+	const std::string & nameB = (b.pNew != NULL) ? b.pNew->name : b.pOld->name;
+
+	return deltaA > deltaB || (deltaA == deltaB && nameA < nameB);
+}
+
+////////////////////////////////////////////////////////////
+// Join one kind of entities by name
+//
+//  The names are hashed by all the threads, then thread t joins
+//  the names whose hash is t modulo the thread count, so no two
+//  threads touch the same name.
+//
+static void DiffEntities(const std::vector<PdbDiffEntity> & oldList, const std::vector<PdbDiffEntity> & newList,
+                         unsigned cThreads, std::vector<PdbDiffChange> & changes)
+{
+	std::vector<size_t> oldHashes(oldList.size());
+	std::vector<size_t> newHashes(newList.size());
+	std::vector<std::vector<PdbDiffChange> > threadChanges(cThreads);
+
+	auto hasher = [&](unsigned iThread) {
+		std::hash<std::string> hash;
+
+		for (size_t i = iThread; i < oldList.size(); i += cThreads) {
+			oldHashes[i] = hash(oldList[i].name);
+		}
+
+		for (size_t i = iThread; i < newList.size(); i += cThreads) {
+			newHashes[i] = hash(newList[i].name);
+		}
+	};
+
+	auto joiner = [&](unsigned iThread) {
+		std::unordered_map<DiffKey, const PdbDiffEntity *, DiffKeyHash> oldByName;
+		std::vector<PdbDiffChange> & out = threadChanges[iThread];
+
+		for (size_t i = 0; i < oldList.size(); i++) {
+			if (oldHashes[i] % cThreads == iThread) {
+				DiffKey key = {&oldList[i].name, oldHashes[i]};
+
+				oldByName.insert(std::make_pair(key, &oldList[i]));
+			}
+		}
+
+		for (size_t i = 0; i < newList.size(); i++) {
+			if (newHashes[i] % cThreads != iThread) {
+				continue;
+			}
+
+			DiffKey key = {&newList[i].name, newHashes[i]};
+			auto it = oldByName.find(key);
+			PdbDiffChange change = {PDB_DIFF_ADDED, NULL, &newList[i], (int64_t)newList[i].cb};
+
+			if (it != oldByName.end()) {
+				const PdbDiffEntity * pOld = it->second;
+
+				oldByName.erase(it);
+
+				change.pOld = pOld;
+				change.cbDelta = (int64_t)newList[i].cb - (int64_t)pOld->cb;
+
+				if (change.cbDelta != 0) {
+					change.change = PDB_DIFF_RESIZED;
+				}
+
+				else if (pOld->crc != 0 && newList[i].crc != 0 && pOld->crc != newList[i].crc) {
+					change.change = PDB_DIFF_CHANGED;
+				}
+
+				else {
+					continue;
+				}
+			}
+
+			out.push_back(change);
+		}
+
+		for (const auto & entry : oldByName) {
+			PdbDiffChange change = {PDB_DIFF_REMOVED, entry.second, NULL, -(int64_t)entry.second->cb};
+
+			out.push_back(change);
+		}
+	};
+
+	RunParallel(cThreads, hasher);
+
+	RunParallel(cThreads, joiner);
+
+	changes.clear();
+
+	for (const std::vector<PdbDiffChange> & out : threadChanges) {
+		changes.insert(changes.end(), out.begin(), out.end());
+	}
+
+	std::sort(changes.begin(), changes.end(), CompareChanges);
+}
+
+void DiffPdbSnapshots(const PdbSnapshot & oldPdb, const PdbSnapshot & newPdb, unsigned cThreads, PdbDiffResult & result)
+{
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	for (int kind = 0; kind < PDB_DIFF_KINDS; kind++) {
+		DiffEntities(oldPdb.Entities(kind), newPdb.Entities(kind), cThreads, result.changes[kind]);
+
+		memset(result.rgCount[kind], 0, sizeof(result.rgCount[kind]));
+
+		for (const PdbDiffChange & change : result.changes[kind]) {
+			result.rgCount[kind][change.change]++;
+		}
+	}
+
+	// Compiland sizes, there are few enough to join on one thread
+
+	std::unordered_map<std::string, uint64_t> oldSizes(oldPdb.ModuleSizes().begin(), oldPdb.ModuleSizes().end());
+
+	result.modules.clear();
+
+	for (const auto & module : newPdb.ModuleSizes()) {
+		auto it = oldSizes.find(module.first);
+		PdbDiffModule delta = {module.first, 0, module.second};
+
+		if (it != oldSizes.end()) {
+			delta.cbOld = it->second;
+			oldSizes.erase(it);
+		}
+
+		if (delta.cbOld != delta.cbNew) {
+			result.modules.push_back(delta);
+		}
+	}
+
+	for (const auto & module : oldSizes) {
+		PdbDiffModule delta = {module.first, module.second, 0};
+
+		result.modules.push_back(delta);
+	}
+
+	std::sort(result.modules.begin(), result.modules.end(),
+		[](const PdbDiffModule & a, const PdbDiffModule & b) {
+			int64_t deltaA = (int64_t)a.cbNew - (int64_t)a.cbOld;
+			int64_t deltaB = (int64_t)b.cbNew - (int64_t)b.cbOld;
+
+			deltaA = (deltaA < 0) ? -deltaA : deltaA;
+			deltaB = (deltaB < 0) ? -deltaB : deltaB;
+
+			return deltaA > deltaB || (deltaA == deltaB && a.name < b.name);
+		});
+}
@@ -0,0 +1,80 @@
+// PdbDiff.h : Structural diff of two builds' PDBs
+//
+// Both PDBs are read natively, with the module streams spread over
+// worker threads, into flat lists of functions, publics, globals and
+// section contributions. The lists are then hash joined by name, one
+// hash partition per thread, and every entity is reported added,
+// removed, resized or changed (same size, different contribution
+// CRC). Sizes are also totalled per compiland.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "PdbFile.h"
+
+#define PDB_DIFF_FUNCTIONS          0
+#define PDB_DIFF_PUBLICS            1
+#define PDB_DIFF_GLOBALS            2
+#define PDB_DIFF_CONTRIBS           3
+#define PDB_DIFF_KINDS              4
+
+#define PDB_DIFF_ADDED              0
+#define PDB_DIFF_REMOVED            1
+#define PDB_DIFF_RESIZED            2
+#define PDB_DIFF_CHANGED            3
+#define PDB_DIFF_CHANGES            4
+
+struct PdbDiffEntity
+{
+	std::string name;                    // unique within its kind
+	uint32_t cb;                         // 0 when unknown, for publics and globals
+	uint32_t crc;                        // of the contribution starting at the entity, 0 if none
+};
+
+////////////////////////////////////////////////////////////
+// The entities of one PDB
+//
+class PdbSnapshot
+{
+	public:
+	bool Load(const PdbFile & pdb, unsigned cThreads);
+
+	const std::vector<PdbDiffEntity> & Entities(int kind) const { return m_entities[kind]; }
+	const std::vector<std::pair<std::string, uint64_t> > & ModuleSizes() const { return m_moduleSizes; }
+
+	private:
+	std::vector<PdbDiffEntity> m_entities[PDB_DIFF_KINDS];
+	std::vector<std::pair<std::string, uint64_t> > m_moduleSizes;
+};
+
+struct PdbDiffChange
+{
+	int change;
+	const PdbDiffEntity * pOld;          // NULL when added
+	const PdbDiffEntity * pNew;          // NULL when removed
+	int64_t cbDelta;
+};
+
+struct PdbDiffModule
+{
+	std::string name;
+	uint64_t cbOld;
+	uint64_t cbNew;
+};
+
+////////////////////////////////////////////////////////////
+// Changes per kind and the compilands whose size changed, each
+//  sorted by the size delta, largest first
+//
+struct PdbDiffResult
+{
+	std::vector<PdbDiffChange> changes[PDB_DIFF_KINDS];
+	uint32_t rgCount[PDB_DIFF_KINDS][PDB_DIFF_CHANGES];
+	std::vector<PdbDiffModule> modules;
+};
+
+void DiffPdbSnapshots(const PdbSnapshot & oldPdb, const PdbSnapshot & newPdb, unsigned cThreads, PdbDiffResult & result);
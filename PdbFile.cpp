@@ -0,0 +1,462 @@
+// PdbFile.cpp : Native reader for MSF 7.00 program databases
+//
+
+#include "PdbFile.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "Util.h"
+
+static const char szMsfMagic[] = "Microsoft C/C++ MSF 7.00\r\n\x1A" "DS\0\0";
+
+#define CB_MSF_MAGIC                32
+#define CB_DBI_HEADER               64
+#define CB_MODULE_INFO              64
+#define CB_SECTION_HEADER           40
+#define DBG_STREAM_SECTION_HEADER   5
+#define NAMES_SIGNATURE             0xEFFEEFFE
+#define SC_VERSION_V60              0xF12EBA2D
+#define SC_VERSION_V2               0xF13151E4
+#define CB_SECTION_CONTRIB          28
+#define CB_SECTION_CONTRIB_V2       32
+
+PdbFile::PdbFile() :
+	m_pFile(NULL)
+{
+	Clear();
+}
+
+PdbFile::~PdbFile()
+{
+	Clear();
+}
+
+void PdbFile::Clear()
+{
+	if (m_pFile != NULL) {
+		fclose(m_pFile);
+		m_pFile = NULL;
+	}
+
+	m_cbBlock = 0;
+	m_streamSizes.clear();
+	m_streamFirstBlock.clear();
+	m_blocks.clear();
+	m_namedStreams.clear();
+	m_names.clear();
+	m_sectionRvas.clear();
+	m_sectionNames.clear();
+	m_debugStreams.clear();
+	m_modules.clear();
+	m_contribs.clear();
+	memset(m_rgGuid, 0, sizeof(m_rgGuid));
+	m_dwAge = 0;
+	m_wMachine = 0;
+	m_iGlobalsStream = PDB_STREAM_NONE;
+	m_iPublicsStream = PDB_STREAM_NONE;
+	m_iSymRecordStream = PDB_STREAM_NONE;
+}
+
+bool PdbFile::Load(const char * szPath)
+{
+	FILE * pFile;
+
+	Clear();
+
+#ifdef _WIN32
+	if (fopen_s(&pFile, szPath, "rb") || !pFile) {
+		return false;
+	}
+#else
+	if ((pFile = fopen(szPath, "rb")) == NULL) {
+		return false;
+	}
+#endif
+
+	return Open(pFile);
+}
+
+#ifdef _WIN32
+bool PdbFile::Load(const wchar_t * wszPath)
+{
+	FILE * pFile;
+
+	Clear();
+
+	if (_wfopen_s(&pFile, wszPath, L"rb") || !pFile) {
+		return false;
+	}
+
+	return Open(pFile);
+}
+#endif
+
+bool PdbFile::ReadAt(uint64_t off, void * pv, uint32_t cb) const
+{
+#ifdef _WIN32
+	if (_fseeki64(m_pFile, (__int64)off, SEEK_SET) != 0) {
+		return false;
+	}
+#else
+	if (fseeko(m_pFile, (off_t)off, SEEK_SET) != 0) {
+		return false;
+	}
+#endif
+
+	return fread(pv, 1, cb, m_pFile) == cb;
+}
+
+////////////////////////////////////////////////////////////
+// Read the superblock and the stream directory, then decode
+//  the streams everything else depends on
+//
+bool PdbFile::Open(FILE * pFile)
+{
+	uint8_t rgSuper[CB_MSF_MAGIC + 24];
+
+	m_pFile = pFile;
+
+	if (!ReadAt(0, rgSuper, sizeof(rgSuper)) || memcmp(rgSuper, szMsfMagic, CB_MSF_MAGIC) != 0) {
+		Clear();
+
+		return false;
+	}
+
+	m_cbBlock = GetU32(rgSuper + 32);
+
+	uint32_t cBlocks = GetU32(rgSuper + 40);
+	uint32_t cbDirectory = GetU32(rgSuper + 44);
+	uint32_t iBlockMap = GetU32(rgSuper + 52);
+
+	if (m_cbBlock < 512 || (m_cbBlock & (m_cbBlock - 1)) != 0 || iBlockMap >= cBlocks || cbDirectory < 4) {
+		Clear();
+
+		return false;
+	}
+
+	// The block map lists the blocks of the directory
+
+	uint32_t cDirBlocks = (cbDirectory + m_cbBlock - 1) / m_cbBlock;
+
+	if ((uint64_t)cDirBlocks * 4 > m_cbBlock) {
+		Clear();
+
+		return false;
+	}
+
+	std::vector<uint8_t> blockMap(cDirBlocks * 4);
+	std::vector<uint8_t> directory(cDirBlocks * m_cbBlock);
+
+	if (!ReadAt((uint64_t)iBlockMap * m_cbBlock, blockMap.data(), (uint32_t)blockMap.size())) {
+		Clear();
+
+		return false;
+	}
+
+	for (uint32_t i = 0; i < cDirBlocks; i++) {
+		uint32_t iBlock = GetU32(&blockMap[i * 4]);
+
+		if (iBlock >= cBlocks || !ReadAt((uint64_t)iBlock * m_cbBlock, &directory[i * m_cbBlock], m_cbBlock)) {
+			Clear();
+
+			return false;
+		}
+	}
+
+	// Directory: stream count, stream sizes, then the blocks of
+	//  every stream
+
+	const uint8_t * pb = directory.data();
+	uint32_t cStreams = GetU32(pb);
+	uint64_t offBlocks = 4 + (uint64_t)cStreams * 4;
+
+	if (offBlocks > cbDirectory) {
+		Clear();
+
+		return false;
+	}
+
+	m_streamSizes.resize(cStreams);
+	m_streamFirstBlock.resize(cStreams + 1);
+
+	for (uint32_t i = 0; i < cStreams; i++) {
+		uint32_t cb = GetU32(pb + 4 + i * 4);
+
+		m_streamSizes[i] = (cb == 0xFFFFFFFF) ? 0 : cb;
+		m_streamFirstBlock[i] = (uint32_t)m_blocks.size();
+
+		uint32_t cStreamBlocks = (m_streamSizes[i] + m_cbBlock - 1) / m_cbBlock;
+
+		if (offBlocks + (uint64_t)cStreamBlocks * 4 > cbDirectory) {
+			Clear();
+
+			return false;
+		}
+
+		for (uint32_t iBlock = 0; iBlock < cStreamBlocks; iBlock++) {
+			m_blocks.push_back(GetU32(pb + offBlocks));
+			offBlocks += 4;
+		}
+	}
+
+	m_streamFirstBlock[cStreams] = (uint32_t)m_blocks.size();
+
+	if (!ParseInfo() || !ParseDbi()) {
+		Clear();
+
+		return false;
+	}
+
+	return true;
+}
+
+uint32_t PdbFile::StreamSize(uint32_t iStream) const
+{
+	return (iStream < m_streamSizes.size()) ? m_streamSizes[iStream] : 0;
+}
+
+////////////////////////////////////////////////////////////
+// Read a whole stream, runs of adjacent blocks are read at once
+//
+bool PdbFile::ReadStream(uint32_t iStream, std::vector<uint8_t> & data) const
+{
+	data.clear();
+
+	if (iStream >= m_streamSizes.size()) {
+		return false;
+	}
+
+	uint32_t cb = m_streamSizes[iStream];
+	const uint32_t * pBlocks = m_blocks.data() + m_streamFirstBlock[iStream];
+	uint32_t cBlocks = m_streamFirstBlock[iStream + 1] - m_streamFirstBlock[iStream];
+
+	data.resize(cb);
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	for (uint32_t i = 0; i < cBlocks; ) {
+		uint32_t cRun = 1;
+
+		while (i + cRun < cBlocks && pBlocks[i + cRun] == pBlocks[i] + cRun) {
+			cRun++;
+		}
+
+		uint64_t offData = (uint64_t)i * m_cbBlock;
+		uint32_t cbRun = (uint32_t)std::min<uint64_t>((uint64_t)cRun * m_cbBlock, cb - offData);
+
+		if (!ReadAt((uint64_t)pBlocks[i] * m_cbBlock, &data[(size_t)offData], cbRun)) {
+			data.clear();
+
+			return false;
+		}
+
+		i += cRun;
+	}
+
+	return true;
+}
+
+uint32_t PdbFile::FindNamedStream(const char * szName) const
+{
+	auto it = m_namedStreams.find(szName);
+
+	return (it != m_namedStreams.end()) ? it->second : PDB_STREAM_NONE;
+}
+
+////////////////////////////////////////////////////////////
+// PDB info stream: signature, age, GUID and the map of named
+//  streams, followed by the /names string table
+//
+bool PdbFile::ParseInfo()
+{
+	std::vector<uint8_t> data;
+
+	if (!ReadStream(PDB_STREAM_PDB, data) || data.size() < 32) {
+		return false;
+	}
+
+	const uint8_t * pb = data.data();
+	const uint8_t * pbEnd = pb + data.size();
+
+	m_dwAge = GetU32(pb + 8);
+	memcpy(m_rgGuid, pb + 12, 16);
+
+	uint32_t cbStrings = GetU32(pb + 28);
+	const uint8_t * pStrings = pb + 32;
+
+	pb = pStrings + cbStrings;
+
+	if (cbStrings > data.size() - 32 || pbEnd - pb < 12) {
+		return false;
+	}
+
+	// Hash table: size, capacity, present and deleted bit vectors,
+	//  then a key/value pair for every present bucket
+
+	uint32_t cEntries = GetU32(pb);
+	uint32_t cPresentWords = GetU32(pb + 8);
+
+	pb += 12;
+
+	if ((uint64_t)(pbEnd - pb) < (uint64_t)cPresentWords * 4 + 4) {
+		return false;
+	}
+
+	pb += cPresentWords * 4;
+
+	uint32_t cDeletedWords = GetU32(pb);
+
+	pb += 4;
+
+	if ((uint64_t)(pbEnd - pb) < (uint64_t)cDeletedWords * 4 + (uint64_t)cEntries * 8) {
+		return false;
+	}
+
+	pb += cDeletedWords * 4;
+
+	for (uint32_t i = 0; i < cEntries; i++, pb += 8) {
+		uint32_t offName = GetU32(pb);
+
+		if (offName < cbStrings) {
+			std::string name((const char *)pStrings + offName, strnlen((const char *)pStrings + offName, cbStrings - offName));
+
+			m_namedStreams[name] = GetU32(pb + 4);
+		}
+	}
+
+	// /names: signature, hash version, size, then the strings
+
+	uint32_t iNames = FindNamedStream("/names");
+
+	if (iNames != PDB_STREAM_NONE && ReadStream(iNames, data) && data.size() >= 12 && GetU32(data.data()) == NAMES_SIGNATURE) {
+		uint32_t cbNames = GetU32(data.data() + 8);
+
+		if (cbNames <= data.size() - 12) {
+			m_names.assign(data.begin() + 12, data.begin() + 12 + cbNames);
+			m_names.push_back('\0');
+		}
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// DBI stream: the header, the module list and the section
+//  headers from the optional debug streams
+//
+bool PdbFile::ParseDbi()
+{
+	std::vector<uint8_t> data;
+
+	if (!ReadStream(PDB_STREAM_DBI, data) || data.size() < CB_DBI_HEADER) {
+		return false;
+	}
+
+	const uint8_t * pb = data.data();
+
+	m_iGlobalsStream = GetU16(pb + 12);
+	m_iPublicsStream = GetU16(pb + 16);
+	m_iSymRecordStream = GetU16(pb + 20);
+	m_wMachine = GetU16(pb + 58);
+
+	// Substreams are in the order: modules, section contributions,
+	//  section map, source files, type server map, EC, debug header
+
+	uint64_t cbModules = GetU32(pb + 24);
+	uint64_t offDbgHeader = CB_DBI_HEADER + cbModules + GetU32(pb + 28) + GetU32(pb + 32) +
+		GetU32(pb + 36) + GetU32(pb + 40) + GetU32(pb + 52);
+	uint64_t cbDbgHeader = GetU32(pb + 48);
+
+	if (CB_DBI_HEADER + cbModules > data.size() || offDbgHeader + cbDbgHeader > data.size()) {
+		return false;
+	}
+
+	for (uint64_t off = CB_DBI_HEADER; off + CB_MODULE_INFO < CB_DBI_HEADER + cbModules; ) {
+		const uint8_t * pModule = pb + off;
+		const char * szName = (const char *)pModule + CB_MODULE_INFO;
+		size_t cchMax = (size_t)(CB_DBI_HEADER + cbModules - off - CB_MODULE_INFO);
+		size_t cchName = strnlen(szName, cchMax);
+
+		if (cchName == cchMax) {
+			return false;
+		}
+
+		const char * szObjName = szName + cchName + 1;
+		size_t cchObjName = strnlen(szObjName, cchMax - cchName - 1);
+
+		if (cchObjName == cchMax - cchName - 1) {
+			return false;
+		}
+
+		PdbModule module;
+
+		module.iStream = GetU16(pModule + 34);
+		module.cbSymbols = GetU32(pModule + 36);
+		module.cbC11Lines = GetU32(pModule + 40);
+		module.cbC13Lines = GetU32(pModule + 44);
+		module.name.assign(szName, cchName);
+		module.objName.assign(szObjName, cchObjName);
+		m_modules.push_back(module);
+
+		off += (CB_MODULE_INFO + cchName + 1 + cchObjName + 1 + 3) & ~3ull;
+	}
+
+	// Section contributions: a version, then fixed size entries
+
+	uint64_t offContribs = CB_DBI_HEADER + cbModules;
+	uint64_t cbContribs = GetU32(pb + 28);
+
+	if (cbContribs >= 4 && offContribs + cbContribs <= data.size()) {
+		uint32_t dwVersion = GetU32(pb + offContribs);
+		uint32_t cbEntry = (dwVersion == SC_VERSION_V2) ? CB_SECTION_CONTRIB_V2 : CB_SECTION_CONTRIB;
+
+		if (dwVersion == SC_VERSION_V60 || dwVersion == SC_VERSION_V2) {
+			for (uint64_t off = 4; off + cbEntry <= cbContribs; off += cbEntry) {
+				const uint8_t * pEntry = pb + offContribs + off;
+				PdbSectionContrib contrib;
+
+				contrib.iSection = GetU16(pEntry);
+				contrib.off = GetU32(pEntry + 4);
+				contrib.cb = GetU32(pEntry + 8);
+				contrib.dwCharacteristics = GetU32(pEntry + 12);
+				contrib.iModule = GetU16(pEntry + 16);
+				contrib.dwDataCrc = GetU32(pEntry + 20);
+				m_contribs.push_back(contrib);
+			}
+		}
+	}
+
+	for (uint64_t off = 0; off + 2 <= cbDbgHeader; off += 2) {
+		m_debugStreams.push_back(GetU16(pb + offDbgHeader + off));
+	}
+
+	// Section headers give the name and RVA of every section
+
+	uint16_t iSections = DebugStream(DBG_STREAM_SECTION_HEADER);
+
+	if (iSections != PDB_STREAM_NONE && ReadStream(iSections, data)) {
+		for (size_t off = 0; off + CB_SECTION_HEADER <= data.size(); off += CB_SECTION_HEADER) {
+			m_sectionRvas.push_back(GetU32(&data[off + 12]));
+			m_sectionNames.push_back(std::string((const char *)&data[off], strnlen((const char *)&data[off], 8)));
+		}
+	}
+
+	return true;
+}
+
+bool PdbFile::SectionToRva(uint16_t iSection, uint32_t off, uint32_t * pRva) const
+{
+	if (iSection == 0 || iSection > m_sectionRvas.size()) {
+		return false;
+	}
+
+	*pRva = m_sectionRvas[iSection - 1] + off;
+
+	return true;
+}
+
+const char * PdbFile::Name(uint32_t offName) const
+{
+	return (offName < m_names.size()) ? &m_names[offName] : "";
+}
@@ -0,0 +1,108 @@
+// PdbFile.h : Native reader for MSF 7.00 program databases
+//
+// Gives access to the raw streams of a PDB and decodes the PDB info
+// stream, the DBI module list, the section headers and the /names
+// string table. Records inside the streams are left to the callers.
+// Nothing in here depends on DIA or Windows.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define PDB_STREAM_PDB              1
+#define PDB_STREAM_TPI              2
+#define PDB_STREAM_DBI              3
+#define PDB_STREAM_IPI              4
+#define PDB_STREAM_NONE             0xFFFF
+
+#define PDB_DBG_STREAM_NEW_FPO      9    // FRAMEDATA records, x86 only
+
+// One entry of the DBI module info substream
+struct PdbModule
+{
+	std::string name;
+	std::string objName;
+	uint16_t iStream;                    // PDB_STREAM_NONE when there is no symbol data
+	uint32_t cbSymbols;                  // includes the 4 byte signature
+	uint32_t cbC11Lines;
+	uint32_t cbC13Lines;
+};
+
+// One entry of the DBI section contribution substream
+struct PdbSectionContrib
+{
+	uint16_t iSection;                   // 1 based
+	uint32_t off;
+	uint32_t cb;
+	uint32_t dwCharacteristics;
+	uint16_t iModule;
+	uint32_t dwDataCrc;
+};
+
+////////////////////////////////////////////////////////////
+// An open PDB file, streams are read on demand
+//
+class PdbFile
+{
+	public:
+	PdbFile();
+	~PdbFile();
+
+	bool Load(const char * szPath);
+#ifdef _WIN32
+	bool Load(const wchar_t * wszPath);
+#endif
+	void Clear();
+
+	bool IsLoaded() const { return m_pFile != NULL; }
+	uint32_t CountStreams() const { return (uint32_t)m_streamSizes.size(); }
+	uint32_t StreamSize(uint32_t iStream) const;
+	bool ReadStream(uint32_t iStream, std::vector<uint8_t> & data) const;
+	uint32_t FindNamedStream(const char * szName) const;
+
+	uint32_t Age() const { return m_dwAge; }
+	const uint8_t * Guid() const { return m_rgGuid; }
+	uint16_t Machine() const { return m_wMachine; }
+	uint16_t GlobalsStream() const { return m_iGlobalsStream; }
+	uint16_t PublicsStream() const { return m_iPublicsStream; }
+	uint16_t SymRecordStream() const { return m_iSymRecordStream; }
+
+	const std::vector<PdbModule> & Modules() const { return m_modules; }
+	const std::vector<PdbSectionContrib> & SectionContribs() const { return m_contribs; }
+	const std::vector<std::string> & SectionNames() const { return m_sectionNames; }
+	uint16_t DebugStream(uint32_t iDbg) const { return (iDbg < m_debugStreams.size()) ? m_debugStreams[iDbg] : PDB_STREAM_NONE; }
+	bool SectionToRva(uint16_t iSection, uint32_t off, uint32_t * pRva) const;
+	const char * Name(uint32_t offName) const;
+
+	private:
+	bool Open(FILE * pFile);
+	bool ReadAt(uint64_t off, void * pv, uint32_t cb) const;
+	bool ParseInfo();
+	bool ParseDbi();
+
+	FILE * m_pFile;
+	mutable std::mutex m_lock;
+	uint32_t m_cbBlock;
+	std::vector<uint32_t> m_streamSizes;
+	std::vector<uint32_t> m_streamFirstBlock;      // index into m_blocks
+	std::vector<uint32_t> m_blocks;
+	std::unordered_map<std::string, uint32_t> m_namedStreams;
+	std::vector<char> m_names;
+	std::vector<uint32_t> m_sectionRvas;
+	std::vector<std::string> m_sectionNames;
+	std::vector<uint16_t> m_debugStreams;          // DBI optional debug header
+	std::vector<PdbModule> m_modules;
+	std::vector<PdbSectionContrib> m_contribs;
+	uint8_t m_rgGuid[16];
+	uint32_t m_dwAge;
+	uint16_t m_wMachine;
+	uint16_t m_iGlobalsStream;
+	uint16_t m_iPublicsStream;
+	uint16_t m_iSymRecordStream;
+};
@@ -0,0 +1,273 @@
+// PeImage.cpp : Minimal reader for PE32 and PE32+ image files
+//
+
+#include "PeImage.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Util.h"
+
+static bool ReadOpenFile(FILE * pFile, std::vector<uint8_t> & file)
+{
+	bool fRead = false;
+
+	if (fseek(pFile, 0, SEEK_END) == 0) {
+		long cb = ftell(pFile);
+
+		if (cb > 0 && fseek(pFile, 0, SEEK_SET) == 0) {
+			file.resize((size_t)cb);
+			fRead = fread(file.data(), 1, file.size(), pFile) == file.size();
+		}
+	}
+
+	fclose(pFile);
+
+	return fRead;
+}
+
+////////////////////////////////////////////////////////////
+// Read a whole file into memory
+//
+bool ReadWholeFile(const char * szPath, std::vector<uint8_t> & file)
+{
+	FILE * pFile;
+
+#ifdef _WIN32
+	if (fopen_s(&pFile, szPath, "rb") || !pFile) {
+		return false;
+	}
+#else
+	if ((pFile = fopen(szPath, "rb")) == NULL) {
+		return false;
+	}
+#endif
+
+	return ReadOpenFile(pFile, file);
+}
+
+#ifdef _WIN32
+bool ReadWholeFile(const wchar_t * wszPath, std::vector<uint8_t> & file)
+{
+	FILE * pFile;
+
+	if (_wfopen_s(&pFile, wszPath, L"rb") || !pFile) {
+		return false;
+	}
+
+	return ReadOpenFile(pFile, file);
+}
+#endif
+
+PeImage::PeImage()
+{
+	Clear();
+}
+
+void PeImage::Clear()
+{
+	m_file.clear();
+	m_sections.clear();
+	memset(m_rgDirRva, 0, sizeof(m_rgDirRva));
+	memset(m_rgDirSize, 0, sizeof(m_rgDirSize));
+	m_qwImageBase = 0;
+	m_cbImage = 0;
+	m_cbHeaders = 0;
+	m_dwTimeDateStamp = 0;
+	m_wMachine = 0;
+	m_fPlus = false;
+}
+
+bool PeImage::Load(const char * szPath)
+{
+	std::vector<uint8_t> file;
+
+	return ReadWholeFile(szPath, file) && Load(file);
+}
+
+#ifdef _WIN32
+bool PeImage::Load(const wchar_t * wszPath)
+{
+	std::vector<uint8_t> file;
+
+	return ReadWholeFile(wszPath, file) && Load(file);
+}
+#endif
+
+////////////////////////////////////////////////////////////
+// Take over the contents of file and parse them
+//
+bool PeImage::Load(std::vector<uint8_t> & file)
+{
+	Clear();
+
+	m_file.swap(file);
+
+	if (!Parse()) {
+		Clear();
+
+		return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Decode the headers and the section table
+//
+bool PeImage::Parse()
+{
+	const uint8_t * pb = m_file.data();
+	size_t cb = m_file.size();
+
+	if (cb < 0x40 || pb[0] != 'M' || pb[1] != 'Z') {
+		return false;
+	}
+
+	uint32_t offNt = GetU32(pb + 0x3C);
+
+	if (offNt > cb || cb - offNt < 24 || memcmp(pb + offNt, "PE\0\0", 4) != 0) {
+		return false;
+	}
+
+	const uint8_t * pFileHeader = pb + offNt + 4;
+	uint16_t cSections = GetU16(pFileHeader + 2);
+	uint16_t cbOptional = GetU16(pFileHeader + 16);
+	size_t offOptional = offNt + 24;
+	size_t offSections = offOptional + cbOptional;
+
+	m_wMachine = GetU16(pFileHeader);
+	m_dwTimeDateStamp = GetU32(pFileHeader + 4);
+
+	if (offSections > cb || (cb - offSections) / 40 < cSections || cbOptional < 2) {
+		return false;
+	}
+
+	const uint8_t * pOptional = pb + offOptional;
+	uint32_t offDirs;
+
+	switch (GetU16(pOptional)) {
+		case 0x10B:
+			if (cbOptional < 96) {
+				return false;
+			}
+
+			m_fPlus = false;
+			m_qwImageBase = GetU32(pOptional + 28);
+			offDirs = 96;
+			break;
+
+		case 0x20B:
+			if (cbOptional < 112) {
+				return false;
+			}
+
+			m_fPlus = true;
+			m_qwImageBase = GetU64(pOptional + 24);
+			offDirs = 112;
+			break;
+
+		default:
+			return false;
+	}
+
+	m_cbImage = GetU32(pOptional + 56);
+	m_cbHeaders = GetU32(pOptional + 60);
+
+	uint32_t cDirs = GetU32(pOptional + offDirs - 4);
+
+	for (uint32_t i = 0; i < cDirs && i < PE_DIRECTORY_MAX && offDirs + i * 8 + 8 <= cbOptional; i++) {
+		m_rgDirRva[i] = GetU32(pOptional + offDirs + i * 8);
+		m_rgDirSize[i] = GetU32(pOptional + offDirs + i * 8 + 4);
+	}
+
+	m_sections.resize(cSections);
+
+	for (uint16_t i = 0; i < cSections; i++) {
+		const uint8_t * pSection = pb + offSections + i * 40;
+		PeSection & section = m_sections[i];
+
+		memcpy(section.szName, pSection, 8);
+		section.szName[8] = '\0';
+		section.cbVirtual = GetU32(pSection + 8);
+		section.rva = GetU32(pSection + 12);
+		section.cbRaw = GetU32(pSection + 16);
+		section.offRaw = GetU32(pSection + 20);
+		section.dwCharacteristics = GetU32(pSection + 36);
+
+		if (section.cbVirtual == 0) {
+			section.cbVirtual = section.cbRaw;
+		}
+	}
+
+	return true;
+}
+
+bool PeImage::Directory(int iDirectory, uint32_t * pRva, uint32_t * pcb) const
+{
+	if (iDirectory < 0 || iDirectory >= PE_DIRECTORY_MAX || m_rgDirRva[iDirectory] == 0) {
+		return false;
+	}
+
+	*pRva = m_rgDirRva[iDirectory];
+	*pcb = m_rgDirSize[iDirectory];
+
+	return true;
+}
+
+const PeSection * PeImage::SectionOf(uint32_t rva) const
+{
+	for (const PeSection & section : m_sections) {
+		if (rva - section.rva < section.cbVirtual) {
+			return &section;
+		}
+	}
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////
+// Pointer to cb bytes of file data at rva, NULL when not all
+//  of them are backed by the file (e.g. .bss)
+//
+const uint8_t * PeImage::Ptr(uint32_t rva, uint32_t cb) const
+{
+	uint64_t off;
+
+	if (rva < m_cbHeaders) {
+		off = rva;
+
+		if ((uint64_t)rva + cb > m_cbHeaders) {
+			return NULL;
+		}
+	}
+
+	else {
+		const PeSection * pSection = SectionOf(rva);
+
+		if (pSection == NULL || (uint64_t)(rva - pSection->rva) + cb > pSection->cbRaw) {
+			return NULL;
+		}
+
+		off = (uint64_t)pSection->offRaw + (rva - pSection->rva);
+	}
+
+	if (off + cb > m_file.size()) {
+		return NULL;
+	}
+
+	return m_file.data() + off;
+}
+
+bool PeImage::Read(uint32_t rva, void * pv, uint32_t cb) const
+{
+	const uint8_t * pb = Ptr(rva, cb);
+
+	if (pb == NULL) {
+		return false;
+	}
+
+	memcpy(pv, pb, cb);
+
+	return true;
+}
@@ -0,0 +1,86 @@
+// PeImage.h : Minimal reader for PE32 and PE32+ image files
+//
+// Only the headers, the section table and the data directories are
+// parsed; everything else is read on demand by RVA. Nothing in here
+// depends on Windows, the structures are decoded field by field.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define PE_MACHINE_I386             0x014C
+#define PE_MACHINE_AMD64            0x8664
+
+#define PE_DIRECTORY_EXPORT         0
+#define PE_DIRECTORY_IMPORT         1
+#define PE_DIRECTORY_RESOURCE       2
+#define PE_DIRECTORY_EXCEPTION      3
+#define PE_DIRECTORY_BASERELOC      5
+#define PE_DIRECTORY_DEBUG          6
+#define PE_DIRECTORY_TLS            9
+#define PE_DIRECTORY_LOAD_CONFIG    10
+#define PE_DIRECTORY_MAX            16
+
+struct PeSection
+{
+	char szName[9];
+	uint32_t rva;
+	uint32_t cbVirtual;
+	uint32_t offRaw;
+	uint32_t cbRaw;
+	uint32_t dwCharacteristics;
+};
+
+////////////////////////////////////////////////////////////
+// A PE file read into memory
+//
+class PeImage
+{
+	public:
+	PeImage();
+
+	bool Load(const char * szPath);
+#ifdef _WIN32
+	bool Load(const wchar_t * wszPath);
+#endif
+	bool Load(std::vector<uint8_t> & file);
+	void Clear();
+
+	bool IsLoaded() const { return !m_file.empty(); }
+	uint16_t Machine() const { return m_wMachine; }
+	bool Is64() const { return m_fPlus; }
+	uint64_t ImageBase() const { return m_qwImageBase; }
+	uint32_t SizeOfImage() const { return m_cbImage; }
+	uint32_t TimeDateStamp() const { return m_dwTimeDateStamp; }
+
+	bool Directory(int iDirectory, uint32_t * pRva, uint32_t * pcb) const;
+
+	const uint8_t * Ptr(uint32_t rva, uint32_t cb) const;
+	bool Read(uint32_t rva, void * pv, uint32_t cb) const;
+
+	const PeSection * SectionOf(uint32_t rva) const;
+	size_t CountSections() const { return m_sections.size(); }
+	const PeSection & Section(size_t i) const { return m_sections[i]; }
+
+	private:
+	bool Parse();
+
+	std::vector<uint8_t> m_file;
+	std::vector<PeSection> m_sections;
+	uint32_t m_rgDirRva[PE_DIRECTORY_MAX];
+	uint32_t m_rgDirSize[PE_DIRECTORY_MAX];
+	uint64_t m_qwImageBase;
+	uint32_t m_cbImage;
+	uint32_t m_cbHeaders;
+	uint32_t m_dwTimeDateStamp;
+	uint16_t m_wMachine;
+	bool m_fPlus;
+};
+
+bool ReadWholeFile(const char * szPath, std::vector<uint8_t> & file);
+#ifdef _WIN32
+bool ReadWholeFile(const wchar_t * wszPath, std::vector<uint8_t> & file);
+#endif
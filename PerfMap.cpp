@@ -0,0 +1,163 @@
+// PerfMap.cpp : Writers for the Linux perf symbol map and jitdump formats
+//
+
+#include "PerfMap.h"
+
+#include <string.h>
+
+#define JITDUMP_MAGIC               0x4A695444
+#define JITDUMP_VERSION             1
+#define JITDUMP_CODE_LOAD           0
+#define CB_JITDUMP_HEADER           40
+#define CB_JITDUMP_CODE_LOAD        56      // record header and fixed fields, before the name
+
+// Large enough that a module's map is written in a few hundred calls
+#define CB_PERF_MAP_BUFFER          (1024 * 1024)
+
+static void PutU32(std::vector<uint8_t> & data, uint32_t value)
+{
+	for (int i = 0; i < 4; i++) {
+		data.push_back((uint8_t)(value >> (i * 8)));
+	}
+}
+
+static void PutU64(std::vector<uint8_t> & data, uint64_t value)
+{
+	PutU32(data, (uint32_t)value);
+	PutU32(data, (uint32_t)(value >> 32));
+}
+
+PerfMapWriter::PerfMapWriter()
+	: m_pFile(NULL), m_format(PERF_MAP_TEXT), m_pid(0), m_timestamp(0), m_cEntries(0)
+{
+}
+
+PerfMapWriter::~PerfMapWriter()
+{
+	Close();
+}
+
+bool PerfMapWriter::Open(const char * szPath, int format, uint32_t pid, uint16_t wElfMachine, uint64_t timestamp)
+{
+	FILE * pFile;
+
+	Close();
+
+#ifdef _WIN32
+	if (fopen_s(&pFile, szPath, "wb") || !pFile) {
+		return false;
+	}
+#else
+	if ((pFile = fopen(szPath, "wb")) == NULL) {
+		return false;
+	}
+#endif
+
+	return Start(pFile, format, pid, wElfMachine, timestamp);
+}
+
+#ifdef _WIN32
+bool PerfMapWriter::Open(const wchar_t * wszPath, int format, uint32_t pid, uint16_t wElfMachine, uint64_t timestamp)
+{
+	FILE * pFile;
+
+	Close();
+
+	if (_wfopen_s(&pFile, wszPath, L"wb") || !pFile) {
+		return false;
+	}
+
+	return Start(pFile, format, pid, wElfMachine, timestamp);
+}
+#endif
+
+////////////////////////////////////////////////////////////
+// Take over an open file and write the jitdump header
+//
+bool PerfMapWriter::Start(FILE * pFile, int format, uint32_t pid, uint16_t wElfMachine, uint64_t timestamp)
+{
+	m_pFile = pFile;
+	m_format = format;
+	m_pid = pid;
+	m_timestamp = timestamp;
+	m_cEntries = 0;
+
+	setvbuf(m_pFile, NULL, _IOFBF, CB_PERF_MAP_BUFFER);
+
+	if (m_format != PERF_MAP_JITDUMP) {
+		return true;
+	}
+
+	m_record.clear();
+	PutU32(m_record, JITDUMP_MAGIC);
+	PutU32(m_record, JITDUMP_VERSION);
+	PutU32(m_record, CB_JITDUMP_HEADER);
+	PutU32(m_record, wElfMachine);
+	PutU32(m_record, 0);                  // pad1
+	PutU32(m_record, m_pid);
+	PutU64(m_record, m_timestamp);
+	PutU64(m_record, 0);                  // flags
+
+	if (fwrite(m_record.data(), 1, m_record.size(), m_pFile) != m_record.size()) {
+		Close();
+
+		return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Write one symbol. A jitdump record carries the code bytes,
+//  pCode may be NULL when they are not available and the
+//  record is zero filled instead.
+//
+bool PerfMapWriter::Add(uint64_t qwAddress, uint64_t cb, const char * szName, const void * pCode)
+{
+	if (m_pFile == NULL) {
+		return false;
+	}
+
+	if (m_format != PERF_MAP_JITDUMP) {
+		m_cEntries++;
+
+		return fprintf(m_pFile, "%llx %llx %s\n", (unsigned long long)qwAddress, (unsigned long long)cb, szName) > 0;
+	}
+
+	size_t cchName = strlen(szName) + 1;
+
+	m_record.clear();
+	PutU32(m_record, JITDUMP_CODE_LOAD);
+	PutU32(m_record, (uint32_t)(CB_JITDUMP_CODE_LOAD + cchName + cb));
+	PutU64(m_record, m_timestamp);
+	PutU32(m_record, m_pid);
+	PutU32(m_record, m_pid);              // tid
+	PutU64(m_record, qwAddress);          // vma
+	PutU64(m_record, qwAddress);          // code_addr
+	PutU64(m_record, cb);
+	PutU64(m_record, m_cEntries++);       // code_index
+	m_record.insert(m_record.end(), szName, szName + cchName);
+
+	if (pCode != NULL) {
+		m_record.insert(m_record.end(), (const uint8_t *)pCode, (const uint8_t *)pCode + cb);
+	}
+
+	else {
+		m_record.resize(m_record.size() + (size_t)cb);
+	}
+
+	return fwrite(m_record.data(), 1, m_record.size(), m_pFile) == m_record.size();
+}
+
+bool PerfMapWriter::Close()
+{
+	if (m_pFile == NULL) {
+		return true;
+	}
+
+	bool fOk = fclose(m_pFile) == 0;
+
+	m_pFile = NULL;
+
+	return fOk;
+}
@@ -0,0 +1,49 @@
+// PerfMap.h : Writers for the Linux perf symbol map and jitdump formats
+//
+// perf cannot read PDBs, so for images running under Wine the symbols
+// are handed to it the way JIT compilers do: a /tmp/perf-<pid>.map
+// text file, or a jitdump file for perf inject --jit. Entries are
+// written as they are added, callers are expected to add them in
+// address order.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#define PERF_MAP_TEXT               0
+#define PERF_MAP_JITDUMP            1
+
+#define PERF_ELF_MACHINE_386        3
+#define PERF_ELF_MACHINE_X86_64     62
+
+////////////////////////////////////////////////////////////
+// A perf map or jitdump file being written
+//
+class PerfMapWriter
+{
+	public:
+	PerfMapWriter();
+	~PerfMapWriter();
+
+	bool Open(const char * szPath, int format, uint32_t pid, uint16_t wElfMachine, uint64_t timestamp);
+#ifdef _WIN32
+	bool Open(const wchar_t * wszPath, int format, uint32_t pid, uint16_t wElfMachine, uint64_t timestamp);
+#endif
+	bool Add(uint64_t qwAddress, uint64_t cb, const char * szName, const void * pCode);
+	bool Close();
+
+	uint64_t Count() const { return m_cEntries; }
+
+	private:
+	bool Start(FILE * pFile, int format, uint32_t pid, uint16_t wElfMachine, uint64_t timestamp);
+
+	FILE * m_pFile;
+	int m_format;
+	uint32_t m_pid;
+	uint64_t m_timestamp;
+	uint64_t m_cEntries;
+	std::vector<uint8_t> m_record;
+};
@@ -22,8 +22,41 @@
 #include <algorithm>
 #include <map>
 #include <Shlwapi.h>
+#include <unordered_map>
 #include <vector>
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#include <intrin.h>
+#endif
+
+extern ULONGLONG g_dwloadAddress;
+
+////////////////////////////////////////////////////////////
+// Append printf style formatted text
+//
+static void AppendFormat(std::wstring & text, const wchar_t * szFormat, ...)
+{
+	wchar_t wszText[64];
+	va_list args;
+
+	va_start(args, szFormat);
+	_vsnwprintf_s(wszText, _countof(wszText), _TRUNCATE, szFormat, args);
+	va_end(args);
+
+	text += wszText;
+}
+
+// Type names by symbol id, see GetTypeName()
+static std::unordered_map<DWORD, std::wstring> g_typeNames;
+static std::vector<DWORD> g_typeNamesPending;
+
+static void FormatType(IDiaSymbol * pSymbol, std::wstring & text);
+static void FormatName(IDiaSymbol * pSymbol, std::wstring & text);
+static void FormatVariant(VARIANT var, std::wstring & text);
+static void FormatBound(IDiaSymbol * pSymbol, std::wstring & text);
+static void FormatUdtKind(IDiaSymbol * pSymbol, std::wstring & text);
+
 // Basic types
 const wchar_t * const rgBaseType[] =
 {
@@ -483,16 +516,188 @@ const wchar_t * const rgLocationTypeString[] =
 	L"RegRelAliasIndir"
 };
 
+////////////////////////////////////////////////////////////
+// Name fragments that change from build to build
+//
+//  Every rule masks the run of digits following its prefix
+//  (or following szAnchor, searched for after the prefix up to
+//  the end of the name token) with 'x', so dumps of different
+//  builds diff cleanly. Masking never changes the name length.
+//
+enum ScrubClass
+{
+	ScrubHex,
+	ScrubDecimal,
+};
+
+struct ScrubRule
+{
+	const wchar_t * szPrefix;
+	const wchar_t * szAnchor;
+	ScrubClass cls;
+	size_t cchMax;
+};
+
+static const ScrubRule rgScrubRules[] =
+{
+	{L"A0x",      NULL,  ScrubHex,     8},   // anonymous namespace ?A0x1234abcd
+	{L"<lambda_", NULL,  ScrubHex,     32},  // <lambda_1> and hashed <lambda_0f3a...>
+	{L"$S",       NULL,  ScrubDecimal, 10},  // static guard numbering $S1
+	{L"$TSS",     NULL,  ScrubDecimal, 10},  // thread safe static guards $TSS0
+	{L"??__E",    L"@?", ScrubDecimal, 10},  // dynamic initializer scope ??__Ex@?1??f@@...
+	{L"??__F",    L"@?", ScrubDecimal, 10},  // atexit destructor scope ??__Fx@?1??f@@...
+};
+
+static inline bool IsScrubChar(wchar_t ch, ScrubClass cls)
+{
+	if (ch >= L'0' && ch <= L'9') {
+		return true;
+	}
+
+	return (cls == ScrubHex) && ((ch >= L'a' && ch <= L'f') || (ch >= L'A' && ch <= L'F'));
+}
+
+////////////////////////////////////////////////////////////
+// Try to apply a rule at wsz[i], returns the index to resume
+//  scanning from, or i + 1 if the rule does not match there
+//
+static size_t ApplyScrubRule(const ScrubRule & rule, wchar_t * wsz, size_t cch, size_t i, size_t * pcScrubbed)
+{
+	size_t j = i;
+
+	for (const wchar_t * p = rule.szPrefix; *p; p++, j++) {
+		if (j >= cch || wsz[j] != *p) {
+			return i + 1;
+		}
+	}
+
+	// With an anchor the scan resumes right after the prefix, the
+	// text up to the anchor may still hold fragments of other rules
+
+	size_t iResume = j;
+
+	if (rule.szAnchor != NULL) {
+		size_t cchAnchor = wcslen(rule.szAnchor);
+
+		for (;; j++) {
+			if (j + cchAnchor > cch || wsz[j] == L' ' || wsz[j] == L'\'') {
+				return iResume;
+			}
+
+			if (wcsncmp(&wsz[j], rule.szAnchor, cchAnchor) == 0) {
+				j += cchAnchor;
+				break;
+			}
+		}
+	}
+
+	size_t iStart = j;
+
+	while (j < cch && (j - iStart) < rule.cchMax && IsScrubChar(wsz[j], rule.cls)) {
+		wsz[j++] = L'x';
+	}
+
+	if (j != iStart) {
+		(*pcScrubbed)++;
+	}
+
+	return (rule.szAnchor != NULL) ? iResume : j;
+}
+
+////////////////////////////////////////////////////////////
+// Mask all nondeterministic fragments of a name in place
+//
+//  Single pass over the buffer, no allocation. On x86/x64 the
+//  scan compares the first two characters of every rule against
+//  8 characters at a time and only verifies the candidate hits.
+//  Returns the number of fragments masked.
+//
+size_t ScrubSymbolName(wchar_t * wsz, size_t cch)
+{
+	size_t cScrubbed = 0;
+	size_t i = 0;
+
+#if defined(_M_IX86) || defined(_M_X64)
+	static_assert(sizeof(wchar_t) == sizeof(short), "SSE2 scan expects 16-bit wchar_t");
+
+	__m128i rgFirst[_countof(rgScrubRules)];
+	__m128i rgSecond[_countof(rgScrubRules)];
+
+	for (size_t r = 0; r < _countof(rgScrubRules); r++) {
+		rgFirst[r] = _mm_set1_epi16((short)rgScrubRules[r].szPrefix[0]);
+		rgSecond[r] = _mm_set1_epi16((short)rgScrubRules[r].szPrefix[1]);
+	}
+
+	// Two overlapping loads per step, so stop one character early
+
+	while (i + 9 <= cch) {
+		__m128i v0 = _mm_loadu_si128((const __m128i *)&wsz[i]);
+		__m128i v1 = _mm_loadu_si128((const __m128i *)&wsz[i + 1]);
+		__m128i vHit = _mm_setzero_si128();
+
+		for (size_t r = 0; r < _countof(rgScrubRules); r++) {
+			vHit = _mm_or_si128(vHit, _mm_and_si128(_mm_cmpeq_epi16(v0, rgFirst[r]), _mm_cmpeq_epi16(v1, rgSecond[r])));
+		}
+
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(vHit) & 0x5555;
+		size_t iSkip = i;
+
+		while (mask != 0) {
+			unsigned long iBit;
+
+			_BitScanForward(&iBit, mask);
+			mask &= mask - 1;
+
+			size_t iHit = i + (iBit >> 1);
+
+			if (iHit < iSkip) {
+				// Inside a fragment that was just masked
+				continue;
+			}
+
+			for (size_t r = 0; r < _countof(rgScrubRules); r++) {
+				size_t iEnd = ApplyScrubRule(rgScrubRules[r], wsz, cch, iHit, &cScrubbed);
+
+				if (iEnd > iHit + 1) {
+					iSkip = iEnd;
+					break;
+				}
+			}
+		}
+
+		i = (iSkip > i + 8) ? iSkip : i + 8;
+	}
+#endif
+
+	while (i < cch) {
+		size_t iResume = i + 1;
+
+		for (size_t r = 0; r < _countof(rgScrubRules); r++) {
+			if (wsz[i] != rgScrubRules[r].szPrefix[0]) {
+				continue;
+			}
+
+			size_t iEnd = ApplyScrubRule(rgScrubRules[r], wsz, cch, i, &cScrubbed);
+
+			if (iEnd > i + 1) {
+				iResume = iEnd;
+				break;
+			}
+		}
+
+		i = iResume;
+	}
+
+	return cScrubbed;
+}
+
 ////////////////////////////////////////////////////////////
 // Cleanup symbol from various inconsistent junk
 //
 void CleanupSymbol(std::wstring &str)
 {
-	// hacky way to remove hash from mangled symbol
-	auto pos = str.find(L"A0x");
-	while (pos != std::wstring::npos) {
-		str.replace(pos + 3, 8, L"xxxxxxxx");
-		pos = str.find(L"A0x", pos + 1);
+	if (!str.empty()) {
+		ScrubSymbolName(&str[0], str.size());
 	}
 }
 
@@ -956,43 +1161,57 @@ void PrintSymTag(DWORD dwSymTag)
 }
 
 ////////////////////////////////////////////////////////////
-// Print the name of the symbol
+// Append the name of the symbol
 //
-void PrintName(IDiaSymbol * pSymbol)
+static void FormatName(IDiaSymbol * pSymbol, std::wstring & text)
 {
 	BSTR bstrName;
 	BSTR bstrUndName;
 
 	if (pSymbol->get_name(&bstrName) != S_OK) {
-		wprintf(L"(none)");
+		text += L"(none)";
 		return;
 	}
 
-	if (pSymbol->get_undecoratedName(&bstrUndName) == S_OK) {
-		if (wcscmp(bstrName, bstrUndName) == 0) {
-			std::wstring str = bstrName;
-			CleanupSymbol(str);
-			wprintf(L"%s", str.c_str());
-		}
+	if (pSymbol->get_undecoratedName(&bstrUndName) != S_OK) {
+		bstrUndName = NULL;
+	}
 
-		else {
-			std::wstring str = bstrName;
-			CleanupSymbol(str);
-			wprintf(L"%s(%s)", bstrUndName, str.c_str());
-		}
+	bool fSameName = (bstrUndName == NULL) || (wcscmp(bstrName, bstrUndName) == 0);
 
-		SysFreeString(bstrUndName);
+	// The BSTR is ours until it is freed, so scrub it in place
+
+	ScrubSymbolName(bstrName, SysStringLen(bstrName));
+
+	if (fSameName) {
+		text += bstrName;
 	}
 
 	else {
-		std::wstring str = bstrName;
-		CleanupSymbol(str);
-		wprintf(L"%s", str.c_str());
+		text += bstrUndName;
+		text += L"(";
+		text += bstrName;
+		text += L")";
+	}
+
+	if (bstrUndName != NULL) {
+		SysFreeString(bstrUndName);
 	}
 
 	SysFreeString(bstrName);
 }
 
+////////////////////////////////////////////////////////////
+// Print the name of the symbol
+//
+void PrintName(IDiaSymbol * pSymbol)
+{
+	std::wstring text;
+
+	FormatName(pSymbol, text);
+	wprintf(L"%s", text.c_str());
+}
+
 ////////////////////////////////////////////////////////////
 // Print the undecorated name of the symbol
 //  - only SymTagFunction, SymTagData and SymTagPublicSymbol
@@ -1277,7 +1496,7 @@ void PrintLocation(IDiaSymbol * pSymbol)
 			if ((pSymbol->get_relativeVirtualAddress(&dwRVA) == S_OK) &&
 				(pSymbol->get_addressSection(&dwSect) == S_OK) &&
 				(pSymbol->get_addressOffset(&dwOff) == S_OK)) {
-				wprintf(L"%s // [%08X][%04X:%08X]", SafeDRef(rgLocationTypeString, dwLocType), dwRVA + 0x400000, dwSect, dwOff);
+				wprintf(L"%s // [%08llX][%04X:%08X]", SafeDRef(rgLocationTypeString, dwLocType), g_dwloadAddress + dwRVA, dwSect, dwOff);
 				//wprintf(L"%s, ", SafeDRef(rgLocationTypeString, dwLocType));
 			}
 			break;
@@ -1288,7 +1507,7 @@ void PrintLocation(IDiaSymbol * pSymbol)
 			if ((pSymbol->get_relativeVirtualAddress(&dwRVA) == S_OK) &&
 				(pSymbol->get_addressSection(&dwSect) == S_OK) &&
 				(pSymbol->get_addressOffset(&dwOff) == S_OK)) {
-				wprintf(L"%s // [%08X][%04X:%08X]", SafeDRef(rgLocationTypeString, dwLocType), dwRVA + 0x400000, dwSect, dwOff);
+				wprintf(L"%s // [%08llX][%04X:%08X]", SafeDRef(rgLocationTypeString, dwLocType), g_dwloadAddress + dwRVA, dwSect, dwOff);
 			}
 			break;
 
@@ -1383,16 +1602,85 @@ void PrintSymbolType(IDiaSymbol * pSymbol)
 	}
 }
 
+////////////////////////////////////////////////////////////
+// The text PrintType() prints for a type
+//
+//  The text of every type is built once and kept by symbol id,
+//  since -s and -t print the same few types for millions of
+//  symbols. A type reached again while it is being built, which
+//  only malformed records do, is printed by name.
+//
+const std::wstring & GetTypeName(IDiaSymbol * pSymbol)
+{
+	static std::wstring noId;
+	std::wstring text;
+	DWORD dwId;
+
+	if (pSymbol->get_symIndexId(&dwId) != S_OK) {
+		FormatType(pSymbol, text);
+		noId.swap(text);
+
+		return noId;
+	}
+
+	auto it = g_typeNames.find(dwId);
+
+	if (it != g_typeNames.end()) {
+		return it->second;
+	}
+
+	if (std::find(g_typeNamesPending.begin(), g_typeNamesPending.end(), dwId) != g_typeNamesPending.end()) {
+		FormatName(pSymbol, text);
+	}
+
+	else {
+		g_typeNamesPending.push_back(dwId);
+		FormatType(pSymbol, text);
+		g_typeNamesPending.pop_back();
+	}
+
+	return g_typeNames[dwId] = text;
+}
+
+////////////////////////////////////////////////////////////
+// Forget the type names, symbol ids are only unique within a
+//  session
+//
+void ClearTypeNames()
+{
+	g_typeNames.clear();
+}
+
 ////////////////////////////////////////////////////////////
 // Print the information details for a type symbol
 //
 void PrintType(IDiaSymbol * pSymbol)
+{
+	DWORD dwTag;
+
+	if (pSymbol->get_symTag(&dwTag) != S_OK) {
+		wprintf(L"ERROR - can't retrieve the symbol's SymTag\n");
+		return;
+	}
+
+	if (dwTag == SymTagData) { // This really is member data, just print its location
+		PrintLocation(pSymbol);
+		return;
+	}
+
+	wprintf(L"%s", GetTypeName(pSymbol).c_str());
+}
+
+////////////////////////////////////////////////////////////
+// Build the text of a type, the types it refers to come from
+//  the cache
+//
+static void FormatType(IDiaSymbol * pSymbol, std::wstring & text)
 {
 	IDiaSymbol * pBaseType;
 	IDiaEnumSymbols * pEnumSym;
 	IDiaSymbol * pSym;
 	DWORD dwTag;
-	BSTR bstrName;
 	DWORD dwInfo;
 	BOOL bSet;
 	DWORD dwRank;
@@ -1400,25 +1688,21 @@ void PrintType(IDiaSymbol * pSymbol)
 	ULONG celt = 1;
 
 	if (pSymbol->get_symTag(&dwTag) != S_OK) {
-		wprintf(L"ERROR - can't retrieve the symbol's SymTag\n");
+		text += L"ERROR - can't retrieve the symbol's SymTag\n";
 		return;
 	}
 
-	if (pSymbol->get_name(&bstrName) != S_OK) {
-		bstrName = NULL;
-	}
-
 	if (dwTag != SymTagPointerType) {
 		if ((pSymbol->get_constType(&bSet) == S_OK) && bSet) {
-			wprintf(L"const ");
+			text += L"const ";
 		}
 
 		if ((pSymbol->get_volatileType(&bSet) == S_OK) && bSet) {
-			wprintf(L"volatile ");
+			text += L"volatile ";
 		}
 
 		if ((pSymbol->get_unalignedType(&bSet) == S_OK) && bSet) {
-			wprintf(L"__unaligned ");
+			text += L"__unaligned ";
 		}
 	}
 
@@ -1428,67 +1712,64 @@ void PrintType(IDiaSymbol * pSymbol)
 
 	switch (dwTag) {
 		case SymTagUDT:
-			PrintUdtKind(pSymbol);
-			PrintName(pSymbol);
+			FormatUdtKind(pSymbol, text);
+			FormatName(pSymbol, text);
 			break;
 
 		case SymTagEnum:
-			wprintf(L"enum ");
-			PrintName(pSymbol);
+			text += L"enum ";
+			FormatName(pSymbol, text);
 			break;
 
 		case SymTagFunctionType:
-			wprintf(L"function ");
+			text += L"function ";
 			break;
 
 		case SymTagPointerType:
 			if (pSymbol->get_type(&pBaseType) != S_OK) {
-				wprintf(L"ERROR - SymTagPointerType get_type");
-				if (bstrName != NULL) {
-					SysFreeString(bstrName);
-				}
+				text += L"ERROR - SymTagPointerType get_type";
 				return;
 			}
 
-			PrintType(pBaseType);
+			text += GetTypeName(pBaseType);
 			pBaseType->Release();
 
 			if ((pSymbol->get_reference(&bSet) == S_OK) && bSet) {
-				wprintf(L" &");
+				text += L" &";
 			}
 
 			else {
-				wprintf(L" *");
+				text += L" *";
 			}
 
 			if ((pSymbol->get_constType(&bSet) == S_OK) && bSet) {
-				wprintf(L" const");
+				text += L" const";
 			}
 
 			if ((pSymbol->get_volatileType(&bSet) == S_OK) && bSet) {
-				wprintf(L" volatile");
+				text += L" volatile";
 			}
 
 			if ((pSymbol->get_unalignedType(&bSet) == S_OK) && bSet) {
-				wprintf(L" __unaligned");
+				text += L" __unaligned";
 			}
 			break;
 
 		case SymTagArrayType:
 			if (pSymbol->get_type(&pBaseType) == S_OK) {
-				PrintType(pBaseType);
+				text += GetTypeName(pBaseType);
 
 				if (pSymbol->get_rank(&dwRank) == S_OK) {
 					if (SUCCEEDED(pSymbol->findChildren(SymTagDimension, NULL, nsNone, &pEnumSym)) && (pEnumSym != NULL)) {
 						while (SUCCEEDED(pEnumSym->Next(1, &pSym, &celt)) && (celt == 1)) {
 							IDiaSymbol * pBound;
 
-							wprintf(L"[");
+							text += L"[";
 
 							if (pSym->get_lowerBound(&pBound) == S_OK) {
-								PrintBound(pBound);
+								FormatBound(pBound, text);
 
-								wprintf(L"..");
+								text += L"..";
 
 								pBound->Release();
 							}
@@ -1496,7 +1777,7 @@ void PrintType(IDiaSymbol * pSymbol)
 							pBound = NULL;
 
 							if (pSym->get_upperBound(&pBound) == S_OK) {
-								PrintBound(pBound);
+								FormatBound(pBound, text);
 
 								pBound->Release();
 							}
@@ -1504,7 +1785,7 @@ void PrintType(IDiaSymbol * pSymbol)
 							pSym->Release();
 							pSym = NULL;
 
-							wprintf(L"]");
+							text += L"]";
 						}
 
 						pEnumSym->Release();
@@ -1516,9 +1797,9 @@ void PrintType(IDiaSymbol * pSymbol)
 						 (pEnumSym->get_Count(&lCount) == S_OK) &&
 						 (lCount > 0)) {
 					while (SUCCEEDED(pEnumSym->Next(1, &pSym, &celt)) && (celt == 1)) {
-						wprintf(L"[");
-						PrintType(pSym);
-						wprintf(L"]");
+						text += L"[";
+						text += GetTypeName(pSym);
+						text += L"]";
 
 						pSym->Release();
 					}
@@ -1532,17 +1813,17 @@ void PrintType(IDiaSymbol * pSymbol)
 					ULONGLONG ulLenElem;
 
 					if (pSymbol->get_count(&dwCountElems) == S_OK) {
-						wprintf(L"[0x%X]", dwCountElems);
+						AppendFormat(text, L"[0x%X]", dwCountElems);
 					}
 
 					else if ((pSymbol->get_length(&ulLenArray) == S_OK) &&
 							 (pBaseType->get_length(&ulLenElem) == S_OK)) {
 						if (ulLenElem == 0) {
-							wprintf(L"[0x%lX]", (ULONG)ulLenArray);
+							AppendFormat(text, L"[0x%lX]", (ULONG)ulLenArray);
 						}
 
 						else {
-							wprintf(L"[0x%lX]", (ULONG)ulLenArray / (ULONG)ulLenElem);
+							AppendFormat(text, L"[0x%lX]", (ULONG)ulLenArray / (ULONG)ulLenElem);
 						}
 					}
 				}
@@ -1551,26 +1832,20 @@ void PrintType(IDiaSymbol * pSymbol)
 			}
 
 			else {
-				wprintf(L"ERROR - SymTagArrayType get_type\n");
-				if (bstrName != NULL) {
-					SysFreeString(bstrName);
-				}
+				text += L"ERROR - SymTagArrayType get_type\n";
 				return;
 			}
 			break;
 
 		case SymTagBaseType:
 			if (pSymbol->get_baseType(&dwInfo) != S_OK) {
-				wprintf(L"SymTagBaseType get_baseType\n");
-				if (bstrName != NULL) {
-					SysFreeString(bstrName);
-				}
+				text += L"SymTagBaseType get_baseType\n";
 				return;
 			}
 
 			switch (dwInfo) {
 				case btUInt:
-					wprintf(L"unsigned ");
+					text += L"unsigned ";
 
 				  // Fall through
 
@@ -1578,22 +1853,22 @@ void PrintType(IDiaSymbol * pSymbol)
 					switch (ulLen) {
 						case 1:
 							if (dwInfo == btInt) {
-								wprintf(L"signed ");
+								text += L"signed ";
 							}
 
-							wprintf(L"char");
+							text += L"char";
 							break;
 
 						case 2:
-							wprintf(L"short");
+							text += L"short";
 							break;
 
 						case 4:
-							wprintf(L"int");
+							text += L"int";
 							break;
 
 						case 8:
-							wprintf(L"__int64");
+							text += L"__int64";
 							break;
 					}
 
@@ -1603,11 +1878,11 @@ void PrintType(IDiaSymbol * pSymbol)
 				case btFloat:
 					switch (ulLen) {
 						case 4:
-							wprintf(L"float");
+							text += L"float";
 							break;
 
 						case 8:
-							wprintf(L"double");
+							text += L"double";
 							break;
 					}
 
@@ -1619,11 +1894,11 @@ void PrintType(IDiaSymbol * pSymbol)
 				break;
 			}
 
-			wprintf(L"%s", rgBaseType[dwInfo]);
+			text += rgBaseType[dwInfo];
 			break;
 
 		case SymTagTypedef:
-			PrintName(pSymbol);
+			FormatName(pSymbol, text);
 			break;
 
 		case SymTagCustomType:
@@ -1633,11 +1908,11 @@ void PrintType(IDiaSymbol * pSymbol)
 			DWORD count;
 
 			if (pSymbol->get_oemId(&idOEM) == S_OK) {
-				wprintf(L"OEMId = %X, ", idOEM);
+				AppendFormat(text, L"OEMId = %X, ", idOEM);
 			}
 
 			if (pSymbol->get_oemSymbolId(&idOEMSym) == S_OK) {
-				wprintf(L"SymbolId = %X, ", idOEMSym);
+				AppendFormat(text, L"SymbolId = %X, ", idOEMSym);
 			}
 
 			if (pSymbol->get_types(0, &count, NULL) == S_OK) {
@@ -1645,7 +1920,7 @@ void PrintType(IDiaSymbol * pSymbol)
 
 				if (pSymbol->get_types(count, &count, rgpDiaSymbols) == S_OK) {
 					for (ULONG i = 0; i < count; i++) {
-						PrintType(rgpDiaSymbols[i]);
+						text += GetTypeName(rgpDiaSymbols[i]);
 						rgpDiaSymbols[i]->Release();
 					}
 				}
@@ -1654,28 +1929,20 @@ void PrintType(IDiaSymbol * pSymbol)
 			// print custom data
 
 			if ((pSymbol->get_dataBytes(cbData, &cbData, NULL) == S_OK) && (cbData != 0)) {
-				wprintf(L", Data: ");
+				text += L", Data: ";
 
 				BYTE * pbData = new BYTE[cbData];
 
 				pSymbol->get_dataBytes(cbData, &cbData, pbData);
 
 				for (ULONG i = 0; i < cbData; i++) {
-					wprintf(L"0x%02X ", pbData[i]);
+					AppendFormat(text, L"0x%02X ", pbData[i]);
 				}
 
 				delete[] pbData;
 			}
 		}
 		break;
-
-		case SymTagData: // This really is member data, just print its location
-			PrintLocation(pSymbol);
-			break;
-	}
-
-	if (bstrName != NULL) {
-		SysFreeString(bstrName);
 	}
 }
 
@@ -1683,17 +1950,25 @@ void PrintType(IDiaSymbol * pSymbol)
 // Print bound information
 //
 void PrintBound(IDiaSymbol * pSymbol)
+{
+	std::wstring text;
+
+	FormatBound(pSymbol, text);
+	wprintf(L"%s", text.c_str());
+}
+
+static void FormatBound(IDiaSymbol * pSymbol, std::wstring & text)
 {
 	DWORD dwTag = 0;
 	DWORD dwKind;
 
 	if (pSymbol->get_symTag(&dwTag) != S_OK) {
-		wprintf(L"ERROR - PrintBound() get_symTag");
+		text += L"ERROR - PrintBound() get_symTag";
 		return;
 	}
 
 	if (pSymbol->get_locationType(&dwKind) != S_OK) {
-		wprintf(L"ERROR - PrintBound() get_locationType");
+		text += L"ERROR - PrintBound() get_locationType";
 		return;
 	}
 
@@ -1701,13 +1976,13 @@ void PrintBound(IDiaSymbol * pSymbol)
 		VARIANT v;
 
 		if (pSymbol->get_value(&v) == S_OK) {
-			PrintVariant(v);
+			FormatVariant(v, text);
 			VariantClear((VARIANTARG *)&v);
 		}
 	}
 
 	else {
-		PrintName(pSymbol);
+		FormatName(pSymbol, text);
 	}
 }
 
@@ -1735,17 +2010,25 @@ void PrintData(IDiaSymbol * pSymbol)
 // Print a VARIANT
 //
 void PrintVariant(VARIANT var)
+{
+	std::wstring text;
+
+	FormatVariant(var, text);
+	wprintf(L"%s", text.c_str());
+}
+
+static void FormatVariant(VARIANT var, std::wstring & text)
 {
 	switch (var.vt) {
 		case VT_UI1:
 		case VT_I1:
-			wprintf(L" I1 0x%X", var.bVal);
+			AppendFormat(text, L" I1 0x%X", var.bVal);
 			break;
 
 		case VT_I2:
 		case VT_UI2:
 		case VT_BOOL:
-			wprintf(L" I2 0x%X", var.iVal);
+			AppendFormat(text, L" I2 0x%X", var.iVal);
 			break;
 
 		case VT_I4:
@@ -1753,23 +2036,25 @@ void PrintVariant(VARIANT var)
 		case VT_INT:
 		case VT_UINT:
 		case VT_ERROR:
-			wprintf(L" I4 0x%X", var.lVal);
+			AppendFormat(text, L" I4 0x%X", var.lVal);
 			break;
 
 		case VT_R4:
-			wprintf(L" R4 %g", var.fltVal);
+			AppendFormat(text, L" R4 %g", var.fltVal);
 			break;
 
 		case VT_R8:
-			wprintf(L" R8 %g", var.dblVal);
+			AppendFormat(text, L" R8 %g", var.dblVal);
 			break;
 
 		case VT_BSTR:
-			wprintf(L" BSTR \"%s\"", var.bstrVal);
+			text += L" BSTR \"";
+			text += var.bstrVal;
+			text += L"\"";
 			break;
 
 		default:
-			wprintf(L" ??");
+			text += L" ??";
 	}
 }
 
@@ -1777,11 +2062,20 @@ void PrintVariant(VARIANT var)
 // Print a string corresponding to a UDT kind
 //
 void PrintUdtKind(IDiaSymbol * pSymbol)
+{
+	std::wstring text;
+
+	FormatUdtKind(pSymbol, text);
+	wprintf(L"%s", text.c_str());
+}
+
+static void FormatUdtKind(IDiaSymbol * pSymbol, std::wstring & text)
 {
 	DWORD dwKind = 0;
 
 	if (pSymbol->get_udtKind(&dwKind) == S_OK) {
-		wprintf(L"%s ", rgUdtKind[dwKind]);
+		text += rgUdtKind[dwKind];
+		text += L" ";
 	}
 }
 
@@ -2205,8 +2499,6 @@ bool compareByLineNums(const LineInfo & a, const LineInfo & b)
 
 std::map<DWORD,DataInfo> datainfo;
 
-extern ULONGLONG g_dwloadAddress;
-
 ////////////////////////////////////////////////////////////
 //
 void PrintLines(IDiaEnumLineNumbers * pLines, wchar_t const * szFileName)
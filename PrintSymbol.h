@@ -50,6 +50,8 @@ void PrintFrameData(IDiaFrameData *);
 
 void PrintPropertyStorage(IDiaPropertyStorage *);
 
+size_t ScrubSymbolName(wchar_t *, size_t);
+
 template<class T> void PrintGeneric(T t)
 {
 	IDiaPropertyStorage * pPropertyStorage;
@@ -66,3 +68,7 @@ void PrintSpecificDword(IDiaSession *, IDiaSectionContrib *, wchar_t *, wchar_t
 //PdbTypeMatch addition
 #include <string>
 void GetSymbolName(std::wstring & symbolName, IDiaSymbol * pSymbol);
+void CleanupSymbol(std::wstring &);
+
+const std::wstring & GetTypeName(IDiaSymbol *);
+void ClearTypeNames();
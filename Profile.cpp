@@ -0,0 +1,412 @@
+// Profile.cpp : Sample profile aggregation against address ordered tables
+//
+
+#include "Profile.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+uint32_t ProfileSymbols::Intern(std::vector<std::string> & strings, std::unordered_map<std::string, uint32_t> & ids, const std::string & str)
+{
+	auto it = ids.find(str);
+
+	if (it != ids.end()) {
+		return it->second;
+	}
+
+	uint32_t id = (uint32_t)strings.size();
+
+	strings.push_back(str);
+	ids.insert(std::make_pair(str, id));
+
+	return id;
+}
+
+void ProfileSymbols::AddFunction(uint32_t rva, uint32_t cb, uint32_t iName, uint32_t iCompiland)
+{
+	ProfileFunction function = {rva, cb, iName, iCompiland};
+
+	m_functions.push_back(function);
+}
+
+void ProfileSymbols::AddLine(uint32_t rva, uint32_t cb, uint32_t line, uint32_t iFile)
+{
+	ProfileLine entry = {rva, cb, line, iFile};
+
+	m_lines.push_back(entry);
+}
+
+void ProfileSymbols::Finish()
+{
+	std::sort(m_functions.begin(), m_functions.end(),
+		[](const ProfileFunction & a, const ProfileFunction & b) { return a.rva < b.rva; });
+	std::sort(m_lines.begin(), m_lines.end(),
+		[](const ProfileLine & a, const ProfileLine & b) { return a.rva < b.rva; });
+}
+
+uint32_t ProfileSymbols::FindFunction(uint32_t rva) const
+{
+	auto it = std::upper_bound(m_functions.begin(), m_functions.end(), rva,
+		[](uint32_t value, const ProfileFunction & function) { return value < function.rva; });
+
+	if (it == m_functions.begin() || rva - (it - 1)->rva >= (it - 1)->cb) {
+		return PROFILE_NO_INDEX;
+	}
+
+	return (uint32_t)(it - 1 - m_functions.begin());
+}
+
+void ProfileSamples::Clear()
+{
+	m_leaves.clear();
+	m_stacks.clear();
+	m_stackIds.clear();
+	m_cSamples = 0;
+}
+
+bool ProfileSamples::Load(const char * szPath, uint64_t qwBase, uint64_t cbModule)
+{
+	FILE * pFile;
+
+#ifdef _WIN32
+	if (fopen_s(&pFile, szPath, "r") || !pFile) {
+		return false;
+	}
+#else
+	if ((pFile = fopen(szPath, "r")) == NULL) {
+		return false;
+	}
+#endif
+
+	bool fOk = Load(pFile, qwBase, cbModule);
+
+	fclose(pFile);
+
+	return fOk;
+}
+
+#ifdef _WIN32
+bool ProfileSamples::Load(const wchar_t * wszPath, uint64_t qwBase, uint64_t cbModule)
+{
+	FILE * pFile;
+
+	if (_wfopen_s(&pFile, wszPath, L"r") || !pFile) {
+		return false;
+	}
+
+	bool fOk = Load(pFile, qwBase, cbModule);
+
+	fclose(pFile);
+
+	return fOk;
+}
+#endif
+
+static bool IsBlank(char ch)
+{
+	return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '\0';
+}
+
+////////////////////////////////////////////////////////////
+// Parse the samples of a file
+//
+//  perf script indents the stack frames with a tab and pads
+//  the command of a sample header with spaces, so a line is a
+//  frame when it holds an address and its indent has a tab, or
+//  it is indented below an open header that has no ip. Other
+//  lines start a new sample. A perf sample without a call chain
+//  has its ip after the event name, the last field ending with
+//  a colon.
+//
+bool ProfileSamples::Load(FILE * pFile, uint64_t qwBase, uint64_t cbModule)
+{
+	char szLine[4096];
+	std::vector<uint32_t> frames;
+	uint32_t rvaHeader = PROFILE_NO_RVA;
+	bool fHeader = false;
+	bool fHeaderIp = false;
+
+	Clear();
+
+	auto relocate = [&](uint64_t qwAddress) {
+		return (qwAddress >= qwBase && qwAddress - qwBase < cbModule) ? (uint32_t)(qwAddress - qwBase) : PROFILE_NO_RVA;
+	};
+
+	auto flush = [&]() {
+		if (!frames.empty()) {
+			AddStack(frames, 1);
+		}
+
+		else if (fHeader) {
+			ProfileSample sample = {rvaHeader, 1};
+
+			m_leaves.push_back(sample);
+			m_cSamples++;
+		}
+
+		fHeader = false;
+	};
+
+	while (fgets(szLine, sizeof(szLine), pFile) != NULL) {
+		char * p = szLine;
+		bool fIndented = *p == ' ' || *p == '\t';
+		bool fTabbed = false;
+
+		while (*p == ' ' || *p == '\t') {
+			fTabbed = fTabbed || *p == '\t';
+			p++;
+		}
+
+		if (IsBlank(*p)) {
+			flush();
+			continue;
+		}
+
+		if (*p == '#') {
+			continue;
+		}
+
+		char * pEnd;
+		uint64_t value = strtoull(p, &pEnd, 16);
+
+		if ((fTabbed || (fIndented && fHeader && !fHeaderIp)) && pEnd != p && IsBlank(*pEnd)) {
+			frames.push_back(relocate(value));
+			continue;
+		}
+
+		if (fTabbed) {
+			continue;
+		}
+
+		// "<hex rva> [count]"
+
+		if (pEnd != p && IsBlank(*pEnd)) {
+			char * pCount;
+			unsigned long count = strtoul(pEnd, &pCount, 10);
+
+			while (*pCount == ' ' || *pCount == '\t') {
+				pCount++;
+			}
+
+			if (*pCount == '\r' || *pCount == '\n' || *pCount == '\0') {
+				flush();
+
+				ProfileSample sample = {(value <= 0xFFFFFFFF) ? (uint32_t)value : PROFILE_NO_RVA, count ? (uint32_t)count : 1};
+
+				m_leaves.push_back(sample);
+				m_cSamples += sample.count;
+				continue;
+			}
+		}
+
+		flush();
+
+		fHeader = true;
+		fHeaderIp = false;
+		rvaHeader = PROFILE_NO_RVA;
+
+		for (char * pToken = p; *pToken != '\0'; ) {
+			char * pTokenEnd = pToken;
+
+			while (!IsBlank(*pTokenEnd)) {
+				pTokenEnd++;
+			}
+
+			char * pNext = pTokenEnd;
+
+			while (*pNext == ' ' || *pNext == '\t') {
+				pNext++;
+			}
+
+			if (pTokenEnd > pToken && pTokenEnd[-1] == ':') {
+				value = strtoull(pNext, &pEnd, 16);
+				fHeaderIp = pEnd != pNext && IsBlank(*pEnd);
+				rvaHeader = fHeaderIp ? relocate(value) : PROFILE_NO_RVA;
+			}
+
+			if (pNext == pTokenEnd) {
+				break;
+			}
+
+			pToken = pNext;
+		}
+	}
+
+	flush();
+
+	return !ferror(pFile);
+}
+
+void ProfileSamples::AddStack(std::vector<uint32_t> & frames, uint32_t count)
+{
+	ProfileSample sample = {frames[0], count};
+	std::string key((const char *)frames.data(), frames.size() * sizeof(uint32_t));
+	auto it = m_stackIds.find(key);
+
+	m_leaves.push_back(sample);
+	m_cSamples += count;
+
+	if (it != m_stackIds.end()) {
+		m_stacks[it->second].count += count;
+	}
+
+	else {
+		ProfileStack stack;
+
+		stack.frames = frames;
+		stack.count = count;
+
+		m_stackIds.insert(std::make_pair(key, (uint32_t)m_stacks.size()));
+		m_stacks.push_back(stack);
+	}
+
+	frames.clear();
+}
+
+static void SortCounts(const std::vector<uint64_t> & counts, std::vector<ProfileCount> & sorted)
+{
+	sorted.clear();
+
+	for (size_t i = 0; i < counts.size(); i++) {
+		if (counts[i] != 0) {
+			ProfileCount count = {(uint32_t)i, counts[i]};
+
+			sorted.push_back(count);
+		}
+	}
+
+	std::sort(sorted.begin(), sorted.end(),
+		[](const ProfileCount & a, const ProfileCount & b) { return a.count > b.count || (a.count == b.count && a.index < b.index); });
+}
+
+////////////////////////////////////////////////////////////
+// Count the samples of every function, line and compiland in
+//  a single merge pass over the sorted samples and tables
+//
+void AggregateProfile(const ProfileSymbols & symbols, const ProfileSamples & samples, ProfileReport & report)
+{
+	const std::vector<ProfileFunction> & functions = symbols.Functions();
+	const std::vector<ProfileLine> & lines = symbols.Lines();
+	std::vector<ProfileSample> leaves(samples.Leaves());
+	std::vector<uint64_t> functionCounts(functions.size());
+	std::vector<uint64_t> lineCounts(lines.size());
+	std::vector<uint64_t> compilandCounts(symbols.CountCompilands());
+	size_t iFunction = 0;
+	size_t iLine = 0;
+
+	std::sort(leaves.begin(), leaves.end(),
+		[](const ProfileSample & a, const ProfileSample & b) { return a.rva < b.rva; });
+
+	report.cSamples = 0;
+	report.cUnresolved = 0;
+
+	for (const ProfileSample & sample : leaves) {
+		report.cSamples += sample.count;
+
+		while (iFunction < functions.size() && sample.rva - functions[iFunction].rva >= functions[iFunction].cb &&
+			sample.rva >= functions[iFunction].rva) {
+			iFunction++;
+		}
+
+		while (iLine < lines.size() && sample.rva - lines[iLine].rva >= lines[iLine].cb &&
+			sample.rva >= lines[iLine].rva) {
+			iLine++;
+		}
+
+		if (sample.rva != PROFILE_NO_RVA && iFunction < functions.size() && sample.rva >= functions[iFunction].rva) {
+			functionCounts[iFunction] += sample.count;
+
+			if (functions[iFunction].iCompiland != PROFILE_NO_INDEX) {
+				compilandCounts[functions[iFunction].iCompiland] += sample.count;
+			}
+		}
+
+		else {
+			report.cUnresolved += sample.count;
+		}
+
+		if (sample.rva != PROFILE_NO_RVA && iLine < lines.size() && sample.rva >= lines[iLine].rva) {
+			lineCounts[iLine] += sample.count;
+		}
+	}
+
+	SortCounts(functionCounts, report.functions);
+	SortCounts(lineCounts, report.lines);
+	SortCounts(compilandCounts, report.compilands);
+}
+
+////////////////////////////////////////////////////////////
+// Write the stacks as "root;...;leaf count" lines for flame
+//  graph tools. Every distinct frame address is resolved once,
+//  return addresses one byte back so tail calls stay in the
+//  caller.
+//
+bool WriteCollapsedStacks(const ProfileSymbols & symbols, const ProfileSamples & samples, const char * szModule, FILE * pFile)
+{
+	std::vector<uint32_t> addresses;
+
+	for (const ProfileStack & stack : samples.Stacks()) {
+		for (size_t i = 0; i < stack.frames.size(); i++) {
+			if (stack.frames[i] != PROFILE_NO_RVA) {
+				addresses.push_back((i != 0 && stack.frames[i] != 0) ? stack.frames[i] - 1 : stack.frames[i]);
+			}
+		}
+	}
+
+	std::sort(addresses.begin(), addresses.end());
+	addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+
+	std::vector<uint32_t> resolved(addresses.size(), PROFILE_NO_INDEX);
+	const std::vector<ProfileFunction> & functions = symbols.Functions();
+	size_t iFunction = 0;
+
+	for (size_t i = 0; i < addresses.size(); i++) {
+		while (iFunction < functions.size() && addresses[i] - functions[iFunction].rva >= functions[iFunction].cb &&
+			addresses[i] >= functions[iFunction].rva) {
+			iFunction++;
+		}
+
+		if (iFunction < functions.size() && addresses[i] >= functions[iFunction].rva) {
+			resolved[i] = (uint32_t)iFunction;
+		}
+	}
+
+	std::string line;
+	char szFrame[64];
+
+	for (const ProfileStack & stack : samples.Stacks()) {
+		line.clear();
+
+		for (size_t i = stack.frames.size(); i-- != 0; ) {
+			uint32_t rva = stack.frames[i];
+
+			if (!line.empty()) {
+				line += ';';
+			}
+
+			if (rva == PROFILE_NO_RVA) {
+				line += "[unknown]";
+				continue;
+			}
+
+			uint32_t rvaLookup = (i != 0 && rva != 0) ? rva - 1 : rva;
+			size_t iAddress = std::lower_bound(addresses.begin(), addresses.end(), rvaLookup) - addresses.begin();
+
+			if (resolved[iAddress] != PROFILE_NO_INDEX) {
+				line += symbols.Name(functions[resolved[iAddress]].iName);
+			}
+
+			else {
+				snprintf(szFrame, sizeof(szFrame), "%s+0x%X", szModule, rva);
+				line += szFrame;
+			}
+		}
+
+		if (fprintf(pFile, "%s %llu\n", line.c_str(), (unsigned long long)stack.count) < 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,136 @@
+// Profile.h : Sample profile aggregation against address ordered tables
+//
+// Reads instruction pointer samples, either a list of RVAs or the
+// output of perf script, and resolves them all at once: the samples
+// are sorted by address and merged against the function and line
+// tables, which are sorted the same way, instead of being looked up
+// one by one. Stacks are kept unique with a count so the collapsed
+// output for flame graphs only resolves every distinct frame once.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define PROFILE_NO_RVA              0xFFFFFFFF
+#define PROFILE_NO_INDEX            0xFFFFFFFF
+
+struct ProfileFunction
+{
+	uint32_t rva;
+	uint32_t cb;
+	uint32_t iName;
+	uint32_t iCompiland;
+};
+
+struct ProfileLine
+{
+	uint32_t rva;
+	uint32_t cb;
+	uint32_t line;
+	uint32_t iFile;
+};
+
+////////////////////////////////////////////////////////////
+// Functions and lines of a module, sorted by address once
+//  Finish() is called
+//
+class ProfileSymbols
+{
+	public:
+	uint32_t AddName(const std::string & name) { return Intern(m_names, m_nameIds, name); }
+	uint32_t AddFile(const std::string & name) { return Intern(m_files, m_fileIds, name); }
+	uint32_t AddCompiland(const std::string & name) { return Intern(m_compilands, m_compilandIds, name); }
+	void AddFunction(uint32_t rva, uint32_t cb, uint32_t iName, uint32_t iCompiland);
+	void AddLine(uint32_t rva, uint32_t cb, uint32_t line, uint32_t iFile);
+	void Finish();
+
+	uint32_t FindFunction(uint32_t rva) const;
+
+	const std::vector<ProfileFunction> & Functions() const { return m_functions; }
+	const std::vector<ProfileLine> & Lines() const { return m_lines; }
+	const std::string & Name(uint32_t i) const { return m_names[i]; }
+	const std::string & File(uint32_t i) const { return m_files[i]; }
+	const std::string & Compiland(uint32_t i) const { return m_compilands[i]; }
+	size_t CountCompilands() const { return m_compilands.size(); }
+
+	private:
+	static uint32_t Intern(std::vector<std::string> & strings, std::unordered_map<std::string, uint32_t> & ids, const std::string & str);
+
+	std::vector<ProfileFunction> m_functions;
+	std::vector<ProfileLine> m_lines;
+	std::vector<std::string> m_names;
+	std::vector<std::string> m_files;
+	std::vector<std::string> m_compilands;
+	std::unordered_map<std::string, uint32_t> m_nameIds;
+	std::unordered_map<std::string, uint32_t> m_fileIds;
+	std::unordered_map<std::string, uint32_t> m_compilandIds;
+};
+
+struct ProfileSample
+{
+	uint32_t rva;                        // PROFILE_NO_RVA when outside the module
+	uint32_t count;
+};
+
+struct ProfileStack
+{
+	std::vector<uint32_t> frames;        // leaf first, the callers are return addresses
+	uint64_t count;
+};
+
+////////////////////////////////////////////////////////////
+// Samples read from a file
+//
+//  RVA lists hold "<hex rva> [count]" per line. perf script
+//  output holds virtual addresses, they are relocated with
+//  qwBase and the ones outside the module are kept as
+//  PROFILE_NO_RVA so stacks through other modules still add up.
+//
+class ProfileSamples
+{
+	public:
+	bool Load(const char * szPath, uint64_t qwBase, uint64_t cbModule);
+#ifdef _WIN32
+	bool Load(const wchar_t * wszPath, uint64_t qwBase, uint64_t cbModule);
+#endif
+	bool Load(FILE * pFile, uint64_t qwBase, uint64_t cbModule);
+	void Clear();
+
+	const std::vector<ProfileSample> & Leaves() const { return m_leaves; }
+	const std::vector<ProfileStack> & Stacks() const { return m_stacks; }
+	uint64_t CountSamples() const { return m_cSamples; }
+
+	private:
+	void AddStack(std::vector<uint32_t> & frames, uint32_t count);
+
+	std::vector<ProfileSample> m_leaves;
+	std::vector<ProfileStack> m_stacks;
+	std::unordered_map<std::string, uint32_t> m_stackIds;
+	uint64_t m_cSamples = 0;
+};
+
+struct ProfileCount
+{
+	uint32_t index;
+	uint64_t count;
+};
+
+////////////////////////////////////////////////////////////
+// Self sample counts, each list sorted by count, highest first
+//
+struct ProfileReport
+{
+	uint64_t cSamples;
+	uint64_t cUnresolved;                // outside the module or not in any function
+	std::vector<ProfileCount> functions; // index into ProfileSymbols::Functions()
+	std::vector<ProfileCount> lines;     // index into ProfileSymbols::Lines()
+	std::vector<ProfileCount> compilands;
+};
+
+void AggregateProfile(const ProfileSymbols & symbols, const ProfileSamples & samples, ProfileReport & report);
+bool WriteCollapsedStacks(const ProfileSymbols & symbols, const ProfileSamples & samples, const char * szModule, FILE * pFile);
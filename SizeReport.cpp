@@ -0,0 +1,117 @@
+// SizeReport.cpp : Hash aggregated size tables for bloat analysis
+//
+
+#include "SizeReport.h"
+
+#include <algorithm>
+#include <string.h>
+
+void SizeTable::Add(const std::string & key, uint64_t cb)
+{
+	auto it = m_index.find(key);
+
+	if (it == m_index.end()) {
+		SizeRow row = {key, 0, 0};
+
+		it = m_index.insert(std::make_pair(key, (uint32_t)m_rows.size())).first;
+		m_rows.push_back(row);
+	}
+
+	m_rows[it->second].cb += cb;
+	m_rows[it->second].count++;
+	m_cbTotal += cb;
+}
+
+////////////////////////////////////////////////////////////
+// Rows by size, largest first
+//
+void SizeTable::Sorted(std::vector<const SizeRow *> & rows) const
+{
+	rows.clear();
+
+	for (const SizeRow & row : m_rows) {
+		rows.push_back(&row);
+	}
+
+	std::sort(rows.begin(), rows.end(),
+		[](const SizeRow * a, const SizeRow * b) { return a->cb > b->cb || (a->cb == b->cb && a->key < b->key); });
+}
+
+////////////////////////////////////////////////////////////
+// Collapse the template argument lists of an undecorated name,
+//  "std::vector<int>::push_back" becomes "std::vector<>::push_back",
+//  so every instantiation lands in the same family. Returns false
+//  for names without template arguments.
+//
+bool TemplateFamily(const char * szName, std::string & family)
+{
+	static const char szOperator[] = "operator";
+	const size_t cchOperator = sizeof(szOperator) - 1;
+	int depth = 0;
+	bool fTemplate = false;
+
+	family.clear();
+
+	for (const char * p = szName; *p != '\0'; p++) {
+		char ch = *p;
+
+		// The brackets of operator<, operator<<=, operator-> and the
+		//  like are part of the name
+
+		if ((ch == '<' || ch == '>') && depth == 0 && family.size() >= cchOperator &&
+			family.compare(family.size() - cchOperator, cchOperator, szOperator) == 0) {
+			static const char * const rgszOperators[] = {"<=>", "<<=", ">>=", "<<", ">>", "<=", ">=", "<", ">"};
+
+			for (const char * szOp : rgszOperators) {
+				size_t cch = strlen(szOp);
+
+				if (strncmp(p, szOp, cch) == 0) {
+					family.append(p, cch);
+					p += cch - 1;
+					break;
+				}
+			}
+
+			continue;
+		}
+
+		if (ch == '<') {
+			if (depth++ == 0) {
+				family += '<';
+			}
+
+			fTemplate = true;
+		}
+
+		else if (ch == '>' && depth > 0) {
+			if (--depth == 0) {
+				family += '>';
+			}
+		}
+
+		else if (depth == 0) {
+			family += ch;
+		}
+	}
+
+	return fTemplate;
+}
+
+////////////////////////////////////////////////////////////
+// Write a table as tab separated "table key bytes count" lines
+//
+bool WriteSizeTable(FILE * pFile, const char * szTable, const SizeTable & table)
+{
+	std::vector<const SizeRow *> rows;
+
+	table.Sorted(rows);
+
+	for (const SizeRow * pRow : rows) {
+		if (fprintf(pFile, "%s\t%s\t%llu\t%llu\n", szTable, pRow->key.c_str(),
+			(unsigned long long)pRow->cb, (unsigned long long)pRow->count) < 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
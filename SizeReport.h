@@ -0,0 +1,42 @@
+// SizeReport.h : Hash aggregated size tables for bloat analysis
+//
+// Every section contribution is added to a handful of tables keyed by
+// compiland, library, section, kind and template family in a single
+// pass. The tables are sorted only when printed.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct SizeRow
+{
+	std::string key;
+	uint64_t cb;
+	uint64_t count;
+};
+
+////////////////////////////////////////////////////////////
+// Bytes and contribution count per key
+//
+class SizeTable
+{
+	public:
+	void Add(const std::string & key, uint64_t cb);
+	void Sorted(std::vector<const SizeRow *> & rows) const;
+
+	uint64_t Total() const { return m_cbTotal; }
+	size_t Count() const { return m_rows.size(); }
+
+	private:
+	std::unordered_map<std::string, uint32_t> m_index;
+	std::vector<SizeRow> m_rows;
+	uint64_t m_cbTotal = 0;
+};
+
+bool TemplateFamily(const char * szName, std::string & family);
+bool WriteSizeTable(FILE * pFile, const char * szTable, const SizeTable & table);
@@ -0,0 +1,591 @@
+// StackFrames.cpp : Stack frame sizes and worst case stack depth
+//
+
+#include "StackFrames.h"
+
+#include <algorithm>
+#include <iterator>
+#include <string.h>
+#include <unordered_map>
+
+#include "InlineIndex.h"
+#include "Util.h"
+
+#define S_END                       0x0006
+#define S_FRAMEPROC                 0x1012
+#define S_THUNK32                   0x1102
+#define S_BLOCK32                   0x1103
+#define S_BPREL32                   0x110B
+#define S_LPROC32                   0x110F
+#define S_GPROC32                   0x1110
+#define S_REGREL32                  0x1111
+#define S_SEPCODE                   0x1132
+#define S_LOCAL                     0x113E
+#define S_DEFRANGE                  0x113F
+#define S_DEFRANGE_FRAMEPOINTER_REL 0x1142
+#define S_DEFRANGE_FRAMEPOINTER_REL_FULL_SCOPE 0x1144
+#define S_DEFRANGE_REGISTER_REL     0x1145
+#define S_LPROC32_ID                0x1146
+#define S_GPROC32_ID                0x1147
+#define S_INLINESITE                0x114D
+#define S_INLINESITE_END            0x114E
+#define S_PROC_ID_END               0x114F
+#define S_CALLEES                   0x115A
+#define S_INLINESITE2               0x115D
+
+#define FRAMEPROC_HAS_ALLOCA        0x00000001
+#define FRAMEPROC_HAS_EH            0x00000010
+#define FRAMEPROC_HAS_SEH           0x00000040
+#define FRAMEPROC_SECURITY_CHECKS   0x00000100
+
+#define LOCAL_IS_PARAM              0x0001
+
+#define CV_REG_ESP                  21
+#define CV_REG_EBP                  22
+#define CV_AMD64_RBP                334
+#define CV_AMD64_RSP                335
+
+#define CB_FRAMEDATA                32
+
+// What one module contributes, the calls are by caller RVA and callee id
+struct StackFrameIndex::ModuleFrames
+{
+	std::vector<StackFrame> frames;
+	std::vector<StackLocal> locals;
+	std::vector<std::pair<uint32_t, uint32_t> > calls;
+};
+
+////////////////////////////////////////////////////////////
+// Read the frames of every module, one module per thread at a
+//  time, then the FRAMEDATA of the whole image
+//
+bool StackFrameIndex::Build(const PdbFile & pdb, const TpiStream * pTpi, uint32_t cbPointer, unsigned cThreads)
+{
+	Clear();
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	m_cbPointer = cbPointer;
+
+	std::vector<ModuleFrames> modules(pdb.Modules().size());
+
+	ParallelFor(cThreads, modules.size(), [&](unsigned, size_t iModule) {
+		ReadModule(pdb, pTpi, (uint16_t)iModule, modules[iModule]);
+	});
+
+	std::vector<std::pair<uint32_t, uint32_t> > calls;
+
+	for (ModuleFrames & module : modules) {
+		for (StackFrame & frame : module.frames) {
+			frame.iFirstLocal += (uint32_t)m_locals.size();
+			m_frames.push_back(std::move(frame));
+		}
+
+		std::move(module.locals.begin(), module.locals.end(), std::back_inserter(m_locals));
+		calls.insert(calls.end(), module.calls.begin(), module.calls.end());
+		module = ModuleFrames();
+	}
+
+	if (m_frames.empty()) {
+		return false;
+	}
+
+	std::stable_sort(m_frames.begin(), m_frames.end(),
+		[](const StackFrame & a, const StackFrame & b) { return a.rva < b.rva; });
+
+	ResolveCallees(pdb, pTpi, calls);
+
+	ReadFrameData(pdb);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Match the callee ids of the S_CALLEES records to the frames
+//
+//  The procedures of a compiland carry their function id, the
+//  linker rewrites them to S_GPROC32 and S_LPROC32, so an id is
+//  matched by the name and type of its LF_FUNC_ID or LF_MFUNC_ID.
+//  Functions of the same name and type, statics of several
+//  compilands, go to the one in the module of the caller.
+//
+void StackFrameIndex::ResolveCallees(const PdbFile & pdb, const TpiStream * pTpi, const std::vector<std::pair<uint32_t, uint32_t> > & calls)
+{
+	std::unordered_map<uint32_t, std::vector<uint32_t> > candidates;
+	std::unordered_multimap<std::string, uint32_t> names;
+	FuncIdIndex funcIds;
+	std::string name;
+
+	if (!calls.empty()) {
+		funcIds.Load(pdb);
+	}
+
+	for (uint32_t i = 0; i < m_frames.size(); i++) {
+		if (m_frames[i].id != 0) {
+			candidates[m_frames[i].id].push_back(i);
+		}
+
+		names.emplace(m_frames[i].name, i);
+	}
+
+	for (const auto & call : calls) {
+		uint32_t iCaller = FindRva(call.first);
+		auto it = candidates.find(call.second);
+
+		if (iCaller == STACK_FRAME_NONE) {
+			continue;
+		}
+
+		if (it == candidates.end()) {
+			std::vector<uint32_t> frames;
+			uint32_t type;
+
+			if (funcIds.QualifiedName(call.second, pTpi, name, &type)) {
+				auto range = names.equal_range(name);
+
+				for (auto itName = range.first; itName != range.second; ++itName) {
+					if (m_frames[itName->second].type == type) {
+						frames.push_back(itName->second);
+					}
+				}
+
+				// A name with a single procedure needs no type to match
+
+				if (frames.empty() && std::distance(range.first, range.second) == 1) {
+					frames.push_back(range.first->second);
+				}
+			}
+
+			m_cUnresolved += frames.empty() ? 1 : 0;
+			it = candidates.emplace(call.second, std::move(frames)).first;
+		}
+
+		uint32_t iCallee = (it->second.size() == 1) ? it->second[0] : STACK_FRAME_NONE;
+
+		for (size_t i = 0; i < it->second.size() && iCallee == STACK_FRAME_NONE; i++) {
+			if (m_frames[it->second[i]].iModule == m_frames[iCaller].iModule) {
+				iCallee = it->second[i];
+			}
+		}
+
+		if (iCallee != STACK_FRAME_NONE) {
+			m_calls.push_back(std::make_pair(iCaller, iCallee));
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// The procedures of a module with their frame and stack locals
+//
+//  The locals of blocks and inline sites are in the frame of
+//  the procedure they are nested in.
+//
+void StackFrameIndex::ReadModule(const PdbFile & pdb, const TpiStream * pTpi, uint16_t iModule, ModuleFrames & result) const
+{
+	const PdbModule & module = pdb.Modules()[iModule];
+	std::vector<uint8_t> data;
+
+	if (module.iStream == PDB_STREAM_NONE || !pdb.ReadStream(module.iStream, data)) {
+		return;
+	}
+
+	size_t cbSymbols = std::min<size_t>(module.cbSymbols, data.size());
+	StackFrame * pFrame = NULL;
+	StackLocal pending;
+	bool fPending = false;
+	int depth = 0;
+
+	for (size_t off = 4; off + 4 <= cbSymbols; ) {
+		const uint8_t * pRecord = &data[off];
+		uint16_t cbRecord = GetU16(pRecord);
+		uint16_t kind = GetU16(pRecord + 2);
+
+		if (cbRecord < 2 || off + 2 + cbRecord > cbSymbols) {
+			break;
+		}
+
+		const uint8_t * pEnd = pRecord + 2 + cbRecord;
+		size_t offName;
+
+		off += 2 + cbRecord;
+
+		if (kind < S_DEFRANGE || kind > S_DEFRANGE_REGISTER_REL) {
+			fPending = false;
+		}
+
+		switch (kind) {
+			case S_LPROC32:
+			case S_GPROC32:
+			case S_LPROC32_ID:
+			case S_GPROC32_ID:
+				if (depth++ != 0 || cbRecord < 38 || memchr(pRecord + 39, '\0', cbRecord - 37) == NULL) {
+					break;
+				}
+
+				result.frames.push_back(StackFrame());
+				pFrame = &result.frames.back();
+				pFrame->name = (const char *)pRecord + 39;
+				pFrame->cb = GetU32(pRecord + 16);
+				pFrame->id = (kind == S_LPROC32_ID || kind == S_GPROC32_ID) ? GetU32(pRecord + 28) : 0;
+				pFrame->type = (pFrame->id == 0) ? GetU32(pRecord + 28) : 0;
+				pFrame->iModule = iModule;
+				pFrame->flags = 0;
+				pFrame->cbFrame = 0;
+				pFrame->cbSavedRegs = 0;
+				pFrame->cbParams = 0;
+				pFrame->cbMaxStack = 0;
+				pFrame->iFirstLocal = (uint32_t)result.locals.size();
+				pFrame->cLocals = 0;
+				pFrame->cbDepth = 0;
+				pFrame->iDeepest = STACK_FRAME_NONE;
+
+				if (!pdb.SectionToRva(GetU16(pRecord + 36), GetU32(pRecord + 32), &pFrame->rva)) {
+					result.locals.resize(pFrame->iFirstLocal);
+					result.frames.pop_back();
+					pFrame = NULL;
+				}
+
+				break;
+
+			case S_THUNK32:
+			case S_BLOCK32:
+			case S_SEPCODE:
+			case S_INLINESITE:
+			case S_INLINESITE2:
+				depth += (depth != 0) ? 1 : 0;
+				break;
+
+			case S_END:
+			case S_INLINESITE_END:
+			case S_PROC_ID_END:
+				if (depth != 0 && --depth == 0) {
+					pFrame = NULL;
+				}
+
+				break;
+
+			case S_FRAMEPROC:
+				if (pFrame != NULL && cbRecord >= 28) {
+					uint32_t dwFlags = GetU32(pRecord + 26);
+
+					pFrame->cbFrame = GetU32(pRecord + 4);
+					pFrame->cbSavedRegs = GetU32(pRecord + 16);
+					pFrame->flags |= (dwFlags & FRAMEPROC_HAS_ALLOCA) ? STACK_FRAME_ALLOCA : 0;
+					pFrame->flags |= (dwFlags & FRAMEPROC_SECURITY_CHECKS) ? STACK_FRAME_GS : 0;
+					pFrame->flags |= (dwFlags & (FRAMEPROC_HAS_EH | FRAMEPROC_HAS_SEH)) ? STACK_FRAME_EH : 0;
+				}
+
+				break;
+
+			case S_BPREL32:
+			case S_REGREL32:
+				offName = (kind == S_BPREL32) ? 12 : 14;
+
+				if (pFrame != NULL && (size_t)cbRecord + 2 > offName && memchr(pRecord + offName, '\0', pEnd - pRecord - offName) != NULL) {
+					StackLocal local;
+
+					local.name = (const char *)pRecord + offName;
+					local.offset = (int32_t)GetU32(pRecord + 4);
+					local.type = GetU32(pRecord + 8);
+					local.reg = (kind == S_BPREL32) ? STACK_REG_FRAME : GetU16(pRecord + 12);
+					local.cb = (pTpi != NULL) ? pTpi->TypeSize(local.type) : 0;
+
+					// Parameters are above the frame pointer, or above the
+					//  locals from the stack pointer
+
+					if (local.reg == STACK_REG_FRAME || local.reg == CV_REG_EBP || local.reg == CV_AMD64_RBP) {
+						local.fParam = local.offset > 0;
+					}
+
+					else if (local.reg == CV_REG_ESP || local.reg == CV_AMD64_RSP) {
+						local.fParam = local.offset >= 0 && (uint32_t)local.offset >= pFrame->cbFrame;
+					}
+
+					else {
+						local.fParam = false;
+					}
+
+					result.locals.push_back(local);
+					pFrame->cLocals++;
+				}
+
+				break;
+
+			case S_LOCAL:
+				if (pFrame != NULL && cbRecord >= 9 && memchr(pRecord + 10, '\0', cbRecord - 8) != NULL) {
+					pending.name = (const char *)pRecord + 10;
+					pending.type = GetU32(pRecord + 4);
+					pending.fParam = (GetU16(pRecord + 8) & LOCAL_IS_PARAM) != 0;
+					pending.cb = (pTpi != NULL) ? pTpi->TypeSize(pending.type) : 0;
+					fPending = true;
+				}
+
+				break;
+
+			// The first range in memory places an S_LOCAL, the others
+			//  are the same variable
+
+			case S_DEFRANGE_FRAMEPOINTER_REL:
+			case S_DEFRANGE_FRAMEPOINTER_REL_FULL_SCOPE:
+			case S_DEFRANGE_REGISTER_REL:
+				if (fPending && pFrame != NULL && cbRecord >= ((kind == S_DEFRANGE_REGISTER_REL) ? 10 : 6)) {
+					if (kind == S_DEFRANGE_REGISTER_REL) {
+						pending.reg = GetU16(pRecord + 4);
+						pending.offset = (int32_t)GetU32(pRecord + 8);
+					}
+
+					else {
+						pending.reg = STACK_REG_FRAME;
+						pending.offset = (int32_t)GetU32(pRecord + 4);
+					}
+
+					result.locals.push_back(pending);
+					pFrame->cLocals++;
+					fPending = false;
+				}
+
+				break;
+
+			case S_CALLEES:
+				if (pFrame != NULL && cbRecord >= 6) {
+					uint32_t cCallees = GetU32(pRecord + 4);
+
+					for (uint32_t i = 0; i < cCallees && pRecord + 12 + i * 4 <= pEnd; i++) {
+						result.calls.push_back(std::make_pair(pFrame->rva, GetU32(pRecord + 8 + i * 4)));
+					}
+				}
+
+				break;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// The x86 frame data of the function starts, for the bytes
+//  of parameters the caller pushes
+//
+void StackFrameIndex::ReadFrameData(const PdbFile & pdb)
+{
+	std::vector<uint8_t> data;
+	uint16_t iStream = pdb.DebugStream(PDB_DBG_STREAM_NEW_FPO);
+
+	if (iStream == PDB_STREAM_NONE || !pdb.ReadStream(iStream, data)) {
+		return;
+	}
+
+	for (size_t off = 0; off + CB_FRAMEDATA <= data.size(); off += CB_FRAMEDATA) {
+		const uint8_t * pb = &data[off];
+		uint32_t iFrame = FindRva(GetU32(pb));
+
+		if (iFrame == STACK_FRAME_NONE || m_frames[iFrame].rva != GetU32(pb)) {
+			continue;
+		}
+
+		StackFrame & frame = m_frames[iFrame];
+
+		frame.cbParams = GetU32(pb + 12);
+		frame.cbMaxStack = GetU32(pb + 16);
+
+		if (frame.cbFrame == 0) {
+			frame.cbFrame = GetU32(pb + 8);
+			frame.cbSavedRegs = GetU16(pb + 26);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Add the direct calls, E8 rel32, to the start of a function
+//
+//  The code is not disassembled, so an E8 inside another
+//  instruction can add a call, only the ones landing exactly
+//  on a function start are kept.
+//
+uint32_t StackFrameIndex::AddImageCalls(const PeImage & image, unsigned cThreads)
+{
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	std::vector<std::vector<std::pair<uint32_t, uint32_t> > > threadCalls(cThreads);
+
+	ParallelFor(cThreads, m_frames.size(), [&](unsigned iThread, size_t iFrame) {
+		const StackFrame & frame = m_frames[iFrame];
+		const uint8_t * pb = (frame.cb >= 5) ? image.Ptr(frame.rva, frame.cb) : NULL;
+
+		if (pb == NULL) {
+			return;
+		}
+
+		for (uint32_t off = 0; off + 5 <= frame.cb; off++) {
+			if (pb[off] != 0xE8) {
+				continue;
+			}
+
+			uint32_t rvaTarget = frame.rva + off + 5 + GetU32(pb + off + 1);
+			uint32_t iTarget = FindRva(rvaTarget);
+
+			if (iTarget != STACK_FRAME_NONE && m_frames[iTarget].rva == rvaTarget) {
+				threadCalls[iThread].push_back(std::make_pair((uint32_t)iFrame, iTarget));
+			}
+		}
+	});
+
+	uint32_t cCalls = 0;
+
+	for (const auto & calls : threadCalls) {
+		m_calls.insert(m_calls.end(), calls.begin(), calls.end());
+		cCalls += (uint32_t)calls.size();
+	}
+
+	return cCalls;
+}
+
+////////////////////////////////////////////////////////////
+// The worst case depth of every function, deepest callee first
+//
+//  A depth first walk of the call graph, a callee still on the
+//  walk is a recursion and is left out of the depth.
+//
+void StackFrameIndex::ComputeDepths()
+{
+	std::sort(m_calls.begin(), m_calls.end());
+	m_calls.erase(std::unique(m_calls.begin(), m_calls.end()), m_calls.end());
+
+	m_calleeStart.assign(m_frames.size() + 1, 0);
+	m_callees.clear();
+
+	for (const auto & call : m_calls) {
+		m_calleeStart[call.first + 1]++;
+		m_callees.push_back(call.second);
+	}
+
+	for (size_t i = 0; i < m_frames.size(); i++) {
+		m_calleeStart[i + 1] += m_calleeStart[i];
+	}
+
+	std::vector<uint8_t> states(m_frames.size(), 0);
+	std::vector<std::pair<uint32_t, uint32_t> > walk;
+
+	for (uint32_t iRoot = 0; iRoot < m_frames.size(); iRoot++) {
+		if (states[iRoot] != 0) {
+			continue;
+		}
+
+		states[iRoot] = 1;
+		walk.push_back(std::make_pair(iRoot, m_calleeStart[iRoot]));
+
+		while (!walk.empty()) {
+			uint32_t iFrame = walk.back().first;
+			uint32_t iCall = walk.back().second;
+
+			if (iCall < m_calleeStart[iFrame + 1]) {
+				uint32_t iCallee = m_callees[iCall];
+
+				walk.back().second++;
+
+				if (states[iCallee] == 0) {
+					states[iCallee] = 1;
+					walk.push_back(std::make_pair(iCallee, m_calleeStart[iCallee]));
+				}
+
+				else if (states[iCallee] == 1) {
+					m_frames[iFrame].flags |= STACK_FRAME_RECURSIVE;
+					m_frames[iCallee].flags |= STACK_FRAME_RECURSIVE;
+				}
+
+				continue;
+			}
+
+			// All the callees are done, except the ones of a recursion
+
+			StackFrame & frame = m_frames[iFrame];
+			uint64_t cbDeepest = 0;
+
+			frame.iDeepest = STACK_FRAME_NONE;
+
+			for (uint32_t i = m_calleeStart[iFrame]; i < m_calleeStart[iFrame + 1]; i++) {
+				uint32_t iCallee = m_callees[i];
+
+				if (states[iCallee] == 2 && iCallee != iFrame && m_frames[iCallee].cbDepth > cbDeepest) {
+					cbDeepest = m_frames[iCallee].cbDepth;
+					frame.iDeepest = iCallee;
+				}
+			}
+
+			frame.cbDepth = FrameBytes(frame) + cbDeepest;
+			states[iFrame] = 2;
+			walk.pop_back();
+		}
+	}
+}
+
+void StackFrameIndex::Clear()
+{
+	m_cbPointer = 4;
+	m_cUnresolved = 0;
+	std::vector<StackFrame>().swap(m_frames);
+	std::vector<StackLocal>().swap(m_locals);
+	std::vector<std::pair<uint32_t, uint32_t> >().swap(m_calls);
+	std::vector<uint32_t>().swap(m_calleeStart);
+	std::vector<uint32_t>().swap(m_callees);
+}
+
+const uint32_t * StackFrameIndex::Callees(uint32_t iFrame, uint32_t * pcCallees) const
+{
+	if (iFrame + 1 >= m_calleeStart.size()) {
+		*pcCallees = 0;
+
+		return NULL;
+	}
+
+	*pcCallees = m_calleeStart[iFrame + 1] - m_calleeStart[iFrame];
+
+	return m_callees.data() + m_calleeStart[iFrame];
+}
+
+////////////////////////////////////////////////////////////
+// The function holding an RVA
+//
+uint32_t StackFrameIndex::FindRva(uint32_t rva) const
+{
+	auto it = std::upper_bound(m_frames.begin(), m_frames.end(), rva,
+		[](uint32_t rva, const StackFrame & frame) { return rva < frame.rva; });
+
+	if (it == m_frames.begin()) {
+		return STACK_FRAME_NONE;
+	}
+
+	// Folded functions share an RVA, take the first
+
+	uint32_t iFrame = (uint32_t)(it - m_frames.begin() - 1);
+
+	while (iFrame > 0 && m_frames[iFrame - 1].rva == m_frames[iFrame].rva) {
+		iFrame--;
+	}
+
+	if (rva != m_frames[iFrame].rva && rva - m_frames[iFrame].rva >= m_frames[iFrame].cb) {
+		return STACK_FRAME_NONE;
+	}
+
+	return iFrame;
+}
+
+uint32_t StackFrameIndex::Find(const char * szName) const
+{
+	for (uint32_t i = 0; i < m_frames.size(); i++) {
+		if (m_frames[i].name == szName) {
+			return i;
+		}
+	}
+
+	return STACK_FRAME_NONE;
+}
+
+uint64_t StackFrameIndex::FrameBytes(const StackFrame & frame) const
+{
+	uint64_t cb = (uint64_t)frame.cbFrame + frame.cbSavedRegs + m_cbPointer;
+
+	return (m_cbPointer == 4) ? cb + frame.cbParams : cb;
+}
@@ -0,0 +1,100 @@
+// StackFrames.h : Stack frame sizes and worst case stack depth
+//
+// Reads the S_FRAMEPROC record and the stack locals of every procedure
+// in the module symbol streams, the modules in parallel, and the x86
+// FRAMEDATA records for the parameter bytes. Every frame local is
+// sized from the TPI stream, so the bytes of a frame can be put on the
+// large arrays and structures passed or kept by value. The calls come
+// from the S_CALLEES records, whose function ids are matched to the
+// procedures by the name and type of their IPI record, and with the
+// image, from the direct calls in the code; the deepest chain of frames
+// over them is the worst case stack use of a function. Recursion is
+// reported and not followed.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "PdbFile.h"
+#include "PeImage.h"
+#include "TpiStream.h"
+
+#define STACK_FRAME_NONE            0xFFFFFFFF
+
+#define STACK_FRAME_ALLOCA          0x0001
+#define STACK_FRAME_GS              0x0002   // /GS security cookie checks
+#define STACK_FRAME_EH              0x0004
+#define STACK_FRAME_RECURSIVE       0x0008   // calls back into one of its callers
+
+#define STACK_REG_FRAME             0        // base register of a frame pointer relative local
+
+struct StackLocal
+{
+	std::string name;
+	int32_t offset;
+	uint16_t reg;                        // CV register, STACK_REG_FRAME for the frame pointer
+	uint32_t type;
+	uint64_t cb;                         // 0 when the type is unknown
+	bool fParam;
+};
+
+struct StackFrame
+{
+	std::string name;
+	uint32_t rva;
+	uint32_t cb;
+	uint32_t id;                         // LF_FUNC_ID or LF_MFUNC_ID of an S_*PROC32_ID, 0 when none
+	uint32_t type;                       // procedure type of the others, 0 when none
+	uint16_t iModule;
+	uint16_t flags;
+	uint32_t cbFrame;                    // locals and temporaries
+	uint32_t cbSavedRegs;
+	uint32_t cbParams;                   // from FRAMEDATA, x86 only
+	uint32_t cbMaxStack;                 // from FRAMEDATA, x86 only
+	uint32_t iFirstLocal;
+	uint32_t cLocals;
+	uint64_t cbDepth;                    // worst case from the call of this function
+	uint32_t iDeepest;                   // callee on the worst case chain, STACK_FRAME_NONE when none
+};
+
+////////////////////////////////////////////////////////////
+// The frames of all the procedures of a PDB, by RVA
+//
+//  A frame costs its locals, its saved registers and the return
+//  address, and on x86 the parameters its caller pushes.
+//
+class StackFrameIndex
+{
+	public:
+	bool Build(const PdbFile & pdb, const TpiStream * pTpi, uint32_t cbPointer, unsigned cThreads);
+	uint32_t AddImageCalls(const PeImage & image, unsigned cThreads);
+	void ComputeDepths();
+	void Clear();
+
+	const std::vector<StackFrame> & Frames() const { return m_frames; }
+	const StackLocal * Locals(const StackFrame & frame) const { return m_locals.data() + frame.iFirstLocal; }
+	const uint32_t * Callees(uint32_t iFrame, uint32_t * pcCallees) const;
+	uint32_t CountCalls() const { return (uint32_t)m_calls.size(); }
+	uint32_t CountUnresolved() const { return m_cUnresolved; }
+	uint32_t FindRva(uint32_t rva) const;
+	uint32_t Find(const char * szName) const;
+	uint64_t FrameBytes(const StackFrame & frame) const;
+
+	private:
+	struct ModuleFrames;
+
+	void ReadModule(const PdbFile & pdb, const TpiStream * pTpi, uint16_t iModule, ModuleFrames & result) const;
+	void ReadFrameData(const PdbFile & pdb);
+	void ResolveCallees(const PdbFile & pdb, const TpiStream * pTpi, const std::vector<std::pair<uint32_t, uint32_t> > & calls);
+
+	uint32_t m_cbPointer = 4;
+	uint32_t m_cUnresolved = 0;                               // callee ids matching no procedure
+	std::vector<StackFrame> m_frames;
+	std::vector<StackLocal> m_locals;
+	std::vector<std::pair<uint32_t, uint32_t> > m_calls;     // caller, callee
+	std::vector<uint32_t> m_calleeStart;                      // per frame, and one past the last
+	std::vector<uint32_t> m_callees;
+};
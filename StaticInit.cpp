@@ -0,0 +1,482 @@
+// StaticInit.cpp : Inventory of the dynamic initializers of an image
+//
+
+#include "StaticInit.h"
+
+#include <algorithm>
+#include <map>
+#include <string.h>
+#include <unordered_map>
+
+#include "Util.h"
+
+#define S_LDATA32                   0x110C
+#define S_GDATA32                   0x110D
+#define S_PUB32                     0x110E
+#define S_LPROC32                   0x110F
+#define S_GPROC32                   0x1110
+#define S_PROCREF                   0x1125
+#define S_LPROCREF                  0x1127
+#define S_COFFGROUP                 0x1137
+
+#define STATIC_INIT_LINKER_MODULE   "* Linker *"
+
+////////////////////////////////////////////////////////////
+// Recognize an initializer or atexit destructor by name, either
+//  decorated, "??__Eg_foo@ns@@YAXXZ", or as the compiler names the
+//  function, "`dynamic initializer for 'ns::g_foo''", and get the
+//  variable it is for
+//
+bool ParseStaticInitName(const char * szName, uint8_t * pKind, std::string & global)
+{
+	static const char szInitializer[] = "`dynamic initializer for '";
+	static const char szDestructor[] = "`dynamic atexit destructor for '";
+
+	global.clear();
+
+	if (!strncmp(szName, "??__E", 5) || !strncmp(szName, "??__F", 5)) {
+		const char * pch = szName + 5;
+		const char * pchEnd = strstr(pch, "@@");
+		std::vector<std::string> scopes;
+
+		*pKind = (szName[4] == 'E') ? STATIC_INIT_INITIALIZER : STATIC_INIT_DESTRUCTOR;
+
+		if (pchEnd == NULL) {
+			global = pch;
+
+			return true;
+		}
+
+		// Special names keep their decoration
+
+		if (*pch == '?') {
+			global.assign(pch, pchEnd);
+
+			return true;
+		}
+
+		while (pch < pchEnd) {
+			const char * pchScope = (const char *)memchr(pch, '@', pchEnd - pch);
+
+			if (pchScope == NULL) {
+				pchScope = pchEnd;
+			}
+
+			scopes.push_back(std::string(pch, pchScope));
+			pch = pchScope + 1;
+		}
+
+		for (size_t i = scopes.size(); i > 0; i--) {
+			global += scopes[i - 1];
+			global += (i > 1) ? "::" : "";
+		}
+
+		return true;
+	}
+
+	const char * pchGlobal = NULL;
+
+	if (!strncmp(szName, szInitializer, sizeof(szInitializer) - 1)) {
+		*pKind = STATIC_INIT_INITIALIZER;
+		pchGlobal = szName + sizeof(szInitializer) - 1;
+	}
+
+	else if (!strncmp(szName, szDestructor, sizeof(szDestructor) - 1)) {
+		*pKind = STATIC_INIT_DESTRUCTOR;
+		pchGlobal = szName + sizeof(szDestructor) - 1;
+	}
+
+	else {
+		return false;
+	}
+
+	global = pchGlobal;
+
+	if (global.size() >= 2 && global.compare(global.size() - 2, 2, "''") == 0) {
+		global.resize(global.size() - 2);
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Recognize the pointer the compiler puts in .CRT$XCU for the
+//  initializer of a variable, "?g_foo$initializer$@ns@@3P6AXXZEA"
+//  or "ns::g_foo$initializer$", and get the variable
+//
+bool ParseInitializerPointerName(const char * szName, std::string & global)
+{
+	static const char szMarker[] = "$initializer$";
+
+	const char * pchMarker = strstr(szName, szMarker);
+
+	if (pchMarker == NULL) {
+		return false;
+	}
+
+	if (*szName != '?') {
+		global.assign(szName, pchMarker);
+
+		return true;
+	}
+
+	// The scopes follow the marker the way they follow the name of
+	//  a ??__E initializer
+
+	std::string initializer("??__E");
+	uint8_t kind;
+
+	initializer.append(szName + 1, pchMarker);
+	initializer += pchMarker + sizeof(szMarker) - 1;
+
+	return ParseStaticInitName(initializer.c_str(), &kind, global);
+}
+
+////////////////////////////////////////////////////////////
+// Find the initializers, their compilands and the init tables, and
+//  put the initializers in init order
+//
+bool StaticInitInventory::Build(const PdbFile & pdb, const PeImage * pImage)
+{
+	std::vector<uint8_t> records;
+	std::map<uint16_t, std::vector<uint32_t> > procRefs;
+	std::vector<std::pair<uint32_t, std::string> > pointers;
+
+	Clear();
+
+	if (pdb.SymRecordStream() == PDB_STREAM_NONE || !pdb.ReadStream(pdb.SymRecordStream(), records)) {
+		return false;
+	}
+
+	for (const PdbSectionContrib & contrib : pdb.SectionContribs()) {
+		Contribution entry = {0, contrib.cb, contrib.iModule};
+
+		if (pdb.SectionToRva(contrib.iSection, contrib.off, &entry.rva)) {
+			m_contribs.push_back(entry);
+		}
+	}
+
+	std::sort(m_contribs.begin(), m_contribs.end(),
+		[](const Contribution & a, const Contribution & b) { return a.rva < b.rva; });
+
+	// One pass over the publics and the procedure references, the
+	//  procedures themselves are read from their module afterwards
+
+	for (size_t off = 0; off + 4 <= records.size(); ) {
+		const uint8_t * pRecord = &records[off];
+		uint16_t cbRecord = GetU16(pRecord);
+		uint16_t kind = GetU16(pRecord + 2);
+		StaticInitializer initializer;
+
+		if (cbRecord < 2 || off + 2 + cbRecord > records.size()) {
+			break;
+		}
+
+		if (cbRecord >= 13 && memchr(pRecord + 14, '\0', cbRecord - 12) != NULL) {
+			const char * szName = (const char *)pRecord + 14;
+
+			if (kind == S_PUB32 && ParseStaticInitName(szName, &initializer.kind, initializer.global) &&
+				pdb.SectionToRva(GetU16(pRecord + 12), GetU32(pRecord + 8), &initializer.rva)) {
+				initializer.cb = 0;
+				initializer.name = szName;
+				m_initializers.push_back(initializer);
+			}
+
+			else if ((kind == S_PROCREF || kind == S_LPROCREF) && GetU16(pRecord + 12) != 0 &&
+				ParseStaticInitName(szName, &initializer.kind, initializer.global)) {
+				procRefs[GetU16(pRecord + 12) - 1].push_back(GetU32(pRecord + 8));
+			}
+
+			else if ((kind == S_PUB32 || kind == S_GDATA32 || kind == S_LDATA32) &&
+				ParseInitializerPointerName(szName, initializer.global) &&
+				pdb.SectionToRva(GetU16(pRecord + 12), GetU32(pRecord + 8), &initializer.rva)) {
+				pointers.push_back(std::make_pair(initializer.rva, initializer.global));
+			}
+		}
+
+		off += 2 + cbRecord;
+	}
+
+	for (const auto & module : procRefs) {
+		ReadProcedures(pdb, module.first, module.second);
+	}
+
+	// A function found both ways keeps the procedure, which has a
+	//  size and the compiler's name
+
+	std::stable_sort(m_initializers.begin(), m_initializers.end(),
+		[](const StaticInitializer & a, const StaticInitializer & b) { return a.rva < b.rva || (a.rva == b.rva && a.cb > b.cb); });
+	m_initializers.erase(std::unique(m_initializers.begin(), m_initializers.end(),
+		[](const StaticInitializer & a, const StaticInitializer & b) { return a.rva == b.rva; }), m_initializers.end());
+
+	for (StaticInitializer & initializer : m_initializers) {
+		auto it = std::upper_bound(m_contribs.begin(), m_contribs.end(), initializer.rva,
+			[](uint32_t rva, const Contribution & contrib) { return rva < contrib.rva; });
+
+		initializer.iModule = STATIC_INIT_NO_MODULE;
+		initializer.iEntry = STATIC_INIT_NONE;
+		initializer.offSlot = 0;
+		initializer.cSamples = 0;
+
+		if (it != m_contribs.begin() && initializer.rva - (it - 1)->rva < (it - 1)->cb) {
+			initializer.iModule = (it - 1)->iModule;
+
+			// A public alone has the size of its COMDAT
+
+			if (initializer.cb == 0 && (it - 1)->rva == initializer.rva) {
+				initializer.cb = (it - 1)->cb;
+			}
+		}
+	}
+
+	ReadInitGroups(pdb);
+
+	// Place the initializers at the table entry calling them
+
+	if (pImage != NULL && pImage->IsLoaded()) {
+		uint32_t cbPointer = pImage->Is64() ? 8 : 4;
+
+		for (uint32_t iEntry = 0; iEntry < m_entries.size(); iEntry++) {
+			const StaticInitEntry & entry = m_entries[iEntry];
+
+			for (uint32_t offSlot = 0; offSlot + cbPointer <= entry.cb; offSlot += cbPointer) {
+				uint64_t qwTarget = 0;
+
+				if (!pImage->Read(entry.rva + offSlot, &qwTarget, cbPointer) || qwTarget < pImage->ImageBase()) {
+					continue;
+				}
+
+				uint32_t rvaTarget = (uint32_t)(qwTarget - pImage->ImageBase());
+				auto it = std::lower_bound(m_initializers.begin(), m_initializers.end(), rvaTarget,
+					[](const StaticInitializer & initializer, uint32_t rva) { return initializer.rva < rva; });
+
+				if (it != m_initializers.end() && it->rva == rvaTarget && it->iEntry == STATIC_INIT_NONE) {
+					it->iEntry = iEntry;
+					it->offSlot = offSlot;
+				}
+			}
+		}
+	}
+
+	else {
+		std::unordered_map<std::string, StaticInitializer *> byGlobal;
+		std::unordered_map<uint16_t, uint32_t> firstEntries;
+
+		for (StaticInitializer & initializer : m_initializers) {
+			if (initializer.kind == STATIC_INIT_INITIALIZER) {
+				byGlobal.emplace(initializer.global, &initializer);
+			}
+		}
+
+		for (const auto & pointer : pointers) {
+			auto it = byGlobal.find(pointer.second);
+			uint32_t iEntry = FindEntry(pointer.first);
+
+			if (it != byGlobal.end() && iEntry != STATIC_INIT_NONE && it->second->iEntry == STATIC_INIT_NONE) {
+				it->second->iEntry = iEntry;
+				it->second->offSlot = pointer.first - m_entries[iEntry].rva;
+			}
+		}
+
+		for (uint32_t iEntry = 0; iEntry < m_entries.size(); iEntry++) {
+			firstEntries.emplace(m_entries[iEntry].iModule, iEntry);
+		}
+
+		for (StaticInitializer & initializer : m_initializers) {
+			auto it = firstEntries.find(initializer.iModule);
+
+			if (initializer.kind == STATIC_INIT_INITIALIZER && initializer.iEntry == STATIC_INIT_NONE && it != firstEntries.end()) {
+				initializer.iEntry = it->second;
+			}
+		}
+	}
+
+	// A destructor is registered by the initializer of its variable
+
+	std::unordered_map<std::string, std::pair<uint32_t, uint32_t> > globalSlots;
+
+	for (const StaticInitializer & initializer : m_initializers) {
+		if (initializer.kind == STATIC_INIT_INITIALIZER && initializer.iEntry != STATIC_INIT_NONE) {
+			globalSlots.emplace(initializer.global, std::make_pair(initializer.iEntry, initializer.offSlot));
+		}
+	}
+
+	for (StaticInitializer & initializer : m_initializers) {
+		auto it = globalSlots.find(initializer.global);
+
+		if (initializer.kind == STATIC_INIT_DESTRUCTOR && it != globalSlots.end()) {
+			initializer.iEntry = it->second.first;
+			initializer.offSlot = it->second.second;
+		}
+	}
+
+	// The CRT calls the pointers of an entry in order
+
+	std::stable_sort(m_initializers.begin(), m_initializers.end(),
+		[](const StaticInitializer & a, const StaticInitializer & b) {
+			if (a.iEntry != b.iEntry || a.offSlot != b.offSlot) {
+				return a.iEntry < b.iEntry || (a.iEntry == b.iEntry && a.offSlot < b.offSlot);
+			}
+
+			return a.kind < b.kind || (a.kind == b.kind && a.rva < b.rva);
+		});
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Read the procedures a module's references point to
+//
+void StaticInitInventory::ReadProcedures(const PdbFile & pdb, uint16_t iModule, const std::vector<uint32_t> & offsets)
+{
+	std::vector<uint8_t> data;
+
+	if (iModule >= pdb.Modules().size()) {
+		return;
+	}
+
+	const PdbModule & module = pdb.Modules()[iModule];
+
+	if (module.iStream == PDB_STREAM_NONE || !pdb.ReadStream(module.iStream, data)) {
+		return;
+	}
+
+	size_t cbSymbols = std::min<size_t>(module.cbSymbols, data.size());
+
+	for (uint32_t off : offsets) {
+		if ((size_t)off + 39 > cbSymbols) {
+			continue;
+		}
+
+		const uint8_t * pRecord = &data[off];
+		uint16_t cbRecord = GetU16(pRecord);
+		uint16_t kind = GetU16(pRecord + 2);
+		StaticInitializer initializer;
+
+		if ((kind != S_GPROC32 && kind != S_LPROC32) || cbRecord < 38 || off + 2 + (size_t)cbRecord > cbSymbols ||
+			memchr(pRecord + 39, '\0', cbRecord - 37) == NULL ||
+			!ParseStaticInitName((const char *)pRecord + 39, &initializer.kind, initializer.global) ||
+			!pdb.SectionToRva(GetU16(pRecord + 36), GetU32(pRecord + 32), &initializer.rva)) {
+			continue;
+		}
+
+		initializer.cb = GetU32(pRecord + 16);
+		initializer.name = (const char *)pRecord + 39;
+		m_initializers.push_back(initializer);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// The contributions to the .CRT$XI* and .CRT$XC* groups, which
+//  the linker module lists as COFF groups, in RVA order
+//
+void StaticInitInventory::ReadInitGroups(const PdbFile & pdb)
+{
+	std::vector<uint8_t> data;
+	std::vector<StaticInitEntry> groups;
+
+	for (const PdbModule & module : pdb.Modules()) {
+		if (module.name != STATIC_INIT_LINKER_MODULE || module.iStream == PDB_STREAM_NONE || !pdb.ReadStream(module.iStream, data)) {
+			continue;
+		}
+
+		size_t cbSymbols = std::min<size_t>(module.cbSymbols, data.size());
+
+		for (size_t off = 4; off + 4 <= cbSymbols; ) {
+			const uint8_t * pRecord = &data[off];
+			uint16_t cbRecord = GetU16(pRecord);
+			StaticInitEntry group;
+
+			if (cbRecord < 2 || off + 2 + cbRecord > cbSymbols) {
+				break;
+			}
+
+			if (GetU16(pRecord + 2) == S_COFFGROUP && cbRecord >= 17 && memchr(pRecord + 18, '\0', cbRecord - 16) != NULL &&
+				(!strncmp((const char *)pRecord + 18, ".CRT$XI", 7) || !strncmp((const char *)pRecord + 18, ".CRT$XC", 7)) &&
+				pdb.SectionToRva(GetU16(pRecord + 16), GetU32(pRecord + 12), &group.rva)) {
+				group.cb = GetU32(pRecord + 4);
+				group.iModule = STATIC_INIT_NO_MODULE;
+				group.group = (const char *)pRecord + 18;
+				groups.push_back(group);
+			}
+
+			off += 2 + cbRecord;
+		}
+
+		break;
+	}
+
+	std::sort(groups.begin(), groups.end(),
+		[](const StaticInitEntry & a, const StaticInitEntry & b) { return a.rva < b.rva; });
+
+	for (const StaticInitEntry & group : groups) {
+		auto it = std::lower_bound(m_contribs.begin(), m_contribs.end(), group.rva,
+			[](const Contribution & contrib, uint32_t rva) { return contrib.rva < rva; });
+
+		for (; it != m_contribs.end() && it->rva < group.rva + group.cb; ++it) {
+			StaticInitEntry entry = {it->rva, it->cb, it->iModule, group.group};
+
+			m_entries.push_back(entry);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Add the self samples that land in each initializer
+//
+void StaticInitInventory::Weight(const ProfileSamples & samples)
+{
+	std::vector<std::pair<uint32_t, uint32_t> > byRva;
+
+	for (uint32_t i = 0; i < m_initializers.size(); i++) {
+		m_initializers[i].cSamples = 0;
+		byRva.push_back(std::make_pair(m_initializers[i].rva, i));
+	}
+
+	std::sort(byRva.begin(), byRva.end());
+
+	for (const ProfileSample & sample : samples.Leaves()) {
+		auto it = std::upper_bound(byRva.begin(), byRva.end(), std::make_pair(sample.rva, STATIC_INIT_NONE));
+
+		if (sample.rva == PROFILE_NO_RVA || it == byRva.begin()) {
+			continue;
+		}
+
+		StaticInitializer & initializer = m_initializers[(it - 1)->second];
+
+		if (sample.rva - initializer.rva < initializer.cb) {
+			initializer.cSamples += sample.count;
+		}
+	}
+}
+
+void StaticInitInventory::Clear()
+{
+	std::vector<Contribution>().swap(m_contribs);
+	std::vector<StaticInitializer>().swap(m_initializers);
+	std::vector<StaticInitEntry>().swap(m_entries);
+}
+
+uint16_t StaticInitInventory::FindModule(uint32_t rva) const
+{
+	auto it = std::upper_bound(m_contribs.begin(), m_contribs.end(), rva,
+		[](uint32_t rva, const Contribution & contrib) { return rva < contrib.rva; });
+
+	if (it == m_contribs.begin() || rva - (it - 1)->rva >= (it - 1)->cb) {
+		return STATIC_INIT_NO_MODULE;
+	}
+
+	return (it - 1)->iModule;
+}
+
+uint32_t StaticInitInventory::FindEntry(uint32_t rva) const
+{
+	auto it = std::upper_bound(m_entries.begin(), m_entries.end(), rva,
+		[](uint32_t rva, const StaticInitEntry & entry) { return rva < entry.rva; });
+
+	if (it == m_entries.begin() || rva - (it - 1)->rva >= (it - 1)->cb) {
+		return STATIC_INIT_NONE;
+	}
+
+	return (uint32_t)(it - 1 - m_entries.begin());
+}
@@ -0,0 +1,92 @@
+// StaticInit.h : Inventory of the dynamic initializers of an image
+//
+// Finds the functions the CRT runs before main: the dynamic
+// initializers of globals (??__E) and the atexit destructors they
+// register (??__F), in one pass over the global symbol records, and
+// the .CRT$XI and .CRT$XC table entries that call them, from the COFF
+// groups of the linker module and the section contributions. The
+// contributions are sorted by RVA once, so every initializer finds its
+// compiland with a binary search. The tables are in the order the CRT
+// walks them, and the pointers of an entry in their own order, which
+// gives the init order; a startup sample profile can be added to see
+// which initializers cost time.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "PdbFile.h"
+#include "PeImage.h"
+#include "Profile.h"
+
+#define STATIC_INIT_NONE            0xFFFFFFFF
+#define STATIC_INIT_NO_MODULE       0xFFFF
+
+#define STATIC_INIT_INITIALIZER     0
+#define STATIC_INIT_DESTRUCTOR      1
+
+struct StaticInitializer
+{
+	uint32_t rva;
+	uint32_t cb;
+	uint8_t kind;
+	uint16_t iModule;                    // STATIC_INIT_NO_MODULE when no contribution holds it
+	uint32_t iEntry;                     // first table entry calling it, STATIC_INIT_NONE when unknown
+	uint32_t offSlot;                    // of the pointer to it in the entry, 0 when unknown
+	uint64_t cSamples;
+	std::string name;
+	std::string global;                  // the variable it constructs or destroys
+};
+
+// A contribution to a .CRT$XI* or .CRT$XC* group, an array of
+//  function pointers
+struct StaticInitEntry
+{
+	uint32_t rva;
+	uint32_t cb;
+	uint16_t iModule;
+	std::string group;
+};
+
+////////////////////////////////////////////////////////////
+// The initializers and init tables of a PDB, in init order
+//
+//  With the image, the function pointers of the tables are read
+//  to place every initializer at its pointer. Without it, the
+//  pointer is found by its "g_foo$initializer$" symbol, and the
+//  initializers without one are placed at the first entry of
+//  their compiland.
+//
+class StaticInitInventory
+{
+	public:
+	bool Build(const PdbFile & pdb, const PeImage * pImage);
+	void Weight(const ProfileSamples & samples);
+	void Clear();
+
+	const std::vector<StaticInitializer> & Initializers() const { return m_initializers; }
+	const std::vector<StaticInitEntry> & Entries() const { return m_entries; }
+	uint16_t FindModule(uint32_t rva) const;
+
+	private:
+	void ReadProcedures(const PdbFile & pdb, uint16_t iModule, const std::vector<uint32_t> & offsets);
+	void ReadInitGroups(const PdbFile & pdb);
+	uint32_t FindEntry(uint32_t rva) const;
+
+	struct Contribution
+	{
+		uint32_t rva;
+		uint32_t cb;
+		uint16_t iModule;
+	};
+
+	std::vector<Contribution> m_contribs;          // by rva
+	std::vector<StaticInitializer> m_initializers;
+	std::vector<StaticInitEntry> m_entries;
+};
+
+bool ParseStaticInitName(const char * szName, uint8_t * pKind, std::string & global);
+bool ParseInitializerPointerName(const char * szName, std::string & global);
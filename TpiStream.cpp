@@ -0,0 +1,761 @@
+// TpiStream.cpp : Native decoder for the TPI and IPI type streams
+//
+
+#include "TpiStream.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Util.h"
+
+#define LF_NUMERIC                  0x8000
+#define LF_CHAR                     0x8000
+#define LF_SHORT                    0x8001
+#define LF_USHORT                   0x8002
+#define LF_LONG                     0x8003
+#define LF_ULONG                    0x8004
+#define LF_QUADWORD                 0x8009
+#define LF_UQUADWORD                0x800A
+#define LF_PAD0                     0xF0
+
+#define CB_TPI_HEADER               56
+
+#define TPI_MAX_NAME_DEPTH          32
+
+static const char * ReadName(const uint8_t *& pb, const uint8_t * pEnd)
+{
+	const uint8_t * pNul = (pb < pEnd) ? (const uint8_t *)memchr(pb, '\0', pEnd - pb) : NULL;
+
+	if (pNul == NULL) {
+		pb = pEnd;
+
+		return "";
+	}
+
+	const char * szName = (const char *)pb;
+
+	pb = pNul + 1;
+
+	return szName;
+}
+
+bool IsUdtLeaf(uint16_t leaf)
+{
+	return leaf == LF_CLASS || leaf == LF_STRUCTURE || leaf == LF_UNION || leaf == LF_INTERFACE || leaf == LF_ENUM;
+}
+
+////////////////////////////////////////////////////////////
+// Read a numeric leaf, either a value below LF_NUMERIC or a
+//  LF_NUMERIC kind followed by the value
+//
+bool ReadTpiNumeric(const uint8_t *& pb, const uint8_t * pEnd, int64_t & value)
+{
+	if (pEnd - pb < 2) {
+		return false;
+	}
+
+	uint16_t leaf = GetU16(pb);
+	size_t cb;
+
+	pb += 2;
+
+	if (leaf < LF_NUMERIC) {
+		value = leaf;
+
+		return true;
+	}
+
+	switch (leaf) {
+		case LF_CHAR:       cb = 1; break;
+		case LF_SHORT:
+		case LF_USHORT:     cb = 2; break;
+		case LF_LONG:
+		case LF_ULONG:      cb = 4; break;
+		case LF_QUADWORD:
+		case LF_UQUADWORD:  cb = 8; break;
+		default:            return false;
+	}
+
+	if ((size_t)(pEnd - pb) < cb) {
+		return false;
+	}
+
+	switch (leaf) {
+		case LF_CHAR:       value = (int8_t)pb[0]; break;
+		case LF_SHORT:      value = (int16_t)GetU16(pb); break;
+		case LF_USHORT:     value = GetU16(pb); break;
+		case LF_LONG:       value = (int32_t)GetU32(pb); break;
+		case LF_ULONG:      value = GetU32(pb); break;
+		default:            value = (int64_t)GetU64(pb); break;
+	}
+
+	pb += cb;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Read a type stream and index its records
+//
+//  The IPI stream has the same layout and can be loaded the same
+//  way, for its id records.
+//
+bool TpiStream::Load(const PdbFile & pdb, uint32_t iStream)
+{
+	Clear();
+
+	if (!pdb.ReadStream(iStream, m_data) || m_data.size() < CB_TPI_HEADER) {
+		return false;
+	}
+
+	uint32_t cbHeader = GetU32(&m_data[4]);
+	uint32_t tiMin = GetU32(&m_data[8]);
+	uint32_t tiMax = GetU32(&m_data[12]);
+	uint32_t cbRecords = GetU32(&m_data[16]);
+
+	if (cbHeader > m_data.size() || cbRecords > m_data.size() - cbHeader || tiMax < tiMin) {
+		Clear();
+
+		return false;
+	}
+
+	m_tiFirst = tiMin;
+	m_offsets.reserve(tiMax - tiMin);
+
+	for (size_t off = cbHeader; off + 4 <= (size_t)cbHeader + cbRecords; ) {
+		uint16_t cbRecord = GetU16(&m_data[off]);
+
+		if (cbRecord < 2 || off + 2 + cbRecord > (size_t)cbHeader + cbRecords) {
+			break;
+		}
+
+		m_offsets.push_back((uint32_t)off);
+		off += 2 + cbRecord;
+	}
+
+	// Definitions by unique name and by name, for the forward
+	//  references; the first definition of a name wins
+
+	TpiUdt udt;
+
+	for (uint32_t ti = FirstIndex(); ti < EndIndex(); ti++) {
+		if (IsUdtLeaf(Leaf(ti)) && GetUdt(ti, udt) && !(udt.property & TPI_PROP_FWDREF)) {
+			if (*udt.szUniqueName != '\0') {
+				m_definitions.insert(std::make_pair(std::string(udt.szUniqueName), ti));
+			}
+
+			m_definitions.insert(std::make_pair(std::string(udt.szName), ti));
+		}
+	}
+
+	return true;
+}
+
+void TpiStream::Clear()
+{
+	std::vector<uint8_t>().swap(m_data);
+	std::vector<uint32_t>().swap(m_offsets);
+	std::unordered_map<std::string, uint32_t>().swap(m_definitions);
+	m_tiFirst = TPI_FIRST_INDEX;
+}
+
+uint16_t TpiStream::Leaf(uint32_t ti) const
+{
+	if (ti < FirstIndex() || ti >= EndIndex()) {
+		return 0;
+	}
+
+	return GetU16(&m_data[m_offsets[ti - m_tiFirst] + 2]);
+}
+
+////////////////////////////////////////////////////////////
+// The bytes of a record after its leaf kind
+//
+const uint8_t * TpiStream::Record(uint32_t ti, uint16_t * pcb) const
+{
+	if (ti < FirstIndex() || ti >= EndIndex()) {
+		*pcb = 0;
+
+		return NULL;
+	}
+
+	const uint8_t * pRecord = &m_data[m_offsets[ti - m_tiFirst]];
+
+	*pcb = GetU16(pRecord) - 2;
+
+	return pRecord + 4;
+}
+
+bool TpiStream::GetUdt(uint32_t ti, TpiUdt & udt) const
+{
+	uint16_t cb;
+	const uint8_t * pb = Record(ti, &cb);
+	const uint8_t * pEnd = pb + cb;
+
+	memset(&udt, 0, sizeof(udt));
+	udt.leaf = Leaf(ti);
+	udt.szName = "";
+	udt.szUniqueName = "";
+
+	if (pb == NULL || !IsUdtLeaf(udt.leaf) || cb < 8) {
+		return false;
+	}
+
+	udt.cFields = GetU16(pb);
+	udt.property = GetU16(pb + 2);
+
+	if (udt.leaf == LF_ENUM) {
+		if (cb < 12) {
+			return false;
+		}
+
+		udt.underlying = GetU32(pb + 4);
+		udt.fieldList = GetU32(pb + 8);
+		pb += 12;
+	}
+
+	else {
+		int64_t cbUdt;
+
+		udt.fieldList = GetU32(pb + 4);
+		pb += 8;
+
+		if (udt.leaf != LF_UNION) {
+			if (pEnd - pb < 8) {
+				return false;
+			}
+
+			udt.derived = GetU32(pb);
+			udt.vshape = GetU32(pb + 4);
+			pb += 8;
+		}
+
+		if (!ReadTpiNumeric(pb, pEnd, cbUdt)) {
+			return false;
+		}
+
+		udt.cb = (uint64_t)cbUdt;
+	}
+
+	udt.szName = ReadName(pb, pEnd);
+
+	if (udt.property & TPI_PROP_HASUNIQUENAME) {
+		udt.szUniqueName = ReadName(pb, pEnd);
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Decode a field list, following the LF_INDEX continuations
+//
+bool TpiStream::GetFields(uint32_t fieldList, std::vector<TpiField> & fields) const
+{
+	fields.clear();
+
+	for (uint32_t cLists = 0; fieldList != 0 && cLists < m_offsets.size(); cLists++) {
+		uint16_t cb;
+		const uint8_t * pb = Record(fieldList, &cb);
+		const uint8_t * pEnd = pb + cb;
+
+		if (pb == NULL || Leaf(fieldList) != LF_FIELDLIST) {
+			return false;
+		}
+
+		fieldList = 0;
+
+		while (pEnd - pb >= 2) {
+			TpiField field;
+
+			memset(&field, 0, sizeof(field));
+			field.leaf = GetU16(pb);
+			field.szName = "";
+			pb += 2;
+
+			if (pEnd - pb < 6) {
+				return false;
+			}
+
+			field.attr = GetU16(pb);
+			field.type = GetU32(pb + 2);
+
+			switch (field.leaf) {
+				case LF_MEMBER:
+				case LF_BCLASS:
+				case LF_BINTERFACE:
+					pb += 6;
+
+					if (!ReadTpiNumeric(pb, pEnd, field.offset)) {
+						return false;
+					}
+
+					if (field.leaf == LF_MEMBER) {
+						field.szName = ReadName(pb, pEnd);
+					}
+
+					break;
+
+				case LF_VBCLASS:
+				case LF_IVBCLASS:
+					if (pEnd - pb < 10) {
+						return false;
+					}
+
+					field.vbptrType = GetU32(pb + 6);
+					pb += 10;
+
+					if (!ReadTpiNumeric(pb, pEnd, field.offset) || !ReadTpiNumeric(pb, pEnd, field.vbIndex)) {
+						return false;
+					}
+
+					break;
+
+				case LF_ENUMERATE:
+					field.type = 0;
+					pb += 2;
+
+					if (!ReadTpiNumeric(pb, pEnd, field.offset)) {
+						return false;
+					}
+
+					field.szName = ReadName(pb, pEnd);
+					break;
+
+				case LF_STMEMBER:
+				case LF_NESTTYPE:
+				case LF_NESTTYPEEX:
+				case LF_FRIENDFCN:
+				case LF_MEMBERMODIFY:
+					pb += 6;
+					field.szName = ReadName(pb, pEnd);
+					break;
+
+				case LF_METHOD:
+					field.cMethods = field.attr;
+					field.attr = 0;
+					pb += 6;
+					field.szName = ReadName(pb, pEnd);
+					break;
+
+				case LF_ONEMETHOD:
+					pb += 6;
+
+					if (((field.attr >> 2) & 7) == TPI_MPROP_INTRO || ((field.attr >> 2) & 7) == TPI_MPROP_PUREINTRO) {
+						if (pEnd - pb < 4) {
+							return false;
+						}
+
+						field.offset = (int32_t)GetU32(pb);
+						pb += 4;
+					}
+
+					field.szName = ReadName(pb, pEnd);
+					break;
+
+				case LF_VFUNCTAB:
+				case LF_FRIENDCLS:
+					pb += 6;
+					break;
+
+				case LF_VFUNCOFF:
+					if (pEnd - pb < 10) {
+						return false;
+					}
+
+					field.offset = (int32_t)GetU32(pb + 6);
+					pb += 10;
+					break;
+
+				case LF_INDEX:
+					fieldList = field.type;
+					pb = pEnd;
+					continue;
+
+				default:
+					return false;
+			}
+
+			// Every entry is padded to 4 bytes with LF_PAD bytes
+
+			while (pb < pEnd && *pb >= LF_PAD0) {
+				pb++;
+			}
+
+			fields.push_back(field);
+		}
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// The definition of a forward referenced UDT, or ti itself
+//
+uint32_t TpiStream::Definition(uint32_t ti) const
+{
+	TpiUdt udt;
+
+	if (!IsUdtLeaf(Leaf(ti)) || !GetUdt(ti, udt) || !(udt.property & TPI_PROP_FWDREF)) {
+		return ti;
+	}
+
+	auto it = m_definitions.end();
+
+	if (*udt.szUniqueName != '\0') {
+		it = m_definitions.find(udt.szUniqueName);
+	}
+
+	if (it == m_definitions.end()) {
+		it = m_definitions.find(udt.szName);
+	}
+
+	return (it != m_definitions.end()) ? it->second : ti;
+}
+
+////////////////////////////////////////////////////////////
+// The definition of a UDT or enum by name, 0 if none
+//
+uint32_t TpiStream::FindType(const char * szName) const
+{
+	auto it = m_definitions.find(szName);
+
+	return (it != m_definitions.end()) ? it->second : 0;
+}
+
+static uint64_t SimpleTypeSize(uint32_t ti)
+{
+	uint32_t mode = (ti >> 8) & 0xF;
+
+	if (mode != 0) {
+		return (mode == 6) ? 8 : (mode == 7) ? 16 : (mode >= 4) ? 4 : 2;
+	}
+
+	switch (ti & 0xFF) {
+		case 0x10: case 0x20: case 0x68: case 0x69: case 0x70: case 0x30: case 0x7C:
+			return 1;
+
+		case 0x11: case 0x21: case 0x72: case 0x73: case 0x71: case 0x7A: case 0x31: case 0x46:
+			return 2;
+
+		case 0x12: case 0x22: case 0x74: case 0x75: case 0x40: case 0x7B: case 0x32: case 0x08:
+			return 4;
+
+		case 0x13: case 0x23: case 0x76: case 0x77: case 0x41: case 0x33:
+			return 8;
+
+		case 0x42:
+			return 10;
+
+		case 0x14: case 0x24: case 0x78: case 0x79: case 0x43:
+			return 16;
+	}
+
+	return 0;
+}
+
+uint64_t TpiStream::TypeSize(uint32_t ti) const
+{
+	for (int depth = 0; depth < TPI_MAX_NAME_DEPTH; depth++) {
+		if (ti < FirstIndex()) {
+			return SimpleTypeSize(ti);
+		}
+
+		uint16_t cb;
+		const uint8_t * pb = Record(ti, &cb);
+		uint16_t leaf = Leaf(ti);
+		TpiUdt udt;
+		int64_t cbArray;
+
+		if (pb == NULL) {
+			return 0;
+		}
+
+		switch (leaf) {
+			case LF_MODIFIER:
+			case LF_BITFIELD:
+				if (cb < 4) {
+					return 0;
+				}
+
+				ti = GetU32(pb);
+				break;
+
+			case LF_POINTER:
+				return (cb >= 8) ? (GetU32(pb + 4) >> 13) & 0x3F : 0;
+
+			case LF_ARRAY:
+				pb += 8;
+
+				return (cb >= 10 && ReadTpiNumeric(pb, pb + cb - 8, cbArray)) ? (uint64_t)cbArray : 0;
+
+			case LF_CLASS:
+			case LF_STRUCTURE:
+			case LF_UNION:
+			case LF_INTERFACE:
+			case LF_ENUM:
+				if (!GetUdt(Definition(ti), udt)) {
+					return 0;
+				}
+
+				if (leaf != LF_ENUM) {
+					return udt.cb;
+				}
+
+				ti = udt.underlying;
+				break;
+
+			default:
+				return 0;
+		}
+	}
+
+	return 0;
+}
+
+static const char * SimpleTypeName(uint32_t ti)
+{
+	switch (ti & 0xFF) {
+		case 0x03: return "void";
+		case 0x08: return "HRESULT";
+		case 0x10: return "signed char";
+		case 0x11: return "short";
+		case 0x12: return "long";
+		case 0x13: return "__int64";
+		case 0x14: return "__int128";
+		case 0x20: return "unsigned char";
+		case 0x21: return "unsigned short";
+		case 0x22: return "unsigned long";
+		case 0x23: return "unsigned __int64";
+		case 0x24: return "unsigned __int128";
+		case 0x30: return "bool";
+		case 0x40: return "float";
+		case 0x41: return "double";
+		case 0x42: return "long double";
+		case 0x68: return "__int8";
+		case 0x69: return "unsigned __int8";
+		case 0x70: return "char";
+		case 0x71: return "wchar_t";
+		case 0x72: return "__int16";
+		case 0x73: return "unsigned __int16";
+		case 0x74: return "int";
+		case 0x75: return "unsigned int";
+		case 0x76: return "__int64";
+		case 0x77: return "unsigned __int64";
+		case 0x7A: return "char16_t";
+		case 0x7B: return "char32_t";
+		case 0x7C: return "char8_t";
+	}
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////
+// The C++ spelling of a type, "const Foo *", "int[4][2]",
+//  "void (*)(int)"
+//
+void TpiStream::TypeName(uint32_t ti, std::string & name) const
+{
+	name.clear();
+	AppendTypeName(ti, name, 0);
+}
+
+void TpiStream::AppendTypeName(uint32_t ti, std::string & name, int depth) const
+{
+	char szBuffer[32];
+
+	if (depth > TPI_MAX_NAME_DEPTH) {
+		name += "...";
+
+		return;
+	}
+
+	if (ti < FirstIndex()) {
+		const char * szSimple = SimpleTypeName(ti);
+
+		if (szSimple != NULL) {
+			name += szSimple;
+		}
+
+		else {
+			snprintf(szBuffer, sizeof(szBuffer), "<type 0x%x>", ti & 0xFF);
+			name += szBuffer;
+		}
+
+		if (((ti >> 8) & 0xF) != 0) {
+			name += " *";
+		}
+
+		return;
+	}
+
+	uint16_t cb;
+	const uint8_t * pb = Record(ti, &cb);
+	TpiUdt udt;
+
+	switch (Leaf(ti)) {
+		case LF_MODIFIER:
+			if (cb >= 6) {
+				uint16_t modifiers = GetU16(pb + 4);
+
+				if (modifiers & 1) {
+					name += "const ";
+				}
+
+				if (modifiers & 2) {
+					name += "volatile ";
+				}
+
+				AppendTypeName(GetU32(pb), name, depth + 1);
+
+				return;
+			}
+
+			break;
+
+		case LF_POINTER:
+			if (cb >= 8) {
+				uint32_t referent = GetU32(pb);
+				uint32_t attr = GetU32(pb + 4);
+				uint32_t mode = (attr >> 5) & 7;
+				uint16_t leafReferent = Leaf(referent);
+
+				if (leafReferent == LF_PROCEDURE || leafReferent == LF_MFUNCTION) {
+					uint16_t cbProc;
+					const uint8_t * pProc = Record(referent, &cbProc);
+					uint32_t offArgs = (leafReferent == LF_PROCEDURE) ? 8 : 16;
+
+					if (cbProc >= offArgs + 4) {
+						AppendTypeName(GetU32(pProc), name, depth + 1);
+						name += " (*)(";
+
+						uint16_t cbArgs;
+						const uint8_t * pArgs = Record(GetU32(pProc + offArgs), &cbArgs);
+
+						if (pArgs != NULL && cbArgs >= 4) {
+							uint32_t cArgs = GetU32(pArgs);
+
+							for (uint32_t i = 0; i < cArgs && 8 + i * 4 <= cbArgs; i++) {
+								if (i != 0) {
+									name += ", ";
+								}
+
+								AppendTypeName(GetU32(pArgs + 4 + i * 4), name, depth + 1);
+							}
+						}
+
+						name += ")";
+
+						return;
+					}
+				}
+
+				AppendTypeName(referent, name, depth + 1);
+
+				if ((mode == 2 || mode == 3) && cb >= 12) {
+					name += " ";
+					AppendTypeName(GetU32(pb + 8), name, depth + 1);
+					name += "::*";
+				}
+
+				else {
+					name += (mode == 1) ? " &" : (mode == 4) ? " &&" : " *";
+				}
+
+				if (attr & (1 << 10)) {
+					name += "const";
+				}
+
+				return;
+			}
+
+			break;
+
+		case LF_ARRAY:
+			if (cb >= 10) {
+				std::string dims;
+
+				// Nested arrays are outermost first, like their spelling
+
+				for (int cDims = 0; Leaf(ti) == LF_ARRAY && cDims < TPI_MAX_NAME_DEPTH; cDims++) {
+					int64_t cbArray;
+
+					pb = Record(ti, &cb);
+
+					const uint8_t * pEnd = pb + cb;
+					uint32_t element = GetU32(pb);
+					uint64_t cbElement = TypeSize(element);
+
+					pb += 8;
+
+					if (!ReadTpiNumeric(pb, pEnd, cbArray)) {
+						break;
+					}
+
+					snprintf(szBuffer, sizeof(szBuffer), "[%llu]",
+						(unsigned long long)((cbElement != 0) ? (uint64_t)cbArray / cbElement : (uint64_t)cbArray));
+					dims += szBuffer;
+					ti = element;
+				}
+
+				AppendTypeName(ti, name, depth + 1);
+				name += dims;
+
+				return;
+			}
+
+			break;
+
+		case LF_BITFIELD:
+			if (cb >= 4) {
+				AppendTypeName(GetU32(pb), name, depth + 1);
+
+				return;
+			}
+
+			break;
+
+		case LF_PROCEDURE:
+		case LF_MFUNCTION:
+			name += "<function>";
+			return;
+
+		case LF_VTSHAPE:
+			name += "<vtshape>";
+			return;
+
+		case LF_CLASS:
+		case LF_STRUCTURE:
+		case LF_UNION:
+		case LF_INTERFACE:
+		case LF_ENUM:
+			if (GetUdt(ti, udt)) {
+				name += udt.szName;
+
+				return;
+			}
+
+			break;
+	}
+
+	snprintf(szBuffer, sizeof(szBuffer), "<type 0x%x>", ti);
+	name += szBuffer;
+}
+
+////////////////////////////////////////////////////////////
+// The string of an IPI LF_STRING_ID record, NULL if id is not one
+//
+const char * TpiStream::StringId(uint32_t id) const
+{
+	uint16_t cb;
+	const uint8_t * pb = Record(id, &cb);
+
+	if (pb == NULL || Leaf(id) != LF_STRING_ID || cb < 5) {
+		return NULL;
+	}
+
+	const uint8_t * pEnd = pb + cb;
+
+	pb += 4;
+
+	return ReadName(pb, pEnd);
+}
@@ -0,0 +1,133 @@
+// TpiStream.h : Native decoder for the TPI and IPI type streams
+//
+// Indexes the records of a type stream by type index and decodes the
+// records that describe data layouts: classes, structures, unions,
+// enums, their field lists, and the pointer, modifier, array and
+// bitfield records members refer to. Forward references are resolved
+// to their definition by unique name. Nothing in here depends on DIA
+// or Windows.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PdbFile.h"
+
+#define TPI_FIRST_INDEX             0x1000
+
+#define LF_VTSHAPE                  0x000A
+#define LF_MODIFIER                 0x1001
+#define LF_POINTER                  0x1002
+#define LF_PROCEDURE                0x1008
+#define LF_MFUNCTION                0x1009
+#define LF_ARGLIST                  0x1201
+#define LF_FIELDLIST                0x1203
+#define LF_BITFIELD                 0x1205
+#define LF_METHODLIST               0x1206
+#define LF_BCLASS                   0x1400
+#define LF_VBCLASS                  0x1401
+#define LF_IVBCLASS                 0x1402
+#define LF_INDEX                    0x1404
+#define LF_VFUNCTAB                 0x1409
+#define LF_FRIENDCLS                0x140A
+#define LF_VFUNCOFF                 0x140C
+#define LF_ENUMERATE                0x1502
+#define LF_ARRAY                    0x1503
+#define LF_CLASS                    0x1504
+#define LF_STRUCTURE                0x1505
+#define LF_UNION                    0x1506
+#define LF_ENUM                     0x1507
+#define LF_FRIENDFCN                0x150C
+#define LF_MEMBER                   0x150D
+#define LF_STMEMBER                 0x150E
+#define LF_METHOD                   0x150F
+#define LF_NESTTYPE                 0x1510
+#define LF_ONEMETHOD                0x1511
+#define LF_NESTTYPEEX               0x1512
+#define LF_MEMBERMODIFY             0x1513
+#define LF_INTERFACE                0x1519
+#define LF_BINTERFACE               0x151A
+#define LF_FUNC_ID                  0x1601
+#define LF_MFUNC_ID                 0x1602
+#define LF_BUILDINFO                0x1603
+#define LF_SUBSTR_LIST              0x1604
+#define LF_STRING_ID                0x1605
+#define LF_UDT_SRC_LINE             0x1606
+#define LF_UDT_MOD_SRC_LINE         0x1607
+
+#define TPI_PROP_FWDREF             0x0080
+#define TPI_PROP_HASUNIQUENAME      0x0200
+
+#define TPI_MPROP_INTRO             4
+#define TPI_MPROP_PUREINTRO         6
+
+// A class, structure, union, interface or enum record
+struct TpiUdt
+{
+	uint16_t leaf;
+	uint16_t property;
+	uint16_t cFields;
+	uint32_t fieldList;
+	uint32_t derived;
+	uint32_t vshape;
+	uint32_t underlying;                 // enums only
+	uint64_t cb;                         // 0 for enums, see TypeSize()
+	const char * szName;
+	const char * szUniqueName;           // "" when none
+};
+
+// One entry of a field list
+struct TpiField
+{
+	uint16_t leaf;
+	uint16_t attr;
+	uint32_t type;                       // member, base, vbase, method list or nested type
+	int64_t offset;                      // member or base offset, enumerator value, vbptr offset,
+	                                     //  vftable offset of an introducing method
+	int64_t vbIndex;                     // index of a virtual base in the vbtable
+	uint32_t vbptrType;
+	uint16_t cMethods;                   // LF_METHOD overloads
+	const char * szName;                 // "" when none
+};
+
+////////////////////////////////////////////////////////////
+// The records of a type stream by type index
+//
+//  The decoded names point into the stream data and live as long
+//  as the stream is loaded.
+//
+class TpiStream
+{
+	public:
+	bool Load(const PdbFile & pdb, uint32_t iStream = PDB_STREAM_TPI);
+	void Clear();
+
+	uint32_t CountTypes() const { return (uint32_t)m_offsets.size(); }
+	uint32_t FirstIndex() const { return m_tiFirst; }
+	uint32_t EndIndex() const { return m_tiFirst + (uint32_t)m_offsets.size(); }
+	uint16_t Leaf(uint32_t ti) const;
+	const uint8_t * Record(uint32_t ti, uint16_t * pcb) const;
+
+	bool GetUdt(uint32_t ti, TpiUdt & udt) const;
+	bool GetFields(uint32_t fieldList, std::vector<TpiField> & fields) const;
+	uint32_t Definition(uint32_t ti) const;
+	uint32_t FindType(const char * szName) const;
+	uint64_t TypeSize(uint32_t ti) const;
+	void TypeName(uint32_t ti, std::string & name) const;
+	const char * StringId(uint32_t id) const;
+
+	private:
+	void AppendTypeName(uint32_t ti, std::string & name, int depth) const;
+
+	std::vector<uint8_t> m_data;
+	std::vector<uint32_t> m_offsets;     // record offset per type index
+	std::unordered_map<std::string, uint32_t> m_definitions;
+	uint32_t m_tiFirst = TPI_FIRST_INDEX;
+};
+
+bool IsUdtLeaf(uint16_t leaf);
+bool ReadTpiNumeric(const uint8_t *& pb, const uint8_t * pEnd, int64_t & value);
@@ -0,0 +1,292 @@
+// TypeBaseline.cpp : Persisted UDT layouts for incremental type matching
+//
+
+#include "TypeBaseline.h"
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "Util.h"
+
+#define TYPE_BASELINE_HEADER        "PDBTYPES 1"
+
+////////////////////////////////////////////////////////////
+// FNV-1a over the size and the fields in order, names included
+//  with their terminator so adjacent names cannot run together
+//
+void HashTypeLayout(TypeLayout & layout)
+{
+	uint64_t hash = HashU64(FNV_OFFSET_BASIS, layout.cb);
+
+	hash = HashU64(hash, layout.fields.size());
+
+	for (const TypeField & field : layout.fields) {
+		hash = HashU64(hash, (uint32_t)field.offset);
+		hash = HashU64(hash, field.baseType);
+		hash = HashBytes(hash, field.name.c_str(), field.name.size() + 1);
+	}
+
+	layout.hash = hash;
+}
+
+static bool NamesMatch(const std::string & name1, const std::string & name2)
+{
+	if (name1.size() == name2.size()) {
+		size_t i = 0;
+
+		while (i < name1.size() && tolower((unsigned char)name1[i]) == tolower((unsigned char)name2[i])) {
+			i++;
+		}
+
+		if (i == name1.size()) {
+			return true;
+		}
+	}
+
+	// Renamed members often keep the old name as a prefix
+
+	return name1.compare(0, name2.size(), name2) == 0 || name2.compare(0, name1.size(), name1) == 0;
+}
+
+////////////////////////////////////////////////////////////
+// Same rules as LayoutMatches(): equal sizes, and every field of
+//  the old layout still at its offset in the new one, with a
+//  matching name and the same basic type
+//
+bool TypeLayoutsMatch(const TypeLayout & oldLayout, const TypeLayout & newLayout, std::string & reason)
+{
+	char szReason[128];
+
+	reason.clear();
+
+	if (oldLayout.cb == 0 || newLayout.cb == 0) {
+		return true;
+	}
+
+	if (oldLayout.cb != newLayout.cb) {
+		snprintf(szReason, sizeof(szReason), "Failed to match type size: (sizeof(sym1)=%" PRIu64 ") != (sizeof(sym2)=%" PRIu64 ")",
+			oldLayout.cb, newLayout.cb);
+		reason = szReason;
+
+		return false;
+	}
+
+	for (const TypeField & oldField : oldLayout.fields) {
+		const TypeField * pMatch = NULL;
+
+		for (const TypeField & newField : newLayout.fields) {
+			if (newField.offset == oldField.offset && NamesMatch(oldField.name, newField.name)) {
+				pMatch = &newField;
+				break;
+			}
+		}
+
+		if (pMatch == NULL) {
+			snprintf(szReason, sizeof(szReason), " field at offset %x", oldField.offset);
+			reason = "Failed to match " + oldLayout.name + " field " + oldField.name + szReason;
+
+			return false;
+		}
+
+		if (pMatch->baseType != oldField.baseType) {
+			snprintf(szReason, sizeof(szReason), " at offset %x", oldField.offset);
+			reason = "Failed to match type of field " + oldField.name + szReason;
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Add a layout, the first one of a name wins
+//
+bool TypeBaseline::Add(const TypeLayout & layout)
+{
+	if (!m_index.insert(std::make_pair(layout.name, (uint32_t)m_layouts.size())).second) {
+		return false;
+	}
+
+	m_layouts.push_back(layout);
+
+	return true;
+}
+
+const TypeLayout * TypeBaseline::Find(const std::string & name) const
+{
+	auto it = m_index.find(name);
+
+	return (it != m_index.end()) ? &m_layouts[it->second] : NULL;
+}
+
+static bool ReadLine(FILE * pFile, std::string & line)
+{
+	char buffer[1024];
+
+	line.clear();
+
+	while (fgets(buffer, sizeof(buffer), pFile) != NULL) {
+		line += buffer;
+
+		if (!line.empty() && line.back() == '\n') {
+			line.pop_back();
+
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+
+			return true;
+		}
+	}
+
+	return !line.empty();
+}
+
+////////////////////////////////////////////////////////////
+// Read a baseline
+//
+//  "T <hash> <size> <field count> <name>" per type, followed by
+//  "F <offset> <basic type> <name>" per field. The names run to
+//  the end of the line since undecorated names contain spaces.
+//
+bool TypeBaseline::Load(FILE * pFile)
+{
+	std::string line;
+
+	m_index.clear();
+	m_layouts.clear();
+
+	if (!ReadLine(pFile, line) || line != TYPE_BASELINE_HEADER) {
+		return false;
+	}
+
+	while (ReadLine(pFile, line)) {
+		TypeLayout layout;
+		unsigned long long hash, cb;
+		unsigned cFields;
+		int cchPrefix = 0;
+
+		if (sscanf(line.c_str(), "T %llx %llu %u %n", &hash, &cb, &cFields, &cchPrefix) != 3 || cchPrefix == 0) {
+			return false;
+		}
+
+		layout.name.assign(line, cchPrefix, std::string::npos);
+		layout.hash = hash;
+		layout.cb = cb;
+		layout.fields.resize(cFields);
+
+		for (TypeField & field : layout.fields) {
+			if (!ReadLine(pFile, line)) {
+				return false;
+			}
+
+			cchPrefix = 0;
+
+			if (sscanf(line.c_str(), "F %d %u %n", &field.offset, &field.baseType, &cchPrefix) != 2 || cchPrefix == 0) {
+				return false;
+			}
+
+			field.name.assign(line, cchPrefix, std::string::npos);
+		}
+
+		Add(layout);
+	}
+
+	return true;
+}
+
+bool TypeBaseline::Load(const char * szPath)
+{
+	FILE * pFile;
+
+#ifdef _WIN32
+	if (fopen_s(&pFile, szPath, "r") || !pFile) {
+		return false;
+	}
+#else
+	if ((pFile = fopen(szPath, "r")) == NULL) {
+		return false;
+	}
+#endif
+
+	bool fLoaded = Load(pFile);
+
+	fclose(pFile);
+
+	return fLoaded;
+}
+
+#ifdef _WIN32
+bool TypeBaseline::Load(const wchar_t * wszPath)
+{
+	FILE * pFile;
+
+	if (_wfopen_s(&pFile, wszPath, L"r") || !pFile) {
+		return false;
+	}
+
+	bool fLoaded = Load(pFile);
+
+	fclose(pFile);
+
+	return fLoaded;
+}
+#endif
+
+bool TypeBaseline::Save(FILE * pFile) const
+{
+	if (fprintf(pFile, "%s\n", TYPE_BASELINE_HEADER) < 0) {
+		return false;
+	}
+
+	for (const TypeLayout & layout : m_layouts) {
+		if (fprintf(pFile, "T %016llx %llu %u %s\n", (unsigned long long)layout.hash, (unsigned long long)layout.cb,
+			(unsigned)layout.fields.size(), layout.name.c_str()) < 0) {
+			return false;
+		}
+
+		for (const TypeField & field : layout.fields) {
+			if (fprintf(pFile, "F %d %u %s\n", field.offset, field.baseType, field.name.c_str()) < 0) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool TypeBaseline::Save(const char * szPath) const
+{
+	FILE * pFile;
+
+#ifdef _WIN32
+	if (fopen_s(&pFile, szPath, "w") || !pFile) {
+		return false;
+	}
+#else
+	if ((pFile = fopen(szPath, "w")) == NULL) {
+		return false;
+	}
+#endif
+
+	bool fSaved = Save(pFile);
+
+	return (fclose(pFile) == 0) && fSaved;
+}
+
+#ifdef _WIN32
+bool TypeBaseline::Save(const wchar_t * wszPath) const
+{
+	FILE * pFile;
+
+	if (_wfopen_s(&pFile, wszPath, L"w") || !pFile) {
+		return false;
+	}
+
+	bool fSaved = Save(pFile);
+
+	return (fclose(pFile) == 0) && fSaved;
+}
+#endif
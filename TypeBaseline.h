@@ -0,0 +1,63 @@
+// TypeBaseline.h : Persisted UDT layouts for incremental type matching
+//
+// A baseline holds the canonical layout of every UDT of a reference
+// PDB - size and the this relative fields - with a structural hash of
+// it. Checking a new PDB against the baseline only hashes the new
+// layouts; the field by field comparison is done for the types whose
+// hash differs, so the reference PDB is not opened again.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TypeField
+{
+	int32_t offset;
+	uint32_t baseType;                   // basic type of the field, 0 if none
+	std::string name;
+};
+
+struct TypeLayout
+{
+	std::string name;
+	uint64_t cb;
+	uint64_t hash;                       // set by HashTypeLayout
+	std::vector<TypeField> fields;
+};
+
+////////////////////////////////////////////////////////////
+// UDT layouts by name, saved as text
+//
+class TypeBaseline
+{
+	public:
+	bool Add(const TypeLayout & layout);
+	const TypeLayout * Find(const std::string & name) const;
+
+	bool Load(const char * szPath);
+#ifdef _WIN32
+	bool Load(const wchar_t * wszPath);
+#endif
+	bool Load(FILE * pFile);
+
+	bool Save(const char * szPath) const;
+#ifdef _WIN32
+	bool Save(const wchar_t * wszPath) const;
+#endif
+	bool Save(FILE * pFile) const;
+
+	size_t Count() const { return m_layouts.size(); }
+	const TypeLayout & Layout(size_t i) const { return m_layouts[i]; }
+
+	private:
+	std::unordered_map<std::string, uint32_t> m_index;
+	std::vector<TypeLayout> m_layouts;
+};
+
+void HashTypeLayout(TypeLayout & layout);
+bool TypeLayoutsMatch(const TypeLayout & oldLayout, const TypeLayout & newLayout, std::string & reason);
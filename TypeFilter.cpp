@@ -0,0 +1,155 @@
+// TypeFilter.cpp : Type exclusion list matching
+//
+
+#include "TypeFilter.h"
+
+#include <atomic>
+#include <string.h>
+
+#include "Util.h"
+
+#define TYPE_FILTER_NO_STATE        0xFFFFFFFF
+
+void TypeFilter::AddName(const std::string & name)
+{
+	m_names.insert(name);
+}
+
+void TypeFilter::AddPattern(const std::string & pattern)
+{
+	if (!pattern.empty()) {
+		m_patterns.push_back(pattern);
+		m_fBuilt = false;
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Compile the patterns into a DFA
+//
+//  The trie is built first, then the failure links are folded in
+//  breadth first so every state has a transition on every class.
+//  A name only needs to know whether something matched, so the
+//  final states are made absorbing.
+//
+void TypeFilter::Build()
+{
+	memset(m_rgClass, 0, sizeof(m_rgClass));
+	m_cClasses = 1;                      // class 0 is every byte no pattern uses
+
+	for (const std::string & pattern : m_patterns) {
+		for (unsigned char ch : pattern) {
+			if (m_rgClass[ch] == 0) {
+				m_rgClass[ch] = (uint8_t)m_cClasses++;
+			}
+		}
+	}
+
+	m_delta.assign(m_cClasses, TYPE_FILTER_NO_STATE);
+	m_final.assign(1, 0);
+
+	for (const std::string & pattern : m_patterns) {
+		uint32_t state = 0;
+
+		for (unsigned char ch : pattern) {
+			uint32_t & next = m_delta[state * m_cClasses + m_rgClass[ch]];
+
+			if (next == TYPE_FILTER_NO_STATE) {
+				next = (uint32_t)m_final.size();
+				m_final.push_back(0);
+				m_delta.resize(m_delta.size() + m_cClasses, TYPE_FILTER_NO_STATE);
+			}
+
+			state = m_delta[state * m_cClasses + m_rgClass[ch]];
+		}
+
+		m_final[state] = 1;
+	}
+
+	std::vector<uint32_t> fail(m_final.size(), 0);
+	std::vector<uint32_t> queue;
+
+	for (uint32_t c = 0; c < m_cClasses; c++) {
+		uint32_t & next = m_delta[c];
+
+		if (next == TYPE_FILTER_NO_STATE) {
+			next = 0;
+		}
+
+		else {
+			queue.push_back(next);
+		}
+	}
+
+	for (size_t iQueue = 0; iQueue < queue.size(); iQueue++) {
+		uint32_t state = queue[iQueue];
+
+		m_final[state] |= m_final[fail[state]];
+
+		for (uint32_t c = 0; c < m_cClasses; c++) {
+			uint32_t & next = m_delta[state * m_cClasses + c];
+
+			if (m_final[state]) {
+				next = state;
+			}
+
+			else if (next == TYPE_FILTER_NO_STATE) {
+				next = m_delta[fail[state] * m_cClasses + c];
+			}
+
+			else {
+				fail[next] = m_delta[fail[state] * m_cClasses + c];
+				queue.push_back(next);
+			}
+		}
+	}
+
+	m_fBuilt = true;
+}
+
+bool TypeFilter::MatchesPattern(const std::string & name) const
+{
+	uint32_t state = 0;
+
+	for (unsigned char ch : name) {
+		state = m_delta[state * m_cClasses + m_rgClass[ch]];
+
+		if (m_final[state]) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool TypeFilter::IsExcluded(const std::string & name) const
+{
+	if (m_names.find(name) != m_names.end()) {
+		return true;
+	}
+
+	return m_fBuilt && !m_patterns.empty() && MatchesPattern(name);
+}
+
+////////////////////////////////////////////////////////////
+// Flag the excluded names, the threads take blocks of names
+//  from a shared counter
+//
+void TypeFilter::Filter(const std::vector<std::string> & names, unsigned cThreads, std::vector<uint8_t> & excluded) const
+{
+	const size_t cBlock = 1024;
+	std::atomic<size_t> iNext(0);
+
+	excluded.assign(names.size(), 0);
+
+	auto worker = [&](unsigned) {
+		for (size_t iBegin; (iBegin = iNext.fetch_add(cBlock)) < names.size(); ) {
+			size_t iEnd = (iBegin + cBlock < names.size()) ? iBegin + cBlock : names.size();
+
+			for (size_t i = iBegin; i < iEnd; i++) {
+				excluded[i] = IsExcluded(names[i]) ? 1 : 0;
+			}
+		}
+	};
+
+	RunParallel(cThreads, worker);
+}
@@ -0,0 +1,38 @@
+// TypeFilter.h : Type exclusion list matching
+//
+// Exact names go in a hash set. The "*str" patterns are compiled into
+// one Aho-Corasick automaton over UTF-8 bytes, with the byte alphabet
+// reduced to the bytes the patterns use, so checking a name against
+// every pattern is a single pass over its bytes.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+class TypeFilter
+{
+	public:
+	void AddName(const std::string & name);
+	void AddPattern(const std::string & pattern);
+	void Build();
+
+	bool IsExcluded(const std::string & name) const;
+	void Filter(const std::vector<std::string> & names, unsigned cThreads, std::vector<uint8_t> & excluded) const;
+
+	bool Empty() const { return m_names.empty() && m_patterns.empty(); }
+
+	private:
+	bool MatchesPattern(const std::string & name) const;
+
+	std::unordered_set<std::string> m_names;
+	std::vector<std::string> m_patterns;
+	uint8_t m_rgClass[256] = {};
+	uint32_t m_cClasses = 0;
+	std::vector<uint32_t> m_delta;       // state * m_cClasses + class -> state
+	std::vector<uint8_t> m_final;        // some pattern ends at the state
+	bool m_fBuilt = false;
+};
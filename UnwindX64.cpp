@@ -0,0 +1,627 @@
+// UnwindX64.cpp : Decoder and virtual unwinder for x64 exception data
+//
+
+#include "UnwindX64.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+static const char * const rgX64RegNames[] =
+{
+	"rax",
+	"rcx",
+	"rdx",
+	"rbx",
+	"rsp",
+	"rbp",
+	"rsi",
+	"rdi",
+	"r8",
+	"r9",
+	"r10",
+	"r11",
+	"r12",
+	"r13",
+	"r14",
+	"r15",
+	"rip",
+};
+
+static_assert(sizeof(rgX64RegNames) / sizeof(rgX64RegNames[0]) == X64RegMax, "rgX64RegNames out of sync");
+
+static const char * const rgUnwindOpNames[] =
+{
+	"PUSH_NONVOL",
+	"ALLOC_LARGE",
+	"ALLOC_SMALL",
+	"SET_FPREG",
+	"SAVE_NONVOL",
+	"SAVE_NONVOL_FAR",
+	"EPILOG",
+	"SPARE_CODE",
+	"SAVE_XMM128",
+	"SAVE_XMM128_FAR",
+	"PUSH_MACHFRAME",
+};
+
+const char * X64RegName(int reg)
+{
+	return (reg >= 0 && reg < X64RegMax) ? rgX64RegNames[reg] : "???";
+}
+
+////////////////////////////////////////////////////////////
+// Read the exception directory, resolving entries that point
+//  to another RUNTIME_FUNCTION instead of an UNWIND_INFO
+//
+bool X64UnwindIndex::Load(const PeImage & image)
+{
+	uint32_t rvaDir, cbDir;
+
+	m_functions.clear();
+
+	if (!image.Is64() || !image.Directory(PE_DIRECTORY_EXCEPTION, &rvaDir, &cbDir)) {
+		return false;
+	}
+
+	const uint8_t * pb = image.Ptr(rvaDir, cbDir);
+
+	if (pb == NULL) {
+		return false;
+	}
+
+	m_functions.resize(cbDir / 12);
+	memcpy(m_functions.data(), pb, m_functions.size() * 12);
+
+	for (X64RuntimeFunction & function : m_functions) {
+		if (function.rvaUnwind & 1) {
+			X64RuntimeFunction target;
+
+			if (image.Read(function.rvaUnwind & ~1u, &target, sizeof(target))) {
+				function.rvaUnwind = target.rvaUnwind;
+			}
+		}
+	}
+
+	// The linker emits them sorted, only pay for the sort when it did not
+
+	auto less = [](const X64RuntimeFunction & a, const X64RuntimeFunction & b) { return a.rvaBegin < b.rvaBegin; };
+
+	if (!std::is_sorted(m_functions.begin(), m_functions.end(), less)) {
+		std::sort(m_functions.begin(), m_functions.end(), less);
+	}
+
+	return true;
+}
+
+const X64RuntimeFunction * X64UnwindIndex::Find(uint32_t rva) const
+{
+	auto it = std::upper_bound(m_functions.begin(), m_functions.end(), rva,
+		[](uint32_t value, const X64RuntimeFunction & function) { return value < function.rvaBegin; });
+
+	if (it == m_functions.begin()) {
+		return NULL;
+	}
+
+	--it;
+
+	return (rva < it->rvaEnd) ? &*it : NULL;
+}
+
+////////////////////////////////////////////////////////////
+// Decode an UNWIND_INFO and its codes
+//
+bool DecodeX64UnwindInfo(const PeImage & image, uint32_t rvaUnwind, X64UnwindInfo & info)
+{
+	const uint8_t * pb = image.Ptr(rvaUnwind, 4);
+
+	if (pb == NULL) {
+		return false;
+	}
+
+	uint8_t cSlots = pb[2];
+
+	info.version = pb[0] & 7;
+	info.flags = pb[0] >> 3;
+	info.cbProlog = pb[1];
+	info.regFrame = pb[3] & 0xF;
+	info.offFrame = (pb[3] >> 4) * 16;
+	info.rvaHandler = 0;
+	memset(&info.chained, 0, sizeof(info.chained));
+	info.ops.clear();
+
+	if (info.version != 1 && info.version != 2) {
+		return false;
+	}
+
+	// The codes are followed by the handler or the chained entry,
+	//  at an even number of slots
+
+	uint32_t cbCodes = ((cSlots + 1) & ~1) * 2;
+	uint32_t cbTrailer = (info.flags & X64_UNW_FLAG_CHAININFO) ? 12 :
+		(info.flags & (X64_UNW_FLAG_EHANDLER | X64_UNW_FLAG_UHANDLER)) ? 4 : 0;
+
+	pb = image.Ptr(rvaUnwind, 4 + cbCodes + cbTrailer);
+
+	if (pb == NULL) {
+		return false;
+	}
+
+	const uint8_t * pSlot = pb + 4;
+
+	for (uint32_t i = 0; i < cSlots; ) {
+		X64UnwindOp op;
+		uint32_t cUsed;
+
+		op.iCodeOffset = pSlot[i * 2];
+		op.op = pSlot[i * 2 + 1] & 0xF;
+		op.info = pSlot[i * 2 + 1] >> 4;
+		op.dwValue = 0;
+
+		switch (op.op) {
+			case X64UnwindOpPushNonvol:
+			case X64UnwindOpPushMachframe:
+				cUsed = 1;
+				break;
+
+			case X64UnwindOpAllocSmall:
+				cUsed = 1;
+				op.dwValue = op.info * 8 + 8;
+				break;
+
+			case X64UnwindOpSetFpreg:
+				cUsed = 1;
+				op.dwValue = info.offFrame;
+				break;
+
+			case X64UnwindOpAllocLarge:
+				cUsed = (op.info == 0) ? 2 : 3;
+				break;
+
+			case X64UnwindOpSaveNonvol:
+			case X64UnwindOpSaveXmm128:
+			case X64UnwindOpEpilog:
+				cUsed = 2;
+				break;
+
+			case X64UnwindOpSaveNonvolFar:
+			case X64UnwindOpSaveXmm128Far:
+			case X64UnwindOpSpareCode:
+				cUsed = 3;
+				break;
+
+			default:
+				return false;
+		}
+
+		if (i + cUsed > cSlots) {
+			return false;
+		}
+
+		uint32_t dwSlot1 = (cUsed > 1) ? (pSlot[i * 2 + 2] | (pSlot[i * 2 + 3] << 8)) : 0;
+		uint32_t dwSlot2 = (cUsed > 2) ? (pSlot[i * 2 + 4] | (pSlot[i * 2 + 5] << 8)) : 0;
+
+		switch (op.op) {
+			case X64UnwindOpAllocLarge:
+				op.dwValue = (op.info == 0) ? dwSlot1 * 8 : dwSlot1 | (dwSlot2 << 16);
+				break;
+
+			case X64UnwindOpSaveNonvol:
+				op.dwValue = dwSlot1 * 8;
+				break;
+
+			case X64UnwindOpSaveXmm128:
+				op.dwValue = dwSlot1 * 16;
+				break;
+
+			case X64UnwindOpSaveNonvolFar:
+			case X64UnwindOpSaveXmm128Far:
+				op.dwValue = dwSlot1 | (dwSlot2 << 16);
+				break;
+
+			case X64UnwindOpEpilog:
+				op.dwValue = op.iCodeOffset | (op.info << 8);
+				break;
+		}
+
+		info.ops.push_back(op);
+		i += cUsed;
+	}
+
+	const uint8_t * pTrailer = pb + 4 + cbCodes;
+
+	if (info.flags & X64_UNW_FLAG_CHAININFO) {
+		memcpy(&info.chained, pTrailer, sizeof(info.chained));
+	}
+
+	else if (cbTrailer != 0) {
+		info.rvaHandler = pTrailer[0] | (pTrailer[1] << 8) | (pTrailer[2] << 16) | ((uint32_t)pTrailer[3] << 24);
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Turn decoded unwind info into text, one code per line
+//
+void FormatX64UnwindInfo(const X64UnwindInfo & info, std::string & text)
+{
+	char szLine[128];
+
+	snprintf(szLine, sizeof(szLine), "  Version       : %u\n", info.version);
+	text += szLine;
+
+	snprintf(szLine, sizeof(szLine), "  Flags         : %s%s%s%s\n",
+		(info.flags == 0) ? "none" : "",
+		(info.flags & X64_UNW_FLAG_EHANDLER) ? "EHANDLER " : "",
+		(info.flags & X64_UNW_FLAG_UHANDLER) ? "UHANDLER " : "",
+		(info.flags & X64_UNW_FLAG_CHAININFO) ? "CHAININFO " : "");
+	text += szLine;
+
+	snprintf(szLine, sizeof(szLine), "  Prolog        : 0x%02X\n", info.cbProlog);
+	text += szLine;
+
+	if (info.regFrame != 0) {
+		snprintf(szLine, sizeof(szLine), "  Frame         : %s, offset 0x%X\n", X64RegName(info.regFrame), info.offFrame);
+		text += szLine;
+	}
+
+	snprintf(szLine, sizeof(szLine), "  Codes         : %u\n", (unsigned)info.ops.size());
+	text += szLine;
+
+	for (const X64UnwindOp & op : info.ops) {
+		switch (op.op) {
+			case X64UnwindOpPushNonvol:
+				snprintf(szLine, sizeof(szLine), "    [%02X] %-16s %s\n", op.iCodeOffset, rgUnwindOpNames[op.op], X64RegName(op.info));
+				break;
+
+			case X64UnwindOpAllocLarge:
+			case X64UnwindOpAllocSmall:
+				snprintf(szLine, sizeof(szLine), "    [%02X] %-16s 0x%X\n", op.iCodeOffset, rgUnwindOpNames[op.op], op.dwValue);
+				break;
+
+			case X64UnwindOpSetFpreg:
+				snprintf(szLine, sizeof(szLine), "    [%02X] %-16s %s = rsp + 0x%X\n", op.iCodeOffset, rgUnwindOpNames[op.op], X64RegName(info.regFrame), op.dwValue);
+				break;
+
+			case X64UnwindOpSaveNonvol:
+			case X64UnwindOpSaveNonvolFar:
+				snprintf(szLine, sizeof(szLine), "    [%02X] %-16s %s at [rsp + 0x%X]\n", op.iCodeOffset, rgUnwindOpNames[op.op], X64RegName(op.info), op.dwValue);
+				break;
+
+			case X64UnwindOpSaveXmm128:
+			case X64UnwindOpSaveXmm128Far:
+				snprintf(szLine, sizeof(szLine), "    [%02X] %-16s xmm%u at [rsp + 0x%X]\n", op.iCodeOffset, rgUnwindOpNames[op.op], op.info, op.dwValue);
+				break;
+
+			case X64UnwindOpEpilog:
+				snprintf(szLine, sizeof(szLine), "    [%02X] %-16s 0x%X\n", op.iCodeOffset, rgUnwindOpNames[op.op], op.dwValue);
+				break;
+
+			case X64UnwindOpPushMachframe:
+				snprintf(szLine, sizeof(szLine), "    [%02X] %-16s %s\n", op.iCodeOffset, rgUnwindOpNames[op.op], op.info ? "with error code" : "");
+				break;
+
+			default:
+				snprintf(szLine, sizeof(szLine), "    [%02X] %s\n", op.iCodeOffset, rgUnwindOpNames[op.op]);
+				break;
+		}
+
+		text += szLine;
+	}
+
+	if (info.rvaHandler != 0) {
+		snprintf(szLine, sizeof(szLine), "  Handler       : 0x%08X\n", info.rvaHandler);
+		text += szLine;
+	}
+
+	if (info.flags & X64_UNW_FLAG_CHAININFO) {
+		snprintf(szLine, sizeof(szLine), "  Chained       : [0x%08X][0x%08X] unwind 0x%08X\n",
+			info.chained.rvaBegin, info.chained.rvaEnd, info.chained.rvaUnwind);
+		text += szLine;
+	}
+}
+
+static bool ReadStack(const MemoryReader & mem, uint64_t qwAddress, uint64_t * pqw)
+{
+	return mem.Read(qwAddress, pqw, sizeof(*pqw));
+}
+
+static bool RestoreReg(const MemoryReader & mem, uint64_t qwAddress, int reg, X64Context & ctx)
+{
+	if (!ReadStack(mem, qwAddress, &ctx.rgReg[reg])) {
+		return false;
+	}
+
+	ctx.fValid |= 1u << reg;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Undo the unwind codes that have executed at offset
+//
+//  Saved registers are read relative to the fixed frame, which
+//  is the frame register minus its offset once SET_FPREG has
+//  executed, and rsp otherwise.
+//
+static bool ApplyX64UnwindCodes(const X64UnwindInfo & info,
+                                uint32_t offset,
+                                const MemoryReader & mem,
+                                X64Context & ctx,
+                                bool * pfMachframe)
+{
+	uint64_t qwFrame = ctx.rgReg[X64RegRsp];
+
+	if (info.regFrame != 0) {
+		for (const X64UnwindOp & op : info.ops) {
+			if (op.op == X64UnwindOpSetFpreg && op.iCodeOffset <= offset) {
+				if (!(ctx.fValid & (1u << info.regFrame))) {
+					return false;
+				}
+
+				qwFrame = ctx.rgReg[info.regFrame] - info.offFrame;
+			}
+		}
+	}
+
+	for (const X64UnwindOp & op : info.ops) {
+		if (op.iCodeOffset > offset) {
+			continue;
+		}
+
+		switch (op.op) {
+			case X64UnwindOpPushNonvol:
+				if (!RestoreReg(mem, ctx.rgReg[X64RegRsp], op.info, ctx)) {
+					return false;
+				}
+
+				ctx.rgReg[X64RegRsp] += 8;
+				break;
+
+			case X64UnwindOpAllocLarge:
+			case X64UnwindOpAllocSmall:
+				ctx.rgReg[X64RegRsp] += op.dwValue;
+				break;
+
+			case X64UnwindOpSetFpreg:
+				ctx.rgReg[X64RegRsp] = qwFrame;
+				break;
+
+			case X64UnwindOpSaveNonvol:
+			case X64UnwindOpSaveNonvolFar:
+				if (!RestoreReg(mem, qwFrame + op.dwValue, op.info, ctx)) {
+					return false;
+				}
+				break;
+
+			case X64UnwindOpPushMachframe:
+			{
+				uint64_t qwRsp = ctx.rgReg[X64RegRsp] + (op.info ? 8 : 0);
+
+				if (!RestoreReg(mem, qwRsp, X64RegRip, ctx) || !RestoreReg(mem, qwRsp + 24, X64RegRsp, ctx)) {
+					return false;
+				}
+
+				*pfMachframe = true;
+			}
+			break;
+
+			default:
+				// xmm registers are not tracked, epilog codes only
+				//  describe where epilogs are
+				break;
+		}
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// When rip is inside an epilog, finish it by emulation
+//
+//  An epilog is an optional add rsp/lea rsp, pops of integer
+//  registers, and a ret or a jmp out of the function.
+//
+static bool UnwindX64Epilog(const PeImage & image,
+                            uint32_t rva,
+                            const X64RuntimeFunction & function,
+                            const X64UnwindInfo & info,
+                            const MemoryReader & mem,
+                            X64Context & ctx)
+{
+	uint8_t rgCode[64];
+	uint32_t cbCode = sizeof(rgCode);
+
+	// The epilog may run up to the end of the section
+
+	while (cbCode > 0 && !image.Read(rva, rgCode, cbCode)) {
+		cbCode /= 2;
+	}
+
+	if (cbCode < 8) {
+		return false;
+	}
+
+	uint32_t i = 0;
+	uint64_t qwRsp = ctx.rgReg[X64RegRsp];
+
+	if (rgCode[0] == 0x48 && rgCode[1] == 0x83 && rgCode[2] == 0xC4) {
+		qwRsp += (int8_t)rgCode[3];
+		i = 4;
+	}
+
+	else if (rgCode[0] == 0x48 && rgCode[1] == 0x81 && rgCode[2] == 0xC4) {
+		qwRsp += (int32_t)(rgCode[3] | (rgCode[4] << 8) | (rgCode[5] << 16) | ((uint32_t)rgCode[6] << 24));
+		i = 7;
+	}
+
+	else if ((rgCode[0] & 0xFE) == 0x48 && rgCode[1] == 0x8D && ((rgCode[2] >> 3) & 7) == X64RegRsp) {
+		int reg = (rgCode[2] & 7) | ((rgCode[0] & 1) << 3);
+		int mod = rgCode[2] >> 6;
+
+		if (info.regFrame == 0 || reg != info.regFrame || (reg & 7) == X64RegRsp || !(ctx.fValid & (1u << reg))) {
+			return false;
+		}
+
+		if (mod == 1) {
+			qwRsp = ctx.rgReg[reg] + (int8_t)rgCode[3];
+			i = 4;
+		}
+
+		else if (mod == 2) {
+			qwRsp = ctx.rgReg[reg] + (int32_t)(rgCode[3] | (rgCode[4] << 8) | (rgCode[5] << 16) | ((uint32_t)rgCode[6] << 24));
+			i = 7;
+		}
+
+		else {
+			return false;
+		}
+	}
+
+	int rgPop[16];
+	int cPop = 0;
+
+	while (i + 2 < cbCode && cPop < 16) {
+		if ((rgCode[i] & 0xF8) == 0x58) {
+			rgPop[cPop++] = rgCode[i] & 7;
+			i += 1;
+		}
+
+		else if (rgCode[i] == 0x41 && (rgCode[i + 1] & 0xF8) == 0x58) {
+			rgPop[cPop++] = 8 + (rgCode[i + 1] & 7);
+			i += 2;
+		}
+
+		else {
+			break;
+		}
+	}
+
+	if (i + 6 > cbCode) {
+		return false;
+	}
+
+	// The epilog must end the function: ret, or a tail call jmp
+
+	const uint8_t * pb = rgCode + i;
+	bool fEpilog = false;
+
+	if (pb[0] == 0xC3 || pb[0] == 0xC2 || (pb[0] == 0xF3 && pb[1] == 0xC3)) {
+		fEpilog = true;
+	}
+
+	else if (pb[0] == 0xE9 || pb[0] == 0xEB) {
+		int32_t disp = (pb[0] == 0xEB) ? (int8_t)pb[1] : (int32_t)(pb[1] | (pb[2] << 8) | (pb[3] << 16) | ((uint32_t)pb[4] << 24));
+		uint32_t rvaTarget = rva + i + ((pb[0] == 0xEB) ? 2 : 5) + disp;
+
+		fEpilog = rvaTarget < function.rvaBegin || rvaTarget >= function.rvaEnd;
+	}
+
+	else if ((pb[0] == 0xFF && pb[1] == 0x25) || (pb[0] == 0x48 && pb[1] == 0xFF && pb[2] == 0x25)) {
+		fEpilog = true;
+	}
+
+	if (!fEpilog) {
+		return false;
+	}
+
+	X64Context next = ctx;
+
+	for (int iPop = 0; iPop < cPop; iPop++) {
+		if (!RestoreReg(mem, qwRsp, rgPop[iPop], next)) {
+			return false;
+		}
+
+		qwRsp += 8;
+	}
+
+	if (!RestoreReg(mem, qwRsp, X64RegRip, next)) {
+		return false;
+	}
+
+	next.rgReg[X64RegRsp] = qwRsp + 8;
+	ctx = next;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Unwind one x64 frame in place
+//
+//  Functions without a RUNTIME_FUNCTION are leaf functions,
+//  the return address is at rsp.
+//
+bool UnwindX64Frame(const X64UnwindIndex & index,
+                    const PeImage & image,
+                    uint64_t qwImageBase,
+                    const MemoryReader & mem,
+                    X64Context & ctx)
+{
+	const uint32_t fRequired = (1u << X64RegRip) | (1u << X64RegRsp);
+
+	if ((ctx.fValid & fRequired) != fRequired || ctx.rgReg[X64RegRip] - qwImageBase >= image.SizeOfImage()) {
+		return false;
+	}
+
+	uint32_t rva = (uint32_t)(ctx.rgReg[X64RegRip] - qwImageBase);
+	const X64RuntimeFunction * pFunction = index.Find(rva);
+	X64Context next = ctx;
+
+	if (pFunction == NULL) {
+		if (!RestoreReg(mem, next.rgReg[X64RegRsp], X64RegRip, next)) {
+			return false;
+		}
+
+		next.rgReg[X64RegRsp] += 8;
+	}
+
+	else {
+		X64UnwindInfo info;
+		uint32_t offset = rva - pFunction->rvaBegin;
+
+		if (!DecodeX64UnwindInfo(image, pFunction->rvaUnwind, info)) {
+			return false;
+		}
+
+		if (offset < info.cbProlog || !UnwindX64Epilog(image, rva, *pFunction, info, mem, next)) {
+			bool fMachframe = false;
+
+			if (!ApplyX64UnwindCodes(info, offset, mem, next, &fMachframe)) {
+				return false;
+			}
+
+			// Chained entries describe code that runs after the whole
+			//  parent prolog, so all their codes apply
+
+			for (int cChain = 0; info.flags & X64_UNW_FLAG_CHAININFO; cChain++) {
+				if (cChain == X64_CHAIN_MAX || !DecodeX64UnwindInfo(image, info.chained.rvaUnwind, info)) {
+					return false;
+				}
+
+				if (!ApplyX64UnwindCodes(info, 0xFFFFFFFF, mem, next, &fMachframe)) {
+					return false;
+				}
+			}
+
+			if (!fMachframe) {
+				if (!RestoreReg(mem, next.rgReg[X64RegRsp], X64RegRip, next)) {
+					return false;
+				}
+
+				next.rgReg[X64RegRsp] += 8;
+			}
+		}
+	}
+
+	// No progress means a corrupt stack, stop instead of looping
+
+	if (next.rgReg[X64RegRip] == 0 ||
+		(next.rgReg[X64RegRsp] == ctx.rgReg[X64RegRsp] && next.rgReg[X64RegRip] == ctx.rgReg[X64RegRip])) {
+		return false;
+	}
+
+	ctx = next;
+
+	return true;
+}
@@ -0,0 +1,116 @@
+// UnwindX64.h : Decoder and virtual unwinder for x64 exception data
+//
+// Reads RUNTIME_FUNCTION entries from the exception directory of a
+// PE32+ image and the UNWIND_INFO they point to, including chained
+// unwind info, and applies the unwind codes to a register context
+// the same way RtlVirtualUnwind does.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "FrameProgram.h"
+#include "PeImage.h"
+
+// Registers in unwind code numbering
+enum X64Reg
+{
+	X64RegRax,
+	X64RegRcx,
+	X64RegRdx,
+	X64RegRbx,
+	X64RegRsp,
+	X64RegRbp,
+	X64RegRsi,
+	X64RegRdi,
+	X64RegR8,
+	X64RegR15 = X64RegR8 + 7,
+	X64RegRip,
+	X64RegMax
+};
+
+enum X64UnwindOpCode
+{
+	X64UnwindOpPushNonvol,
+	X64UnwindOpAllocLarge,
+	X64UnwindOpAllocSmall,
+	X64UnwindOpSetFpreg,
+	X64UnwindOpSaveNonvol,
+	X64UnwindOpSaveNonvolFar,
+	X64UnwindOpEpilog,                   // version 2 only
+	X64UnwindOpSpareCode,
+	X64UnwindOpSaveXmm128,
+	X64UnwindOpSaveXmm128Far,
+	X64UnwindOpPushMachframe
+};
+
+#define X64_UNW_FLAG_EHANDLER       0x01
+#define X64_UNW_FLAG_UHANDLER       0x02
+#define X64_UNW_FLAG_CHAININFO      0x04
+
+// Chains longer than this are treated as corrupt
+#define X64_CHAIN_MAX               32
+
+// Register state of one frame, fValid has a bit per X64Reg
+struct X64Context
+{
+	uint64_t rgReg[X64RegMax];
+	uint32_t fValid;
+};
+
+struct X64RuntimeFunction
+{
+	uint32_t rvaBegin;
+	uint32_t rvaEnd;
+	uint32_t rvaUnwind;
+};
+
+// One unwind code with its operand decoded
+struct X64UnwindOp
+{
+	uint8_t iCodeOffset;
+	uint8_t op;
+	uint8_t info;
+	uint32_t dwValue;                    // size or frame offset, already scaled
+};
+
+struct X64UnwindInfo
+{
+	uint8_t version;
+	uint8_t flags;
+	uint8_t cbProlog;
+	uint8_t regFrame;
+	uint8_t offFrame;                    // scaled by 16
+	std::vector<X64UnwindOp> ops;
+	uint32_t rvaHandler;
+	X64RuntimeFunction chained;
+};
+
+////////////////////////////////////////////////////////////
+// Function ranges of an image sorted by start address
+//
+class X64UnwindIndex
+{
+	public:
+	bool Load(const PeImage & image);
+
+	const X64RuntimeFunction * Find(uint32_t rva) const;
+
+	size_t Count() const { return m_functions.size(); }
+	const X64RuntimeFunction & Function(size_t i) const { return m_functions[i]; }
+
+	private:
+	std::vector<X64RuntimeFunction> m_functions;
+};
+
+const char * X64RegName(int reg);
+bool DecodeX64UnwindInfo(const PeImage & image, uint32_t rvaUnwind, X64UnwindInfo & info);
+void FormatX64UnwindInfo(const X64UnwindInfo & info, std::string & text);
+bool UnwindX64Frame(const X64UnwindIndex & index,
+                    const PeImage & image,
+                    uint64_t qwImageBase,
+                    const MemoryReader & mem,
+                    X64Context & ctx);
@@ -0,0 +1,92 @@
+// Util.h : Byte order, hashing and thread helpers of the PDB readers
+//
+// The PDB, PE and minidump formats are little endian and their records
+// are not aligned, so every field is read a byte at a time. The FNV-1a
+// hashes are the ones the layout baselines are saved with, they must not
+// change. The parallel passes run a worker on the calling thread and on
+// cThreads - 1 more, the workers take their items from an atomic index.
+//
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#define FNV_OFFSET_BASIS            0xCBF29CE484222325ull
+#define FNV_PRIME                   0x100000001B3ull
+
+inline uint16_t GetU16(const uint8_t * pb)
+{
+	return (uint16_t)(pb[0] | (pb[1] << 8));
+}
+
+inline uint32_t GetU32(const uint8_t * pb)
+{
+	return pb[0] | (pb[1] << 8) | (pb[2] << 16) | ((uint32_t)pb[3] << 24);
+}
+
+inline uint64_t GetU64(const uint8_t * pb)
+{
+	return GetU32(pb) | ((uint64_t)GetU32(pb + 4) << 32);
+}
+
+inline uint64_t HashBytes(uint64_t hash, const void * pv, size_t cb)
+{
+	const uint8_t * pb = (const uint8_t *)pv;
+
+	for (size_t i = 0; i < cb; i++) {
+		hash = (hash ^ pb[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+inline uint64_t HashU64(uint64_t hash, uint64_t value)
+{
+	uint8_t rgb[8];
+
+	for (int i = 0; i < 8; i++) {
+		rgb[i] = (uint8_t)(value >> (i * 8));
+	}
+
+	return HashBytes(hash, rgb, sizeof(rgb));
+}
+
+////////////////////////////////////////////////////////////
+// Run worker(iThread) on cThreads threads, the calling thread
+//  being thread 0, and wait for all of them
+//
+template <typename Worker>
+void RunParallel(unsigned cThreads, Worker worker)
+{
+	std::vector<std::thread> threads;
+
+	for (unsigned i = 1; i < cThreads; i++) {
+		threads.push_back(std::thread(worker, i));
+	}
+
+	worker(0u);
+
+	for (std::thread & thread : threads) {
+		thread.join();
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Call body(iThread, i) for every i below cItems, each item on
+//  the first thread to take it
+//
+template <typename Body>
+void ParallelFor(unsigned cThreads, size_t cItems, Body body)
+{
+	std::atomic<size_t> iNext(0);
+
+	RunParallel((cThreads != 0) ? cThreads : 1, [&](unsigned iThread) {
+		for (size_t i; (i = iNext.fetch_add(1)) < cItems; ) {
+			body(iThread, i);
+		}
+	});
+}
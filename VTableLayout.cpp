@@ -0,0 +1,592 @@
+// VTableLayout.cpp : Virtual function table layouts from the TPI stream
+//
+
+#include "VTableLayout.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+
+#include "Util.h"
+
+#define S_PUB32                     0x110E
+
+#define TPI_PROP_CTOR               0x0002
+
+#define TPI_MOD_CONST               0x0001
+#define TPI_MOD_VOLATILE            0x0002
+#define TPI_PTR_LREF_THIS           0x00100000
+#define TPI_PTR_RREF_THIS           0x00200000
+
+#define TPI_MPROP_VIRTUAL           1
+#define TPI_MPROP_PUREVIRT          5
+
+struct VirtualMethod
+{
+	const char * szName;
+	uint32_t type;
+	uint16_t mprop;
+	int64_t vfOffset;                    // introducing methods only
+};
+
+struct BuildingTable
+{
+	VTable table;
+	std::vector<VTableSlot> slots;
+};
+
+struct ClassTables
+{
+	std::vector<VTable> tables;
+	std::vector<VTableSlot> slots;       // iFirstSlot is relative to these
+};
+
+////////////////////////////////////////////////////////////
+// The cv and ref qualifiers of a method, from the modifiers of
+//  the class its this points to and the attributes of the this
+//  pointer
+//
+static uint32_t GetThisQualifiers(const TpiStream & tpi, uint32_t thisType)
+{
+	uint16_t cb;
+	const uint8_t * pb = tpi.Record(thisType, &cb);
+
+	if (pb == NULL || tpi.Leaf(thisType) != LF_POINTER || cb < 8) {
+		return 0;
+	}
+
+	uint32_t qualifiers = GetU32(pb + 4) & (TPI_PTR_LREF_THIS | TPI_PTR_RREF_THIS);
+	uint32_t tiClass = GetU32(pb);
+
+	pb = tpi.Record(tiClass, &cb);
+
+	if (pb != NULL && tpi.Leaf(tiClass) == LF_MODIFIER && cb >= 6) {
+		qualifiers |= GetU16(pb + 4) & (TPI_MOD_CONST | TPI_MOD_VOLATILE);
+	}
+
+	return qualifiers;
+}
+
+////////////////////////////////////////////////////////////
+// The argument list, this adjustment and qualifiers of a
+//  LF_MFUNCTION, the function attributes in the top byte of
+//  the qualifiers
+//
+static bool GetMethodType(const TpiStream & tpi, uint32_t type, uint32_t * pArgList, int32_t * pThisAdjust, uint32_t * pQualifiers)
+{
+	uint16_t cb;
+	const uint8_t * pb = tpi.Record(type, &cb);
+
+	if (pb == NULL || tpi.Leaf(type) != LF_MFUNCTION || cb < 24) {
+		return false;
+	}
+
+	*pArgList = GetU32(pb + 16);
+	*pThisAdjust = (int32_t)GetU32(pb + 20);
+	*pQualifiers = GetThisQualifiers(tpi, GetU32(pb + 8)) | ((uint32_t)pb[13] << 24);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// The virtual methods a class declares, from its LF_ONEMETHOD
+//  records and the method lists of its LF_METHOD records
+//
+static void GetVirtualMethods(const TpiStream & tpi, const std::vector<TpiField> & fields, std::vector<VirtualMethod> & methods)
+{
+	methods.clear();
+
+	for (const TpiField & field : fields) {
+		if (field.leaf == LF_ONEMETHOD) {
+			uint16_t mprop = (field.attr >> 2) & 7;
+
+			if (mprop == TPI_MPROP_VIRTUAL || mprop == TPI_MPROP_PUREVIRT || mprop == TPI_MPROP_INTRO || mprop == TPI_MPROP_PUREINTRO) {
+				VirtualMethod method = {field.szName, field.type, mprop, field.offset};
+
+				methods.push_back(method);
+			}
+		}
+
+		else if (field.leaf == LF_METHOD) {
+			uint16_t cb;
+			const uint8_t * pb = tpi.Record(field.type, &cb);
+			const uint8_t * pEnd = pb + cb;
+
+			if (pb == NULL || tpi.Leaf(field.type) != LF_METHODLIST) {
+				continue;
+			}
+
+			// attr, padding, type and the vftable offset of the
+			//  introducing ones
+
+			for (uint16_t i = 0; i < field.cMethods && pEnd - pb >= 8; i++) {
+				VirtualMethod method = {field.szName, GetU32(pb + 4), (uint16_t)((GetU16(pb) >> 2) & 7), 0};
+
+				pb += 8;
+
+				if (method.mprop == TPI_MPROP_INTRO || method.mprop == TPI_MPROP_PUREINTRO) {
+					if (pEnd - pb < 4) {
+						break;
+					}
+
+					method.vfOffset = (int32_t)GetU32(pb);
+					pb += 4;
+				}
+
+				if (method.mprop == TPI_MPROP_VIRTUAL || method.mprop == TPI_MPROP_PUREVIRT ||
+					method.mprop == TPI_MPROP_INTRO || method.mprop == TPI_MPROP_PUREINTRO) {
+					methods.push_back(method);
+				}
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Whether a method overrides the function of a slot: same name,
+//  arguments and qualifiers, or both destructors
+//
+static bool Overrides(const TpiStream & tpi, const VirtualMethod & method, uint32_t argList, uint32_t qualifiers, const VTableSlot & slot)
+{
+	uint32_t slotArgList;
+	int32_t thisAdjust;
+	uint32_t slotQualifiers;
+
+	if (slot.szName == NULL) {
+		return false;
+	}
+
+	if (method.szName[0] == '~' && slot.szName[0] == '~') {
+		return true;
+	}
+
+	return !strcmp(method.szName, slot.szName) && GetMethodType(tpi, slot.type, &slotArgList, &thisAdjust, &slotQualifiers) &&
+		slotArgList == argList && slotQualifiers == qualifiers;
+}
+
+////////////////////////////////////////////////////////////
+// Add the copies a base has of the tables of a virtual base to
+//  the ones from the bases before it
+//
+//  A copy already there takes the slots the base fills with a
+//  more derived overrider, so in a diamond the overrides of
+//  both sides are kept.
+//
+static void InheritCopies(const ClassHierarchy & hierarchy, const ClassTables & base, uint32_t iBase, uint32_t iVirtualBase,
+                          std::vector<BuildingTable> & building, size_t iFirstCopy)
+{
+	for (uint32_t iTable = 0; iTable < base.tables.size(); iTable++) {
+		const VTable & table = base.tables[iTable];
+		const VTableSlot * pSlots = base.slots.data() + table.iFirstSlot;
+
+		if (table.iVirtualBase != iVirtualBase) {
+			continue;
+		}
+
+		auto it = std::find_if(building.begin() + iFirstCopy, building.end(),
+			[&](const BuildingTable & copy) { return copy.table.offset == table.offset; });
+
+		if (it == building.end()) {
+			BuildingTable inherited;
+
+			inherited.table = table;
+			inherited.table.iFrom = iBase;
+			inherited.table.iFromTable = iTable;
+			inherited.table.rva = 0;
+			inherited.slots.assign(pSlots, pSlots + table.cSlots);
+			building.push_back(std::move(inherited));
+
+			continue;
+		}
+
+		for (uint32_t iSlot = 0; iSlot < table.cSlots && iSlot < it->slots.size(); iSlot++) {
+			VTableSlot & slot = it->slots[iSlot];
+
+			if (pSlots[iSlot].iOverrider != slot.iOverrider && pSlots[iSlot].iOverrider != VTABLE_NONE &&
+				(slot.iOverrider == VTABLE_NONE || hierarchy.IsDerivedFrom(pSlots[iSlot].iOverrider, slot.iOverrider))) {
+				slot = pSlots[iSlot];
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Build the tables of one class on the tables of its bases
+//
+//  The non-virtual bases bring their tables at their offset, the
+//  virtual bases, direct or not, theirs once: the copies the other
+//  bases have, with their overrides, or the virtual base's own
+//  when no base has one. A class with its own vfptr starts a table
+//  at offset 0, which is where the primary table is and where the
+//  new virtual functions go.
+//
+static void BuildClass(const ClassHierarchy & hierarchy, const TpiStream & tpi, uint32_t cbPointer, uint32_t iClass,
+                       std::vector<ClassTables> & classes, std::vector<TpiField> & fields, std::vector<VirtualMethod> & methods)
+{
+	std::vector<BuildingTable> building;
+	TpiUdt udt;
+	bool fUdt = tpi.GetUdt(hierarchy.Type(iClass), udt);
+	bool fVfptr = false;
+
+	fields.clear();
+
+	if (fUdt && udt.fieldList != 0) {
+		tpi.GetFields(udt.fieldList, fields);
+	}
+
+	// With /vd1, the default, a class declaring a constructor or a
+	//  destructor has a vtordisp in front of every virtual base whose
+	//  functions it overrides. /vd0 and #pragma vtordisp are not in
+	//  the types.
+
+	bool fVtordisp = fUdt && (udt.property & TPI_PROP_CTOR) != 0;
+
+	for (const TpiField & field : fields) {
+		fVfptr = fVfptr || field.leaf == LF_VFUNCTAB;
+	}
+
+	GetVirtualMethods(tpi, fields, methods);
+
+	if (fVfptr) {
+		BuildingTable own;
+
+		own.table = {0, VTABLE_NONE, VTABLE_NONE, 0, 0, 0, 0};
+		building.push_back(own);
+	}
+
+	uint32_t cBases;
+	const HierarchyEdge * pBases = hierarchy.Bases(iClass, &cBases);
+
+	for (int fVirtual = 0; fVirtual < 2; fVirtual++) {
+		for (uint32_t i = 0; i < cBases; i++) {
+			const HierarchyEdge & edge = pBases[i];
+
+			// Bases in a cycle, which only bad records make, are not
+			//  built yet
+
+			if ((edge.kind != HIERARCHY_BASE) != (fVirtual != 0) || hierarchy.Depth(edge.iClass) >= hierarchy.Depth(iClass)) {
+				continue;
+			}
+
+			// A virtual base comes with the overrides of the bases it
+			//  is inherited through, from their copies of its tables
+
+			if (fVirtual) {
+				size_t iFirstCopy = building.size();
+
+				for (uint32_t j = 0; j < cBases; j++) {
+					if (j != i && hierarchy.Depth(pBases[j].iClass) < hierarchy.Depth(iClass)) {
+						InheritCopies(hierarchy, classes[pBases[j].iClass], pBases[j].iClass, edge.iClass, building, iFirstCopy);
+					}
+				}
+
+				if (building.size() != iFirstCopy) {
+					continue;
+				}
+			}
+
+			const ClassTables & base = classes[edge.iClass];
+
+			for (uint32_t iTable = 0; iTable < base.tables.size(); iTable++) {
+				const VTable & table = base.tables[iTable];
+				BuildingTable inherited;
+
+				if (table.iVirtualBase != VTABLE_NONE) {
+					continue;
+				}
+
+				inherited.table = table;
+				inherited.table.iFrom = edge.iClass;
+				inherited.table.iFromTable = iTable;
+				inherited.table.rva = 0;
+
+				if (fVirtual) {
+					inherited.table.iVirtualBase = edge.iClass;
+				}
+
+				else {
+					inherited.table.offset += (uint64_t)edge.offset;
+				}
+
+				inherited.slots.assign(base.slots.begin() + table.iFirstSlot, base.slots.begin() + table.iFirstSlot + table.cSlots);
+				building.push_back(std::move(inherited));
+			}
+		}
+	}
+
+	BuildingTable * pPrimary = NULL;
+
+	for (BuildingTable & table : building) {
+		if (pPrimary == NULL && table.table.iVirtualBase == VTABLE_NONE && table.table.offset == 0) {
+			pPrimary = &table;
+		}
+	}
+
+	for (const VirtualMethod & method : methods) {
+		uint32_t argList = 0;
+		int32_t thisAdjust = 0;
+		uint32_t qualifiers = 0;
+		bool fPure = method.mprop == TPI_MPROP_PUREVIRT || method.mprop == TPI_MPROP_PUREINTRO;
+
+		GetMethodType(tpi, method.type, &argList, &thisAdjust, &qualifiers);
+
+		if (method.mprop == TPI_MPROP_INTRO || method.mprop == TPI_MPROP_PUREINTRO) {
+			if (pPrimary == NULL) {
+				BuildingTable own;
+
+				own.table = {0, VTABLE_NONE, VTABLE_NONE, 0, 0, 0, 0};
+				building.insert(building.begin(), own);
+				pPrimary = &building[0];
+			}
+
+			uint32_t iSlot = (uint32_t)(method.vfOffset / cbPointer);
+			VTableSlot slot = {method.szName, method.type, iClass, iClass, 0, fPure, false};
+
+			if (method.vfOffset < 0 || iSlot > 0xFFFF) {
+				continue;
+			}
+
+			if (iSlot >= pPrimary->slots.size()) {
+				VTableSlot empty = {NULL, 0, VTABLE_NONE, VTABLE_NONE, 0, false, false};
+
+				pPrimary->slots.resize(iSlot + 1, empty);
+			}
+
+			pPrimary->slots[iSlot] = slot;
+
+			continue;
+		}
+
+		// An override fills the slots of the function in every table
+		//  it appears in, through a thunk where the table is not at
+		//  the subobject the function expects
+
+		for (BuildingTable & table : building) {
+			for (VTableSlot & slot : table.slots) {
+				if (Overrides(tpi, method, argList, qualifiers, slot)) {
+					slot.szName = method.szName;
+					slot.type = method.type;
+					slot.iOverrider = iClass;
+					slot.fPure = fPure;
+					slot.fVtordisp = fVtordisp && table.table.iVirtualBase != VTABLE_NONE;
+					slot.thisAdjust = (int64_t)table.table.offset - thisAdjust;
+				}
+			}
+		}
+	}
+
+	ClassTables & result = classes[iClass];
+
+	for (BuildingTable & table : building) {
+		table.table.iFirstSlot = (uint32_t)result.slots.size();
+		table.table.cSlots = (uint32_t)table.slots.size();
+		result.tables.push_back(table.table);
+		result.slots.insert(result.slots.end(), table.slots.begin(), table.slots.end());
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Build the tables of every class, a depth of the hierarchy at a
+//  time
+//
+bool VTableLayout::Build(const ClassHierarchy & hierarchy, const TpiStream & tpi, uint32_t cbPointer, unsigned cThreads)
+{
+	Clear();
+
+	if (cThreads == 0) {
+		cThreads = 1;
+	}
+
+	if (cbPointer == 0) {
+		cbPointer = 4;
+	}
+
+	m_pHierarchy = &hierarchy;
+	m_pTpi = &tpi;
+
+	uint32_t cClasses = hierarchy.CountClasses();
+	std::vector<ClassTables> classes(cClasses);
+	std::vector<std::vector<uint32_t> > levels;
+
+	for (uint32_t iClass = 0; iClass < cClasses; iClass++) {
+		if (hierarchy.Depth(iClass) >= levels.size()) {
+			levels.resize(hierarchy.Depth(iClass) + 1);
+		}
+
+		levels[hierarchy.Depth(iClass)].push_back(iClass);
+	}
+
+	for (const std::vector<uint32_t> & level : levels) {
+		std::atomic<uint32_t> iNext(0);
+
+		auto worker = [&](unsigned) {
+			std::vector<TpiField> fields;
+			std::vector<VirtualMethod> methods;
+
+			for (uint32_t i; (i = iNext++) < level.size(); ) {
+				BuildClass(hierarchy, tpi, cbPointer, level[i], classes, fields, methods);
+			}
+		};
+
+		RunParallel((unsigned)std::min<size_t>(cThreads, level.size()), worker);
+	}
+
+	m_tableStart.push_back(0);
+
+	for (ClassTables & result : classes) {
+		uint32_t iFirstSlot = (uint32_t)m_slots.size();
+
+		for (VTable & table : result.tables) {
+			table.iFirstSlot += iFirstSlot;
+			m_tables.push_back(table);
+		}
+
+		m_slots.insert(m_slots.end(), result.slots.begin(), result.slots.end());
+		m_tableStart.push_back((uint32_t)m_tables.size());
+		std::vector<VTable>().swap(result.tables);
+		std::vector<VTableSlot>().swap(result.slots);
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// The decorated name of a class as it appears in its vftable
+//  publics, "Bar@Foo@@" for Foo::Bar
+//
+//  The unique name of the type is its type descriptor name,
+//  ".?AVBar@Foo@@", which is the same. Template names without
+//  one are not spelled out.
+//
+static bool GetDecoratedName(const TpiStream & tpi, uint32_t ti, std::string & name)
+{
+	TpiUdt udt;
+
+	name.clear();
+
+	if (!tpi.GetUdt(ti, udt)) {
+		return false;
+	}
+
+	if (!strncmp(udt.szUniqueName, ".?A", 3) && strlen(udt.szUniqueName) > 4) {
+		name = udt.szUniqueName + 4;
+
+		return true;
+	}
+
+	if (strchr(udt.szName, '<') != NULL) {
+		return false;
+	}
+
+	std::vector<std::string> scopes;
+
+	for (const char * pch = udt.szName; ; ) {
+		const char * pchEnd = strstr(pch, "::");
+
+		if (pchEnd == NULL) {
+			scopes.push_back(pch);
+			break;
+		}
+
+		scopes.push_back(std::string(pch, pchEnd));
+		pch = pchEnd + 2;
+	}
+
+	for (size_t i = scopes.size(); i > 0; i--) {
+		name += scopes[i - 1] + "@";
+	}
+
+	name += "@";
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Find the RVA of every table in the ??_7 vftable publics
+//
+//  A class with one table has "??_7Foo@@6B@", the tables of a
+//  class with several are named after a base they come from,
+//  "??_7Foo@@6BBar@@@", which may be any class of the chain the
+//  table was inherited along.
+//
+uint32_t VTableLayout::MatchPublics(const PdbFile & pdb)
+{
+	std::vector<uint8_t> records;
+	std::unordered_map<std::string, uint32_t> publics;
+	uint32_t cMatched = 0;
+
+	if (m_pTpi == NULL || pdb.SymRecordStream() == PDB_STREAM_NONE || !pdb.ReadStream(pdb.SymRecordStream(), records)) {
+		return 0;
+	}
+
+	for (size_t off = 0; off + 4 <= records.size(); ) {
+		const uint8_t * pRecord = &records[off];
+		uint16_t cbRecord = GetU16(pRecord);
+		uint32_t rva;
+
+		if (cbRecord < 2 || off + 2 + cbRecord > records.size()) {
+			break;
+		}
+
+		if (cbRecord >= 17 && GetU16(pRecord + 2) == S_PUB32 && !memcmp(pRecord + 14, "??_7", 4) &&
+			memchr(pRecord + 14, '\0', cbRecord - 12) != NULL && pdb.SectionToRva(GetU16(pRecord + 12), GetU32(pRecord + 8), &rva)) {
+			publics.emplace((const char *)pRecord + 14, rva);
+		}
+
+		off += 2 + cbRecord;
+	}
+
+	std::string decorated;
+	std::string base;
+
+	for (uint32_t iClass = 0; iClass + 1 < m_tableStart.size(); iClass++) {
+		uint32_t cTables = m_tableStart[iClass + 1] - m_tableStart[iClass];
+
+		if (cTables == 0 || !GetDecoratedName(*m_pTpi, m_pHierarchy->Type(iClass), decorated)) {
+			continue;
+		}
+
+		for (uint32_t iTable = m_tableStart[iClass]; iTable < m_tableStart[iClass + 1]; iTable++) {
+			VTable & table = m_tables[iTable];
+			std::string prefix = "??_7" + decorated + "6B";
+			auto it = publics.end();
+
+			if (cTables == 1) {
+				it = publics.find(prefix + "@");
+			}
+
+			for (const VTable * pChain = &table; it == publics.end() && pChain->iFrom != VTABLE_NONE; ) {
+				if (GetDecoratedName(*m_pTpi, m_pHierarchy->Type(pChain->iFrom), base)) {
+					it = publics.find(prefix + base + "@");
+				}
+
+				pChain = &m_tables[m_tableStart[pChain->iFrom] + pChain->iFromTable];
+			}
+
+			if (it != publics.end()) {
+				table.rva = it->second;
+				cMatched++;
+			}
+		}
+	}
+
+	return cMatched;
+}
+
+void VTableLayout::Clear()
+{
+	m_pHierarchy = NULL;
+	m_pTpi = NULL;
+	std::vector<uint32_t>().swap(m_tableStart);
+	std::vector<VTable>().swap(m_tables);
+	std::vector<VTableSlot>().swap(m_slots);
+}
+
+const VTable * VTableLayout::Tables(uint32_t iClass, uint32_t * pcTables) const
+{
+	*pcTables = m_tableStart[iClass + 1] - m_tableStart[iClass];
+
+	return m_tables.data() + m_tableStart[iClass];
+}
@@ -0,0 +1,69 @@
+// VTableLayout.h : Virtual function table layouts from the TPI stream
+//
+// Rebuilds the vftables of every polymorphic class: one per vfptr of
+// the class, with the slot index, the class introducing each slot, the
+// class whose function fills it and the this adjustment a thunk makes
+// when the function was written for another subobject. A class starts
+// from the tables of its bases and only applies its own overrides and
+// new virtual functions, so the classes are built a depth at a time,
+// each depth in parallel, on the tables of the depth before. The
+// tables are matched to the ??_7 vftable publics for their RVA.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "ClassHierarchy.h"
+#include "PdbFile.h"
+
+#define VTABLE_NONE                 0xFFFFFFFF
+
+struct VTableSlot
+{
+	const char * szName;
+	uint32_t type;                       // LF_MFUNCTION of the function in the slot
+	uint32_t iIntroducer;                // classes of the ClassHierarchy
+	uint32_t iOverrider;
+	int64_t thisAdjust;                  // subtracted from this by the thunk, 0 when none
+	bool fPure;
+	bool fVtordisp;                      // the thunk first subtracts the vtordisp in front of the virtual base
+};
+
+struct VTable
+{
+	uint64_t offset;                     // of the vfptr, in the virtual base for fVirtualBase
+	uint32_t iVirtualBase;               // class of the virtual base holding it, VTABLE_NONE when none
+	uint32_t iFrom;                      // base class it was inherited from, VTABLE_NONE when introduced
+	uint32_t iFromTable;                 // its index in the tables of that base
+	uint32_t iFirstSlot;
+	uint32_t cSlots;
+	uint32_t rva;                        // of the matching vftable public, 0 when none
+};
+
+////////////////////////////////////////////////////////////
+// The vftables of all the classes of a ClassHierarchy
+//
+//  Overriders are found by name, argument list and the cv and
+//  ref qualifiers, and any destructor overrides a destructor.
+//
+class VTableLayout
+{
+	public:
+	bool Build(const ClassHierarchy & hierarchy, const TpiStream & tpi, uint32_t cbPointer, unsigned cThreads);
+	uint32_t MatchPublics(const PdbFile & pdb);
+	void Clear();
+
+	uint32_t CountTables() const { return (uint32_t)m_tables.size(); }
+	uint32_t CountSlots() const { return (uint32_t)m_slots.size(); }
+	const VTable * Tables(uint32_t iClass, uint32_t * pcTables) const;
+	const VTableSlot * Slots(const VTable & table) const { return m_slots.data() + table.iFirstSlot; }
+
+	private:
+	const ClassHierarchy * m_pHierarchy = NULL;
+	const TpiStream * m_pTpi = NULL;
+	std::vector<uint32_t> m_tableStart;  // per class, and one past the last
+	std::vector<VTable> m_tables;
+	std::vector<VTableSlot> m_slots;
+};
@@ -0,0 +1,551 @@
+// ValueRenderer.cpp : Typed rendering of captured memory
+//
+
+#include "ValueRenderer.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include "Util.h"
+
+#define RENDER_MAX_STRING           256
+
+static uint64_t GetValue(const uint8_t * pb, uint64_t cb)
+{
+	uint64_t value = 0;
+
+	for (uint64_t i = (cb < 8) ? cb : 8; i > 0; i--) {
+		value = (value << 8) | pb[i - 1];
+	}
+
+	return value;
+}
+
+////////////////////////////////////////////////////////////
+// Classify the basic types, false for the ones without a value
+//
+static bool SimpleScalar(uint32_t ti, uint8_t * pScalar)
+{
+	switch (ti & 0xFF) {
+		case 0x10: case 0x11: case 0x12: case 0x13: case 0x68: case 0x72: case 0x74: case 0x76: case 0x08:
+			*pScalar = RENDER_SIGNED;
+			return true;
+
+		case 0x20: case 0x21: case 0x22: case 0x23: case 0x69: case 0x73: case 0x75: case 0x77:
+			*pScalar = RENDER_UNSIGNED;
+			return true;
+
+		case 0x40: case 0x41:
+			*pScalar = RENDER_FLOAT;
+			return true;
+
+		case 0x30: case 0x31: case 0x32: case 0x33:
+			*pScalar = RENDER_BOOL;
+			return true;
+
+		case 0x70: case 0x71: case 0x7A: case 0x7B: case 0x7C:
+			*pScalar = RENDER_CHAR;
+			return true;
+	}
+
+	return false;
+}
+
+static void AppendIndent(int indent, std::string & text)
+{
+	text.append((size_t)indent * 2, ' ');
+}
+
+ValueRenderer::ValueRenderer(const LayoutCache & cache, const MemorySnapshot & memory) :
+	m_cache(cache), m_tpi(*cache.Types()), m_memory(memory)
+{
+}
+
+////////////////////////////////////////////////////////////
+// The rendering description of a type, decoded on first use
+//
+const RenderType & ValueRenderer::Describe(uint32_t ti)
+{
+	auto it = m_types.find(ti);
+
+	if (it != m_types.end()) {
+		return it->second;
+	}
+
+	RenderType type;
+	uint16_t cb;
+	const uint8_t * pb = m_tpi.Record(ti, &cb);
+	TpiUdt udt;
+
+	type.kind = RENDER_UNKNOWN;
+	type.scalar = RENDER_UNSIGNED;
+	type.cb = m_tpi.TypeSize(ti);
+	type.target = 0;
+	type.cElements = 0;
+	type.pLayout = NULL;
+
+	// Recorded before recursing, a pointer cycle ends on it
+
+	m_types[ti] = type;
+	m_tpi.TypeName(ti, type.name);
+
+	if (ti < m_tpi.FirstIndex()) {
+		if ((ti >> 8) & 0xF) {
+			type.kind = RENDER_POINTER;
+			type.target = ti & 0xFF;
+		}
+
+		else if (SimpleScalar(ti, &type.scalar) && type.cb != 0 && type.cb <= 8) {
+			type.kind = RENDER_SCALAR;
+		}
+	}
+
+	else if (pb != NULL) {
+		switch (m_tpi.Leaf(ti)) {
+			case LF_MODIFIER:
+			case LF_BITFIELD:
+				if (cb >= 4) {
+					std::string name;
+
+					name.swap(type.name);
+					type = Describe(GetU32(pb));
+					type.name.swap(name);
+				}
+
+				break;
+
+			case LF_POINTER:
+				// Pointers to members have no target to follow
+
+				if (cb >= 8 && ((GetU32(pb + 4) >> 5) & 0x7) < 2) {
+					type.kind = RENDER_POINTER;
+					type.target = GetU32(pb);
+				}
+
+				break;
+
+			case LF_ARRAY:
+				if (cb >= 4) {
+					const RenderType & element = Describe(GetU32(pb));
+
+					type.kind = RENDER_ARRAY;
+					type.target = GetU32(pb);
+					type.cElements = (element.cb != 0) ? type.cb / element.cb : 0;
+					type.scalar = (element.kind == RENDER_SCALAR) ? element.scalar : RENDER_UNSIGNED;
+				}
+
+				break;
+
+			case LF_ENUM:
+				if (m_tpi.GetUdt(m_tpi.Definition(ti), udt)) {
+					std::vector<TpiField> fields;
+
+					type.kind = RENDER_ENUM;
+					type.target = udt.underlying;
+					type.scalar = Describe(udt.underlying).scalar;
+
+					if (m_tpi.GetFields(udt.fieldList, fields)) {
+						for (const TpiField & field : fields) {
+							if (field.leaf == LF_ENUMERATE) {
+								type.enumerators.push_back(std::make_pair(field.offset, field.szName));
+							}
+						}
+					}
+
+					std::stable_sort(type.enumerators.begin(), type.enumerators.end(),
+						[](const std::pair<int64_t, const char *> & a, const std::pair<int64_t, const char *> & b) { return a.first < b.first; });
+				}
+
+				break;
+
+			default:
+				if (IsUdtLeaf(m_tpi.Leaf(ti)) && (type.pLayout = m_cache.Find(ti)) != NULL) {
+					type.kind = RENDER_UDT;
+				}
+
+				break;
+		}
+	}
+
+	RenderType & entry = m_types[ti];
+
+	entry = std::move(type);
+
+	return entry;
+}
+
+////////////////////////////////////////////////////////////
+// Append a scalar or enum value
+//
+void ValueRenderer::FormatScalar(const RenderType & type, uint64_t value, std::string & text)
+{
+	char szValue[64];
+
+	// Sign extend from the size of the type
+
+	if (type.scalar == RENDER_SIGNED && type.cb < 8 && (value >> (type.cb * 8 - 1)) & 1) {
+		value |= ~0ULL << (type.cb * 8);
+	}
+
+	if (type.kind == RENDER_ENUM) {
+		auto it = std::lower_bound(type.enumerators.begin(), type.enumerators.end(), std::make_pair((int64_t)value, (const char *)NULL),
+			[](const std::pair<int64_t, const char *> & a, const std::pair<int64_t, const char *> & b) { return a.first < b.first; });
+
+		if (it != type.enumerators.end() && it->first == (int64_t)value) {
+			text += it->second;
+
+			return;
+		}
+
+		// Flags, when every set bit has its own enumerator
+
+		std::string flags;
+		uint64_t remaining = value;
+
+		for (const auto & enumerator : type.enumerators) {
+			uint64_t bit = (uint64_t)enumerator.first;
+
+			if (bit != 0 && (bit & (bit - 1)) == 0 && (remaining & bit)) {
+				flags += flags.empty() ? "" : " | ";
+				flags += enumerator.second;
+				remaining &= ~bit;
+			}
+		}
+
+		if (value != 0 && remaining == 0) {
+			text += flags;
+
+			return;
+		}
+
+		snprintf(szValue, sizeof(szValue), "0x%llX", (unsigned long long)value);
+		text += szValue;
+
+		return;
+	}
+
+	switch (type.scalar) {
+		case RENDER_SIGNED:
+			snprintf(szValue, sizeof(szValue), "%lld", (long long)value);
+			break;
+
+		case RENDER_FLOAT:
+			if (type.cb == 4) {
+				uint32_t bits = (uint32_t)value;
+				float f;
+
+				memcpy(&f, &bits, sizeof(f));
+				snprintf(szValue, sizeof(szValue), "%g", f);
+			}
+
+			else {
+				double d;
+
+				memcpy(&d, &value, sizeof(d));
+				snprintf(szValue, sizeof(szValue), "%g", d);
+			}
+
+			break;
+
+		case RENDER_BOOL:
+			if (value <= 1) {
+				snprintf(szValue, sizeof(szValue), "%s", value ? "true" : "false");
+			}
+
+			else {
+				snprintf(szValue, sizeof(szValue), "true (0x%llX)", (unsigned long long)value);
+			}
+
+			break;
+
+		case RENDER_CHAR:
+			if (value >= 0x20 && value < 0x7F) {
+				snprintf(szValue, sizeof(szValue), "%llu '%c'", (unsigned long long)value, (int)value);
+			}
+
+			else {
+				snprintf(szValue, sizeof(szValue), "%llu", (unsigned long long)value);
+			}
+
+			break;
+
+		default:
+			snprintf(szValue, sizeof(szValue), "%llu", (unsigned long long)value);
+			break;
+	}
+
+	text += szValue;
+}
+
+////////////////////////////////////////////////////////////
+// Append the characters up to a NUL, escaping the others
+//
+static void AppendString(const MemorySnapshot & memory, uint64_t qwAddress, const uint8_t * pb, uint64_t cbChar, uint64_t cMax,
+                         std::string & text)
+{
+	char szEscape[24];
+
+	text += '"';
+
+	for (uint64_t i = 0; i < cMax; i++) {
+		const uint8_t * pbChar = (pb != NULL) ? pb + i * cbChar : memory.Pointer(qwAddress + i * cbChar, cbChar);
+
+		if (pbChar == NULL) {
+			text += "...";
+			break;
+		}
+
+		uint64_t ch = GetValue(pbChar, cbChar);
+
+		if (ch == 0) {
+			break;
+		}
+
+		if (ch >= 0x20 && ch < 0x7F && ch != '"' && ch != '\\') {
+			text += (char)ch;
+		}
+
+		else {
+			snprintf(szEscape, sizeof(szEscape), "\\x%llX", (unsigned long long)ch);
+			text += szEscape;
+		}
+	}
+
+	text += '"';
+}
+
+void ValueRenderer::RenderBitfield(const LayoutMember & member, const uint8_t * pb, int indent, std::string & text)
+{
+	const RenderType & type = Describe(member.type);
+	char szBits[32];
+
+	AppendIndent(indent, text);
+	text += member.szName;
+	text += " : ";
+	text += type.name;
+	snprintf(szBits, sizeof(szBits), " : %u = ", member.cBits);
+	text += szBits;
+
+	if (pb == NULL || member.cb > 8) {
+		text += "<not captured>\n";
+
+		return;
+	}
+
+	uint64_t value = GetValue(pb, member.cb) >> member.bitPos;
+	RenderType bitfield = type;
+
+	if (member.cBits < 64) {
+		value &= (1ULL << member.cBits) - 1;
+	}
+
+	// Sign extend from the width of the bitfield
+
+	if (bitfield.scalar == RENDER_SIGNED && member.cBits < 64 && (value >> (member.cBits - 1)) & 1) {
+		value |= ~0ULL << member.cBits;
+	}
+
+	bitfield.cb = 8;
+	FormatScalar(bitfield, value, text);
+	text += '\n';
+}
+
+////////////////////////////////////////////////////////////
+// Append "name : type = value" and the members, elements or
+//  pointee below it
+//
+//  pb is the value in the snapshot when the enclosing object was
+//  captured whole, otherwise the value is looked up by address.
+//
+void ValueRenderer::RenderValue(const char * szName, uint32_t ti, uint64_t qwAddress, const uint8_t * pb, int indent, int depth,
+                                std::string & text)
+{
+	const RenderType & type = Describe(ti);
+	char szValue[64];
+
+	if (pb == NULL && type.cb != 0) {
+		pb = m_memory.Pointer(qwAddress, type.cb);
+	}
+
+	AppendIndent(indent, text);
+	text += szName;
+	text += " : ";
+	text += type.name;
+
+	switch (type.kind) {
+		case RENDER_SCALAR:
+		case RENDER_ENUM:
+			text += " = ";
+
+			if (pb == NULL) {
+				text += "<not captured>";
+			}
+
+			else {
+				FormatScalar(type, GetValue(pb, type.cb), text);
+			}
+
+			text += '\n';
+			break;
+
+		case RENDER_POINTER: {
+			if (pb == NULL) {
+				text += " = <not captured>\n";
+				break;
+			}
+
+			uint64_t value = GetValue(pb, type.cb);
+			const RenderType & target = Describe(type.target);
+
+			snprintf(szValue, sizeof(szValue), " = 0x%0*llX", (int)type.cb * 2, (unsigned long long)value);
+			text += szValue;
+
+			if (value != 0 && target.kind == RENDER_SCALAR && target.scalar == RENDER_CHAR) {
+				text += ' ';
+				AppendString(m_memory, value, NULL, target.cb, RENDER_MAX_STRING, text);
+				text += '\n';
+			}
+
+			else {
+				text += '\n';
+
+				if (value != 0 && depth < m_pointerDepth && target.kind != RENDER_UNKNOWN) {
+					RenderValue("*", type.target, value, NULL, indent + 1, depth + 1, text);
+				}
+			}
+
+			break;
+		}
+
+		case RENDER_ARRAY: {
+			const RenderType & element = Describe(type.target);
+
+			snprintf(szValue, sizeof(szValue), " (%llu elements)", (unsigned long long)type.cElements);
+			text += szValue;
+
+			// Strings and scalars on one line, the others one per element
+
+			if (element.kind == RENDER_SCALAR && element.scalar == RENDER_CHAR) {
+				text += " = ";
+				AppendString(m_memory, qwAddress, pb, element.cb, type.cElements, text);
+				text += '\n';
+				break;
+			}
+
+			if (element.kind == RENDER_SCALAR || element.kind == RENDER_ENUM || element.kind == RENDER_POINTER) {
+				text += " = {";
+
+				for (uint64_t i = 0; i < type.cElements && i < m_maxElements; i++) {
+					const uint8_t * pbElement = (pb != NULL) ? pb + i * element.cb : m_memory.Pointer(qwAddress + i * element.cb, element.cb);
+
+					text += (i != 0) ? ", " : "";
+
+					if (pbElement == NULL) {
+						text += "?";
+					}
+
+					else if (element.kind == RENDER_POINTER) {
+						snprintf(szValue, sizeof(szValue), "0x%llX", (unsigned long long)GetValue(pbElement, element.cb));
+						text += szValue;
+					}
+
+					else {
+						FormatScalar(element, GetValue(pbElement, element.cb), text);
+					}
+				}
+
+				if (type.cElements > m_maxElements) {
+					snprintf(szValue, sizeof(szValue), ", ... %llu more", (unsigned long long)(type.cElements - m_maxElements));
+					text += szValue;
+				}
+
+				text += "}\n";
+				break;
+			}
+
+			text += '\n';
+
+			for (uint64_t i = 0; i < type.cElements && i < m_maxElements; i++) {
+				snprintf(szValue, sizeof(szValue), "[%llu]", (unsigned long long)i);
+				RenderValue(szValue, type.target, qwAddress + i * element.cb, (pb != NULL) ? pb + i * element.cb : NULL,
+					indent + 1, depth, text);
+			}
+
+			if (type.cElements > m_maxElements) {
+				AppendIndent(indent + 1, text);
+				snprintf(szValue, sizeof(szValue), "... %llu more\n", (unsigned long long)(type.cElements - m_maxElements));
+				text += szValue;
+			}
+
+			break;
+		}
+
+		case RENDER_UDT: {
+			const LayoutMember * pMembers = m_cache.Members(*type.pLayout);
+
+			if (pb == NULL) {
+				text += " = <not captured>\n";
+				break;
+			}
+
+			text += '\n';
+
+			for (uint32_t i = 0; i < type.pLayout->cMembers; i++) {
+				const LayoutMember & member = pMembers[i];
+				const uint8_t * pbMember = (pb != NULL) ? pb + member.offset : NULL;
+
+				switch (member.kind) {
+					case LAYOUT_BASE:
+						RenderValue("<base>", member.type, qwAddress + member.offset, pbMember, indent + 1, depth, text);
+						break;
+
+					case LAYOUT_VFPTR:
+					case LAYOUT_VBPTR:
+						AppendIndent(indent + 1, text);
+						text += member.szName;
+
+						if (pbMember == NULL || member.cb == 0 || member.cb > 8) {
+							text += " = <not captured>\n";
+						}
+
+						else {
+							snprintf(szValue, sizeof(szValue), " = 0x%0*llX\n", (int)member.cb * 2, (unsigned long long)GetValue(pbMember, member.cb));
+							text += szValue;
+						}
+
+						break;
+
+					default:
+						if (member.cBits != 0) {
+							RenderBitfield(member, pbMember, indent + 1, text);
+						}
+
+						else {
+							RenderValue(member.szName, member.type, qwAddress + member.offset, pbMember, indent + 1, depth, text);
+						}
+
+						break;
+				}
+			}
+
+			break;
+		}
+
+		default:
+			text += '\n';
+			break;
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Render the object of a type at an address, appending to text
+//
+void ValueRenderer::Render(uint64_t qwAddress, uint32_t type, const char * szName, std::string & text)
+{
+	char szAddress[32];
+
+	snprintf(szAddress, sizeof(szAddress), "0x%016llX ", (unsigned long long)qwAddress);
+	text += szAddress;
+	RenderValue(szName, type, qwAddress, NULL, 0, 0, text);
+}
@@ -0,0 +1,80 @@
+// ValueRenderer.h : Typed rendering of captured memory
+//
+// Renders the object at an address of a minidump or raw memory dump
+// as a tree of typed values, using the TPI types of its PDB: members
+// and base classes, arrays with their element count, enums by their
+// enumerator names and pointers followed to a given depth. The bytes
+// are read in place from the MemorySnapshot. What every type needs to
+// be rendered is worked out once and kept, so rendering many objects
+// of the same types only decodes the memory.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "FrameProgram.h"
+#include "LayoutCache.h"
+
+#define RENDER_UNKNOWN              0
+#define RENDER_SCALAR               1
+#define RENDER_POINTER              2
+#define RENDER_ENUM                 3
+#define RENDER_ARRAY                4
+#define RENDER_UDT                  5
+
+#define RENDER_SIGNED               0
+#define RENDER_UNSIGNED             1
+#define RENDER_FLOAT                2
+#define RENDER_BOOL                 3
+#define RENDER_CHAR                 4
+
+#define RENDER_POINTER_DEPTH        1
+#define RENDER_MAX_ELEMENTS         32
+
+// What rendering a type needs, decoded once per type index
+struct RenderType
+{
+	uint8_t kind;
+	uint8_t scalar;                      // RENDER_SIGNED... for scalars, enums and char arrays
+	uint64_t cb;
+	uint32_t target;                     // pointee, array element or enum underlying type
+	uint64_t cElements;
+	const UdtLayout * pLayout;
+	std::string name;
+	std::vector<std::pair<int64_t, const char *> > enumerators;   // by value
+};
+
+////////////////////////////////////////////////////////////
+// Renders typed values out of captured memory
+//
+//  Not thread safe, the type descriptions are filled in as they
+//  are first needed.
+//
+class ValueRenderer
+{
+	public:
+	ValueRenderer(const LayoutCache & cache, const MemorySnapshot & memory);
+
+	void SetPointerDepth(int depth) { m_pointerDepth = depth; }
+	void SetMaxElements(uint32_t cElements) { m_maxElements = cElements; }
+	void Render(uint64_t qwAddress, uint32_t type, const char * szName, std::string & text);
+	uint32_t CountTypes() const { return (uint32_t)m_types.size(); }
+
+	private:
+	const RenderType & Describe(uint32_t ti);
+	void RenderValue(const char * szName, uint32_t ti, uint64_t qwAddress, const uint8_t * pb, int indent, int depth, std::string & text);
+	void RenderBitfield(const LayoutMember & member, const uint8_t * pb, int indent, std::string & text);
+	void FormatScalar(const RenderType & type, uint64_t value, std::string & text);
+
+	const LayoutCache & m_cache;
+	const TpiStream & m_tpi;
+	const MemorySnapshot & m_memory;
+	std::unordered_map<uint32_t, RenderType> m_types;
+	int m_pointerDepth = RENDER_POINTER_DEPTH;
+	uint32_t m_maxElements = RENDER_MAX_ELEMENTS;
+};